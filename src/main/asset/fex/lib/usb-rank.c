@@ -1,5 +1,7 @@
 #define LOG_MODULE "fex-profile-rank"
 
+#include "crypt/usb-profile.h"
+
 #include "usb-rank.h"
 
 struct asset_fex_usb_rank *asset_fex_usb_rank_new(void)
@@ -18,14 +20,10 @@ char *asset_fex_usb_rank_to_string(const struct asset_fex_usb_rank *rank)
 
 void asset_fex_usb_rank_decrypt(uint8_t *buf, size_t len)
 {
-  for (size_t a = len - 1; a > 0; --a) {
-    buf[a] = (buf[a] ^ buf[a - 1]) + ((a * 1234567) >> 8);
-  }
+  crypt_usb_profile_decrypt(buf, len);
 }
 
 void asset_fex_usb_rank_encrypt(uint8_t *buf, size_t len)
 {
-  for (size_t a = 1; a < len; ++a) {
-    buf[a] = (buf[a] - ((a * 1234567) >> 8)) ^ buf[a - 1];
-  }
+  crypt_usb_profile_encrypt(buf, len);
 }
\ No newline at end of file
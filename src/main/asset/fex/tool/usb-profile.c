@@ -1,5 +1,6 @@
 /**
- * Tool for FiestaEX profiles: decrypt, encrypt, print profile data
+ * Tool for FiestaEX profiles: decrypt, encrypt, print profile data. The batch
+ * command processes many profiles on a thread pool
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,17 +8,180 @@
 
 #include "asset/fex/lib/util.h"
 
+#include "util/batch.h"
+#include "util/fs.h"
 #include "util/str.h"
 
+#define BATCH_QUEUE_SIZE 256
+
+static char *batch_save_dump(
+    const char *path,
+    const struct asset_fex_usb_rank *rank,
+    const struct asset_fex_usb_save *save)
+{
+  char *dump_path;
+  char *rank_str;
+  char *save_str;
+  char *tmp;
+  char *dump;
+  bool res;
+
+  rank_str = asset_fex_usb_rank_to_string(rank);
+  save_str = asset_fex_usb_save_to_string(save);
+
+  tmp = util_str_merge(
+      "----------------- rank -----------------\n", rank_str);
+  dump = util_str_merge(tmp, "----------------- save -----------------\n");
+  free(tmp);
+  tmp = dump;
+  dump = util_str_merge(tmp, save_str);
+  free(tmp);
+
+  dump_path = util_str_merge(path, "fiestaex_profile.txt");
+
+  res = util_file_save(dump_path, dump, strlen(dump));
+
+  free(dump_path);
+  free(dump);
+  free(rank_str);
+  free(save_str);
+
+  return res ? NULL : util_str_dup("Saving dump failed");
+}
+
+static char *batch_proc(const char *path, void *ctx)
+{
+  const char *cmd;
+  struct asset_fex_usb_rank *rank;
+  struct asset_fex_usb_save *save;
+  char *rank_path;
+  char *save_path;
+  char *rank_path_out;
+  char *save_path_out;
+  char *tmp;
+  char *error;
+  bool encrypted;
+
+  cmd = (const char *) ctx;
+  error = NULL;
+  rank = NULL;
+  save = NULL;
+
+  rank_path = util_str_merge(path, "fiestaex_rank.bin");
+  save_path = util_str_merge(path, "fiestaex_save.bin");
+
+  encrypted = strcmp(cmd, "enc") != 0;
+
+  if (!encrypted) {
+    tmp = util_str_merge(rank_path, ".dec");
+    free(rank_path);
+    rank_path = tmp;
+
+    tmp = util_str_merge(save_path, ".dec");
+    free(save_path);
+    save_path = tmp;
+  }
+
+  rank = asset_fex_usb_rank_load_from_file(rank_path, encrypted);
+
+  if (!rank) {
+    error = util_str_dup("Loading rank file failed");
+    goto cleanup;
+  }
+
+  save = asset_fex_usb_save_load_from_file(save_path, encrypted);
+
+  if (!save) {
+    error = util_str_dup("Loading save file failed");
+    goto cleanup;
+  }
+
+  if (!strcmp(cmd, "dec") || !strcmp(cmd, "enc")) {
+    rank_path_out = util_str_merge(rank_path, encrypted ? ".dec" : ".enc");
+    save_path_out = util_str_merge(save_path, encrypted ? ".dec" : ".enc");
+
+    if (!asset_fex_usb_rank_save_to_file(rank_path_out, rank, !encrypted)) {
+      error = util_str_dup("Saving rank file failed");
+    } else if (!asset_fex_usb_save_save_to_file(
+                   save_path_out, save, !encrypted)) {
+      error = util_str_dup("Saving save file failed");
+    }
+
+    free(rank_path_out);
+    free(save_path_out);
+  } else if (!strcmp(cmd, "dump")) {
+    error = batch_save_dump(path, rank, save);
+  }
+
+cleanup:
+  free(rank);
+  free(save);
+  free(rank_path);
+  free(save_path);
+
+  return error;
+}
+
+static int batch_run(int argc, char **argv)
+{
+  struct util_batch *batch;
+  struct util_batch_result result;
+  const char *cmd;
+  size_t threads;
+  int ret;
+
+  if (argc < 4) {
+    printf(
+        "Usage: %s batch [cmd: dec, enc, dump] "
+        "[directory containing profile directories or file listing profile "
+        "paths] [threads, optional, default number of cpus]\n",
+        argv[0]);
+    return -1;
+  }
+
+  cmd = argv[2];
+
+  if (strcmp(cmd, "dec") && strcmp(cmd, "enc") && strcmp(cmd, "dump")) {
+    fprintf(stderr, "Unknown batch command %s\n", cmd);
+    return -1;
+  }
+
+  threads = argc > 4 ? strtoul(argv[4], NULL, 10) : 0;
+
+  batch = util_batch_start(threads, BATCH_QUEUE_SIZE, batch_proc, (void *) cmd);
+
+  ret = 0;
+
+  if (!util_batch_push_path(batch, argv[3])) {
+    fprintf(stderr, "Reading profiles from %s failed\n", argv[3]);
+    ret = -2;
+  }
+
+  util_batch_finish(batch, &result);
+  util_batch_result_print(&result, stdout);
+
+  if (result.failed > 0) {
+    ret = -3;
+  }
+
+  util_batch_result_fini(&result);
+
+  return ret;
+}
+
 int main(int argc, char **argv)
 {
   int ret;
   char *rank_path;
   char *save_path;
 
+  if (argc >= 2 && !strcmp(argv[1], "batch")) {
+    return batch_run(argc, argv);
+  }
+
   if (argc < 3) {
     printf(
-        "Usage: %s [cmd: new, dec, enc, dump] "
+        "Usage: %s [cmd: new, dec, enc, dump, batch] "
         "[path containing fiestaex_rank.bin fiestaex_save.bin]\n",
         argv[0]);
     return -1;
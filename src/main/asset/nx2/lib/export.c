@@ -0,0 +1,298 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "export.h"
+
+static void asset_nx2_export_json_str(FILE *file, const char *str, size_t max)
+{
+  uint8_t c;
+
+  putc_unlocked('"', file);
+
+  /* Strings of the profile are not necessarily null terminated */
+  for (size_t i = 0; i < max && str[i] != '\0'; i++) {
+    c = (uint8_t) str[i];
+
+    if (c == '"' || c == '\\') {
+      putc_unlocked('\\', file);
+      putc_unlocked(c, file);
+    } else if (c < 0x20 || c >= 0x7F) {
+      fprintf(file, "\\u%04X", c);
+    } else {
+      putc_unlocked(c, file);
+    }
+  }
+
+  putc_unlocked('"', file);
+}
+
+static void asset_nx2_export_json_float(FILE *file, float value)
+{
+  /* NaN and infinity are not valid JSON */
+  if (isfinite(value)) {
+    fprintf(file, "%g", value);
+  } else {
+    fputs("null", file);
+  }
+}
+
+static void asset_nx2_export_json_rank(
+    FILE *file, const struct asset_nx2_usb_rank *rank)
+{
+  const struct asset_nx2_usb_rank_entry *entry;
+  uint32_t count;
+
+  count = rank->num_rankings;
+
+  if (count > ASSET_NX2_USB_RANK_MAX_RANK_ENTRIES) {
+    count = ASSET_NX2_USB_RANK_MAX_RANK_ENTRIES;
+  }
+
+  fprintf(
+      file,
+      "{\"adler32\":%u,\"num_rankings\":%u,\"entries\":[",
+      rank->adler32,
+      rank->num_rankings);
+
+  for (uint32_t i = 0; i < count; i++) {
+    fputs(i > 0 ? ",[" : "[", file);
+
+    for (uint32_t j = 0; j < ASSET_NX2_USB_RANK_MAX_STAGES; j++) {
+      entry = &rank->entries[i][j];
+
+      fprintf(
+          file,
+          "%s{\"game_mode\":%d,\"play_order\":%d,\"play_score\":%d,"
+          "\"grade\":%d,\"mileage\":%d,\"play_time\":",
+          j > 0 ? "," : "",
+          entry->game_mode,
+          entry->play_order,
+          entry->play_score,
+          entry->grade,
+          entry->mileage);
+      asset_nx2_export_json_float(file, entry->play_time);
+      fputs(",\"kcal\":", file);
+      asset_nx2_export_json_float(file, entry->kcal);
+      fputs(",\"v02\":", file);
+      asset_nx2_export_json_float(file, entry->v02);
+      putc_unlocked('}', file);
+    }
+
+    putc_unlocked(']', file);
+  }
+
+  fputs("]}", file);
+}
+
+static void asset_nx2_export_json_review(
+    FILE *file, const struct asset_nx2_usb_save_review *review)
+{
+  fputs("{\"player_id\":", file);
+  asset_nx2_export_json_str(
+      file, review->player_id, ASSET_NX2_USB_SAVE_PLAYER_ID_MAX);
+
+  fprintf(
+      file,
+      ",\"mileage\":%d,\"reward_count\":%d,\"worldmax_count\":%d,"
+      "\"play_count\":%d,\"kcal\":%d,\"v02\":%d}",
+      review->mileage,
+      review->reward_count,
+      review->worldmax_count,
+      review->play_count,
+      review->kcal,
+      review->v02);
+}
+
+static void asset_nx2_export_json_stats(
+    FILE *file, const struct asset_nx2_usb_save_stats *stats)
+{
+  fprintf(file, "{\"adler32\":%u,\"usb_serial\":", stats->adler32);
+  asset_nx2_export_json_str(
+      file, stats->usb_serial, ASSET_NX2_USB_SAVE_SERIAL_ID_MAX);
+
+  fprintf(
+      file,
+      ",\"timestamp\":{\"year\":%d,\"month\":%d,\"day\":%d,\"hour\":%d,"
+      "\"min\":%d,\"ms\":%d}",
+      stats->timestamp.year,
+      stats->timestamp.month,
+      stats->timestamp.day,
+      stats->timestamp.hour,
+      stats->timestamp.min,
+      stats->timestamp.ms);
+
+  fprintf(
+      file,
+      ",\"avatar_id\":%d,\"rank\":%d,\"country_id\":%d,\"player_id\":",
+      stats->avatar_id,
+      stats->rank,
+      stats->country_id);
+  asset_nx2_export_json_str(
+      file, stats->player_id, ASSET_NX2_USB_SAVE_PLAYER_ID_MAX);
+
+  fprintf(
+      file,
+      ",\"mileage\":%d,\"play_count\":%d,\"kcal\":%d,\"v02\":%d,"
+      "\"worldmax_map_position\":%d,\"reward_count\":%d,"
+      "\"worldmax_count\":%d",
+      stats->mileage,
+      stats->play_count,
+      stats->kcal,
+      stats->v02,
+      stats->worldmax_map_position,
+      stats->reward_count,
+      stats->worldmax_count);
+
+  fputs(",\"song_unlocks\":[", file);
+
+  for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_SONG_MAX; i++) {
+    fprintf(
+        file,
+        "%s{\"mode\":%d,\"song\":%d,\"reveal\":%d}",
+        i > 0 ? "," : "",
+        stats->song_unlocks[i].mode,
+        stats->song_unlocks[i].song,
+        stats->song_unlocks[i].reveal);
+  }
+
+  fputs("],\"worldmax_high_score\":[", file);
+
+  for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_MISSION_MAX; i++) {
+    fprintf(file, i > 0 ? ",%d" : "%d", stats->worldmax_high_score[i]);
+  }
+
+  fputs("],\"worldmax_challenge\":[", file);
+
+  for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_MISSION_MAX; i++) {
+    fprintf(file, i > 0 ? ",%d" : "%d", stats->worldmax_challenge[i]);
+  }
+
+  fputs("],\"song_scores\":[", file);
+
+  for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_SONG_MAX; i++) {
+    fputs(i > 0 ? ",[" : "[", file);
+
+    for (uint32_t j = 0; j < ASSET_NX2_USB_SAVE_NUM_MODES; j++) {
+      fprintf(
+          file,
+          "%s{\"score\":%d,\"player_id\":",
+          j > 0 ? "," : "",
+          stats->song_scores[i][j].score);
+      asset_nx2_export_json_str(
+          file,
+          stats->song_scores[i][j].player_id,
+          ASSET_NX2_USB_SAVE_PLAYER_ID_MAX);
+      putc_unlocked('}', file);
+    }
+
+    putc_unlocked(']', file);
+  }
+
+  fputs("]}", file);
+}
+
+bool asset_nx2_export_json(
+    FILE *file,
+    const char *name,
+    const struct asset_nx2_usb_rank *rank,
+    const struct asset_nx2_usb_save *save)
+{
+  bool res;
+
+  flockfile(file);
+
+  fputs("{\"name\":", file);
+  asset_nx2_export_json_str(file, name, SIZE_MAX);
+
+  fputs(",\"rank\":", file);
+  asset_nx2_export_json_rank(file, rank);
+
+  fputs(",\"review\":", file);
+  asset_nx2_export_json_review(file, &save->review);
+
+  fputs(",\"stats\":", file);
+  asset_nx2_export_json_stats(file, &save->stats);
+
+  fputs("}\n", file);
+
+  res = !ferror(file);
+
+  funlockfile(file);
+
+  return res;
+}
+
+static void asset_nx2_export_csv_str(FILE *file, const char *str, size_t max)
+{
+  putc_unlocked('"', file);
+
+  for (size_t i = 0; i < max && str[i] != '\0'; i++) {
+    /* Quotes are escaped by doubling them */
+    if (str[i] == '"') {
+      putc_unlocked('"', file);
+    }
+
+    putc_unlocked(str[i], file);
+  }
+
+  putc_unlocked('"', file);
+}
+
+bool asset_nx2_export_csv_header(FILE *file)
+{
+  fputs(
+      "name,player_id,usb_serial,timestamp,avatar_id,rank,country_id,mileage,"
+      "play_count,kcal,v02,worldmax_map_position,reward_count,worldmax_count,"
+      "num_rankings\n",
+      file);
+
+  return !ferror(file);
+}
+
+bool asset_nx2_export_csv(
+    FILE *file,
+    const char *name,
+    const struct asset_nx2_usb_rank *rank,
+    const struct asset_nx2_usb_save *save)
+{
+  const struct asset_nx2_usb_save_stats *stats;
+  bool res;
+
+  stats = &save->stats;
+
+  flockfile(file);
+
+  asset_nx2_export_csv_str(file, name, SIZE_MAX);
+  putc_unlocked(',', file);
+  asset_nx2_export_csv_str(
+      file, stats->player_id, ASSET_NX2_USB_SAVE_PLAYER_ID_MAX);
+  putc_unlocked(',', file);
+  asset_nx2_export_csv_str(
+      file, stats->usb_serial, ASSET_NX2_USB_SAVE_SERIAL_ID_MAX);
+
+  fprintf(
+      file,
+      ",%04d-%02d-%02d %02d:%02d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%u\n",
+      stats->timestamp.year,
+      stats->timestamp.month,
+      stats->timestamp.day,
+      stats->timestamp.hour,
+      stats->timestamp.min,
+      stats->avatar_id,
+      stats->rank,
+      stats->country_id,
+      stats->mileage,
+      stats->play_count,
+      stats->kcal,
+      stats->v02,
+      stats->worldmax_map_position,
+      stats->reward_count,
+      stats->worldmax_count,
+      rank->num_rankings);
+
+  res = !ferror(file);
+
+  funlockfile(file);
+
+  return res;
+}
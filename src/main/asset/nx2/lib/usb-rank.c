@@ -1,5 +1,7 @@
 #include <string.h>
 
+#include "crypt/usb-profile.h"
+
 #include "util/adler32.h"
 #include "util/mem.h"
 #include "util/str.h"
@@ -24,18 +26,24 @@ void asset_nx2_usb_rank_finalize(struct asset_nx2_usb_rank *rank)
       1, ((const uint8_t *) rank) + 4, sizeof(struct asset_nx2_usb_rank) - 4);
 }
 
+bool asset_nx2_usb_rank_verify(const struct asset_nx2_usb_rank *rank)
+{
+  uint32_t adler32;
+
+  adler32 = util_adler32_calc(
+      1, ((const uint8_t *) rank) + 4, sizeof(struct asset_nx2_usb_rank) - 4);
+
+  return rank->adler32 == adler32;
+}
+
 char *asset_nx2_usb_rank_to_string(const struct asset_nx2_usb_rank *rank)
 {
-  char *buffer;
-  char *buffer2;
-  char *merged;
+  struct util_strbuf buf;
 
-  buffer = (char *) util_xmalloc(128);
-  memset(buffer, 0, 128);
+  util_strbuf_init(&buf, 0);
 
-  util_str_format(
-      buffer,
-      128,
+  util_strbuf_append_format(
+      &buf,
       "adler32: 0x%X\n"
       "num_rankings: %d\n"
       "ranking entries:\n",
@@ -43,14 +51,9 @@ char *asset_nx2_usb_rank_to_string(const struct asset_nx2_usb_rank *rank)
       rank->num_rankings);
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_RANK_MAX_RANK_ENTRIES; i++) {
-
     for (uint32_t j = 0; j < ASSET_NX2_USB_RANK_MAX_STAGES; j++) {
-      buffer2 = (char *) util_xmalloc(512);
-      memset(buffer2, 0, 512);
-
-      util_str_format(
-          buffer2,
-          512,
+      util_strbuf_append_format(
+          &buf,
           "%d/%d:\n"
           "game_mode: %d\n"
           "play_order: %d\n"
@@ -70,29 +73,18 @@ char *asset_nx2_usb_rank_to_string(const struct asset_nx2_usb_rank *rank)
           rank->entries[i][j].play_time,
           rank->entries[i][j].kcal,
           rank->entries[i][j].v02);
-
-      merged = util_str_merge(buffer, buffer2);
-
-      free(buffer);
-      free(buffer2);
-
-      buffer = merged;
     }
   }
 
-  return buffer;
+  return util_strbuf_detach(&buf);
 }
 
 void asset_nx2_usb_rank_decrypt(uint8_t *buf, size_t len)
 {
-  for (size_t a = len - 1; a > 0; --a) {
-    buf[a] = (buf[a] ^ buf[a - 1]) + ((a * 1234567) >> 8);
-  }
+  crypt_usb_profile_decrypt(buf, len);
 }
 
 void asset_nx2_usb_rank_encrypt(uint8_t *buf, size_t len)
 {
-  for (size_t a = 1; a < len; ++a) {
-    buf[a] = (buf[a] - ((a * 1234567) >> 8)) ^ buf[a - 1];
-  }
+  crypt_usb_profile_encrypt(buf, len);
 }
\ No newline at end of file
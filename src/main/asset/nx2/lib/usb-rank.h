@@ -1,6 +1,7 @@
 #ifndef ASSET_NX2_USB_RANK_H
 #define ASSET_NX2_USB_RANK_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -34,6 +35,9 @@ struct asset_nx2_usb_rank *asset_nx2_usb_rank_new(void);
 // update checksum and prepare profile to get encrypted
 void asset_nx2_usb_rank_finalize(struct asset_nx2_usb_rank *rank);
 
+// verify the checksum of a decrypted profile
+bool asset_nx2_usb_rank_verify(const struct asset_nx2_usb_rank *rank);
+
 char *asset_nx2_usb_rank_to_string(const struct asset_nx2_usb_rank *rank);
 
 void asset_nx2_usb_rank_decrypt(uint8_t *buf, size_t len);
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "crypt/usb-profile.h"
+
 #include "util/adler32.h"
 #include "util/log.h"
 #include "util/mem.h"
@@ -8,17 +10,11 @@
 
 #include "usb-save.h"
 
-static char *
-asset_nx2_usb_save_time_to_string(const struct asset_nx2_usb_save_time *time)
+static void asset_nx2_usb_save_time_to_strbuf(
+    struct util_strbuf *buf, const struct asset_nx2_usb_save_time *time)
 {
-  char *buffer;
-
-  buffer = (char *) util_xmalloc(128);
-  memset(buffer, 0, 128);
-
-  util_str_format(
-      buffer,
-      128,
+  util_strbuf_append_format(
+      buf,
       "year: %d\n"
       "month: %d\n"
       "day: %d\n"
@@ -31,80 +27,61 @@ asset_nx2_usb_save_time_to_string(const struct asset_nx2_usb_save_time *time)
       time->hour,
       time->min,
       time->ms);
-
-  return buffer;
 }
 
-static char *asset_nx2_usb_save_review_to_string(
-    const struct asset_nx2_usb_save_review *review)
+static void asset_nx2_usb_save_review_to_strbuf(
+    struct util_strbuf *buf, const struct asset_nx2_usb_save_review *review)
 {
-  char *buffer;
-  char *land;
-  char *mission;
-
-  buffer = (char *) util_xmalloc(1024);
-  memset(buffer, 0, 1024);
-
-  land = util_str_buffer(
-      (const uint8_t *) review->worldmax_current_land,
-      ASSET_NX2_USB_SAVE_WORLDMAX_LOC_MAX);
-  mission = util_str_buffer(
-      (const uint8_t *) review->worldmax_current_mission,
-      ASSET_NX2_USB_SAVE_WORLDMAX_LOC_MAX);
-
-  util_str_format(
-      buffer,
-      1024,
+  util_strbuf_append_format(
+      buf,
       ">>> review:\n"
       "player_id: %s\n"
       "mileage: %d\n"
       "reward_count: %d\n"
       "worldmax_count: %d\n"
       "play_count: %d\n"
-      "worldmax_current_land: %s\n"
-      "worldmax_current_mission: %s\n"
-      "kcal: %d\n"
-      "v02: %d\n",
+      "worldmax_current_land: ",
       review->player_id,
       review->mileage,
       review->reward_count,
       review->worldmax_count,
-      review->play_count,
-      land,
-      mission,
-      review->kcal,
-      review->v02);
+      review->play_count);
 
-  free(land);
-  free(mission);
+  util_strbuf_append_buffer(
+      buf,
+      (const uint8_t *) review->worldmax_current_land,
+      ASSET_NX2_USB_SAVE_WORLDMAX_LOC_MAX);
+  util_strbuf_append(buf, "\nworldmax_current_mission: ");
+  util_strbuf_append_buffer(
+      buf,
+      (const uint8_t *) review->worldmax_current_mission,
+      ASSET_NX2_USB_SAVE_WORLDMAX_LOC_MAX);
 
-  return buffer;
+  util_strbuf_append_format(
+      buf,
+      "\n"
+      "kcal: %d\n"
+      "v02: %d\n",
+      review->kcal,
+      review->v02);
 }
 
-static char *
-asset_nx2_usb_save_stats_to_string(const struct asset_nx2_usb_save_stats *stats)
+static void asset_nx2_usb_save_stats_to_strbuf(
+    struct util_strbuf *buf, const struct asset_nx2_usb_save_stats *stats)
 {
-  char *merged;
-  char *buffer;
-  char *timestamp;
-  char *tmp;
-  const size_t buf_size = 512;
-
-  merged = (char *) util_xmalloc(buf_size);
-  memset(merged, 0, buf_size);
-
-  buffer = (char *) util_xmalloc(buf_size);
-  memset(buffer, 0, buf_size);
-
-  timestamp = asset_nx2_usb_save_time_to_string(&stats->timestamp);
-
-  util_str_format(
-      merged,
-      buf_size,
+  util_strbuf_append_format(
+      buf,
       ">>> stats:\n"
       "adler32: 0x%X\n"
       "usb_serial: %s\n"
-      "timestamp: %s"
+      "timestamp: ",
+      stats->adler32,
+      stats->usb_serial);
+
+  asset_nx2_usb_save_time_to_strbuf(buf, &stats->timestamp);
+
+  util_strbuf_append_format(
+      buf,
       "avatar_id: %d\n"
       "rank: %d\n"
       "country_id: %d\n"
@@ -116,9 +93,6 @@ asset_nx2_usb_save_stats_to_string(const struct asset_nx2_usb_save_stats *stats)
       "worldmax_map_position: 0x%X\n"
       "reward_count: %d\n"
       "worldmax_count: %d\n",
-      stats->adler32,
-      stats->usb_serial,
-      timestamp,
       stats->avatar_id,
       stats->rank,
       stats->country_id,
@@ -131,18 +105,11 @@ asset_nx2_usb_save_stats_to_string(const struct asset_nx2_usb_save_stats *stats)
       stats->reward_count,
       stats->worldmax_count);
 
-  free(timestamp);
-
-  tmp = util_str_merge(merged, "song_unlocks:\n");
-
-  free(merged);
-  merged = tmp;
+  util_strbuf_append(buf, "song_unlocks:\n");
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_SONG_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "song slot: %d\n"
         "mode: 0x%X\n"
         "unused: 0x%X\n"
@@ -153,18 +120,11 @@ asset_nx2_usb_save_stats_to_string(const struct asset_nx2_usb_save_stats *stats)
         stats->song_unlocks[i].unused,
         stats->song_unlocks[i].song,
         stats->song_unlocks[i].reveal);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_MISSION_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "mission slot: %d\n"
         "clear_flags_directions: 0x%X\n"
         "clear_flag_mission: %d\n"
@@ -173,135 +133,76 @@ asset_nx2_usb_save_stats_to_string(const struct asset_nx2_usb_save_stats *stats)
         stats->worldmax_mission_unlocks[i].clear_flags_directions,
         stats->worldmax_mission_unlocks[i].clear_flag_mission,
         stats->worldmax_mission_unlocks[i].unused);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_MISSION_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_high_score %d: %d\n",
         i,
         stats->worldmax_high_score[i]);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_MISSION_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
-        "worldmax_challenge %d: %d\n",
-        i,
-        stats->worldmax_challenge[i]);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
+    util_strbuf_append_format(
+        buf, "worldmax_challenge %d: %d\n", i, stats->worldmax_challenge[i]);
   }
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_BARRICADE_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_barricade %d:\n"
         "flag_open: %d\n"
         "unused: 0x%X\n",
         i,
         stats->worldmax_barricade[i].flag_open,
         stats->worldmax_barricade[i].unused);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_EVENT_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_event %d:\n"
         "flag_cleared: %d\n"
         "unused: 0x%X\n",
         i,
         stats->worldmax_event[i].flag_cleared,
         stats->worldmax_event[i].unused);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_WARP_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_warp %d:\n"
         "direction_clear: 0x%X\n"
-        "clear: %d\n",
+        "clear: %d\n"
         "unused: 0x%X\n",
         i,
         stats->worldmax_warp[i].direction_clear,
         stats->worldmax_warp[i].clear,
         stats->worldmax_warp[i].unused);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_WORLDMAX_LOC_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_current_land %d: %d\n",
         i,
         stats->worldmax_current_land[i]);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_WORLDMAX_LOC_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_current_mission %d: %d\n",
         i,
         stats->worldmax_current_mission[i]);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NX2_USB_SAVE_SONG_MAX; i++) {
-
     for (uint32_t j = 0; j < ASSET_NX2_USB_SAVE_NUM_MODES; j++) {
-      util_str_format(
-          buffer,
-          buf_size,
+      util_strbuf_append_format(
+          buf,
           "song_scores %d/%d:\n"
           "score: %d\n"
           "player_id: %s\n",
@@ -309,17 +210,8 @@ asset_nx2_usb_save_stats_to_string(const struct asset_nx2_usb_save_stats *stats)
           j,
           stats->song_scores[i][j].score,
           stats->song_scores[i][j].player_id);
-
-      tmp = util_str_merge(merged, buffer);
-
-      free(merged);
-      merged = tmp;
     }
   }
-
-  free(buffer);
-
-  return merged;
 }
 
 struct asset_nx2_usb_save *asset_nx2_usb_save_new(void)
@@ -359,21 +251,29 @@ void asset_nx2_usb_save_finalize(struct asset_nx2_usb_save *save)
       sizeof(struct asset_nx2_usb_save_stats) - 4);
 }
 
-char *asset_nx2_usb_save_to_string(const struct asset_nx2_usb_save *save)
+bool asset_nx2_usb_save_verify(const struct asset_nx2_usb_save *save)
 {
-  char *review;
-  char *stats;
-  char *merged;
+  uint32_t adler32;
 
-  review = asset_nx2_usb_save_review_to_string(&save->review);
-  stats = asset_nx2_usb_save_stats_to_string(&save->stats);
+  adler32 = util_adler32_calc(
+      1,
+      ((const uint8_t *) &save->stats) + 4,
+      sizeof(struct asset_nx2_usb_save_stats) - 4);
 
-  merged = util_str_merge(review, stats);
+  return save->stats.adler32 == adler32;
+}
 
-  free(review);
-  free(stats);
+char *asset_nx2_usb_save_to_string(const struct asset_nx2_usb_save *save)
+{
+  struct util_strbuf buf;
 
-  return merged;
+  /* Roughly the size of a full dump */
+  util_strbuf_init(&buf, 256 * 1024);
+
+  asset_nx2_usb_save_review_to_strbuf(&buf, &save->review);
+  asset_nx2_usb_save_stats_to_strbuf(&buf, &save->stats);
+
+  return util_strbuf_detach(&buf);
 }
 
 void asset_nx2_usb_save_decrypt(uint8_t *buf, size_t len)
@@ -382,9 +282,7 @@ void asset_nx2_usb_save_decrypt(uint8_t *buf, size_t len)
   buf += sizeof(struct asset_nx2_usb_save_review);
   len -= sizeof(struct asset_nx2_usb_save_review);
 
-  for (size_t a = len - 1; a > 0; --a) {
-    buf[a] = (buf[a] ^ buf[a - 1]) + ((a * 1234567) >> 8);
-  }
+  crypt_usb_profile_decrypt(buf, len);
 }
 
 void asset_nx2_usb_save_encrypt(uint8_t *buf, size_t len)
@@ -393,7 +291,5 @@ void asset_nx2_usb_save_encrypt(uint8_t *buf, size_t len)
   buf += sizeof(struct asset_nx2_usb_save_review);
   len -= sizeof(struct asset_nx2_usb_save_review);
 
-  for (size_t a = 1; a < len; ++a) {
-    buf[a] = (buf[a] - ((a * 1234567) >> 8)) ^ buf[a - 1];
-  }
+  crypt_usb_profile_encrypt(buf, len);
 }
\ No newline at end of file
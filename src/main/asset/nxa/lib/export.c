@@ -0,0 +1,350 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "export.h"
+
+static void asset_nxa_export_json_str(FILE *file, const char *str, size_t max)
+{
+  uint8_t c;
+
+  putc_unlocked('"', file);
+
+  /* Strings of the profile are not necessarily null terminated */
+  for (size_t i = 0; i < max && str[i] != '\0'; i++) {
+    c = (uint8_t) str[i];
+
+    if (c == '"' || c == '\\') {
+      putc_unlocked('\\', file);
+      putc_unlocked(c, file);
+    } else if (c < 0x20 || c >= 0x7F) {
+      fprintf(file, "\\u%04X", c);
+    } else {
+      putc_unlocked(c, file);
+    }
+  }
+
+  putc_unlocked('"', file);
+}
+
+static void asset_nxa_export_json_float(FILE *file, float value)
+{
+  /* NaN and infinity are not valid JSON */
+  if (isfinite(value)) {
+    fprintf(file, "%g", value);
+  } else {
+    fputs("null", file);
+  }
+}
+
+static void asset_nxa_export_json_time(
+    FILE *file, const struct asset_nxa_usb_save_time *time)
+{
+  fprintf(
+      file,
+      ",\"timestamp\":{\"year\":%d,\"month\":%d,\"day\":%d,\"hour\":%d,"
+      "\"min\":%d,\"ms\":%d}",
+      time->year,
+      time->month,
+      time->day,
+      time->hour,
+      time->min,
+      time->ms);
+}
+
+static void asset_nxa_export_json_rank(
+    FILE *file, const struct asset_nxa_usb_rank *rank)
+{
+  const struct asset_nxa_usb_rank_entry *entry;
+  uint32_t count;
+
+  count = rank->num_rankings;
+
+  if (count > ASSET_NXA_USB_RANK_MAX_RANK_ENTRIES) {
+    count = ASSET_NXA_USB_RANK_MAX_RANK_ENTRIES;
+  }
+
+  fprintf(file, "{\"adler32\":%u,\"usb_serial\":", rank->adler32);
+  asset_nxa_export_json_str(
+      file, rank->usb_serial, ASSET_NXA_USB_RANK_USB_SERIAL_LEN);
+  fprintf(file, ",\"num_rankings\":%u,\"entries\":[", rank->num_rankings);
+
+  for (uint32_t i = 0; i < count; i++) {
+    fputs(i > 0 ? ",[" : "[", file);
+
+    for (uint32_t j = 0; j < ASSET_NXA_USB_RANK_MAX_STAGES; j++) {
+      entry = &rank->entries[i][j];
+
+      fprintf(
+          file,
+          "%s{\"game_mode\":%d,\"play_order\":%d,\"play_score\":%d,"
+          "\"grade\":%d,\"mileage\":%d,\"play_time\":",
+          j > 0 ? "," : "",
+          entry->game_mode,
+          entry->play_order,
+          entry->play_score,
+          entry->grade,
+          entry->mileage);
+      asset_nxa_export_json_float(file, entry->play_time);
+      fputs(",\"kcal\":", file);
+      asset_nxa_export_json_float(file, entry->kcal);
+      fputs(",\"v02\":", file);
+      asset_nxa_export_json_float(file, entry->v02);
+      putc_unlocked('}', file);
+    }
+
+    putc_unlocked(']', file);
+  }
+
+  fputs("]}", file);
+}
+
+static void asset_nxa_export_json_review(
+    FILE *file, const struct asset_nxa_usb_save_review *review)
+{
+  fputs("{\"player_id\":", file);
+  asset_nxa_export_json_str(
+      file, review->player_id, ASSET_NXA_USB_SAVE_PLAYER_ID_MAX);
+
+  fprintf(
+      file,
+      ",\"mileage\":%u,\"reward_count\":%u,\"worldmax_count\":%u,"
+      "\"play_count\":%u,\"kcal\":%u,\"v02\":%u",
+      review->mileage,
+      review->reward_count,
+      review->worldmax_count,
+      review->play_count,
+      review->kcal,
+      review->v02);
+
+  asset_nxa_export_json_time(file, &review->timestamp);
+
+  fprintf(
+      file,
+      ",\"running_step\":%u,\"play_time_minutes\":",
+      review->running_step);
+  asset_nxa_export_json_float(file, review->play_time_minutes);
+  fputs(",\"total_completion_percentage\":", file);
+  asset_nxa_export_json_float(file, review->total_completion_percentage);
+  fputs(",\"arcade_percentage\":", file);
+  asset_nxa_export_json_float(file, review->arcade_percentage);
+  fputs(",\"brain_shower_percentage\":", file);
+  asset_nxa_export_json_float(file, review->brain_shower_percentage);
+  fputs(",\"special_percentage\":", file);
+  asset_nxa_export_json_float(file, review->special_percentage);
+  putc_unlocked('}', file);
+}
+
+static void asset_nxa_export_json_stats(
+    FILE *file, const struct asset_nxa_usb_save_stats *stats)
+{
+  fprintf(file, "{\"adler32\":%u,\"usb_serial\":", stats->adler32);
+  asset_nxa_export_json_str(
+      file, stats->usb_serial, ASSET_NXA_USB_SAVE_SERIAL_ID_MAX);
+
+  asset_nxa_export_json_time(file, &stats->timestamp);
+
+  fprintf(
+      file,
+      ",\"avatar_id\":%d,\"rank\":%d,\"country_id\":%d,\"player_id\":",
+      stats->avatar_id,
+      stats->rank,
+      stats->country_id);
+  asset_nxa_export_json_str(
+      file, stats->player_id, ASSET_NXA_USB_SAVE_PLAYER_ID_MAX);
+
+  fprintf(
+      file,
+      ",\"mileage\":%d,\"play_count\":%d,\"kcal\":%d,\"v02\":%d,"
+      "\"worldmax_map_position\":%d,\"reward_count\":%d,"
+      "\"worldmax_count\":%d",
+      stats->mileage,
+      stats->play_count,
+      stats->kcal,
+      stats->v02,
+      stats->worldmax_map_position,
+      stats->reward_count,
+      stats->worldmax_count);
+
+  fputs(",\"song_unlocks\":[", file);
+
+  for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_SONG_MAX; i++) {
+    fprintf(
+        file,
+        "%s{\"mode\":%d,\"song\":%d,\"reveal\":%d}",
+        i > 0 ? "," : "",
+        stats->song_unlocks[i].mode,
+        stats->song_unlocks[i].song,
+        stats->song_unlocks[i].reveal);
+  }
+
+  fputs("],\"worldmax_high_score\":[", file);
+
+  for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_MISSION_MAX; i++) {
+    fprintf(file, i > 0 ? ",%d" : "%d", stats->worldmax_high_score[i]);
+  }
+
+  fputs("],\"worldmax_challenge\":[", file);
+
+  for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_MISSION_MAX; i++) {
+    fprintf(file, i > 0 ? ",%d" : "%d", stats->worldmax_challenge[i]);
+  }
+
+  fputs("],\"song_scores\":[", file);
+
+  for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_SONG_MAX; i++) {
+    fputs(i > 0 ? ",[" : "[", file);
+
+    for (uint32_t j = 0; j < ASSET_NXA_USB_SAVE_NUM_MODES; j++) {
+      fprintf(
+          file,
+          "%s{\"score\":%d,\"player_id\":",
+          j > 0 ? "," : "",
+          stats->song_scores[i][j].score);
+      asset_nxa_export_json_str(
+          file,
+          stats->song_scores[i][j].player_id,
+          ASSET_NXA_USB_SAVE_PLAYER_ID_MAX);
+      putc_unlocked('}', file);
+    }
+
+    putc_unlocked(']', file);
+  }
+
+  fprintf(
+      file,
+      "],\"security_dongle_mfgid\":%u,\"unlock_signal\":%u,"
+      "\"running_steps\":%u,\"total_play_time_min\":",
+      stats->security_dongle_mfgid,
+      stats->unlock_signal,
+      stats->running_steps);
+  asset_nxa_export_json_float(file, stats->total_play_time_min);
+  fputs(",\"total_completion_percentage\":", file);
+  asset_nxa_export_json_float(file, stats->total_completion_percentage);
+  fputs(",\"arcade_completion_percentage\":", file);
+  asset_nxa_export_json_float(file, stats->arcade_completion_percentage);
+  fputs(",\"brain_shower_completion_percentage\":", file);
+  asset_nxa_export_json_float(
+      file, stats->brain_shower_completion_percentage);
+  fputs(",\"special_stage_completion_percentage\":", file);
+  asset_nxa_export_json_float(
+      file, stats->special_stage_completion_percentage);
+
+  fprintf(
+      file,
+      ",\"break_item_slot\":%u,\"func_item_slot\":%u,\"bga_item_slot\":%u,"
+      "\"time_item_slot\":%u}",
+      stats->break_item_slot,
+      stats->func_item_slot,
+      stats->bga_item_slot,
+      stats->time_item_slot);
+}
+
+bool asset_nxa_export_json(
+    FILE *file,
+    const char *name,
+    const struct asset_nxa_usb_rank *rank,
+    const struct asset_nxa_usb_save *save)
+{
+  bool res;
+
+  flockfile(file);
+
+  fputs("{\"name\":", file);
+  asset_nxa_export_json_str(file, name, SIZE_MAX);
+
+  fputs(",\"rank\":", file);
+  asset_nxa_export_json_rank(file, rank);
+
+  fputs(",\"review\":", file);
+  asset_nxa_export_json_review(file, &save->review);
+
+  fputs(",\"stats\":", file);
+  asset_nxa_export_json_stats(file, &save->stats);
+
+  fputs("}\n", file);
+
+  res = !ferror(file);
+
+  funlockfile(file);
+
+  return res;
+}
+
+static void asset_nxa_export_csv_str(FILE *file, const char *str, size_t max)
+{
+  putc_unlocked('"', file);
+
+  for (size_t i = 0; i < max && str[i] != '\0'; i++) {
+    /* Quotes are escaped by doubling them */
+    if (str[i] == '"') {
+      putc_unlocked('"', file);
+    }
+
+    putc_unlocked(str[i], file);
+  }
+
+  putc_unlocked('"', file);
+}
+
+bool asset_nxa_export_csv_header(FILE *file)
+{
+  fputs(
+      "name,player_id,usb_serial,timestamp,avatar_id,rank,country_id,mileage,"
+      "play_count,kcal,v02,worldmax_map_position,reward_count,worldmax_count,"
+      "running_steps,total_play_time_min,total_completion_percentage,"
+      "num_rankings\n",
+      file);
+
+  return !ferror(file);
+}
+
+bool asset_nxa_export_csv(
+    FILE *file,
+    const char *name,
+    const struct asset_nxa_usb_rank *rank,
+    const struct asset_nxa_usb_save *save)
+{
+  const struct asset_nxa_usb_save_stats *stats;
+  bool res;
+
+  stats = &save->stats;
+
+  flockfile(file);
+
+  asset_nxa_export_csv_str(file, name, SIZE_MAX);
+  putc_unlocked(',', file);
+  asset_nxa_export_csv_str(
+      file, stats->player_id, ASSET_NXA_USB_SAVE_PLAYER_ID_MAX);
+  putc_unlocked(',', file);
+  asset_nxa_export_csv_str(
+      file, stats->usb_serial, ASSET_NXA_USB_SAVE_SERIAL_ID_MAX);
+
+  fprintf(
+      file,
+      ",%04d-%02d-%02d %02d:%02d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%u,%g,%g,%u\n",
+      stats->timestamp.year,
+      stats->timestamp.month,
+      stats->timestamp.day,
+      stats->timestamp.hour,
+      stats->timestamp.min,
+      stats->avatar_id,
+      stats->rank,
+      stats->country_id,
+      stats->mileage,
+      stats->play_count,
+      stats->kcal,
+      stats->v02,
+      stats->worldmax_map_position,
+      stats->reward_count,
+      stats->worldmax_count,
+      stats->running_steps,
+      stats->total_play_time_min,
+      stats->total_completion_percentage,
+      rank->num_rankings);
+
+  res = !ferror(file);
+
+  funlockfile(file);
+
+  return res;
+}
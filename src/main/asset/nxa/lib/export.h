@@ -0,0 +1,55 @@
+/**
+ * Export NXA profiles (rank and save) to machine readable formats. The data is
+ * written to the output file directly without building the whole document in
+ * memory first. Exporting a single profile locks the file (see flockfile), i.e.
+ * multiple threads can export to the same file concurrently
+ */
+#ifndef ASSET_NXA_EXPORT_H
+#define ASSET_NXA_EXPORT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "usb-rank.h"
+#include "usb-save.h"
+
+/**
+ * Write a profile as a single line JSON object (JSON lines)
+ *
+ * @param file File to write to
+ * @param name Name of the profile, e.g. the path it was loaded from
+ * @param rank Decrypted rank data of the profile
+ * @param save Decrypted save data of the profile
+ * @return True on success, false on write error
+ */
+bool asset_nxa_export_json(
+    FILE *file,
+    const char *name,
+    const struct asset_nxa_usb_rank *rank,
+    const struct asset_nxa_usb_save *save);
+
+/**
+ * Write the header line of the CSV export
+ *
+ * @param file File to write to
+ * @return True on success, false on write error
+ */
+bool asset_nxa_export_csv_header(FILE *file);
+
+/**
+ * Write the stats of a profile as a single CSV row, see
+ * asset_nxa_export_csv_header
+ *
+ * @param file File to write to
+ * @param name Name of the profile, e.g. the path it was loaded from
+ * @param rank Decrypted rank data of the profile
+ * @param save Decrypted save data of the profile
+ * @return True on success, false on write error
+ */
+bool asset_nxa_export_csv(
+    FILE *file,
+    const char *name,
+    const struct asset_nxa_usb_rank *rank,
+    const struct asset_nxa_usb_save *save);
+
+#endif
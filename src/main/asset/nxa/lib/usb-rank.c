@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "crypt/usb-profile.h"
+
 #include "util/adler32.h"
 
 #include "util/mem.h"
@@ -26,39 +28,34 @@ void asset_nxa_usb_rank_finalize(struct asset_nxa_usb_rank *rank)
       1, ((const uint8_t *) rank) + 4, sizeof(struct asset_nxa_usb_rank) - 4);
 }
 
-char *asset_nxa_usb_rank_to_string(const struct asset_nxa_usb_rank *rank)
+bool asset_nxa_usb_rank_verify(const struct asset_nxa_usb_rank *rank)
 {
-  char *buffer;
-  char *buffer2;
-  char *merged;
-  char *usb_ser;
+  uint32_t adler32;
+
+  adler32 = util_adler32_calc(
+      1, ((const uint8_t *) rank) + 4, sizeof(struct asset_nxa_usb_rank) - 4);
 
-  buffer = (char *) util_xmalloc(512);
-  memset(buffer, 0, 512);
+  return rank->adler32 == adler32;
+}
+
+char *asset_nxa_usb_rank_to_string(const struct asset_nxa_usb_rank *rank)
+{
+  struct util_strbuf buf;
 
-  usb_ser = util_str_buffer(
-      (const uint8_t *) rank->usb_serial, ASSET_NXA_USB_RANK_USB_SERIAL_LEN);
+  util_strbuf_init(&buf, 0);
 
-  util_str_format(
-      buffer,
-      512,
+  util_strbuf_append_format(
+      &buf,
       "adler32: 0x%X\n"
-      // "usb_serial: %s\n",
       "num_rankings: %d\n"
       "ranking entries:\n",
       rank->adler32,
-      // usb_ser,
       rank->num_rankings);
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_RANK_MAX_RANK_ENTRIES; i++) {
-
     for (uint32_t j = 0; j < ASSET_NXA_USB_RANK_MAX_STAGES; j++) {
-      buffer2 = (char *) util_xmalloc(512);
-      memset(buffer2, 0, 512);
-
-      util_str_format(
-          buffer2,
-          512,
+      util_strbuf_append_format(
+          &buf,
           "%d/%d:\n"
           "game_mode: %d\n"
           "play_order: %d\n"
@@ -78,31 +75,18 @@ char *asset_nxa_usb_rank_to_string(const struct asset_nxa_usb_rank *rank)
           rank->entries[i][j].play_time,
           rank->entries[i][j].kcal,
           rank->entries[i][j].v02);
-
-      merged = util_str_merge(buffer, buffer2);
-
-      free(buffer);
-      free(buffer2);
-
-      buffer = merged;
     }
   }
 
-  free(usb_ser);
-
-  return buffer;
+  return util_strbuf_detach(&buf);
 }
 
 void asset_nxa_usb_rank_decrypt(uint8_t *buf, size_t len)
 {
-  for (size_t a = len - 1; a > 0; --a) {
-    buf[a] = (buf[a] ^ buf[a - 1]) + ((a * 1234567) >> 8);
-  }
+  crypt_usb_profile_decrypt(buf, len);
 }
 
 void asset_nxa_usb_rank_encrypt(uint8_t *buf, size_t len)
 {
-  for (size_t a = 1; a < len; ++a) {
-    buf[a] = (buf[a] - ((a * 1234567) >> 8)) ^ buf[a - 1];
-  }
+  crypt_usb_profile_encrypt(buf, len);
 }
\ No newline at end of file
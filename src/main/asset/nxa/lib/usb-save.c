@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "crypt/usb-profile.h"
+
 #include "util/adler32.h"
 
 #include "util/mem.h"
@@ -8,17 +10,11 @@
 
 #include "usb-save.h"
 
-static char *
-asset_nxa_usb_save_time_to_string(const struct asset_nxa_usb_save_time *time)
+static void asset_nxa_usb_save_time_to_strbuf(
+    struct util_strbuf *buf, const struct asset_nxa_usb_save_time *time)
 {
-  char *buffer;
-
-  buffer = (char *) util_xmalloc(128);
-  memset(buffer, 0, 128);
-
-  util_str_format(
-      buffer,
-      128,
+  util_strbuf_append_format(
+      buf,
       "year: %d\n"
       "month: %d\n"
       "day: %d\n"
@@ -31,98 +27,79 @@ asset_nxa_usb_save_time_to_string(const struct asset_nxa_usb_save_time *time)
       time->hour,
       time->min,
       time->ms);
-
-  return buffer;
 }
 
-static char *asset_nxa_usb_save_review_to_string(
-    const struct asset_nxa_usb_save_review *review)
+static void asset_nxa_usb_save_review_to_strbuf(
+    struct util_strbuf *buf, const struct asset_nxa_usb_save_review *review)
 {
-  char *buffer;
-  char *land;
-  char *mission;
-  char *timestamp;
-
-  buffer = (char *) util_xmalloc(1024);
-  memset(buffer, 0, 1024);
-
-  land = util_str_buffer(
-      (const uint8_t *) review->worldmax_current_land,
-      ASSET_NXA_USB_SAVE_WORLDMAX_LOC_MAX);
-  mission = util_str_buffer(
-      (const uint8_t *) review->worldmax_current_mission,
-      ASSET_NXA_USB_SAVE_WORLDMAX_LOC_MAX);
-  timestamp = asset_nxa_usb_save_time_to_string(&review->timestamp);
-
-  util_str_format(
-      buffer,
-      1024,
+  util_strbuf_append_format(
+      buf,
       ">>> review:\n"
       "player_id: %s\n"
       "mileage: %d\n"
       "reward_count: %d\n"
       "worldmax_count: %d\n"
       "play_count: %d\n"
-      "worldmax_current_land: %s\n"
-      "worldmax_current_mission: %s\n"
-      "kcal: %d\n"
-      "v02: %d\n",
-      "timestamp: \n%s",
-      "running_step: %d\n",
-      "play_time_minutes: %f\n",
-      "total_completion_percentage: %f\n",
-      "arcade_percentage: %f\n",
-      "brain_shower_percentage: %f\n",
-      "special_percentage: %f\n",
+      "worldmax_current_land: ",
       review->player_id,
       review->mileage,
       review->reward_count,
       review->worldmax_count,
-      review->play_count,
-      land,
-      mission,
+      review->play_count);
+
+  util_strbuf_append_buffer(
+      buf,
+      (const uint8_t *) review->worldmax_current_land,
+      ASSET_NXA_USB_SAVE_WORLDMAX_LOC_MAX);
+  util_strbuf_append(buf, "\nworldmax_current_mission: ");
+  util_strbuf_append_buffer(
+      buf,
+      (const uint8_t *) review->worldmax_current_mission,
+      ASSET_NXA_USB_SAVE_WORLDMAX_LOC_MAX);
+
+  util_strbuf_append_format(
+      buf,
+      "\n"
+      "kcal: %d\n"
+      "v02: %d\n"
+      "timestamp: \n",
       review->kcal,
-      review->v02,
-      timestamp,
+      review->v02);
+
+  asset_nxa_usb_save_time_to_strbuf(buf, &review->timestamp);
+
+  util_strbuf_append_format(
+      buf,
+      "running_step: %d\n"
+      "play_time_minutes: %f\n"
+      "total_completion_percentage: %f\n"
+      "arcade_percentage: %f\n"
+      "brain_shower_percentage: %f\n"
+      "special_percentage: %f\n",
       review->running_step,
       review->play_time_minutes,
       review->total_completion_percentage,
       review->arcade_percentage,
       review->brain_shower_percentage,
       review->special_percentage);
-
-  free(land);
-  free(mission);
-  free(timestamp);
-
-  return buffer;
 }
 
-static char *
-asset_nxa_usb_save_stats_to_string(const struct asset_nxa_usb_save_stats *stats)
+static void asset_nxa_usb_save_stats_to_strbuf(
+    struct util_strbuf *buf, const struct asset_nxa_usb_save_stats *stats)
 {
-  char *merged;
-  char *buffer;
-  char *timestamp;
-  char *tmp;
-  char *tmp2;
-  const size_t buf_size = 16384;
-
-  merged = (char *) util_xmalloc(buf_size);
-  memset(merged, 0, buf_size);
-
-  buffer = (char *) util_xmalloc(buf_size);
-  memset(buffer, 0, buf_size);
-
-  timestamp = asset_nxa_usb_save_time_to_string(&stats->timestamp);
-
-  util_str_format(
-      merged,
-      buf_size,
+  util_strbuf_append_format(
+      buf,
       ">>> stats:\n"
       "adler32: 0x%X\n"
       "usb_serial: %s\n"
-      "timestamp: %s"
+      "timestamp: ",
+      stats->adler32,
+      stats->usb_serial);
+
+  asset_nxa_usb_save_time_to_strbuf(buf, &stats->timestamp);
+
+  util_strbuf_append_format(
+      buf,
       "avatar_id: %d\n"
       "rank: %d\n"
       "country_id: %d\n"
@@ -134,9 +111,6 @@ asset_nxa_usb_save_stats_to_string(const struct asset_nxa_usb_save_stats *stats)
       "worldmax_map_position: 0x%X\n"
       "reward_count: %d\n"
       "worldmax_count: %d\n",
-      stats->adler32,
-      stats->usb_serial,
-      timestamp,
       stats->avatar_id,
       stats->rank,
       stats->country_id,
@@ -149,18 +123,11 @@ asset_nxa_usb_save_stats_to_string(const struct asset_nxa_usb_save_stats *stats)
       stats->reward_count,
       stats->worldmax_count);
 
-  free(timestamp);
-
-  tmp = util_str_merge(merged, "song_unlocks:\n");
-
-  free(merged);
-  merged = tmp;
+  util_strbuf_append(buf, "song_unlocks:\n");
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_SONG_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "song slot: %d\n"
         "mode: 0x%X\n"
         "unused: 0x%X\n"
@@ -171,18 +138,11 @@ asset_nxa_usb_save_stats_to_string(const struct asset_nxa_usb_save_stats *stats)
         stats->song_unlocks[i].unused,
         stats->song_unlocks[i].song,
         stats->song_unlocks[i].reveal);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_MISSION_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "mission slot: %d\n"
         "clear_flags_directions: 0x%X\n"
         "clear_flag_mission: %d\n"
@@ -191,135 +151,76 @@ asset_nxa_usb_save_stats_to_string(const struct asset_nxa_usb_save_stats *stats)
         stats->worldmax_mission_unlocks[i].clear_flags_directions,
         stats->worldmax_mission_unlocks[i].clear_flag_mission,
         stats->worldmax_mission_unlocks[i].unused);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_MISSION_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_high_score %d: %d\n",
         i,
         stats->worldmax_high_score[i]);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_MISSION_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
-        "worldmax_challenge %d: %d\n",
-        i,
-        stats->worldmax_challenge[i]);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
+    util_strbuf_append_format(
+        buf, "worldmax_challenge %d: %d\n", i, stats->worldmax_challenge[i]);
   }
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_BARRICADE_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_barricade %d:\n"
         "flag_open: %d\n"
         "unused: 0x%X\n",
         i,
         stats->worldmax_barricade[i].flag_open,
         stats->worldmax_barricade[i].unused);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_EVENT_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_event %d:\n"
         "flag_cleared: %d\n"
         "unused: 0x%X\n",
         i,
         stats->worldmax_event[i].flag_cleared,
         stats->worldmax_event[i].unused);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_WARP_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_warp %d:\n"
         "direction_clear: 0x%X\n"
-        "clear: %d\n",
+        "clear: %d\n"
         "unused: 0x%X\n",
         i,
         stats->worldmax_warp[i].direction_clear,
         stats->worldmax_warp[i].clear,
         stats->worldmax_warp[i].unused);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_WORLDMAX_LOC_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_current_land %d: %d\n",
         i,
         stats->worldmax_current_land[i]);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_WORLDMAX_LOC_MAX; i++) {
-
-    util_str_format(
-        buffer,
-        buf_size,
+    util_strbuf_append_format(
+        buf,
         "worldmax_current_mission %d: %d\n",
         i,
         stats->worldmax_current_mission[i]);
-
-    tmp = util_str_merge(merged, buffer);
-
-    free(merged);
-    merged = tmp;
   }
 
   for (uint32_t i = 0; i < ASSET_NXA_USB_SAVE_SONG_MAX; i++) {
-
     for (uint32_t j = 0; j < ASSET_NXA_USB_SAVE_NUM_MODES; j++) {
-      util_str_format(
-          buffer,
-          buf_size,
+      util_strbuf_append_format(
+          buf,
           "song_scores %d/%d:\n"
           "score: %d\n"
           "player_id: %s\n",
@@ -327,18 +228,11 @@ asset_nxa_usb_save_stats_to_string(const struct asset_nxa_usb_save_stats *stats)
           j,
           stats->song_scores[i][j].score,
           stats->song_scores[i][j].player_id);
-
-      tmp = util_str_merge(merged, buffer);
-
-      free(merged);
-      merged = tmp;
     }
   }
 
-  /* ------------- */
-  util_str_format(
-      buffer,
-      buf_size,
+  util_strbuf_append_format(
+      buf,
       "security_dongle_mfgid 0x%X\n"
       "unlock_signal: 0x%X\n"
       "running_steps: %d\n"
@@ -356,38 +250,17 @@ asset_nxa_usb_save_stats_to_string(const struct asset_nxa_usb_save_stats *stats)
       stats->brain_shower_completion_percentage,
       stats->special_stage_completion_percentage);
 
-  tmp = util_str_merge(merged, buffer);
-
-  free(merged);
-  merged = tmp;
-
-  /* ------------- */
-  tmp2 = util_str_buffer(stats->unkn_some_map_scores_to_song_ids, 4096);
-
-  util_str_format(
-      buffer, buf_size, "unkn_some_map_scores_to_song_ids: %s\n", tmp2);
-
-  tmp = util_str_merge(merged, buffer);
-
-  free(tmp2);
-  free(merged);
-  merged = tmp;
-
-  /* ------------- */
-  tmp2 = util_str_buffer(stats->unkn2, sizeof(stats->unkn2));
-
-  util_str_format(buffer, buf_size, "unkn2: %s\n", tmp2);
-
-  tmp = util_str_merge(merged, buffer);
-
-  free(tmp2);
-  free(merged);
-  merged = tmp;
-
-  /* ------------- */
-  util_str_format(
-      buffer,
-      buf_size,
+  util_strbuf_append(buf, "unkn_some_map_scores_to_song_ids: ");
+  util_strbuf_append_buffer(
+      buf,
+      stats->unkn_some_map_scores_to_song_ids,
+      sizeof(stats->unkn_some_map_scores_to_song_ids));
+  util_strbuf_append(buf, "\nunkn2: ");
+  util_strbuf_append_buffer(buf, stats->unkn2, sizeof(stats->unkn2));
+  util_strbuf_append(buf, "\n");
+
+  util_strbuf_append_format(
+      buf,
       "break_item_slot 0x%X\n"
       "func_item_slot: 0x%X\n"
       "bga_item_slot: 0x%X\n"
@@ -398,15 +271,6 @@ asset_nxa_usb_save_stats_to_string(const struct asset_nxa_usb_save_stats *stats)
       stats->bga_item_slot,
       stats->time_item_slot,
       stats->unknown);
-
-  tmp = util_str_merge(merged, buffer);
-
-  free(merged);
-  merged = tmp;
-
-  free(buffer);
-
-  return merged;
 }
 
 struct asset_nxa_usb_save *asset_nxa_usb_save_new(void)
@@ -446,21 +310,29 @@ void asset_nxa_usb_save_finalize(struct asset_nxa_usb_save *save)
       sizeof(struct asset_nxa_usb_save_stats) - 4);
 }
 
-char *asset_nxa_usb_save_to_string(const struct asset_nxa_usb_save *save)
+bool asset_nxa_usb_save_verify(const struct asset_nxa_usb_save *save)
 {
-  char *review;
-  char *stats;
-  char *merged;
+  uint32_t adler32;
 
-  review = asset_nxa_usb_save_review_to_string(&save->review);
-  stats = asset_nxa_usb_save_stats_to_string(&save->stats);
+  adler32 = util_adler32_calc(
+      1,
+      ((const uint8_t *) &save->stats) + 4,
+      sizeof(struct asset_nxa_usb_save_stats) - 4);
 
-  merged = util_str_merge(review, stats);
+  return save->stats.adler32 == adler32;
+}
 
-  free(review);
-  free(stats);
+char *asset_nxa_usb_save_to_string(const struct asset_nxa_usb_save *save)
+{
+  struct util_strbuf buf;
+
+  /* Roughly the size of a full dump */
+  util_strbuf_init(&buf, 320 * 1024);
+
+  asset_nxa_usb_save_review_to_strbuf(&buf, &save->review);
+  asset_nxa_usb_save_stats_to_strbuf(&buf, &save->stats);
 
-  return merged;
+  return util_strbuf_detach(&buf);
 }
 
 void asset_nxa_usb_save_decrypt(uint8_t *buf, size_t len)
@@ -469,9 +341,7 @@ void asset_nxa_usb_save_decrypt(uint8_t *buf, size_t len)
   buf += sizeof(struct asset_nxa_usb_save_review);
   len -= sizeof(struct asset_nxa_usb_save_review);
 
-  for (size_t a = len - 1; a > 0; --a) {
-    buf[a] = (buf[a] ^ buf[a - 1]) + ((a * 1234567) >> 8);
-  }
+  crypt_usb_profile_decrypt(buf, len);
 }
 
 void asset_nxa_usb_save_encrypt(uint8_t *buf, size_t len)
@@ -480,7 +350,5 @@ void asset_nxa_usb_save_encrypt(uint8_t *buf, size_t len)
   buf += sizeof(struct asset_nxa_usb_save_review);
   len -= sizeof(struct asset_nxa_usb_save_review);
 
-  for (size_t a = 1; a < len; ++a) {
-    buf[a] = (buf[a] - ((a * 1234567) >> 8)) ^ buf[a - 1];
-  }
+  crypt_usb_profile_encrypt(buf, len);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef ASSET_NXA_USB_SAVE_H
 #define ASSET_NXA_USB_SAVE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -269,6 +270,9 @@ struct asset_nxa_usb_save *asset_nxa_usb_save_new(void);
 /* update checksum and prepare profile to get encrypted */
 void asset_nxa_usb_save_finalize(struct asset_nxa_usb_save *save);
 
+/* verify the checksum of a decrypted profile */
+bool asset_nxa_usb_save_verify(const struct asset_nxa_usb_save *save);
+
 char *asset_nxa_usb_save_to_string(const struct asset_nxa_usb_save *save);
 
 void asset_nxa_usb_save_decrypt(uint8_t *buf, size_t len);
@@ -1,23 +1,235 @@
 /**
- * Tool for NXA profiles: decrypt, encrypt, print profile data
+ * Tool for NXA profiles: decrypt, encrypt, print profile data. The batch
+ * command processes many profiles on a thread pool and exports them as JSON
+ * lines or CSV
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "asset/nxa/lib/export.h"
 #include "asset/nxa/lib/util.h"
 
+#include "util/batch.h"
+#include "util/fs.h"
 #include "util/str.h"
 
+#define BATCH_QUEUE_SIZE 256
+
+struct batch_ctx {
+  const char *cmd;
+  FILE *out;
+};
+
+static char *batch_save_dump(
+    const char *path,
+    const struct asset_nxa_usb_rank *rank,
+    const struct asset_nxa_usb_save *save)
+{
+  char *dump_path;
+  char *rank_str;
+  char *save_str;
+  char *tmp;
+  char *dump;
+  bool res;
+
+  rank_str = asset_nxa_usb_rank_to_string(rank);
+  save_str = asset_nxa_usb_save_to_string(save);
+
+  tmp = util_str_merge(
+      "----------------- rank -----------------\n", rank_str);
+  dump = util_str_merge(tmp, "----------------- save -----------------\n");
+  free(tmp);
+  tmp = dump;
+  dump = util_str_merge(tmp, save_str);
+  free(tmp);
+
+  dump_path = util_str_merge(path, "nxaprofile.txt");
+
+  res = util_file_save(dump_path, dump, strlen(dump));
+
+  free(dump_path);
+  free(dump);
+  free(rank_str);
+  free(save_str);
+
+  return res ? NULL : util_str_dup("Saving dump failed");
+}
+
+static char *batch_proc(const char *path, void *ctx)
+{
+  struct batch_ctx *batch_ctx;
+  const char *cmd;
+  struct asset_nxa_usb_rank *rank;
+  struct asset_nxa_usb_save *save;
+  char *rank_path;
+  char *save_path;
+  char *rank_path_out;
+  char *save_path_out;
+  char *tmp;
+  char *error;
+  bool encrypted;
+
+  batch_ctx = (struct batch_ctx *) ctx;
+  cmd = batch_ctx->cmd;
+  error = NULL;
+  rank = NULL;
+  save = NULL;
+
+  rank_path = util_str_merge(path, "nxarank.bin");
+  save_path = util_str_merge(path, "nxasave.bin");
+
+  encrypted = strcmp(cmd, "enc") != 0;
+
+  if (!encrypted) {
+    tmp = util_str_merge(rank_path, ".dec");
+    free(rank_path);
+    rank_path = tmp;
+
+    tmp = util_str_merge(save_path, ".dec");
+    free(save_path);
+    save_path = tmp;
+  }
+
+  rank = asset_nxa_usb_rank_load_from_file(rank_path, encrypted);
+
+  if (!rank) {
+    error = util_str_dup("Loading rank file failed");
+    goto cleanup;
+  }
+
+  save = asset_nxa_usb_save_load_from_file(save_path, encrypted);
+
+  if (!save) {
+    error = util_str_dup("Loading save file failed");
+    goto cleanup;
+  }
+
+  if (!strcmp(cmd, "dec") || !strcmp(cmd, "enc")) {
+    rank_path_out = util_str_merge(rank_path, encrypted ? ".dec" : ".enc");
+    save_path_out = util_str_merge(save_path, encrypted ? ".dec" : ".enc");
+
+    if (!asset_nxa_usb_rank_save_to_file(rank_path_out, rank, !encrypted)) {
+      error = util_str_dup("Saving rank file failed");
+    } else if (!asset_nxa_usb_save_save_to_file(
+                   save_path_out, save, !encrypted)) {
+      error = util_str_dup("Saving save file failed");
+    }
+
+    free(rank_path_out);
+    free(save_path_out);
+  } else if (!strcmp(cmd, "verify")) {
+    if (!asset_nxa_usb_rank_verify(rank)) {
+      error = util_str_dup("Checksum mismatch rank file");
+    } else if (!asset_nxa_usb_save_verify(save)) {
+      error = util_str_dup("Checksum mismatch save file");
+    }
+  } else if (!strcmp(cmd, "dump")) {
+    error = batch_save_dump(path, rank, save);
+  } else if (!strcmp(cmd, "json")) {
+    if (!asset_nxa_export_json(batch_ctx->out, path, rank, save)) {
+      error = util_str_dup("Writing json export failed");
+    }
+  } else if (!strcmp(cmd, "csv")) {
+    if (!asset_nxa_export_csv(batch_ctx->out, path, rank, save)) {
+      error = util_str_dup("Writing csv export failed");
+    }
+  }
+
+cleanup:
+  free(rank);
+  free(save);
+  free(rank_path);
+  free(save_path);
+
+  return error;
+}
+
+static int batch_run(int argc, char **argv)
+{
+  struct util_batch *batch;
+  struct util_batch_result result;
+  struct batch_ctx ctx;
+  bool export;
+  size_t threads;
+  int ret;
+
+  if (argc < 4) {
+    printf(
+        "Usage: %s batch [cmd: dec, enc, verify, dump, json, csv] "
+        "[directory containing profile directories or file listing profile "
+        "paths] [threads, optional, default number of cpus] [output file "
+        "for json and csv, optional, default stdout]\n",
+        argv[0]);
+    return -1;
+  }
+
+  ctx.cmd = argv[2];
+  ctx.out = stdout;
+
+  export = !strcmp(ctx.cmd, "json") || !strcmp(ctx.cmd, "csv");
+
+  if (strcmp(ctx.cmd, "dec") && strcmp(ctx.cmd, "enc") &&
+      strcmp(ctx.cmd, "verify") && strcmp(ctx.cmd, "dump") && !export) {
+    fprintf(stderr, "Unknown batch command %s\n", ctx.cmd);
+    return -1;
+  }
+
+  threads = argc > 4 ? strtoul(argv[4], NULL, 10) : 0;
+
+  if (export && argc > 5) {
+    ctx.out = fopen(argv[5], "w");
+
+    if (!ctx.out) {
+      fprintf(stderr, "Opening output file %s failed\n", argv[5]);
+      return -1;
+    }
+  }
+
+  if (!strcmp(ctx.cmd, "csv")) {
+    asset_nxa_export_csv_header(ctx.out);
+  }
+
+  batch = util_batch_start(threads, BATCH_QUEUE_SIZE, batch_proc, &ctx);
+
+  ret = 0;
+
+  if (!util_batch_push_path(batch, argv[3])) {
+    fprintf(stderr, "Reading profiles from %s failed\n", argv[3]);
+    ret = -2;
+  }
+
+  util_batch_finish(batch, &result);
+
+  if (ctx.out != stdout) {
+    fclose(ctx.out);
+  }
+
+  /* Keep the export on stdout clean */
+  util_batch_result_print(&result, export ? stderr : stdout);
+
+  if (result.failed > 0) {
+    ret = -3;
+  }
+
+  util_batch_result_fini(&result);
+
+  return ret;
+}
+
 int main(int argc, char **argv)
 {
   int ret;
   char *rank_path;
   char *save_path;
 
+  if (argc >= 2 && !strcmp(argv[1], "batch")) {
+    return batch_run(argc, argv);
+  }
+
   if (argc < 3) {
     printf(
-        "Usage: %s [cmd: new, dec, enc, dump] "
+        "Usage: %s [cmd: new, dec, enc, dump, batch] "
         "[path containing nxarank.bin nxasave.bin]\n",
         argv[0]);
     return -1;
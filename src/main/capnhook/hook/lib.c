@@ -111,7 +111,7 @@ static void *_cnh_lib_get_func_addr_test(const char *func_name)
 {
   for (size_t i = 0; i < _cnh_lib_func_mocks_cnt; i++) {
     if (!strcmp(_cnh_lib_func_mocks[i].name, func_name)) {
-      return _cnh_lib_func_mocks->func;
+      return _cnh_lib_func_mocks[i].func;
     }
   }
 
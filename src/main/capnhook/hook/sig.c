@@ -7,10 +7,13 @@
 
 typedef int (*cnh_sig_handler_sigaction_t)(
     int sig, const struct sigaction *act, struct sigaction *oact);
+typedef __sighandler_t (*cnh_sig_handler_signal_t)(
+    int sig, __sighandler_t handler);
 
 static void _cnh_signal_handler(int sig);
 
 static cnh_sig_handler_sigaction_t _cnh_sig_handler_real_sigaction;
+static cnh_sig_handler_signal_t _cnh_sig_handler_real_signal;
 
 static cnh_sig_handler_t _cnh_signal_handlers[32];
 static __sighandler_t _cnh_signal_orig_handlers[32];
@@ -30,9 +33,43 @@ void cnh_sig_install(int sig, cnh_sig_handler_t handler)
   log_info("Installed signal handler %p for %d", handler, sig);
 }
 
+__sighandler_t cnh_sig_get_orig_handler(int sig)
+{
+  if (sig < 0 || sig >= 32) {
+    return NULL;
+  }
+
+  return _cnh_signal_orig_handlers[sig];
+}
+
+__sighandler_t signal(int sig, __sighandler_t handler)
+{
+  if (!_cnh_sig_handler_real_signal) {
+    _cnh_sig_handler_real_signal =
+        (cnh_sig_handler_signal_t) cnh_lib_get_func_addr("signal");
+  }
+
+  /* cnh_sig_install installs the detour using signal as well */
+  if (sig >= 0 && sig < 32 && _cnh_signal_handlers[sig] &&
+      handler != _cnh_signal_handler) {
+    __sighandler_t prev;
+
+    log_info("Enforce own signal handler on signal: %d", sig);
+
+    prev = _cnh_signal_orig_handlers[sig];
+    _cnh_signal_orig_handlers[sig] = handler;
+
+    log_debug("Original handler %p for signal %d", handler, sig);
+
+    return prev;
+  }
+
+  return _cnh_sig_handler_real_signal(sig, handler);
+}
+
 int sigaction(int sig, const struct sigaction *act, struct sigaction *oact)
 {
-  if (_cnh_signal_handlers[sig]) {
+  if (act && sig >= 0 && sig < 32 && _cnh_signal_handlers[sig]) {
     log_info("Enforce own signal handler on signal: %d", sig);
 
     /* save the original handler, we might need it */
@@ -23,4 +23,13 @@ typedef void (*cnh_sig_handler_t)(int signal, __sighandler_t orig_handler);
  */
 void cnh_sig_install(int sig, cnh_sig_handler_t handler);
 
+/**
+ * Get the handler the application installed for a signal we installed our own
+ * handler for, e.g. to call it from somewhere else than a signal context
+ *
+ * @param sig Signal
+ * @return Original handler of the application or NULL if none installed (yet)
+ */
+__sighandler_t cnh_sig_get_orig_handler(int sig);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,176 @@
+#define LOG_MODULE "crypt-usb-profile"
+
+#include <immintrin.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "util/cpu.h"
+#include "util/log.h"
+#include "util/mem.h"
+
+#include "usb-profile.h"
+
+#define CRYPT_USB_PROFILE_KEY 1234567
+
+/* Rank and save sizes of a few games, enough for batch processing */
+#define CRYPT_USB_PROFILE_KEYSTREAM_CACHE_SIZE 8
+
+typedef void (*crypt_usb_profile_decrypt_t)(
+    uint8_t *buf, const uint8_t *keystream, size_t len);
+
+struct crypt_usb_profile_keystream {
+  size_t len;
+  uint8_t *data;
+};
+
+static pthread_mutex_t crypt_usb_profile_keystream_lock =
+    PTHREAD_MUTEX_INITIALIZER;
+static struct crypt_usb_profile_keystream
+    crypt_usb_profile_keystreams[CRYPT_USB_PROFILE_KEYSTREAM_CACHE_SIZE];
+static size_t crypt_usb_profile_keystream_count;
+
+static crypt_usb_profile_decrypt_t crypt_usb_profile_decrypt_func;
+
+static const uint8_t *crypt_usb_profile_get_keystream(size_t len)
+{
+  struct crypt_usb_profile_keystream *keystream;
+  uint32_t key;
+
+  pthread_mutex_lock(&crypt_usb_profile_keystream_lock);
+
+  for (size_t i = 0; i < crypt_usb_profile_keystream_count; i++) {
+    if (crypt_usb_profile_keystreams[i].len == len) {
+      pthread_mutex_unlock(&crypt_usb_profile_keystream_lock);
+      return crypt_usb_profile_keystreams[i].data;
+    }
+  }
+
+  /* Evict the oldest keystream. Not freed as other threads might still use it,
+     the memory leaked is only relevant for a large variety of sizes */
+  if (crypt_usb_profile_keystream_count ==
+      CRYPT_USB_PROFILE_KEYSTREAM_CACHE_SIZE) {
+    for (size_t i = 1; i < CRYPT_USB_PROFILE_KEYSTREAM_CACHE_SIZE; i++) {
+      crypt_usb_profile_keystreams[i - 1] = crypt_usb_profile_keystreams[i];
+    }
+
+    crypt_usb_profile_keystream_count--;
+  }
+
+  keystream = &crypt_usb_profile_keystreams[crypt_usb_profile_keystream_count];
+  keystream->len = len;
+  keystream->data = util_xmalloc(len);
+
+  key = 0;
+
+  for (size_t a = 0; a < len; a++) {
+    keystream->data[a] = (uint8_t) (key >> 8);
+    key += CRYPT_USB_PROFILE_KEY;
+  }
+
+  crypt_usb_profile_keystream_count++;
+
+  pthread_mutex_unlock(&crypt_usb_profile_keystream_lock);
+
+  log_debug("Created keystream for size %d", len);
+
+  return keystream->data;
+}
+
+/* Processes a downwards to 1, i.e. enc[a - 1] is not overwritten before it is
+   read. The vectorized variants process the upper part and leave the remaining
+   bytes to this */
+static void crypt_usb_profile_decrypt_scalar(
+    uint8_t *buf, const uint8_t *keystream, size_t len)
+{
+  for (size_t a = len - 1; a > 0; --a) {
+    buf[a] = (buf[a] ^ buf[a - 1]) + keystream[a];
+  }
+}
+
+__attribute__((target("sse2"))) static void crypt_usb_profile_decrypt_sse2(
+    uint8_t *buf, const uint8_t *keystream, size_t len)
+{
+  __m128i cur;
+  __m128i prev;
+  __m128i key;
+
+  while (len > 16) {
+    len -= 16;
+
+    cur = _mm_loadu_si128((const __m128i *) (buf + len));
+    prev = _mm_loadu_si128((const __m128i *) (buf + len - 1));
+    key = _mm_loadu_si128((const __m128i *) (keystream + len));
+
+    _mm_storeu_si128(
+        (__m128i *) (buf + len), _mm_add_epi8(_mm_xor_si128(cur, prev), key));
+  }
+
+  crypt_usb_profile_decrypt_scalar(buf, keystream, len);
+}
+
+__attribute__((target("avx2"))) static void crypt_usb_profile_decrypt_avx2(
+    uint8_t *buf, const uint8_t *keystream, size_t len)
+{
+  __m256i cur;
+  __m256i prev;
+  __m256i key;
+
+  while (len > 32) {
+    len -= 32;
+
+    cur = _mm256_loadu_si256((const __m256i *) (buf + len));
+    prev = _mm256_loadu_si256((const __m256i *) (buf + len - 1));
+    key = _mm256_loadu_si256((const __m256i *) (keystream + len));
+
+    _mm256_storeu_si256(
+        (__m256i *) (buf + len),
+        _mm256_add_epi8(_mm256_xor_si256(cur, prev), key));
+  }
+
+  crypt_usb_profile_decrypt_sse2(buf, keystream, len);
+}
+
+void crypt_usb_profile_decrypt(uint8_t *buf, size_t len)
+{
+  const uint8_t *keystream;
+
+  if (len < 2) {
+    return;
+  }
+
+  /* Resolving concurrently is fine, all threads resolve to the same result */
+  if (!crypt_usb_profile_decrypt_func) {
+    if (util_cpu_has_avx2()) {
+      crypt_usb_profile_decrypt_func = crypt_usb_profile_decrypt_avx2;
+    } else if (util_cpu_has_sse2()) {
+      crypt_usb_profile_decrypt_func = crypt_usb_profile_decrypt_sse2;
+    } else {
+      crypt_usb_profile_decrypt_func = crypt_usb_profile_decrypt_scalar;
+    }
+  }
+
+  keystream = crypt_usb_profile_get_keystream(len);
+
+  crypt_usb_profile_decrypt_func(buf, keystream, len);
+}
+
+void crypt_usb_profile_encrypt(uint8_t *buf, size_t len)
+{
+  const uint8_t *keystream;
+  uint8_t prev;
+
+  if (len < 2) {
+    return;
+  }
+
+  keystream = crypt_usb_profile_get_keystream(len);
+
+  /* Sequential by design, keep the previous ciphertext byte in a register
+     instead of reloading it from the buffer */
+  prev = buf[0];
+
+  for (size_t a = 1; a < len; a++) {
+    prev = (uint8_t) (buf[a] - keystream[a]) ^ prev;
+    buf[a] = prev;
+  }
+}
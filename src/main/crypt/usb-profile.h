@@ -0,0 +1,36 @@
+#ifndef CRYPT_USB_PROFILE_H
+#define CRYPT_USB_PROFILE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Cipher of the usb profile files (save and rank) of Fiesta EX, NX2 and NXA.
+ * Every byte (except the first one) is chained with the previous ciphertext
+ * byte and a keystream byte depending on its position only:
+ *
+ * dec[a] = (enc[a] ^ enc[a - 1]) + ((a * 1234567) >> 8)
+ *
+ * The keystream is calculated with 32-bit arithmetic like the games do.
+ * Decryption does not depend on previously decrypted bytes and is vectorized
+ * (SSE2/AVX2, selected at runtime). The keystreams of the recently used buffer
+ * sizes are cached. All functions are thread-safe.
+ */
+
+/**
+ * Decrypt a buffer in place
+ *
+ * @param buf Buffer to decrypt
+ * @param len Length of the buffer
+ */
+void crypt_usb_profile_decrypt(uint8_t *buf, size_t len);
+
+/**
+ * Encrypt a buffer in place
+ *
+ * @param buf Buffer to encrypt
+ * @param len Length of the buffer
+ */
+void crypt_usb_profile_encrypt(uint8_t *buf, size_t len);
+
+#endif
@@ -9,6 +9,7 @@
 
 #include "util/log.h"
 #include "util/patch.h"
+#include "util/time.h"
 
 /* Taken from ioarcade.hpp nx2 src dump */
 #define GI_P1_1 0x00000001
@@ -39,18 +40,26 @@ struct exchook_io_sensores {
   uint32_t padding : 12;
 };
 
+/* Input state polled from the backend, served to all IO entry points until
+   the next poll */
+struct exchook_io_state {
+  struct exchook_io_sensores sensores_p1;
+  struct exchook_io_sensores sensores_p2;
+  struct ptapi_io_piuio_sys_inputs sys;
+};
+
 static const uint8_t exchook_io_sensor_mappings[] = {1, 2, 3, 0};
 
 static struct ptapi_io_piuio_api exchook_piuio_api;
 
-static uint16_t exchook_io_check(void *obj);
+uint16_t exchook_io_check(void *obj);
 static int32_t exchook_io_light_all(void *obj, uint8_t on);
 static int32_t exchook_io_light_neon(void *obj, uint8_t on);
 static int32_t
 exchook_io_light_halogan(void *obj, uint8_t on, uint16_t light_id);
 static int32_t exchook_io_light_p1_ccfl(void *obj, uint8_t on, uint16_t cmd);
 static int32_t exchook_io_light_p2_ccfl(void *obj, uint8_t on, uint16_t cmd);
-static int32_t exchook_io_input(void *obj);
+int32_t exchook_io_input(void *obj);
 static int32_t exchook_io_coin_input(void *obj);
 static int32_t exchook_io_coin_input_2(void *obj);
 static int32_t exchook_io_coin_counter_2(void *obj);
@@ -61,20 +70,139 @@ static uint32_t *exchook_io_game_input_up;
 
 static uint32_t exchook_io_game_input_stat_prev;
 
-static struct exchook_io_sensores exchook_io_sensores_p1;
-static struct exchook_io_sensores exchook_io_sensores_p2;
+static struct exchook_io_state exchook_io_state;
 static struct ptapi_io_piuio_pad_outputs exchook_io_out_pad_p1;
 static struct ptapi_io_piuio_pad_outputs exchook_io_out_pad_p2;
 static struct ptapi_io_piuio_pad_outputs exchook_io_out_pad_press_p1;
 static struct ptapi_io_piuio_pad_outputs exchook_io_out_pad_press_p2;
 static struct ptapi_io_piuio_cab_outputs exchook_io_out_cab;
+static bool exchook_io_out_dirty;
 
 static bool exchook_io_exit_on_service_test;
+static uint32_t exchook_io_poll_interval_us;
+static bool exchook_io_state_polled;
+static uint64_t exchook_io_state_poll_time_us;
+
+static void exchook_io_flush_outputs(void)
+{
+  if (!exchook_io_out_dirty) {
+    return;
+  }
+
+  exchook_piuio_api.set_output_pad(0, &exchook_io_out_pad_press_p1);
+  exchook_piuio_api.set_output_pad(1, &exchook_io_out_pad_press_p2);
+  exchook_piuio_api.set_output_cab(&exchook_io_out_cab);
+
+  exchook_io_out_dirty = false;
+}
+
+static void exchook_io_poll(void)
+{
+  struct ptapi_io_piuio_pad_inputs p1_pad_in;
+  struct ptapi_io_piuio_pad_inputs p2_pad_in;
+
+  /* Outputs set since the last poll are sent with this poll's transfer */
+  exchook_io_flush_outputs();
+
+  /* might delay output for a frame but whatever */
+  if (!exchook_piuio_api.send()) {
+    log_error("Piuio send failed");
+  }
+
+  if (!exchook_piuio_api.recv()) {
+    log_error("Piuio receive failed");
+  }
+
+  /* State reset */
+  memset(&exchook_io_state, 0, sizeof(struct exchook_io_state));
+
+  /* cycle all sensores */
+  for (uint8_t i = 0; i < 4; i++) {
+    memset(&p1_pad_in, 0, sizeof(struct ptapi_io_piuio_pad_inputs));
+    memset(&p2_pad_in, 0, sizeof(struct ptapi_io_piuio_pad_inputs));
+
+    exchook_piuio_api.get_input_pad(0, i, &p1_pad_in);
+    exchook_piuio_api.get_input_pad(1, i, &p2_pad_in);
+
+    /* process inputs */
+
+    /* Player 1 */
+    if (p1_pad_in.lu) {
+      exchook_io_state.sensores_p1.lu |= (1 << exchook_io_sensor_mappings[i]);
+    }
+
+    if (p1_pad_in.ru) {
+      exchook_io_state.sensores_p1.ru |= (1 << exchook_io_sensor_mappings[i]);
+    }
+
+    if (p1_pad_in.cn) {
+      exchook_io_state.sensores_p1.cn |= (1 << exchook_io_sensor_mappings[i]);
+    }
+
+    if (p1_pad_in.ld) {
+      exchook_io_state.sensores_p1.ld |= (1 << exchook_io_sensor_mappings[i]);
+    }
+
+    if (p1_pad_in.rd) {
+      exchook_io_state.sensores_p1.rd |= (1 << exchook_io_sensor_mappings[i]);
+    }
+
+    /* Player 2 */
+    if (p2_pad_in.lu) {
+      exchook_io_state.sensores_p2.lu |= (1 << exchook_io_sensor_mappings[i]);
+    }
+
+    if (p2_pad_in.ru) {
+      exchook_io_state.sensores_p2.ru |= (1 << exchook_io_sensor_mappings[i]);
+    }
+
+    if (p2_pad_in.cn) {
+      exchook_io_state.sensores_p2.cn |= (1 << exchook_io_sensor_mappings[i]);
+    }
+
+    if (p2_pad_in.ld) {
+      exchook_io_state.sensores_p2.ld |= (1 << exchook_io_sensor_mappings[i]);
+    }
+
+    if (p2_pad_in.rd) {
+      exchook_io_state.sensores_p2.rd |= (1 << exchook_io_sensor_mappings[i]);
+    }
+  }
+
+  exchook_piuio_api.get_input_sys(&exchook_io_state.sys);
+}
+
+static void exchook_io_update(void)
+{
+  uint64_t now;
+
+  if (exchook_io_poll_interval_us == 0) {
+    /* Once per frame: the first call after the game consumed the previous
+       frame's inputs (io_input) triggers the poll */
+    if (exchook_io_state_polled) {
+      return;
+    }
+  } else {
+    /* Minimum interval between two polls, independent of the frames */
+    now = util_time_get_monotonic_ns() / 1000;
+
+    if (exchook_io_state_polled &&
+        now - exchook_io_state_poll_time_us < exchook_io_poll_interval_us) {
+      return;
+    }
+
+    exchook_io_state_poll_time_us = now;
+  }
+
+  exchook_io_poll();
+  exchook_io_state_polled = true;
+}
 
 void exchook_io_init(
     const struct exchook_mempatch_table *patch_table,
     const char *piuio_lib_path,
-    bool exit_on_service_test)
+    bool exit_on_service_test,
+    uint32_t poll_interval_us)
 {
   if (!piuio_lib_path) {
     log_error(
@@ -94,8 +222,17 @@ void exchook_io_init(
 
   exchook_io_exit_on_service_test = exit_on_service_test;
 
+  exchook_io_poll_interval_us = poll_interval_us;
+  exchook_io_state_polled = false;
+
   log_info("Service + Test exit %d", exchook_io_exit_on_service_test);
 
+  if (exchook_io_poll_interval_us == 0) {
+    log_info("Polling piuio once per frame");
+  } else {
+    log_info("Polling piuio every %d us", exchook_io_poll_interval_us);
+  }
+
   /* Hook MK5IO engine calls */
   /* Why so many functions you might ask? Because the MK5 IO code is a pile
      of shit created by a monkey */
@@ -137,96 +274,24 @@ void exchook_io_shutdown(void)
 }
 
 /* check? why can't you just call it get_fucking_inputs... */
-static uint16_t exchook_io_check(void *obj)
+uint16_t exchook_io_check(void *obj)
 {
-  struct ptapi_io_piuio_pad_inputs p1_pad_in;
-  struct ptapi_io_piuio_pad_inputs p2_pad_in;
-
   /* Sensor states are expected to be returned using the object */
   struct exchook_io_sensores *sensores_p1 = (struct exchook_io_sensores *) obj;
   struct exchook_io_sensores *sensores_p2 =
       (struct exchook_io_sensores *) (((uint32_t *) obj) + 1);
 
-  /* execute polling here */
-
-  /* might delay output for a frame but whatever */
-  if (!exchook_piuio_api.send()) {
-    log_error("Piuio send failed");
-  }
-
-  if (!exchook_piuio_api.recv()) {
-    log_error("Piuio receive failed");
-  }
-
-  /* MK5 inputs state reset */
-  exchook_io_sensores_p1.lu = 0;
-  exchook_io_sensores_p1.ru = 0;
-  exchook_io_sensores_p1.cn = 0;
-  exchook_io_sensores_p1.ld = 0;
-  exchook_io_sensores_p1.rd = 0;
-
-  exchook_io_sensores_p2.lu = 0;
-  exchook_io_sensores_p2.ru = 0;
-  exchook_io_sensores_p2.cn = 0;
-  exchook_io_sensores_p2.ld = 0;
-  exchook_io_sensores_p2.rd = 0;
-
-  // State reset
-  memset(&p1_pad_in, 0, sizeof(struct ptapi_io_piuio_pad_inputs));
-  memset(&p2_pad_in, 0, sizeof(struct ptapi_io_piuio_pad_inputs));
-
-  /* cycle all sensores */
-  for (uint8_t i = 0; i < 4; i++) {
-    exchook_piuio_api.get_input_pad(0, i, &p1_pad_in);
-    exchook_piuio_api.get_input_pad(1, i, &p2_pad_in);
-
-    /* process inputs */
-
-    /* Player 1 */
-    if (p1_pad_in.lu) {
-      exchook_io_sensores_p1.lu |= (1 << exchook_io_sensor_mappings[i]);
-    }
-
-    if (p1_pad_in.ru) {
-      exchook_io_sensores_p1.ru |= (1 << exchook_io_sensor_mappings[i]);
-    }
-
-    if (p1_pad_in.cn) {
-      exchook_io_sensores_p1.cn |= (1 << exchook_io_sensor_mappings[i]);
-    }
+  /* execute polling here, if the cached state is outdated */
+  exchook_io_update();
 
-    if (p1_pad_in.ld) {
-      exchook_io_sensores_p1.ld |= (1 << exchook_io_sensor_mappings[i]);
-    }
-
-    if (p1_pad_in.rd) {
-      exchook_io_sensores_p1.rd |= (1 << exchook_io_sensor_mappings[i]);
-    }
-
-    /* Player 2 */
-    if (p2_pad_in.lu) {
-      exchook_io_sensores_p2.lu |= (1 << exchook_io_sensor_mappings[i]);
-    }
-
-    if (p2_pad_in.ru) {
-      exchook_io_sensores_p2.ru |= (1 << exchook_io_sensor_mappings[i]);
-    }
-
-    if (p2_pad_in.cn) {
-      exchook_io_sensores_p2.cn |= (1 << exchook_io_sensor_mappings[i]);
-    }
-
-    if (p2_pad_in.ld) {
-      exchook_io_sensores_p2.ld |= (1 << exchook_io_sensor_mappings[i]);
-    }
-
-    if (p2_pad_in.rd) {
-      exchook_io_sensores_p2.rd |= (1 << exchook_io_sensor_mappings[i]);
-    }
-  }
-
-  memcpy(sensores_p1, &exchook_io_sensores_p1, sizeof(exchook_io_sensores_p1));
-  memcpy(sensores_p2, &exchook_io_sensores_p2, sizeof(exchook_io_sensores_p2));
+  memcpy(
+      sensores_p1,
+      &exchook_io_state.sensores_p1,
+      sizeof(struct exchook_io_sensores));
+  memcpy(
+      sensores_p2,
+      &exchook_io_state.sensores_p2,
+      sizeof(struct exchook_io_sensores));
 
   return 0;
 }
@@ -243,9 +308,16 @@ static int32_t exchook_io_light_all(void *obj, uint8_t on)
     memset(&exchook_io_out_cab, 0, sizeof(exchook_io_out_cab));
   }
 
-  exchook_piuio_api.set_output_pad(0, &exchook_io_out_pad_p1);
-  exchook_piuio_api.set_output_pad(1, &exchook_io_out_pad_p2);
-  exchook_piuio_api.set_output_cab(&exchook_io_out_cab);
+  memcpy(
+      &exchook_io_out_pad_press_p1,
+      &exchook_io_out_pad_p1,
+      sizeof(exchook_io_out_pad_press_p1));
+  memcpy(
+      &exchook_io_out_pad_press_p2,
+      &exchook_io_out_pad_p2,
+      sizeof(exchook_io_out_pad_press_p2));
+
+  exchook_io_out_dirty = true;
 
   return 0;
 }
@@ -258,7 +330,7 @@ static int32_t exchook_io_light_neon(void *obj, uint8_t on)
     exchook_io_out_cab.bass = false;
   }
 
-  exchook_piuio_api.set_output_cab(&exchook_io_out_cab);
+  exchook_io_out_dirty = true;
 
   return 0;
 }
@@ -282,7 +354,7 @@ exchook_io_light_halogan(void *obj, uint8_t on, uint16_t light_id)
     exchook_io_out_cab.halo_r2 = on;
   }
 
-  exchook_piuio_api.set_output_cab(&exchook_io_out_cab);
+  exchook_io_out_dirty = true;
 
   return 0;
 }
@@ -337,21 +409,22 @@ static int32_t exchook_io_light_p2_ccfl(void *obj, uint8_t on, uint16_t cmd)
   return 0;
 }
 
-static int32_t exchook_io_input(void *obj)
+int32_t exchook_io_input(void *obj)
 {
   uint32_t stat;
   uint32_t stat_down;
   uint32_t stat_up;
 
-  struct ptapi_io_piuio_sys_inputs sys_in;
+  const struct ptapi_io_piuio_sys_inputs *sys_in;
 
-  memset(&sys_in, 0, sizeof(struct ptapi_io_piuio_sys_inputs));
+  /* In case the game did not call check before in this frame */
+  exchook_io_update();
 
-  exchook_piuio_api.get_input_sys(&sys_in);
+  sys_in = &exchook_io_state.sys;
 
   /* For game loaders and stuff */
   if (exchook_io_exit_on_service_test) {
-    if (sys_in.test && sys_in.service) {
+    if (sys_in->test && sys_in->service) {
       log_info("Exit on service + test enabled and hit, bye");
       exit(0);
     }
@@ -365,66 +438,66 @@ static int32_t exchook_io_input(void *obj)
   stat_up = 0;
 
   /* Player 1 */
-  if (exchook_io_sensores_p1.lu) {
+  if (exchook_io_state.sensores_p1.lu) {
     stat |= GI_P1_7;
   }
 
-  if (exchook_io_sensores_p1.ru) {
+  if (exchook_io_state.sensores_p1.ru) {
     stat |= GI_P1_9;
   }
 
-  if (exchook_io_sensores_p1.cn) {
+  if (exchook_io_state.sensores_p1.cn) {
     stat |= GI_P1_5;
   }
 
-  if (exchook_io_sensores_p1.ld) {
+  if (exchook_io_state.sensores_p1.ld) {
     stat |= GI_P1_1;
   }
 
-  if (exchook_io_sensores_p1.rd) {
+  if (exchook_io_state.sensores_p1.rd) {
     stat |= GI_P1_3;
   }
 
   /* Player 2 */
-  if (exchook_io_sensores_p2.lu) {
+  if (exchook_io_state.sensores_p2.lu) {
     stat |= GI_P2_7;
   }
 
-  if (exchook_io_sensores_p2.ru) {
+  if (exchook_io_state.sensores_p2.ru) {
     stat |= GI_P2_9;
   }
 
-  if (exchook_io_sensores_p2.cn) {
+  if (exchook_io_state.sensores_p2.cn) {
     stat |= GI_P2_5;
   }
 
-  if (exchook_io_sensores_p2.ld) {
+  if (exchook_io_state.sensores_p2.ld) {
     stat |= GI_P2_1;
   }
 
-  if (exchook_io_sensores_p2.rd) {
+  if (exchook_io_state.sensores_p2.rd) {
     stat |= GI_P2_3;
   }
 
   /* Sys */
-  if (sys_in.test) {
+  if (sys_in->test) {
     stat |= GI_TEST;
   }
 
-  if (sys_in.service) {
+  if (sys_in->service) {
     stat |= GI_SERVICE;
   }
 
   /* Taken from source but doesn't seem to work (on some versions?) */
-  if (sys_in.clear) {
+  if (sys_in->clear) {
     stat |= GI_CLEAR;
   }
 
-  if (sys_in.coin) {
+  if (sys_in->coin) {
     stat |= GI_COIN;
   }
 
-  if (sys_in.coin2) {
+  if (sys_in->coin2) {
     stat |= GI_COIN2;
   }
 
@@ -457,18 +530,18 @@ static int32_t exchook_io_input(void *obj)
   memset(&exchook_io_out_pad_press_p2, 0, sizeof(exchook_io_out_pad_press_p2));
 
   /* Player 1 */
-  exchook_io_out_pad_press_p1.lu |= exchook_io_sensores_p1.lu;
-  exchook_io_out_pad_press_p1.ru |= exchook_io_sensores_p1.ru;
-  exchook_io_out_pad_press_p1.cn |= exchook_io_sensores_p1.cn;
-  exchook_io_out_pad_press_p1.ld |= exchook_io_sensores_p1.ld;
-  exchook_io_out_pad_press_p1.rd |= exchook_io_sensores_p1.rd;
+  exchook_io_out_pad_press_p1.lu |= exchook_io_state.sensores_p1.lu;
+  exchook_io_out_pad_press_p1.ru |= exchook_io_state.sensores_p1.ru;
+  exchook_io_out_pad_press_p1.cn |= exchook_io_state.sensores_p1.cn;
+  exchook_io_out_pad_press_p1.ld |= exchook_io_state.sensores_p1.ld;
+  exchook_io_out_pad_press_p1.rd |= exchook_io_state.sensores_p1.rd;
 
   /* Player 2 */
-  exchook_io_out_pad_press_p2.lu |= exchook_io_sensores_p2.lu;
-  exchook_io_out_pad_press_p2.ru |= exchook_io_sensores_p2.ru;
-  exchook_io_out_pad_press_p2.cn |= exchook_io_sensores_p2.cn;
-  exchook_io_out_pad_press_p2.ld |= exchook_io_sensores_p2.ld;
-  exchook_io_out_pad_press_p2.rd |= exchook_io_sensores_p2.rd;
+  exchook_io_out_pad_press_p2.lu |= exchook_io_state.sensores_p2.lu;
+  exchook_io_out_pad_press_p2.ru |= exchook_io_state.sensores_p2.ru;
+  exchook_io_out_pad_press_p2.cn |= exchook_io_state.sensores_p2.cn;
+  exchook_io_out_pad_press_p2.ld |= exchook_io_state.sensores_p2.ld;
+  exchook_io_out_pad_press_p2.rd |= exchook_io_state.sensores_p2.rd;
 
   /* merge */
   /* Player 1 */
@@ -485,8 +558,14 @@ static int32_t exchook_io_input(void *obj)
   exchook_io_out_pad_press_p2.ld |= exchook_io_out_pad_p2.ld;
   exchook_io_out_pad_press_p2.rd |= exchook_io_out_pad_p2.rd;
 
-  exchook_piuio_api.set_output_pad(0, &exchook_io_out_pad_press_p1);
-  exchook_piuio_api.set_output_pad(1, &exchook_io_out_pad_press_p2);
+  /* Sent with the next poll */
+  exchook_io_out_dirty = true;
+
+  /* Inputs of this frame consumed, poll again on the next one. With a poll
+     interval, the next poll is due once the interval expired */
+  if (exchook_io_poll_interval_us == 0) {
+    exchook_io_state_polled = false;
+  }
 
   return 0;
 }
@@ -6,6 +6,9 @@
 #ifndef EXCHOOK_IO_H
 #define EXCHOOK_IO_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "hook/exc/mempatch.h"
 
 /**
@@ -14,11 +17,15 @@
  * @param patch_table Patch table with memory addresses
  * @param piuio_lib_path Path to piuio lib to use for emulation
  * @parma exit_on_service_test Exit the game when pressing service + test
+ * @param poll_interval_us Minimum interval in microseconds between polling
+ *        the piuio lib. All IO calls of the game in between are served from
+ *        a cached state. 0 to poll once per game frame
  */
 void exchook_io_init(
     const struct exchook_mempatch_table *patch_table,
     const char *piuio_lib_path,
-    bool exit_on_service_test);
+    bool exit_on_service_test,
+    uint32_t poll_interval_us);
 
 /**
  * Shut down io emulation
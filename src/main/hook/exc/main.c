@@ -10,7 +10,9 @@
 
 #include "hook/core/piu-utils.h"
 
+#include "hook/patch/alarm-timer.h"
 #include "hook/patch/asound-fix.h"
+#include "hook/patch/gfx-frame-time.h"
 #include "hook/patch/gfx.h"
 #include "hook/patch/hook-mon.h"
 #include "hook/patch/main-loop.h"
@@ -131,7 +133,20 @@ static void exchook_patch_gfx_init(struct exchook_options *options)
   patch_gfx_init();
 
   if (options->patch.gfx.scaling_mode != PATCH_GFX_SCALE_MODE_INVALID) {
-    patch_gfx_scale(options->patch.gfx.scaling_mode);
+    patch_gfx_scale(
+        options->patch.gfx.scaling_mode, options->patch.gfx.scaling_filter);
+  }
+
+  if (options->patch.gfx.swap_interval >= 0) {
+    patch_gfx_force_swap_interval(options->patch.gfx.swap_interval);
+  }
+
+  if (options->patch.gfx.frame_stats_interval > 0) {
+    patch_gfx_frame_time_init(options->patch.gfx.frame_stats_interval);
+  }
+
+  if (options->patch.gfx.frame_limit > 0) {
+    patch_gfx_frame_time_limit_init(options->patch.gfx.frame_limit);
   }
 }
 
@@ -140,7 +155,13 @@ static void exchook_patch_main_loop_init(struct exchook_options *options)
   log_assert(options);
 
   patch_main_loop_init(
-      true, options->patch.main_loop.disable_built_in_inputs, false);
+      !options->patch.main_loop.alarm_timer,
+      options->patch.main_loop.disable_built_in_inputs,
+      false);
+
+  if (options->patch.main_loop.alarm_timer) {
+    patch_alarm_timer_init();
+  }
 
   if (options->patch.main_loop.x11_input_handler_api_lib) {
     char *abs_path_x11_input_hook_lib = util_fs_get_abs_path(
@@ -167,6 +188,17 @@ static void exchook_patch_sound_init(
   }
 
   patch_sound_init(options->patch.sound.device);
+
+  if (options->patch.sound.buffer_time_max_us > 0 ||
+      options->patch.sound.period_time_max_us > 0) {
+    patch_sound_latency_init(
+        options->patch.sound.buffer_time_max_us,
+        options->patch.sound.period_time_max_us);
+  }
+
+  if (options->patch.sound.pcm_pool_size > 0) {
+    patch_sound_pcm_pool_init(options->patch.sound.pcm_pool_size);
+  }
   patch_asound_fix_init();
 
   /* return from StopAllEffects to avoid killing the sound thread */
@@ -224,7 +256,10 @@ static void exchook_patch_piuio_init(
     char *abs_path_iolib = util_fs_get_abs_path(options->patch.piuio.api_lib);
 
     exchook_io_init(
-        patch_table, abs_path_iolib, options->patch.piuio.exit_test_serv);
+        patch_table,
+        abs_path_iolib,
+        options->patch.piuio.exit_test_serv,
+        options->patch.piuio.poll_interval_us);
     free(abs_path_iolib);
   }
 }
@@ -268,6 +303,7 @@ void exchook_trap_before_main(int argc, char **argv)
 
 void exchook_trap_after_main(void)
 {
+  patch_gfx_frame_time_shutdown();
   exchook_io_shutdown();
 }
 
@@ -4,6 +4,11 @@
 
 #define F2HOOK_OPTIONS_STR_GAME_SETTINGS "game.settings"
 #define F2HOOK_OPTIONS_STR_PATCH_GFX_SCALING_MODE "patch.gfx.scaling_mode"
+#define F2HOOK_OPTIONS_STR_PATCH_GFX_SCALING_FILTER "patch.gfx.scaling_filter"
+#define F2HOOK_OPTIONS_STR_PATCH_GFX_FRAME_STATS_INTERVAL \
+  "patch.gfx.frame_stats_interval"
+#define F2HOOK_OPTIONS_STR_PATCH_GFX_SWAP_INTERVAL "patch.gfx.swap_interval"
+#define F2HOOK_OPTIONS_STR_PATCH_GFX_FRAME_LIMIT "patch.gfx.frame_limit"
 #define F2HOOK_OPTIONS_STR_PATCH_HOOK_MON_FILE "patch.hook_mon.file"
 #define F2HOOK_OPTIONS_STR_PATCH_HOOK_MON_FS "patch.hook_mon.fs"
 #define F2HOOK_OPTIONS_STR_PATCH_HOOK_MON_IO "patch.hook_mon.io"
@@ -20,6 +25,10 @@
 #define F2HOOK_OPTIONS_STR_PATCH_PIUIO_EXIT_TEST_SERV \
   "patch.piuio_exit.test_serv"
 #define F2HOOK_OPTIONS_STR_PATCH_SOUND_DEVICE "patch.sound.device"
+#define F2HOOK_OPTIONS_STR_PATCH_SOUND_BUFFER_TIME_MAX_US \
+  "patch.sound.buffer_time_max_us"
+#define F2HOOK_OPTIONS_STR_PATCH_SOUND_PERIOD_TIME_MAX_US \
+  "patch.sound.period_time_max_us"
 #define F2HOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV \
   "patch.sigsegv.halt_on_segv"
 #define F2HOOK_OPTIONS_STR_PATCH_UTIL_LOG_FILE "util.log.file"
@@ -45,6 +54,50 @@ const struct util_options_def f2hook_options_def[] = {
         .is_secret_data = false,
         .default_value.i = 0,
     },
+    {
+        .name = F2HOOK_OPTIONS_STR_PATCH_GFX_SCALING_FILTER,
+        .description =
+            "Filter for scaling the rendered output, requires a scaling mode: "
+            "0 = linear, 1 = nearest, 2 = integer (nearest with the largest "
+            "integer scale factor that fits)",
+        .param = 't',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = F2HOOK_OPTIONS_STR_PATCH_GFX_FRAME_STATS_INTERVAL,
+        .description =
+            "Log frame time stats (mean, p99, worst, dropped frames) every n "
+            "seconds and publish them to shared memory "
+            "/dev/shm/pumptools-frame-time. 0 to disable",
+        .param = 'w',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = F2HOOK_OPTIONS_STR_PATCH_GFX_SWAP_INTERVAL,
+        .description =
+            "Force a swap interval (vsync) on the game's GL context: -1 = do "
+            "not change (driver default), 0 = vsync off, 1 = vsync on, n = "
+            "swap every n-th vertical blank",
+        .param = 'y',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = -1,
+    },
+    {
+        .name = F2HOOK_OPTIONS_STR_PATCH_GFX_FRAME_LIMIT,
+        .description =
+            "Limit the frame rate of the game to the given refresh rate in "
+            "hz, e.g. 60. For games rendering unbounded without vsync. 0 to "
+            "disable",
+        .param = 'x',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
     {
         .name = F2HOOK_OPTIONS_STR_PATCH_HOOK_MON_FILE,
         .description = "Enable file call monitoring",
@@ -145,6 +198,27 @@ const struct util_options_def f2hook_options_def[] = {
         .is_secret_data = false,
         .default_value.str = "dmix",
     },
+    {
+        .name = F2HOOK_OPTIONS_STR_PATCH_SOUND_BUFFER_TIME_MAX_US,
+        .description =
+            "Clamp the buffer time (latency) of the sound device requested by "
+            "the game to a max in us, e.g. 20000. 0 to keep the game's buffer "
+            "time",
+        .param = 'b',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = F2HOOK_OPTIONS_STR_PATCH_SOUND_PERIOD_TIME_MAX_US,
+        .description =
+            "Clamp the period time of the sound device requested by the game "
+            "to a max in us, e.g. 5000. 0 to keep the game's period time",
+        .param = 'B',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
     {
         .name = F2HOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV,
         .description = "Halt on sigsegv to attach a debugger to the process",
@@ -198,6 +272,14 @@ bool f2hook_options_init(int argc, char **argv, struct f2hook_options *options)
       util_options_get_str(options_opt, F2HOOK_OPTIONS_STR_GAME_SETTINGS);
   options->patch.gfx.scaling_mode = util_options_get_int(
       options_opt, F2HOOK_OPTIONS_STR_PATCH_GFX_SCALING_MODE);
+  options->patch.gfx.scaling_filter = util_options_get_int(
+      options_opt, F2HOOK_OPTIONS_STR_PATCH_GFX_SCALING_FILTER);
+  options->patch.gfx.frame_stats_interval = util_options_get_int(
+      options_opt, F2HOOK_OPTIONS_STR_PATCH_GFX_FRAME_STATS_INTERVAL);
+  options->patch.gfx.swap_interval = util_options_get_int(
+      options_opt, F2HOOK_OPTIONS_STR_PATCH_GFX_SWAP_INTERVAL);
+  options->patch.gfx.frame_limit = util_options_get_int(
+      options_opt, F2HOOK_OPTIONS_STR_PATCH_GFX_FRAME_LIMIT);
   options->patch.hook_mon.file = util_options_get_bool(
       options_opt, F2HOOK_OPTIONS_STR_PATCH_HOOK_MON_FILE);
   options->patch.hook_mon.fs =
@@ -226,6 +308,10 @@ bool f2hook_options_init(int argc, char **argv, struct f2hook_options *options)
       options_opt, F2HOOK_OPTIONS_STR_PATCH_PIUIO_EXIT_TEST_SERV);
   options->patch.sound.device =
       util_options_get_str(options_opt, F2HOOK_OPTIONS_STR_PATCH_SOUND_DEVICE);
+  options->patch.sound.buffer_time_max_us = util_options_get_int(
+      options_opt, F2HOOK_OPTIONS_STR_PATCH_SOUND_BUFFER_TIME_MAX_US);
+  options->patch.sound.period_time_max_us = util_options_get_int(
+      options_opt, F2HOOK_OPTIONS_STR_PATCH_SOUND_PERIOD_TIME_MAX_US);
   options->patch.sigsegv.halt_on_segv = util_options_get_bool(
       options_opt, F2HOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV);
   options->log.file =
@@ -14,6 +14,10 @@ struct f2hook_options {
   struct patch {
     struct gfx {
       uint8_t scaling_mode;
+      uint8_t scaling_filter;
+      uint32_t frame_stats_interval;
+      int swap_interval;
+      uint32_t frame_limit;
     } gfx;
 
     struct hook_mon {
@@ -41,6 +45,8 @@ struct f2hook_options {
 
     struct sound {
       const char *device;
+      uint32_t buffer_time_max_us;
+      uint32_t period_time_max_us;
     } sound;
 
     struct sigsegv {
@@ -11,6 +11,7 @@
 #include "hook/core/piu-utils.h"
 
 #include "hook/patch/amixer-block.h"
+#include "hook/patch/gfx-frame-time.h"
 #include "hook/patch/gfx.h"
 #include "hook/patch/hdd-check.h"
 #include "hook/patch/hook-mon.h"
@@ -139,7 +140,20 @@ static void fexhook_patch_gfx_init(struct fexhook_options *options)
   patch_gfx_init();
 
   if (options->patch.gfx.scaling_mode != PATCH_GFX_SCALE_MODE_INVALID) {
-    patch_gfx_scale(options->patch.gfx.scaling_mode);
+    patch_gfx_scale(
+        options->patch.gfx.scaling_mode, options->patch.gfx.scaling_filter);
+  }
+
+  if (options->patch.gfx.swap_interval >= 0) {
+    patch_gfx_force_swap_interval(options->patch.gfx.swap_interval);
+  }
+
+  if (options->patch.gfx.frame_stats_interval > 0) {
+    patch_gfx_frame_time_init(options->patch.gfx.frame_stats_interval);
+  }
+
+  if (options->patch.gfx.frame_limit > 0) {
+    patch_gfx_frame_time_limit_init(options->patch.gfx.frame_limit);
   }
 }
 
@@ -164,6 +178,14 @@ static void fexhook_patch_sound_init(struct fexhook_options *options)
   log_assert(options);
 
   patch_sound_init(options->patch.sound.device);
+
+  if (options->patch.sound.buffer_time_max_us > 0 ||
+      options->patch.sound.period_time_max_us > 0) {
+    patch_sound_latency_init(
+        options->patch.sound.buffer_time_max_us,
+        options->patch.sound.period_time_max_us);
+  }
+
   patch_axmier_block_init();
 }
 
@@ -247,6 +269,7 @@ void fexhook_trap_before_main(int argc, char **argv)
 
 void fexhook_trap_after_main(void)
 {
+  patch_gfx_frame_time_shutdown();
   patch_piuio_shutdown();
 }
 
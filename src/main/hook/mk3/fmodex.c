@@ -2,6 +2,7 @@
 
 #include <fmodex/fmod.h>
 #include <fmodex/fmod_errors.h>
+#include <stdint.h>
 
 #include "capnhook/hook/lib.h"
 
@@ -20,6 +21,132 @@ static FMOD_System_Init_t mk3hook_fmodex_real_FMOD_System_Init;
 
 static bool mk3hook_fmodex_debug_output;
 static const char *mk3hook_fmodex_sound_device;
+static uint32_t mk3hook_fmodex_dsp_buffer_length;
+static uint32_t mk3hook_fmodex_dsp_num_buffers;
+static uint32_t mk3hook_fmodex_sample_rate;
+
+static FMOD_RESULT mk3hook_fmodex_set_dsp_buffer_size(FMOD_SYSTEM *system)
+{
+  FMOD_RESULT res;
+  unsigned int buffer_length;
+  int num_buffers;
+
+  res = FMOD_System_GetDSPBufferSize(system, &buffer_length, &num_buffers);
+
+  if (res != FMOD_OK) {
+    log_error(
+        "FMOD_System_GetDSPBufferSize failed %d: %s",
+        res,
+        FMOD_ErrorString((FMOD_RESULT) res));
+    return res;
+  }
+
+  if (mk3hook_fmodex_dsp_buffer_length > 0) {
+    buffer_length = mk3hook_fmodex_dsp_buffer_length;
+  }
+
+  if (mk3hook_fmodex_dsp_num_buffers > 0) {
+    num_buffers = mk3hook_fmodex_dsp_num_buffers;
+  }
+
+  log_info("Setting DSP buffer size %d x %d", buffer_length, num_buffers);
+
+  res = FMOD_System_SetDSPBufferSize(system, buffer_length, num_buffers);
+
+  if (res != FMOD_OK) {
+    log_error(
+        "FMOD_System_SetDSPBufferSize failed %d: %s",
+        res,
+        FMOD_ErrorString((FMOD_RESULT) res));
+  }
+
+  return res;
+}
+
+static FMOD_RESULT mk3hook_fmodex_set_sample_rate(FMOD_SYSTEM *system)
+{
+  FMOD_RESULT res;
+  int sample_rate;
+  FMOD_SOUND_FORMAT format;
+  int num_output_channels;
+  int max_input_channels;
+  FMOD_DSP_RESAMPLER resample_method;
+  int bits;
+
+  /* Keep everything else the game might have set */
+  res = FMOD_System_GetSoftwareFormat(
+      system,
+      &sample_rate,
+      &format,
+      &num_output_channels,
+      &max_input_channels,
+      &resample_method,
+      &bits);
+
+  if (res != FMOD_OK) {
+    log_error(
+        "FMOD_System_GetSoftwareFormat failed %d: %s",
+        res,
+        FMOD_ErrorString((FMOD_RESULT) res));
+    return res;
+  }
+
+  log_info(
+      "Setting software format sample rate %d (was %d)",
+      mk3hook_fmodex_sample_rate,
+      sample_rate);
+
+  res = FMOD_System_SetSoftwareFormat(
+      system,
+      mk3hook_fmodex_sample_rate,
+      format,
+      num_output_channels,
+      max_input_channels,
+      resample_method);
+
+  if (res != FMOD_OK) {
+    log_error(
+        "FMOD_System_SetSoftwareFormat failed %d: %s",
+        res,
+        FMOD_ErrorString((FMOD_RESULT) res));
+  }
+
+  return res;
+}
+
+static void mk3hook_fmodex_log_latency(FMOD_SYSTEM *system)
+{
+  FMOD_RESULT res;
+  unsigned int buffer_length;
+  int num_buffers;
+  int sample_rate;
+
+  res = FMOD_System_GetDSPBufferSize(system, &buffer_length, &num_buffers);
+
+  if (res == FMOD_OK) {
+    res = FMOD_System_GetSoftwareFormat(
+        system, &sample_rate, NULL, NULL, NULL, NULL, NULL);
+  }
+
+  if (res != FMOD_OK || sample_rate <= 0) {
+    log_warn(
+        "Getting DSP buffer size or software format failed %d: %s",
+        res,
+        FMOD_ErrorString((FMOD_RESULT) res));
+    return;
+  }
+
+  /* Mixer output is buffered num_buffers times before reaching the device */
+  log_info(
+      "DSP buffer size %d x %d, sample rate %d, latency %d us (buffer), %d us "
+      "(mix block)",
+      buffer_length,
+      num_buffers,
+      sample_rate,
+      (int) ((uint64_t) buffer_length * num_buffers * 1000 * 1000 /
+             sample_rate),
+      (int) ((uint64_t) buffer_length * 1000 * 1000 / sample_rate));
+}
 
 FMOD_RESULT FMOD_System_Init(
     FMOD_SYSTEM *system,
@@ -157,14 +284,46 @@ FMOD_RESULT FMOD_System_Init(
     return res;
   }
 
-  return mk3hook_fmodex_real_FMOD_System_Init(
+  /* Must be set before init, override whatever the game set */
+  if (mk3hook_fmodex_dsp_buffer_length > 0 ||
+      mk3hook_fmodex_dsp_num_buffers > 0) {
+    res = mk3hook_fmodex_set_dsp_buffer_size(system);
+
+    if (res != FMOD_OK) {
+      return res;
+    }
+  }
+
+  if (mk3hook_fmodex_sample_rate > 0) {
+    res = mk3hook_fmodex_set_sample_rate(system);
+
+    if (res != FMOD_OK) {
+      return res;
+    }
+  }
+
+  res = mk3hook_fmodex_real_FMOD_System_Init(
       system, maxchannels, flags, extradriverdata);
+
+  if (res == FMOD_OK) {
+    mk3hook_fmodex_log_latency(system);
+  }
+
+  return res;
 }
 
-void mk3hook_fmodex_init(bool debug_output, const char *sound_device)
+void mk3hook_fmodex_init(
+    bool debug_output,
+    const char *sound_device,
+    uint32_t dsp_buffer_length,
+    uint32_t dsp_num_buffers,
+    uint32_t sample_rate)
 {
   mk3hook_fmodex_debug_output = debug_output;
   mk3hook_fmodex_sound_device = sound_device;
+  mk3hook_fmodex_dsp_buffer_length = dsp_buffer_length;
+  mk3hook_fmodex_dsp_num_buffers = dsp_num_buffers;
+  mk3hook_fmodex_sample_rate = sample_rate;
 
   log_info("Initialized");
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #define MK3HOOK_FMODEX_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * Initialize this patch module.
@@ -15,7 +16,16 @@
  * @param sound_device Provide a sound device to pick from the list of devices
  * available with fmodex. NULL to go with with default device selected
  * automatically by fmodex.
+ * @param dsp_buffer_length Length of a DSP buffer (mix block) in samples, 0 to
+ * keep fmodex's default (1024). Smaller values reduce the latency
+ * @param dsp_num_buffers Number of DSP buffers, 0 to keep fmodex's default (4)
+ * @param sample_rate Sample rate of the software mixer, 0 to keep the default
  */
-void mk3hook_fmodex_init(bool debug_output, const char *sound_device);
+void mk3hook_fmodex_init(
+    bool debug_output,
+    const char *sound_device,
+    uint32_t dsp_buffer_length,
+    uint32_t dsp_num_buffers,
+    uint32_t sample_rate);
 
 #endif
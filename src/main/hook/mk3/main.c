@@ -13,6 +13,7 @@
 #include "hook/mk3/config.h"
 #include "hook/mk3/fmodex.h"
 #include "hook/mk3/options.h"
+#include "hook/patch/alarm-timer.h"
 #include "hook/patch/asound-fix.h"
 #include "hook/patch/hook-mon.h"
 #include "hook/patch/main-loop.h"
@@ -159,7 +160,13 @@ static void mk3hook_patch_main_loop_init(struct mk3hook_options *options)
   log_assert(options);
 
   patch_main_loop_init(
-      true, options->patch.main_loop.disable_built_in_inputs, true);
+      !options->patch.main_loop.alarm_timer,
+      options->patch.main_loop.disable_built_in_inputs,
+      true);
+
+  if (options->patch.main_loop.alarm_timer) {
+    patch_alarm_timer_init();
+  }
 
   if (options->patch.main_loop.x11_input_handler_api_lib) {
     char *abs_path_x11_input_hook_lib = util_fs_get_abs_path(
@@ -176,7 +183,11 @@ static void mk3hook_patch_sound_init(struct mk3hook_options *options)
 
   patch_asound_fix_init();
   mk3hook_fmodex_init(
-      options->patch.sound.debug_output, options->patch.sound.device);
+      options->patch.sound.debug_output,
+      options->patch.sound.device,
+      options->patch.sound.dsp_buffer_length,
+      options->patch.sound.dsp_num_buffers,
+      options->patch.sound.sample_rate);
 }
 
 static void mk3hook_patch_sigsegv_init(struct mk3hook_options *options)
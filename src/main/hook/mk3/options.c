@@ -18,11 +18,18 @@
   "patch.hook_main_loop.disable_built_in_inputs"
 #define MK3HOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_X11_INPUT_HANDLER \
   "patch_hook_main_loop.x11_input_handler"
+#define MK3HOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_ALARM_TIMER \
+  "patch.hook_main_loop.alarm_timer"
 #define MK3HOOK_OPTIONS_STR_PATCH_PIUIO_EMU_LIB "patch.piuio.emu_lib"
 #define MK3HOOK_OPTIONS_STR_PATCH_PIUIO_EXIT_TEST_SERV \
   "patch.piuio_exit.test_serv"
 #define MK3HOOK_OPTIONS_STR_PATCH_SOUND_DEVICE "patch.sound.device"
 #define MK3HOOK_OPTIONS_STR_PATCH_SOUND_DEBUG_OUTPUT "patch.sound.debug_output"
+#define MK3HOOK_OPTIONS_STR_PATCH_SOUND_DSP_BUFFER_LENGTH \
+  "patch.sound.dsp_buffer_length"
+#define MK3HOOK_OPTIONS_STR_PATCH_SOUND_DSP_NUM_BUFFERS \
+  "patch.sound.dsp_num_buffers"
+#define MK3HOOK_OPTIONS_STR_PATCH_SOUND_SAMPLE_RATE "patch.sound.sample_rate"
 #define MK3HOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV \
   "patch.sigsegv.halt_on_segv"
 #define MK3HOOK_OPTIONS_STR_PATCH_UTIL_LOG_FILE "util.log.file"
@@ -147,6 +154,16 @@ static const struct util_options_def mk3hook_options_def[] = {
         .is_secret_data = false,
         .default_value.str = NULL,
     },
+    {
+        .name = MK3HOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_ALARM_TIMER,
+        .description =
+            "Drive the SIGALRM handler of the engine from a timer thread "
+            "instead of polling it from the X11 event loop",
+        .param = 'n',
+        .type = UTIL_OPTIONS_TYPE_BOOL,
+        .is_secret_data = false,
+        .default_value.b = false,
+    },
     {
         .name = MK3HOOK_OPTIONS_STR_PATCH_PIUIO_EMU_LIB,
         .description =
@@ -182,6 +199,37 @@ static const struct util_options_def mk3hook_options_def[] = {
         .is_secret_data = false,
         .default_value.b = false,
     },
+    {
+        .name = MK3HOOK_OPTIONS_STR_PATCH_SOUND_DSP_BUFFER_LENGTH,
+        .description =
+            "Length of a DSP buffer (mix block) of fmodex in samples, e.g. "
+            "256. Lower values reduce the audio latency. 0 to keep the "
+            "default (1024)",
+        .param = 'b',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = MK3HOOK_OPTIONS_STR_PATCH_SOUND_DSP_NUM_BUFFERS,
+        .description =
+            "Number of DSP buffers of fmodex, e.g. 2. Lower values reduce the "
+            "audio latency. 0 to keep the default (4)",
+        .param = 't',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = MK3HOOK_OPTIONS_STR_PATCH_SOUND_SAMPLE_RATE,
+        .description =
+            "Sample rate of the software mixer of fmodex, e.g. 48000. 0 to "
+            "keep the default",
+        .param = 'z',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
     {
         .name = MK3HOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV,
         .description = "Halt on sigsegv to attach a debugger to the process",
@@ -261,6 +309,8 @@ bool mk3hook_options_init(
       MK3HOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_DISABLE_BUILT_IN_INPUTS);
   options->patch.main_loop.x11_input_handler_api_lib = util_options_get_str(
       options_opt, MK3HOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_X11_INPUT_HANDLER);
+  options->patch.main_loop.alarm_timer = util_options_get_bool(
+      options_opt, MK3HOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_ALARM_TIMER);
   options->patch.piuio.api_lib = util_options_get_str(
       options_opt, MK3HOOK_OPTIONS_STR_PATCH_PIUIO_EMU_LIB);
   options->patch.piuio.exit_test_serv = util_options_get_bool(
@@ -269,6 +319,12 @@ bool mk3hook_options_init(
       util_options_get_str(options_opt, MK3HOOK_OPTIONS_STR_PATCH_SOUND_DEVICE);
   options->patch.sound.debug_output = util_options_get_bool(
       options_opt, MK3HOOK_OPTIONS_STR_PATCH_SOUND_DEBUG_OUTPUT);
+  options->patch.sound.dsp_buffer_length = util_options_get_int(
+      options_opt, MK3HOOK_OPTIONS_STR_PATCH_SOUND_DSP_BUFFER_LENGTH);
+  options->patch.sound.dsp_num_buffers = util_options_get_int(
+      options_opt, MK3HOOK_OPTIONS_STR_PATCH_SOUND_DSP_NUM_BUFFERS);
+  options->patch.sound.sample_rate = util_options_get_int(
+      options_opt, MK3HOOK_OPTIONS_STR_PATCH_SOUND_SAMPLE_RATE);
   options->patch.sigsegv.halt_on_segv = util_options_get_bool(
       options_opt, MK3HOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV);
   options->log.file = util_options_get_str(
@@ -32,6 +32,7 @@ struct mk3hook_options {
     struct main_loop {
       bool disable_built_in_inputs;
       const char *x11_input_handler_api_lib;
+      bool alarm_timer;
     } main_loop;
 
     struct piuio {
@@ -42,6 +43,9 @@ struct mk3hook_options {
     struct sound {
       const char *device;
       bool debug_output;
+      uint32_t dsp_buffer_length;
+      uint32_t dsp_num_buffers;
+      uint32_t sample_rate;
     } sound;
 
     struct sigsegv {
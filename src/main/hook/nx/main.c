@@ -10,6 +10,8 @@
 
 #include "hook/core/piu-utils.h"
 
+#include "hook/patch/alarm-timer.h"
+#include "hook/patch/gfx-frame-time.h"
 #include "hook/patch/gfx.h"
 #include "hook/patch/hdd-check.h"
 #include "hook/patch/hook-mon.h"
@@ -163,7 +165,20 @@ static void nxhook_patch_gfx_init(struct nxhook_options *options)
   patch_gfx_init();
 
   if (options->patch.gfx.scaling_mode != PATCH_GFX_SCALE_MODE_INVALID) {
-    patch_gfx_scale(options->patch.gfx.scaling_mode);
+    patch_gfx_scale(
+        options->patch.gfx.scaling_mode, options->patch.gfx.scaling_filter);
+  }
+
+  if (options->patch.gfx.swap_interval >= 0) {
+    patch_gfx_force_swap_interval(options->patch.gfx.swap_interval);
+  }
+
+  if (options->patch.gfx.frame_stats_interval > 0) {
+    patch_gfx_frame_time_init(options->patch.gfx.frame_stats_interval);
+  }
+
+  if (options->patch.gfx.frame_limit > 0) {
+    patch_gfx_frame_time_limit_init(options->patch.gfx.frame_limit);
   }
 }
 
@@ -181,7 +196,13 @@ static void nxhook_patch_main_loop_init(struct nxhook_options *options)
   log_assert(options);
 
   patch_main_loop_init(
-      true, options->patch.main_loop.disable_built_in_inputs, false);
+      !options->patch.main_loop.alarm_timer,
+      options->patch.main_loop.disable_built_in_inputs,
+      false);
+
+  if (options->patch.main_loop.alarm_timer) {
+    patch_alarm_timer_init();
+  }
 
   if (options->patch.main_loop.x11_input_handler_api_lib) {
     char *abs_path_x11_input_hook_lib = util_fs_get_abs_path(
@@ -197,6 +218,17 @@ static void nxhook_patch_sound_init(struct nxhook_options *options)
   log_assert(options);
 
   patch_sound_init(options->patch.sound.device);
+
+  if (options->patch.sound.buffer_time_max_us > 0 ||
+      options->patch.sound.period_time_max_us > 0) {
+    patch_sound_latency_init(
+        options->patch.sound.buffer_time_max_us,
+        options->patch.sound.period_time_max_us);
+  }
+
+  if (options->patch.sound.pcm_pool_size > 0) {
+    patch_sound_pcm_pool_init(options->patch.sound.pcm_pool_size);
+  }
 }
 
 static void nxhook_patch_sigsegv_init(struct nxhook_options *options)
@@ -279,6 +311,7 @@ void nxhook_trap_before_main(int argc, char **argv)
 
 void nxhook_trap_after_main(void)
 {
+  patch_gfx_frame_time_shutdown();
   patch_piuio_shutdown();
 }
 
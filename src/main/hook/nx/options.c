@@ -5,6 +5,11 @@
 #define NXHOOK_OPTIONS_STR_GAME_FORCE_UNLOCK "game.force_unlock"
 #define NXHOOK_OPTIONS_STR_GAME_SETTINGS "game.settings"
 #define NXHOOK_OPTIONS_STR_PATCH_GFX_SCALING_MODE "patch.gfx.scaling_mode"
+#define NXHOOK_OPTIONS_STR_PATCH_GFX_SCALING_FILTER "patch.gfx.scaling_filter"
+#define NXHOOK_OPTIONS_STR_PATCH_GFX_FRAME_STATS_INTERVAL \
+  "patch.gfx.frame_stats_interval"
+#define NXHOOK_OPTIONS_STR_PATCH_GFX_SWAP_INTERVAL "patch.gfx.swap_interval"
+#define NXHOOK_OPTIONS_STR_PATCH_GFX_FRAME_LIMIT "patch.gfx.frame_limit"
 #define NXHOOK_OPTIONS_STR_PATCH_HOOK_MON_FILE "patch.hook_mon.file"
 #define NXHOOK_OPTIONS_STR_PATCH_HOOK_MON_FS "patch.hook_mon.fs"
 #define NXHOOK_OPTIONS_STR_PATCH_HOOK_MON_IO "patch.hook_mon.io"
@@ -14,10 +19,17 @@
   "patch.hook_main_loop.disable_built_in_inputs"
 #define NXHOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_X11_INPUT_HANDLER \
   "patch_hook_main_loop.x11_input_handler"
+#define NXHOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_ALARM_TIMER \
+  "patch.hook_main_loop.alarm_timer"
 #define NXHOOK_OPTIONS_STR_PATCH_PIUIO_EMU_LIB "patch.piuio.emu_lib"
 #define NXHOOK_OPTIONS_STR_PATCH_PIUIO_EXIT_TEST_SERV \
   "patch.piuio_exit.test_serv"
 #define NXHOOK_OPTIONS_STR_PATCH_SOUND_DEVICE "patch.sound.device"
+#define NXHOOK_OPTIONS_STR_PATCH_SOUND_BUFFER_TIME_MAX_US \
+  "patch.sound.buffer_time_max_us"
+#define NXHOOK_OPTIONS_STR_PATCH_SOUND_PERIOD_TIME_MAX_US \
+  "patch.sound.period_time_max_us"
+#define NXHOOK_OPTIONS_STR_PATCH_SOUND_PCM_POOL_SIZE "patch.sound.pcm_pool_size"
 #define NXHOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV \
   "patch.sigsegv.halt_on_segv"
 #define NXHOOK_OPTIONS_STR_PATCH_UTIL_LOG_FILE "util.log.file"
@@ -44,6 +56,50 @@ static const struct util_options_def nxhook_options_def[] = {
         .is_secret_data = false,
         .default_value.i = 0,
     },
+    {
+        .name = NXHOOK_OPTIONS_STR_PATCH_GFX_SCALING_FILTER,
+        .description =
+            "Filter for scaling the rendered output, requires a scaling mode: "
+            "0 = linear, 1 = nearest, 2 = integer (nearest with the largest "
+            "integer scale factor that fits)",
+        .param = 't',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = NXHOOK_OPTIONS_STR_PATCH_GFX_FRAME_STATS_INTERVAL,
+        .description =
+            "Log frame time stats (mean, p99, worst, dropped frames) every n "
+            "seconds and publish them to shared memory "
+            "/dev/shm/pumptools-frame-time. 0 to disable",
+        .param = 'w',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = NXHOOK_OPTIONS_STR_PATCH_GFX_SWAP_INTERVAL,
+        .description =
+            "Force a swap interval (vsync) on the game's GL context: -1 = do "
+            "not change (driver default), 0 = vsync off, 1 = vsync on, n = "
+            "swap every n-th vertical blank",
+        .param = 'y',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = -1,
+    },
+    {
+        .name = NXHOOK_OPTIONS_STR_PATCH_GFX_FRAME_LIMIT,
+        .description =
+            "Limit the frame rate of the game to the given refresh rate in "
+            "hz, e.g. 60. For games rendering unbounded without vsync. 0 to "
+            "disable",
+        .param = 'x',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
     {
         .name = NXHOOK_OPTIONS_STR_GAME_SETTINGS,
         .description = "Path to game settings (SETTINGS) folder",
@@ -110,6 +166,16 @@ static const struct util_options_def nxhook_options_def[] = {
         .is_secret_data = false,
         .default_value.str = NULL,
     },
+    {
+        .name = NXHOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_ALARM_TIMER,
+        .description =
+            "Drive the SIGALRM handler of the engine from a timer thread "
+            "instead of polling it from the X11 event loop",
+        .param = 'n',
+        .type = UTIL_OPTIONS_TYPE_BOOL,
+        .is_secret_data = false,
+        .default_value.b = false,
+    },
     {
         .name = NXHOOK_OPTIONS_STR_PATCH_PIUIO_EMU_LIB,
         .description =
@@ -135,6 +201,38 @@ static const struct util_options_def nxhook_options_def[] = {
         .is_secret_data = false,
         .default_value.str = "dmix",
     },
+    {
+        .name = NXHOOK_OPTIONS_STR_PATCH_SOUND_BUFFER_TIME_MAX_US,
+        .description =
+            "Clamp the buffer time (latency) of the sound device requested by "
+            "the game to a max in us, e.g. 20000. 0 to keep the game's buffer "
+            "time",
+        .param = 'b',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = NXHOOK_OPTIONS_STR_PATCH_SOUND_PERIOD_TIME_MAX_US,
+        .description =
+            "Clamp the period time of the sound device requested by the game "
+            "to a max in us, e.g. 5000. 0 to keep the game's period time",
+        .param = 'B',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = NXHOOK_OPTIONS_STR_PATCH_SOUND_PCM_POOL_SIZE,
+        .description =
+            "Keep up to n PCM handles opened by the game in a pool to avoid "
+            "re-opening and re-configuring the sound device for every sound "
+            "effect. 0 to disable",
+        .param = 'c',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
     {
         .name = NXHOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV,
         .description = "Halt on sigsegv to attach a debugger to the process",
@@ -188,6 +286,14 @@ bool nxhook_options_init(int argc, char **argv, struct nxhook_options *options)
       util_options_get_bool(options_opt, NXHOOK_OPTIONS_STR_GAME_FORCE_UNLOCK);
   options->patch.gfx.scaling_mode = util_options_get_int(
       options_opt, NXHOOK_OPTIONS_STR_PATCH_GFX_SCALING_MODE);
+  options->patch.gfx.scaling_filter = util_options_get_int(
+      options_opt, NXHOOK_OPTIONS_STR_PATCH_GFX_SCALING_FILTER);
+  options->patch.gfx.frame_stats_interval = util_options_get_int(
+      options_opt, NXHOOK_OPTIONS_STR_PATCH_GFX_FRAME_STATS_INTERVAL);
+  options->patch.gfx.swap_interval = util_options_get_int(
+      options_opt, NXHOOK_OPTIONS_STR_PATCH_GFX_SWAP_INTERVAL);
+  options->patch.gfx.frame_limit = util_options_get_int(
+      options_opt, NXHOOK_OPTIONS_STR_PATCH_GFX_FRAME_LIMIT);
   options->game.settings =
       util_options_get_str(options_opt, NXHOOK_OPTIONS_STR_GAME_SETTINGS);
   options->patch.hook_mon.file = util_options_get_bool(
@@ -205,12 +311,20 @@ bool nxhook_options_init(int argc, char **argv, struct nxhook_options *options)
       NXHOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_DISABLE_BUILT_IN_INPUTS);
   options->patch.main_loop.x11_input_handler_api_lib = util_options_get_str(
       options_opt, NXHOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_X11_INPUT_HANDLER);
+  options->patch.main_loop.alarm_timer = util_options_get_bool(
+      options_opt, NXHOOK_OPTIONS_STR_PATCH_HOOK_MAIN_LOOP_ALARM_TIMER);
   options->patch.piuio.api_lib =
       util_options_get_str(options_opt, NXHOOK_OPTIONS_STR_PATCH_PIUIO_EMU_LIB);
   options->patch.piuio.exit_test_serv = util_options_get_bool(
       options_opt, NXHOOK_OPTIONS_STR_PATCH_PIUIO_EXIT_TEST_SERV);
   options->patch.sound.device =
       util_options_get_str(options_opt, NXHOOK_OPTIONS_STR_PATCH_SOUND_DEVICE);
+  options->patch.sound.buffer_time_max_us = util_options_get_int(
+      options_opt, NXHOOK_OPTIONS_STR_PATCH_SOUND_BUFFER_TIME_MAX_US);
+  options->patch.sound.period_time_max_us = util_options_get_int(
+      options_opt, NXHOOK_OPTIONS_STR_PATCH_SOUND_PERIOD_TIME_MAX_US);
+  options->patch.sound.pcm_pool_size = util_options_get_int(
+      options_opt, NXHOOK_OPTIONS_STR_PATCH_SOUND_PCM_POOL_SIZE);
   options->patch.sigsegv.halt_on_segv = util_options_get_bool(
       options_opt, NXHOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV);
   options->log.file =
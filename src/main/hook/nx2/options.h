@@ -14,6 +14,10 @@ struct nx2hook_options {
   struct patch {
     struct gfx {
       uint8_t scaling_mode;
+      uint8_t scaling_filter;
+      uint32_t frame_stats_interval;
+      int swap_interval;
+      uint32_t frame_limit;
     } gfx;
 
     struct hook_mon {
@@ -34,6 +38,10 @@ struct nx2hook_options {
       uint64_t machine_id;
       bool verbose_log_output;
       const char *cert_dir_path;
+      const char *upload_journal_path;
+      const char *cache_dir_path;
+      const char *trace_path;
+      bool compression;
     } net;
 
     struct piuio {
@@ -43,6 +51,8 @@ struct nx2hook_options {
 
     struct sound {
       const char *device;
+      uint32_t buffer_time_max_us;
+      uint32_t period_time_max_us;
     } sound;
 
     struct sigsegv {
@@ -10,6 +10,7 @@
 
 #include "hook/core/piu-utils.h"
 
+#include "hook/patch/gfx-frame-time.h"
 #include "hook/patch/gfx.h"
 #include "hook/patch/hdd-check.h"
 #include "hook/patch/hook-mon.h"
@@ -206,7 +207,20 @@ static void nxahook_patch_gfx_init(struct nxahook_options *options)
   patch_gfx_init();
 
   if (options->patch.gfx.scaling_mode != PATCH_GFX_SCALE_MODE_INVALID) {
-    patch_gfx_scale(options->patch.gfx.scaling_mode);
+    patch_gfx_scale(
+        options->patch.gfx.scaling_mode, options->patch.gfx.scaling_filter);
+  }
+
+  if (options->patch.gfx.swap_interval >= 0) {
+    patch_gfx_force_swap_interval(options->patch.gfx.swap_interval);
+  }
+
+  if (options->patch.gfx.frame_stats_interval > 0) {
+    patch_gfx_frame_time_init(options->patch.gfx.frame_stats_interval);
+  }
+
+  if (options->patch.gfx.frame_limit > 0) {
+    patch_gfx_frame_time_limit_init(options->patch.gfx.frame_limit);
   }
 }
 
@@ -231,6 +245,13 @@ static void nxahook_patch_sound_init(struct nxahook_options *options)
   log_assert(options);
 
   patch_sound_init(options->patch.sound.device);
+
+  if (options->patch.sound.buffer_time_max_us > 0 ||
+      options->patch.sound.period_time_max_us > 0) {
+    patch_sound_latency_init(
+        options->patch.sound.buffer_time_max_us,
+        options->patch.sound.period_time_max_us);
+  }
 }
 
 static void nxahook_patch_sigsegv_init(struct nxahook_options *options)
@@ -289,6 +310,10 @@ static void nxahook_patch_pumpnet(struct nxahook_options *options)
         options->patch.net.server,
         options->patch.net.machine_id,
         options->patch.net.cert_dir_path,
+        options->patch.net.upload_journal_path,
+        options->patch.net.cache_dir_path,
+        options->patch.net.trace_path,
+        options->patch.net.compression,
         options->patch.net.verbose_log_output);
   }
 }
@@ -336,6 +361,7 @@ void nxahook_trap_before_main(int argc, char **argv)
 
 void nxahook_trap_after_main(void)
 {
+  patch_gfx_frame_time_shutdown();
   patch_net_profile_shutdown();
   patch_piuio_shutdown();
 }
@@ -4,6 +4,11 @@
 
 #define NXAHOOK_OPTIONS_STR_GAME_SETTINGS "game.settings"
 #define NXAHOOK_OPTIONS_STR_PATCH_GFX_SCALING_MODE "patch.gfx.scaling_mode"
+#define NXAHOOK_OPTIONS_STR_PATCH_GFX_SCALING_FILTER "patch.gfx.scaling_filter"
+#define NXAHOOK_OPTIONS_STR_PATCH_GFX_FRAME_STATS_INTERVAL \
+  "patch.gfx.frame_stats_interval"
+#define NXAHOOK_OPTIONS_STR_PATCH_GFX_SWAP_INTERVAL "patch.gfx.swap_interval"
+#define NXAHOOK_OPTIONS_STR_PATCH_GFX_FRAME_LIMIT "patch.gfx.frame_limit"
 #define NXAHOOK_OPTIONS_STR_PATCH_HOOK_MON_FILE "patch.hook_mon.file"
 #define NXAHOOK_OPTIONS_STR_PATCH_HOOK_MON_FS "patch.hook_mon.fs"
 #define NXAHOOK_OPTIONS_STR_PATCH_HOOK_MON_IO "patch.hook_mon.io"
@@ -20,10 +25,22 @@
   "patch.net_profile.verbose_log_output"
 #define NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_CERT_DIR_PATH \
   "patch.net_profile.cert_dir_path"
+#define NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_UPLOAD_JOURNAL_PATH \
+  "patch.net_profile.upload_journal_path"
+#define NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_CACHE_DIR_PATH \
+  "patch.net_profile.cache_dir_path"
+#define NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_TRACE_PATH \
+  "patch.net_profile.trace_path"
+#define NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_COMPRESSION \
+  "patch.net_profile.compression"
 #define NXAHOOK_OPTIONS_STR_PATCH_PIUIO_EMU_LIB "patch.piuio.emu_lib"
 #define NXAHOOK_OPTIONS_STR_PATCH_PIUIO_EXIT_TEST_SERV \
   "patch.piuio_exit.test_serv"
 #define NXAHOOK_OPTIONS_STR_PATCH_SOUND_DEVICE "patch.sound.device"
+#define NXAHOOK_OPTIONS_STR_PATCH_SOUND_BUFFER_TIME_MAX_US \
+  "patch.sound.buffer_time_max_us"
+#define NXAHOOK_OPTIONS_STR_PATCH_SOUND_PERIOD_TIME_MAX_US \
+  "patch.sound.period_time_max_us"
 #define NXAHOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV \
   "patch.sigsegv.halt_on_segv"
 #define NXAHOOK_OPTIONS_STR_PATCH_UTIL_LOG_FILE "util.log.file"
@@ -49,6 +66,50 @@ const struct util_options_def nxahook_options_def[] = {
         .is_secret_data = false,
         .default_value.i = 0,
     },
+    {
+        .name = NXAHOOK_OPTIONS_STR_PATCH_GFX_SCALING_FILTER,
+        .description =
+            "Filter for scaling the rendered output, requires a scaling mode: "
+            "0 = linear, 1 = nearest, 2 = integer (nearest with the largest "
+            "integer scale factor that fits)",
+        .param = 't',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = NXAHOOK_OPTIONS_STR_PATCH_GFX_FRAME_STATS_INTERVAL,
+        .description =
+            "Log frame time stats (mean, p99, worst, dropped frames) every n "
+            "seconds and publish them to shared memory "
+            "/dev/shm/pumptools-frame-time. 0 to disable",
+        .param = 'w',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = NXAHOOK_OPTIONS_STR_PATCH_GFX_SWAP_INTERVAL,
+        .description =
+            "Force a swap interval (vsync) on the game's GL context: -1 = do "
+            "not change (driver default), 0 = vsync off, 1 = vsync on, n = "
+            "swap every n-th vertical blank",
+        .param = 'y',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = -1,
+    },
+    {
+        .name = NXAHOOK_OPTIONS_STR_PATCH_GFX_FRAME_LIMIT,
+        .description =
+            "Limit the frame rate of the game to the given refresh rate in "
+            "hz, e.g. 60. For games rendering unbounded without vsync. 0 to "
+            "disable",
+        .param = 'x',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
     {
         .name = NXAHOOK_OPTIONS_STR_PATCH_HOOK_MON_FILE,
         .description = "Enable file call monitoring",
@@ -144,6 +205,50 @@ const struct util_options_def nxahook_options_def[] = {
         .is_secret_data = false,
         .default_value.str = NULL,
     },
+    {
+        .name = NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_UPLOAD_JOURNAL_PATH,
+        .description =
+            "Path to a journal file to upload profiles asynchronously in the "
+            "background. Uploads not completed, e.g. on power loss, are "
+            "retried on next start. Empty to upload synchronously",
+        .param = 'J',
+        .type = UTIL_OPTIONS_TYPE_STR,
+        .is_secret_data = false,
+        .default_value.str = "",
+    },
+    {
+        .name = NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_CACHE_DIR_PATH,
+        .description =
+            "Path to a folder to cache profiles in. Cached profiles are "
+            "revalidated with the server which sends them again only if they "
+            "changed. Empty to disable the cache",
+        .param = 'C',
+        .type = UTIL_OPTIONS_TYPE_STR,
+        .is_secret_data = false,
+        .default_value.str = "",
+    },
+    {
+        .name = NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_TRACE_PATH,
+        .description =
+            "Path to a file to trace all requests to the pumpnet server to, "
+            "with a timing breakdown (dns, connect, tls, first byte, "
+            "transfer, encoding, retries) per request. Binary format if the "
+            "path ends with .bin, JSON lines otherwise. Empty to disable",
+        .param = 'T',
+        .type = UTIL_OPTIONS_TYPE_STR,
+        .is_secret_data = false,
+        .default_value.str = "",
+    },
+    {
+        .name = NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_COMPRESSION,
+        .description =
+            "Compress profile data sent to and received from the pumpnet "
+            "server (deflate), if supported by the server",
+        .param = 'Z',
+        .type = UTIL_OPTIONS_TYPE_BOOL,
+        .is_secret_data = false,
+        .default_value.b = false,
+    },
     {
         .name = NXAHOOK_OPTIONS_STR_PATCH_PIUIO_EMU_LIB,
         .description =
@@ -169,6 +274,27 @@ const struct util_options_def nxahook_options_def[] = {
         .is_secret_data = false,
         .default_value.str = "dmix",
     },
+    {
+        .name = NXAHOOK_OPTIONS_STR_PATCH_SOUND_BUFFER_TIME_MAX_US,
+        .description =
+            "Clamp the buffer time (latency) of the sound device requested by "
+            "the game to a max in us, e.g. 20000. 0 to keep the game's buffer "
+            "time",
+        .param = 'b',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
+    {
+        .name = NXAHOOK_OPTIONS_STR_PATCH_SOUND_PERIOD_TIME_MAX_US,
+        .description =
+            "Clamp the period time of the sound device requested by the game "
+            "to a max in us, e.g. 5000. 0 to keep the game's period time",
+        .param = 'B',
+        .type = UTIL_OPTIONS_TYPE_INT,
+        .is_secret_data = false,
+        .default_value.i = 0,
+    },
     {
         .name = NXAHOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV,
         .description = "Halt on sigsegv to attach a debugger to the process",
@@ -221,6 +347,16 @@ bool nxahook_options_init(
 
   options->game.settings =
       util_options_get_str(options_opt, NXAHOOK_OPTIONS_STR_GAME_SETTINGS);
+  options->patch.gfx.scaling_mode = util_options_get_int(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_GFX_SCALING_MODE);
+  options->patch.gfx.scaling_filter = util_options_get_int(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_GFX_SCALING_FILTER);
+  options->patch.gfx.frame_stats_interval = util_options_get_int(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_GFX_FRAME_STATS_INTERVAL);
+  options->patch.gfx.swap_interval = util_options_get_int(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_GFX_SWAP_INTERVAL);
+  options->patch.gfx.frame_limit = util_options_get_int(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_GFX_FRAME_LIMIT);
   options->patch.hook_mon.file = util_options_get_bool(
       options_opt, NXAHOOK_OPTIONS_STR_PATCH_HOOK_MON_FILE);
   options->patch.hook_mon.fs =
@@ -247,12 +383,24 @@ bool nxahook_options_init(
       options_opt, NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_VERBOSE_LOG_OUTPUT);
   options->patch.net.cert_dir_path = util_options_get_str(
       options_opt, NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_CERT_DIR_PATH);
+  options->patch.net.upload_journal_path = util_options_get_str(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_UPLOAD_JOURNAL_PATH);
+  options->patch.net.cache_dir_path = util_options_get_str(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_CACHE_DIR_PATH);
+  options->patch.net.trace_path = util_options_get_str(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_TRACE_PATH);
+  options->patch.net.compression = util_options_get_bool(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_NET_PROFILE_COMPRESSION);
   options->patch.piuio.api_lib = util_options_get_str(
       options_opt, NXAHOOK_OPTIONS_STR_PATCH_PIUIO_EMU_LIB);
   options->patch.piuio.exit_test_serv = util_options_get_bool(
       options_opt, NXAHOOK_OPTIONS_STR_PATCH_PIUIO_EXIT_TEST_SERV);
   options->patch.sound.device =
       util_options_get_str(options_opt, NXAHOOK_OPTIONS_STR_PATCH_SOUND_DEVICE);
+  options->patch.sound.buffer_time_max_us = util_options_get_int(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_SOUND_BUFFER_TIME_MAX_US);
+  options->patch.sound.period_time_max_us = util_options_get_int(
+      options_opt, NXAHOOK_OPTIONS_STR_PATCH_SOUND_PERIOD_TIME_MAX_US);
   options->patch.sigsegv.halt_on_segv = util_options_get_bool(
       options_opt, NXAHOOK_OPTIONS_STR_PATCH_SIGSEGV_HALT_ON_SEGV);
   options->log.file = util_options_get_str(
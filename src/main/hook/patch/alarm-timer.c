@@ -0,0 +1,366 @@
+#define LOG_MODULE "patch-alarm-timer"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "capnhook/hook/lib.h"
+#include "capnhook/hook/sig.h"
+
+#include "hook/patch/alarm-timer.h"
+
+#include "util/log.h"
+#include "util/time.h"
+
+#define PATCH_ALARM_TIMER_SCHED_PRIORITY 50
+
+/* Limit calling the handler on missed ticks to not stall the engine further */
+#define PATCH_ALARM_TIMER_MAX_CATCH_UP_TICKS 4
+
+#define PATCH_ALARM_TIMER_LOG_INTERVAL_NS (60ULL * 1000 * 1000 * 1000)
+
+typedef int (*setitimer_t)(
+    __itimer_which_t which,
+    const struct itimerval *new_value,
+    struct itimerval *old_value);
+typedef int (*getitimer_t)(
+    __itimer_which_t which, struct itimerval *curr_value);
+typedef unsigned int (*alarm_t)(unsigned int seconds);
+
+struct patch_alarm_timer_stats {
+  uint64_t ticks;
+  uint64_t missed_ticks;
+  uint64_t jitter_sum_ns;
+  uint64_t jitter_max_ns;
+};
+
+static setitimer_t patch_alarm_timer_real_setitimer;
+static getitimer_t patch_alarm_timer_real_getitimer;
+static alarm_t patch_alarm_timer_real_alarm;
+
+static int patch_alarm_timer_fd = -1;
+static pthread_t patch_alarm_timer_thread;
+
+/* Protects the timer state below, armed by the game, consumed by the thread */
+static pthread_mutex_t patch_alarm_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t patch_alarm_timer_deadline_ns;
+static uint64_t patch_alarm_timer_period_ns;
+
+/* Owned by the timer thread */
+static struct patch_alarm_timer_stats patch_alarm_timer_stats;
+
+static void patch_alarm_timer_ns_to_timespec(uint64_t ns, struct timespec *ts)
+{
+  ts->tv_sec = ns / (1000 * 1000 * 1000);
+  ts->tv_nsec = ns % (1000 * 1000 * 1000);
+}
+
+static uint64_t patch_alarm_timer_timeval_to_ns(const struct timeval *tv)
+{
+  return (uint64_t) tv->tv_sec * 1000 * 1000 * 1000 +
+      (uint64_t) tv->tv_usec * 1000;
+}
+
+static void patch_alarm_timer_timespec_to_timeval(
+    const struct timespec *ts, struct timeval *tv)
+{
+  tv->tv_sec = ts->tv_sec;
+  tv->tv_usec = ts->tv_nsec / 1000;
+}
+
+static void patch_alarm_timer_get(struct itimerval *value)
+{
+  struct itimerspec its;
+
+  memset(value, 0, sizeof(struct itimerval));
+
+  if (timerfd_gettime(patch_alarm_timer_fd, &its) != 0) {
+    log_error("Getting timer failed: %s", strerror(errno));
+    return;
+  }
+
+  patch_alarm_timer_timespec_to_timeval(&its.it_value, &value->it_value);
+  patch_alarm_timer_timespec_to_timeval(
+      &its.it_interval, &value->it_interval);
+}
+
+static void patch_alarm_timer_arm(uint64_t value_ns, uint64_t interval_ns)
+{
+  struct itimerspec its;
+
+  memset(&its, 0, sizeof(struct itimerspec));
+
+  pthread_mutex_lock(&patch_alarm_timer_lock);
+
+  /* A zero value disarms the timer */
+  if (value_ns > 0) {
+    patch_alarm_timer_deadline_ns =
+        util_time_get_monotonic_ns() + value_ns;
+    patch_alarm_timer_period_ns = interval_ns;
+
+    patch_alarm_timer_ns_to_timespec(
+        patch_alarm_timer_deadline_ns, &its.it_value);
+    patch_alarm_timer_ns_to_timespec(interval_ns, &its.it_interval);
+  } else {
+    patch_alarm_timer_deadline_ns = 0;
+    patch_alarm_timer_period_ns = 0;
+  }
+
+  if (timerfd_settime(patch_alarm_timer_fd, TFD_TIMER_ABSTIME, &its, NULL) !=
+      0) {
+    log_error("Arming timer failed: %s", strerror(errno));
+  }
+
+  pthread_mutex_unlock(&patch_alarm_timer_lock);
+
+  log_debug(
+      "Armed timer, value %llu us, interval %llu us",
+      value_ns / 1000,
+      interval_ns / 1000);
+}
+
+static void patch_alarm_timer_set_priority(void)
+{
+  struct sched_param param;
+  int res;
+
+  memset(&param, 0, sizeof(struct sched_param));
+  param.sched_priority = PATCH_ALARM_TIMER_SCHED_PRIORITY;
+
+  res = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+  if (res != 0) {
+    log_warn(
+        "Setting realtime priority failed, running with normal priority "
+        "(missing CAP_SYS_NICE/rtprio limit?): %s",
+        strerror(res));
+  } else {
+    log_info("Running with realtime priority %d", param.sched_priority);
+  }
+}
+
+static void patch_alarm_timer_log_stats(uint64_t period_ns)
+{
+  struct patch_alarm_timer_stats *stats;
+
+  stats = &patch_alarm_timer_stats;
+
+  if (stats->ticks > 0) {
+    log_info(
+        "Ticks %llu, period %llu us, jitter avg %llu us, max %llu us, missed "
+        "ticks %llu",
+        stats->ticks,
+        period_ns / 1000,
+        stats->jitter_sum_ns / stats->ticks / 1000,
+        stats->jitter_max_ns / 1000,
+        stats->missed_ticks);
+  }
+
+  memset(stats, 0, sizeof(struct patch_alarm_timer_stats));
+}
+
+static void *patch_alarm_timer_thread_proc(void *arg)
+{
+  uint64_t expirations;
+  uint64_t now_ns;
+  uint64_t expected_ns;
+  uint64_t period_ns;
+  uint64_t jitter_ns;
+  uint64_t next_log_ns;
+  uint64_t calls;
+  __sighandler_t handler;
+  ssize_t res;
+
+  patch_alarm_timer_set_priority();
+
+  next_log_ns =
+      util_time_get_monotonic_ns() + PATCH_ALARM_TIMER_LOG_INTERVAL_NS;
+
+  while (true) {
+    res = read(patch_alarm_timer_fd, &expirations, sizeof(uint64_t));
+
+    if (res != sizeof(uint64_t)) {
+      if (res < 0 && errno == EINTR) {
+        continue;
+      }
+
+      log_error("Reading timer failed: %s", strerror(errno));
+      break;
+    }
+
+    now_ns = util_time_get_monotonic_ns();
+
+    pthread_mutex_lock(&patch_alarm_timer_lock);
+
+    /* Disarmed or one-shot expired after reading */
+    if (patch_alarm_timer_deadline_ns == 0) {
+      pthread_mutex_unlock(&patch_alarm_timer_lock);
+      continue;
+    }
+
+    period_ns = patch_alarm_timer_period_ns;
+
+    /* Deadline of the latest expiration */
+    expected_ns =
+        patch_alarm_timer_deadline_ns + (expirations - 1) * period_ns;
+
+    if (period_ns > 0) {
+      patch_alarm_timer_deadline_ns = expected_ns + period_ns;
+    } else {
+      patch_alarm_timer_deadline_ns = 0;
+    }
+
+    pthread_mutex_unlock(&patch_alarm_timer_lock);
+
+    jitter_ns = now_ns > expected_ns ? now_ns - expected_ns : 0;
+
+    patch_alarm_timer_stats.ticks++;
+    patch_alarm_timer_stats.missed_ticks += expirations - 1;
+    patch_alarm_timer_stats.jitter_sum_ns += jitter_ns;
+
+    if (jitter_ns > patch_alarm_timer_stats.jitter_max_ns) {
+      patch_alarm_timer_stats.jitter_max_ns = jitter_ns;
+    }
+
+    handler = cnh_sig_get_orig_handler(SIGALRM);
+
+    if (handler != NULL && handler != SIG_IGN && handler != SIG_DFL) {
+      calls = expirations;
+
+      if (calls > PATCH_ALARM_TIMER_MAX_CATCH_UP_TICKS) {
+        calls = PATCH_ALARM_TIMER_MAX_CATCH_UP_TICKS;
+      }
+
+      for (uint64_t i = 0; i < calls; i++) {
+        handler(SIGALRM);
+      }
+    }
+
+    if (now_ns >= next_log_ns) {
+      patch_alarm_timer_log_stats(period_ns);
+      next_log_ns = now_ns + PATCH_ALARM_TIMER_LOG_INTERVAL_NS;
+    }
+  }
+
+  return NULL;
+}
+
+static void
+patch_alarm_timer_sigalrm_handler(int signal, __sighandler_t orig_handler)
+{
+  /* The game's timer is emulated, actual signals are not raised by the game.
+     The original handler is driven by the timer thread only */
+}
+
+int setitimer(
+    __itimer_which_t which,
+    const struct itimerval *new_value,
+    struct itimerval *old_value)
+{
+  if (!patch_alarm_timer_real_setitimer) {
+    patch_alarm_timer_real_setitimer =
+        (setitimer_t) cnh_lib_get_func_addr("setitimer");
+  }
+
+  if (which != ITIMER_REAL || patch_alarm_timer_fd == -1) {
+    return patch_alarm_timer_real_setitimer(which, new_value, old_value);
+  }
+
+  if (!new_value) {
+    errno = EFAULT;
+    return -1;
+  }
+
+  if (old_value) {
+    patch_alarm_timer_get(old_value);
+  }
+
+  patch_alarm_timer_arm(
+      patch_alarm_timer_timeval_to_ns(&new_value->it_value),
+      patch_alarm_timer_timeval_to_ns(&new_value->it_interval));
+
+  return 0;
+}
+
+int getitimer(__itimer_which_t which, struct itimerval *curr_value)
+{
+  if (!patch_alarm_timer_real_getitimer) {
+    patch_alarm_timer_real_getitimer =
+        (getitimer_t) cnh_lib_get_func_addr("getitimer");
+  }
+
+  if (which != ITIMER_REAL || patch_alarm_timer_fd == -1) {
+    return patch_alarm_timer_real_getitimer(which, curr_value);
+  }
+
+  if (!curr_value) {
+    errno = EFAULT;
+    return -1;
+  }
+
+  patch_alarm_timer_get(curr_value);
+
+  return 0;
+}
+
+unsigned int alarm(unsigned int seconds)
+{
+  struct itimerval old_value;
+  unsigned int remaining;
+
+  if (!patch_alarm_timer_real_alarm) {
+    patch_alarm_timer_real_alarm = (alarm_t) cnh_lib_get_func_addr("alarm");
+  }
+
+  if (patch_alarm_timer_fd == -1) {
+    return patch_alarm_timer_real_alarm(seconds);
+  }
+
+  patch_alarm_timer_get(&old_value);
+  patch_alarm_timer_arm((uint64_t) seconds * 1000 * 1000 * 1000, 0);
+
+  /* Round like glibc's alarm implementation */
+  remaining = old_value.it_value.tv_sec;
+
+  if ((old_value.it_value.tv_sec == 0 && old_value.it_value.tv_usec > 0) ||
+      old_value.it_value.tv_usec >= 500000) {
+    remaining++;
+  }
+
+  return remaining;
+}
+
+void patch_alarm_timer_init(void)
+{
+  int fd;
+
+  fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+  /* Fatal, the engine does not run without its timer */
+  if (fd == -1) {
+    log_die("Creating timerfd failed: %s", strerror(errno));
+  }
+
+  patch_alarm_timer_fd = fd;
+
+  /* Capture the handler the game installs */
+  cnh_sig_install(SIGALRM, patch_alarm_timer_sigalrm_handler);
+
+  if (pthread_create(
+          &patch_alarm_timer_thread,
+          NULL,
+          patch_alarm_timer_thread_proc,
+          NULL) != 0) {
+    log_die("Creating timer thread failed");
+  }
+
+  log_info("Initialized");
+}
@@ -0,0 +1,26 @@
+/**
+ * Patch module driving the SIGALRM handler of the engine from a dedicated
+ * timer thread instead of actual signals. Alternative to the sigalarm fix of
+ * the main-loop module (see main-loop.h for the detailed analysis) which polls
+ * the handler from XPending and, therefore, makes the timing of the engine
+ * depend on how often the game pumps X events.
+ *
+ * setitimer(ITIMER_REAL), getitimer(ITIMER_REAL) and alarm are emulated using a
+ * timerfd with absolute deadlines, i.e. ticks do not drift. The handler the
+ * game installs for SIGALRM (signal or sigaction) is captured and called by a
+ * thread with realtime priority (if permitted) on every tick. The measured tick
+ * jitter is logged periodically.
+ *
+ * Note that this calls the handler on a different thread than the main thread
+ * concurrently to the remaining engine. Use this instead of the main-loop fix,
+ * not in addition to it.
+ */
+#ifndef PATCH_ALARM_TIMER_H
+#define PATCH_ALARM_TIMER_H
+
+/**
+ * Initialize the patch module
+ */
+void patch_alarm_timer_init(void);
+
+#endif
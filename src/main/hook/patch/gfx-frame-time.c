@@ -0,0 +1,508 @@
+#define LOG_MODULE "patch-gfx-frame-time"
+
+#include <GL/glx.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "capnhook/hook/lib.h"
+
+#include "hook/patch/gfx-frame-time.h"
+
+#include "util/log.h"
+#include "util/time.h"
+
+/* Must be a power of two */
+#define PATCH_GFX_FRAME_TIME_RING_SIZE 2048
+#define PATCH_GFX_FRAME_TIME_COLLECT_INTERVAL_MS 50
+
+/* 100 us resolution up to 100 ms, anything above ends up in the last bucket */
+#define PATCH_GFX_FRAME_TIME_HISTOGRAM_RESOLUTION_US 100
+#define PATCH_GFX_FRAME_TIME_HISTOGRAM_BUCKETS 1000
+
+/* Frame times exceeding the refresh interval by this factor count as dropped
+   frame(s) */
+#define PATCH_GFX_FRAME_TIME_DROPPED_FACTOR 1.5
+
+/* Sleeping wakes up with some latency (scheduler, timer slack). Sleep until
+   shortly before the deadline and busy wait the remaining time */
+#define PATCH_GFX_FRAME_TIME_LIMIT_SPIN_TAIL_NS (300 * 1000)
+
+typedef void (*glXSwapBuffers_t)(Display *dpy, GLXDrawable drawable);
+
+struct patch_gfx_frame_time_histogram {
+  uint32_t buckets[PATCH_GFX_FRAME_TIME_HISTOGRAM_BUCKETS];
+  uint64_t frames;
+  uint64_t dropped_frames;
+  uint64_t sum_us;
+  uint32_t worst_us;
+};
+
+static glXSwapBuffers_t patch_gfx_frame_time_real_glXSwapBuffers;
+
+static patch_gfx_frame_time_swap_handler_t patch_gfx_frame_time_pre_swap;
+static patch_gfx_frame_time_swap_handler_t patch_gfx_frame_time_post_swap;
+
+static bool patch_gfx_frame_time_enabled;
+static uint32_t patch_gfx_frame_time_log_interval_sec;
+
+/* Owned by the render thread */
+static uint64_t patch_gfx_frame_time_limit_period_ns;
+static uint64_t patch_gfx_frame_time_limit_deadline_ns;
+
+/* Single producer (render thread), single consumer (collector thread) */
+static uint64_t patch_gfx_frame_time_ring[PATCH_GFX_FRAME_TIME_RING_SIZE];
+static atomic_uint patch_gfx_frame_time_ring_head;
+static atomic_uint patch_gfx_frame_time_ring_tail;
+static atomic_uint patch_gfx_frame_time_lost_samples;
+
+static pthread_t patch_gfx_frame_time_thread;
+static atomic_int patch_gfx_frame_time_thread_run;
+
+/* Owned by the collector thread */
+static uint64_t patch_gfx_frame_time_prev_swap_ns;
+static struct patch_gfx_frame_time_histogram patch_gfx_frame_time_interval;
+static struct patch_gfx_frame_time_histogram patch_gfx_frame_time_total;
+static uint32_t patch_gfx_frame_time_mode_bucket;
+static struct patch_gfx_frame_time_stats *patch_gfx_frame_time_shm;
+
+static void patch_gfx_frame_time_ring_push(uint64_t timestamp_ns)
+{
+  uint32_t head;
+  uint32_t tail;
+
+  head = atomic_load_explicit(
+      &patch_gfx_frame_time_ring_head, memory_order_relaxed);
+  tail = atomic_load_explicit(
+      &patch_gfx_frame_time_ring_tail, memory_order_acquire);
+
+  if (head - tail >= PATCH_GFX_FRAME_TIME_RING_SIZE) {
+    atomic_fetch_add_explicit(
+        &patch_gfx_frame_time_lost_samples, 1, memory_order_relaxed);
+    return;
+  }
+
+  patch_gfx_frame_time_ring[head & (PATCH_GFX_FRAME_TIME_RING_SIZE - 1)] =
+      timestamp_ns;
+
+  atomic_store_explicit(
+      &patch_gfx_frame_time_ring_head, head + 1, memory_order_release);
+}
+
+static uint32_t patch_gfx_frame_time_bucket(uint32_t frame_time_us)
+{
+  uint32_t bucket;
+
+  bucket = frame_time_us / PATCH_GFX_FRAME_TIME_HISTOGRAM_RESOLUTION_US;
+
+  if (bucket >= PATCH_GFX_FRAME_TIME_HISTOGRAM_BUCKETS) {
+    bucket = PATCH_GFX_FRAME_TIME_HISTOGRAM_BUCKETS - 1;
+  }
+
+  return bucket;
+}
+
+static void patch_gfx_frame_time_histogram_add(
+    struct patch_gfx_frame_time_histogram *histogram,
+    uint32_t bucket,
+    uint32_t frame_time_us,
+    uint32_t dropped_frames)
+{
+  histogram->buckets[bucket]++;
+  histogram->frames++;
+  histogram->dropped_frames += dropped_frames;
+  histogram->sum_us += frame_time_us;
+
+  if (frame_time_us > histogram->worst_us) {
+    histogram->worst_us = frame_time_us;
+  }
+}
+
+static void patch_gfx_frame_time_histogram_to_stats(
+    const struct patch_gfx_frame_time_histogram *histogram,
+    struct patch_gfx_frame_time_period_stats *stats)
+{
+  uint64_t threshold;
+  uint64_t count;
+
+  memset(stats, 0, sizeof(struct patch_gfx_frame_time_period_stats));
+
+  if (histogram->frames == 0) {
+    return;
+  }
+
+  stats->frames = histogram->frames;
+  stats->dropped_frames = histogram->dropped_frames;
+  stats->mean_us = (uint32_t) (histogram->sum_us / histogram->frames);
+  stats->worst_us = histogram->worst_us;
+
+  /* Upper bound of the bucket containing the 99th percentile */
+  threshold = (histogram->frames * 99 + 99) / 100;
+  count = 0;
+
+  for (uint32_t i = 0; i < PATCH_GFX_FRAME_TIME_HISTOGRAM_BUCKETS; i++) {
+    count += histogram->buckets[i];
+
+    if (count >= threshold) {
+      /* Last bucket is unbounded */
+      if (i == PATCH_GFX_FRAME_TIME_HISTOGRAM_BUCKETS - 1) {
+        stats->p99_us = stats->worst_us;
+      } else {
+        stats->p99_us = (i + 1) * PATCH_GFX_FRAME_TIME_HISTOGRAM_RESOLUTION_US;
+      }
+
+      break;
+    }
+  }
+
+  /* Not above the worst frame time which is exact */
+  if (stats->p99_us > stats->worst_us) {
+    stats->p99_us = stats->worst_us;
+  }
+}
+
+static uint32_t patch_gfx_frame_time_refresh_interval_us(void)
+{
+  /* Most frequent frame time is the best guess without querying the display
+     configuration. Center of the bucket */
+  return patch_gfx_frame_time_mode_bucket *
+      PATCH_GFX_FRAME_TIME_HISTOGRAM_RESOLUTION_US +
+      PATCH_GFX_FRAME_TIME_HISTOGRAM_RESOLUTION_US / 2;
+}
+
+static void patch_gfx_frame_time_process(uint64_t timestamp_ns)
+{
+  uint32_t frame_time_us;
+  uint32_t bucket;
+  uint32_t refresh_interval_us;
+  uint32_t dropped_frames;
+
+  if (patch_gfx_frame_time_prev_swap_ns == 0) {
+    patch_gfx_frame_time_prev_swap_ns = timestamp_ns;
+    return;
+  }
+
+  frame_time_us =
+      (uint32_t) ((timestamp_ns - patch_gfx_frame_time_prev_swap_ns) / 1000);
+  patch_gfx_frame_time_prev_swap_ns = timestamp_ns;
+
+  bucket = patch_gfx_frame_time_bucket(frame_time_us);
+  refresh_interval_us = patch_gfx_frame_time_refresh_interval_us();
+  dropped_frames = 0;
+
+  if (patch_gfx_frame_time_total.frames > 0 &&
+      frame_time_us >
+          refresh_interval_us * PATCH_GFX_FRAME_TIME_DROPPED_FACTOR) {
+    /* Number of refresh intervals missed, rounded */
+    dropped_frames =
+        (frame_time_us + refresh_interval_us / 2) / refresh_interval_us - 1;
+  }
+
+  patch_gfx_frame_time_histogram_add(
+      &patch_gfx_frame_time_interval, bucket, frame_time_us, dropped_frames);
+  patch_gfx_frame_time_histogram_add(
+      &patch_gfx_frame_time_total, bucket, frame_time_us, dropped_frames);
+
+  if (patch_gfx_frame_time_total.buckets[bucket] >
+      patch_gfx_frame_time_total.buckets[patch_gfx_frame_time_mode_bucket]) {
+    patch_gfx_frame_time_mode_bucket = bucket;
+  }
+}
+
+static void patch_gfx_frame_time_collect(void)
+{
+  uint32_t head;
+  uint32_t tail;
+
+  head = atomic_load_explicit(
+      &patch_gfx_frame_time_ring_head, memory_order_acquire);
+  tail = atomic_load_explicit(
+      &patch_gfx_frame_time_ring_tail, memory_order_relaxed);
+
+  while (tail != head) {
+    patch_gfx_frame_time_process(
+        patch_gfx_frame_time_ring[tail & (PATCH_GFX_FRAME_TIME_RING_SIZE - 1)]);
+    tail++;
+  }
+
+  atomic_store_explicit(
+      &patch_gfx_frame_time_ring_tail, tail, memory_order_release);
+}
+
+static void patch_gfx_frame_time_publish(void)
+{
+  struct patch_gfx_frame_time_stats stats;
+
+  memset(&stats, 0, sizeof(struct patch_gfx_frame_time_stats));
+
+  stats.version = PATCH_GFX_FRAME_TIME_STATS_VERSION;
+  stats.refresh_interval_us = patch_gfx_frame_time_refresh_interval_us();
+  stats.lost_samples = atomic_load(&patch_gfx_frame_time_lost_samples);
+
+  patch_gfx_frame_time_histogram_to_stats(
+      &patch_gfx_frame_time_interval, &stats.interval);
+  patch_gfx_frame_time_histogram_to_stats(
+      &patch_gfx_frame_time_total, &stats.total);
+
+  log_info(
+      "Last %d sec: frames %llu, mean %.3f ms, p99 %.3f ms, worst %.3f ms, "
+      "dropped %llu; total: frames %llu, mean %.3f ms, p99 %.3f ms, worst "
+      "%.3f ms, dropped %llu; refresh interval %.3f ms, lost samples %d",
+      patch_gfx_frame_time_log_interval_sec,
+      stats.interval.frames,
+      stats.interval.mean_us / 1000.0,
+      stats.interval.p99_us / 1000.0,
+      stats.interval.worst_us / 1000.0,
+      stats.interval.dropped_frames,
+      stats.total.frames,
+      stats.total.mean_us / 1000.0,
+      stats.total.p99_us / 1000.0,
+      stats.total.worst_us / 1000.0,
+      stats.total.dropped_frames,
+      stats.refresh_interval_us / 1000.0,
+      stats.lost_samples);
+
+  if (patch_gfx_frame_time_shm) {
+    /* seqlock style update, readers retry on odd or changed sequence */
+    stats.sequence = patch_gfx_frame_time_shm->sequence + 1;
+
+    atomic_store(
+        (atomic_uint *) &patch_gfx_frame_time_shm->sequence, stats.sequence);
+    atomic_thread_fence(memory_order_release);
+
+    memcpy(
+        patch_gfx_frame_time_shm,
+        &stats,
+        sizeof(struct patch_gfx_frame_time_stats));
+
+    atomic_thread_fence(memory_order_release);
+    atomic_store(
+        (atomic_uint *) &patch_gfx_frame_time_shm->sequence,
+        stats.sequence + 1);
+  }
+
+  memset(
+      &patch_gfx_frame_time_interval,
+      0,
+      sizeof(struct patch_gfx_frame_time_histogram));
+}
+
+static void patch_gfx_frame_time_shm_open(void)
+{
+  int fd;
+  void *ptr;
+
+  fd = shm_open(PATCH_GFX_FRAME_TIME_SHM_NAME, O_CREAT | O_RDWR, 0644);
+
+  if (fd < 0) {
+    log_warn(
+        "Creating shared memory %s failed, stats are logged only",
+        PATCH_GFX_FRAME_TIME_SHM_NAME);
+    return;
+  }
+
+  if (ftruncate(fd, sizeof(struct patch_gfx_frame_time_stats)) != 0) {
+    log_warn("Resizing shared memory %s failed", PATCH_GFX_FRAME_TIME_SHM_NAME);
+    close(fd);
+    return;
+  }
+
+  ptr = mmap(
+      NULL,
+      sizeof(struct patch_gfx_frame_time_stats),
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED,
+      fd,
+      0);
+
+  close(fd);
+
+  if (ptr == MAP_FAILED) {
+    log_warn("Mapping shared memory %s failed", PATCH_GFX_FRAME_TIME_SHM_NAME);
+    return;
+  }
+
+  patch_gfx_frame_time_shm = (struct patch_gfx_frame_time_stats *) ptr;
+  memset(
+      patch_gfx_frame_time_shm, 0, sizeof(struct patch_gfx_frame_time_stats));
+  patch_gfx_frame_time_shm->version = PATCH_GFX_FRAME_TIME_STATS_VERSION;
+
+  log_info(
+      "Publishing stats to shared memory %s", PATCH_GFX_FRAME_TIME_SHM_NAME);
+}
+
+static void *patch_gfx_frame_time_thread_proc(void *args)
+{
+  uint64_t next_publish_ns;
+  uint64_t now_ns;
+
+  next_publish_ns = util_time_get_monotonic_ns() +
+      (uint64_t) patch_gfx_frame_time_log_interval_sec * 1000 * 1000 * 1000;
+
+  while (atomic_load(&patch_gfx_frame_time_thread_run) > 0) {
+    util_time_sleep_ms(PATCH_GFX_FRAME_TIME_COLLECT_INTERVAL_MS);
+
+    patch_gfx_frame_time_collect();
+
+    now_ns = util_time_get_monotonic_ns();
+
+    if (now_ns >= next_publish_ns) {
+      patch_gfx_frame_time_publish();
+      next_publish_ns +=
+          (uint64_t) patch_gfx_frame_time_log_interval_sec * 1000 * 1000 * 1000;
+    }
+  }
+
+  return NULL;
+}
+
+static void patch_gfx_frame_time_limit(void)
+{
+  uint64_t now_ns;
+  uint64_t sleep_until_ns;
+  struct timespec ts;
+
+  now_ns = util_time_get_monotonic_ns();
+
+  /* First frame or fell behind by more than a frame, e.g. loading screens.
+     Re-sync instead of rushing frames to catch up */
+  if (patch_gfx_frame_time_limit_deadline_ns == 0 ||
+      now_ns > patch_gfx_frame_time_limit_deadline_ns +
+              patch_gfx_frame_time_limit_period_ns) {
+    patch_gfx_frame_time_limit_deadline_ns =
+        now_ns + patch_gfx_frame_time_limit_period_ns;
+    return;
+  }
+
+  if (patch_gfx_frame_time_limit_deadline_ns >
+      now_ns + PATCH_GFX_FRAME_TIME_LIMIT_SPIN_TAIL_NS) {
+    sleep_until_ns = patch_gfx_frame_time_limit_deadline_ns -
+        PATCH_GFX_FRAME_TIME_LIMIT_SPIN_TAIL_NS;
+
+    ts.tv_sec = (time_t) (sleep_until_ns / (1000 * 1000 * 1000));
+    ts.tv_nsec = (long) (sleep_until_ns % (1000 * 1000 * 1000));
+
+    /* Absolute deadline, interrupted sleeps just continue */
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+           EINTR) {
+    }
+  }
+
+  while (util_time_get_monotonic_ns() <
+         patch_gfx_frame_time_limit_deadline_ns) {
+    /* spin */
+  }
+
+  /* Advance from the deadline, not from now, to not accumulate wake-up
+     latency */
+  patch_gfx_frame_time_limit_deadline_ns +=
+      patch_gfx_frame_time_limit_period_ns;
+}
+
+void glXSwapBuffers(Display *dpy, GLXDrawable drawable)
+{
+  if (!patch_gfx_frame_time_real_glXSwapBuffers) {
+    patch_gfx_frame_time_real_glXSwapBuffers =
+        (glXSwapBuffers_t) cnh_lib_get_func_addr("glXSwapBuffers");
+  }
+
+  if (patch_gfx_frame_time_pre_swap) {
+    patch_gfx_frame_time_pre_swap(dpy, drawable);
+  }
+
+  if (patch_gfx_frame_time_limit_period_ns > 0) {
+    patch_gfx_frame_time_limit();
+  }
+
+  patch_gfx_frame_time_real_glXSwapBuffers(dpy, drawable);
+
+  if (patch_gfx_frame_time_post_swap) {
+    patch_gfx_frame_time_post_swap(dpy, drawable);
+  }
+
+  if (patch_gfx_frame_time_enabled) {
+    patch_gfx_frame_time_ring_push(util_time_get_monotonic_ns());
+  }
+}
+
+void patch_gfx_frame_time_init(uint32_t log_interval_sec)
+{
+  if (log_interval_sec == 0) {
+    log_warn("Invalid log interval 0, defaulting to 1 sec");
+    log_interval_sec = 1;
+  }
+
+  patch_gfx_frame_time_log_interval_sec = log_interval_sec;
+
+  patch_gfx_frame_time_shm_open();
+
+  atomic_store(&patch_gfx_frame_time_thread_run, 1);
+
+  if (pthread_create(
+          &patch_gfx_frame_time_thread,
+          NULL,
+          patch_gfx_frame_time_thread_proc,
+          NULL) != 0) {
+    log_error("Creating frame time collector thread failed");
+    return;
+  }
+
+  patch_gfx_frame_time_enabled = true;
+
+  log_info("Initialized, log interval %d sec", log_interval_sec);
+}
+
+void patch_gfx_frame_time_limit_init(uint32_t refresh_rate_hz)
+{
+  if (refresh_rate_hz == 0) {
+    log_warn("Invalid frame limit 0, ignored");
+    return;
+  }
+
+  patch_gfx_frame_time_limit_deadline_ns = 0;
+  patch_gfx_frame_time_limit_period_ns =
+      (uint64_t) 1000 * 1000 * 1000 / refresh_rate_hz;
+
+  log_info(
+      "Frame limiter enabled, %d hz, frame period %llu ns",
+      refresh_rate_hz,
+      patch_gfx_frame_time_limit_period_ns);
+}
+
+void patch_gfx_frame_time_set_swap_handlers(
+    patch_gfx_frame_time_swap_handler_t pre_swap,
+    patch_gfx_frame_time_swap_handler_t post_swap)
+{
+  patch_gfx_frame_time_pre_swap = pre_swap;
+  patch_gfx_frame_time_post_swap = post_swap;
+}
+
+void patch_gfx_frame_time_shutdown(void)
+{
+  if (!patch_gfx_frame_time_enabled) {
+    return;
+  }
+
+  patch_gfx_frame_time_enabled = false;
+
+  atomic_store(&patch_gfx_frame_time_thread_run, 0);
+  pthread_join(patch_gfx_frame_time_thread, NULL);
+
+  patch_gfx_frame_time_collect();
+  patch_gfx_frame_time_publish();
+
+  if (patch_gfx_frame_time_shm) {
+    munmap(
+        patch_gfx_frame_time_shm, sizeof(struct patch_gfx_frame_time_stats));
+    patch_gfx_frame_time_shm = NULL;
+  }
+
+  log_info("Shut down");
+}
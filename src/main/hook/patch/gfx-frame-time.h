@@ -0,0 +1,95 @@
+/**
+ * Patch module measuring the frame pacing of the game. Hooks glXSwapBuffers
+ * and records a timestamp for every presented frame. The timestamps are
+ * collected into frame time histograms by a separate thread. The stats are
+ * published to a shared memory block and periodically summarized in the log.
+ *
+ * Furthermore, the glXSwapBuffers hook optionally paces the game to a target
+ * refresh rate (frame limiter) which is required for games rendering
+ * unbounded without vsync.
+ */
+#ifndef PATCH_GFX_FRAME_TIME_H
+#define PATCH_GFX_FRAME_TIME_H
+
+#include <GL/glx.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Name of the shared memory block (see shm_open) with the stats
+ */
+#define PATCH_GFX_FRAME_TIME_SHM_NAME "/pumptools-frame-time"
+
+#define PATCH_GFX_FRAME_TIME_STATS_VERSION 1
+
+/**
+ * Frame time stats of a period of time
+ */
+struct patch_gfx_frame_time_period_stats {
+  uint64_t frames;
+  uint64_t dropped_frames;
+  uint32_t mean_us;
+  uint32_t p99_us;
+  uint32_t worst_us;
+};
+
+/**
+ * Layout of the shared memory stats block. Readers have to retry reading the
+ * block if sequence is odd or changed while reading it
+ */
+struct patch_gfx_frame_time_stats {
+  uint32_t version;
+  uint32_t sequence;
+  /* Estimated refresh interval, most frequent frame time */
+  uint32_t refresh_interval_us;
+  /* Timestamps lost because the collector thread did not keep up */
+  uint32_t lost_samples;
+  /* Last log interval */
+  struct patch_gfx_frame_time_period_stats interval;
+  /* Since the game started */
+  struct patch_gfx_frame_time_period_stats total;
+};
+
+/**
+ * Initialize the patch module
+ *
+ * @param log_interval_sec Interval in seconds to summarize the stats in the
+ *        log and to update the shared memory block
+ */
+void patch_gfx_frame_time_init(uint32_t log_interval_sec);
+
+/**
+ * Enable the frame limiter. Paces the buffer swaps using absolute deadlines
+ * (clock_nanosleep) with a short busy wait tail for accuracy. Independent of
+ * the stats, i.e. does not require calling init
+ *
+ * @param refresh_rate_hz Target refresh rate/frames per second
+ */
+void patch_gfx_frame_time_limit_init(uint32_t refresh_rate_hz);
+
+/**
+ * Handler called by the glXSwapBuffers hook on the render thread
+ */
+typedef void (*patch_gfx_frame_time_swap_handler_t)(
+    Display *dpy, GLXDrawable drawable);
+
+/**
+ * Set handlers to run additional GL work around every buffer swap. This module
+ * owns the glXSwapBuffers hook, other gfx patches have to use this instead of
+ * hooking it as well. Independent of the stats, i.e. does not require calling
+ * init
+ *
+ * @param pre_swap Called before the frame limiter and the real swap, e.g. to
+ *        present an offscreen render target, or NULL
+ * @param post_swap Called after the real swap, or NULL
+ */
+void patch_gfx_frame_time_set_swap_handlers(
+    patch_gfx_frame_time_swap_handler_t pre_swap,
+    patch_gfx_frame_time_swap_handler_t post_swap);
+
+/**
+ * Shutdown the patch module. Logs a final summary
+ */
+void patch_gfx_frame_time_shutdown(void);
+
+#endif
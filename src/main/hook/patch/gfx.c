@@ -3,17 +3,25 @@
 #include <GL/gl.h>
 #include <X11/Xutil.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 // OpenGL 3.x+
 #include <GL/glx.h>
 
 #include "capnhook/hook/lib.h"
 
+#include "hook/patch/gfx-frame-time.h"
+
 #include "util/log.h"
 #include "util/str.h"
 
 #include "gfx.h"
 
+/* Query objects in flight to read GPU timer results without stalling */
+#define PATCH_GFX_SCALE_TIMER_QUERIES 2
+#define PATCH_GFX_SCALE_TIMER_LOG_FRAMES 3600
+
 typedef Window (*XCreateWindow_t)(
     Display *display,
     Window parent,
@@ -30,11 +38,108 @@ typedef Window (*XCreateWindow_t)(
 typedef Display *(*XOpenDisplay_t)(const char *display_name);
 typedef XVisualInfo *(*glXChooseVisual_t)(
     Display *dpy, int screen, int *attribList);
+typedef Bool (*glXMakeCurrent_t)(
+    Display *dpy, GLXDrawable drawable, GLXContext ctx);
+typedef GLXContext (*glXGetCurrentContext_t)(void);
+typedef void *(*glXGetProcAddressARB_t)(const GLubyte *procName);
+typedef const char *(*glXQueryExtensionsString_t)(Display *dpy, int screen);
+typedef void (*glXSwapIntervalEXT_t)(
+    Display *dpy, GLXDrawable drawable, int interval);
+typedef int (*glXSwapIntervalMESA_t)(unsigned int interval);
+typedef int (*glXSwapIntervalSGI_t)(int interval);
+typedef const GLubyte *(*glGetString_t)(GLenum name);
+typedef void (*glGetBooleanv_t)(GLenum pname, GLboolean *params);
+typedef void (*glGetFloatv_t)(GLenum pname, GLfloat *params);
+typedef void (*glGetIntegerv_t)(GLenum pname, GLint *params);
+typedef GLboolean (*glIsEnabled_t)(GLenum cap);
+typedef void (*glEnable_t)(GLenum cap);
+typedef void (*glDisable_t)(GLenum cap);
+typedef void (*glClearColor_t)(
+    GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha);
+typedef void (*glColorMask_t)(
+    GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+typedef void (*glClear_t)(GLbitfield mask);
+typedef void (*glViewport_t)(GLint x, GLint y, GLsizei width, GLsizei height);
+typedef void (*glDrawBuffer_t)(GLenum mode);
+typedef void (*glReadBuffer_t)(GLenum mode);
+
+struct patch_gfx_scale_resolution {
+  unsigned int src_width;
+  unsigned int src_height;
+  unsigned int dst_width;
+  unsigned int dst_height;
+};
+
+/* Loaded once the game's context is current, libGL is loaded by the game */
+struct patch_gfx_scale_gl {
+  glGetString_t get_string;
+  glGetBooleanv_t get_booleanv;
+  glGetFloatv_t get_floatv;
+  glGetIntegerv_t get_integerv;
+  glIsEnabled_t is_enabled;
+  glEnable_t enable;
+  glDisable_t disable;
+  glClearColor_t clear_color;
+  glColorMask_t color_mask;
+  glClear_t clear;
+  glViewport_t viewport;
+  glXGetCurrentContext_t get_current_context;
+  PFNGLGENFRAMEBUFFERSPROC gen_framebuffers;
+  PFNGLBINDFRAMEBUFFERPROC bind_framebuffer;
+  PFNGLFRAMEBUFFERRENDERBUFFERPROC framebuffer_renderbuffer;
+  PFNGLCHECKFRAMEBUFFERSTATUSPROC check_framebuffer_status;
+  PFNGLGENRENDERBUFFERSPROC gen_renderbuffers;
+  PFNGLBINDRENDERBUFFERPROC bind_renderbuffer;
+  PFNGLRENDERBUFFERSTORAGEPROC renderbuffer_storage;
+  PFNGLBLITFRAMEBUFFERPROC blit_framebuffer;
+  PFNGLGENQUERIESPROC gen_queries;
+  PFNGLBEGINQUERYPROC begin_query;
+  PFNGLENDQUERYPROC end_query;
+  PFNGLGETQUERYOBJECTIVPROC get_query_objectiv;
+  PFNGLGETQUERYOBJECTUI64VPROC get_query_objectui64v;
+};
+
+static const struct patch_gfx_scale_resolution
+    patch_gfx_scale_resolutions[] = {
+        [PATCH_GFX_SCALE_MODE_SD_480_TO_PILLARBOX_HD_720] =
+            {640, 480, 1280, 720},
+        [PATCH_GFX_SCALE_MODE_SD_480_TO_PILLARBOX_HD_1080] =
+            {640, 480, 1920, 1080},
+        [PATCH_GFX_SCALE_MODE_SD_480_TO_SD_960] = {640, 480, 1280, 960},
+        [PATCH_GFX_SCALE_MODE_HD_720_TO_HD_1080] = {1280, 720, 1920, 1080},
+};
 
 static bool patch_gfx_initialized;
 static XCreateWindow_t patch_gfx_real_XCreateWindow;
 static XOpenDisplay_t patch_gfx_real_XOpenDisplay;
 static glXChooseVisual_t patch_gfx_real_GlXChooseVisual;
+static glXMakeCurrent_t patch_gfx_real_glXMakeCurrent;
+static glDrawBuffer_t patch_gfx_real_glDrawBuffer;
+static glReadBuffer_t patch_gfx_real_glReadBuffer;
+
+static bool patch_gfx_swap_interval_enabled;
+static int patch_gfx_swap_interval;
+static GLXContext patch_gfx_swap_interval_applied_ctx;
+
+static enum patch_gfx_scale_mode patch_gfx_scale_mode;
+static enum patch_gfx_scale_filter patch_gfx_scale_filter;
+static Window patch_gfx_scale_window;
+static unsigned int patch_gfx_scale_src_width;
+static unsigned int patch_gfx_scale_src_height;
+static GLint patch_gfx_scale_dst_rect[4];
+static GLXContext patch_gfx_scale_ctx;
+static struct patch_gfx_scale_gl patch_gfx_scale_gl;
+static GLuint patch_gfx_scale_fbo;
+
+static bool patch_gfx_scale_timer_query;
+static GLuint patch_gfx_scale_timer_queries[PATCH_GFX_SCALE_TIMER_QUERIES];
+static bool patch_gfx_scale_timer_pending[PATCH_GFX_SCALE_TIMER_QUERIES];
+static uint32_t patch_gfx_scale_timer_index;
+static uint32_t patch_gfx_scale_timer_frames;
+static uint32_t patch_gfx_scale_timer_samples;
+static uint32_t patch_gfx_scale_timer_not_ready;
+static uint64_t patch_gfx_scale_timer_sum_ns;
+static uint64_t patch_gfx_scale_timer_worst_ns;
 
 static char *patch_gfx_attrib_list_to_str(int *attrib_list)
 {
@@ -56,6 +161,498 @@ static char *patch_gfx_attrib_list_to_str(int *attrib_list)
   return str;
 }
 
+static bool
+patch_gfx_has_extension(const char *extensions, const char *extension)
+{
+  const char *pos;
+  size_t len;
+
+  if (!extensions) {
+    return false;
+  }
+
+  len = strlen(extension);
+  pos = extensions;
+
+  /* Avoid matching prefixes, e.g. GLX_EXT_swap_control_tear */
+  while ((pos = strstr(pos, extension)) != NULL) {
+    if ((pos == extensions || pos[-1] == ' ') &&
+        (pos[len] == ' ' || pos[len] == '\0')) {
+      return true;
+    }
+
+    pos += len;
+  }
+
+  return false;
+}
+
+static void patch_gfx_apply_swap_interval(Display *dpy, GLXDrawable drawable)
+{
+  glXGetProcAddressARB_t get_proc_address;
+  glXQueryExtensionsString_t query_extensions_string;
+  const char *extensions;
+
+  get_proc_address =
+      (glXGetProcAddressARB_t) cnh_lib_get_func_addr("glXGetProcAddressARB");
+  query_extensions_string = (glXQueryExtensionsString_t) cnh_lib_get_func_addr(
+      "glXQueryExtensionsString");
+
+  if (!get_proc_address || !query_extensions_string) {
+    log_warn(
+        "Setting swap interval %d failed, GLX functions not available",
+        patch_gfx_swap_interval);
+    return;
+  }
+
+  extensions = query_extensions_string(dpy, DefaultScreen(dpy));
+
+  if (!extensions) {
+    log_warn(
+        "Setting swap interval %d failed, querying GLX extensions failed",
+        patch_gfx_swap_interval);
+    return;
+  }
+
+  if (patch_gfx_has_extension(extensions, "GLX_EXT_swap_control")) {
+    glXSwapIntervalEXT_t swap_interval_ext =
+        (glXSwapIntervalEXT_t) get_proc_address(
+            (const GLubyte *) "glXSwapIntervalEXT");
+
+    if (swap_interval_ext) {
+      swap_interval_ext(dpy, drawable, patch_gfx_swap_interval);
+      log_info(
+          "Swap interval set to %d (GLX_EXT_swap_control)",
+          patch_gfx_swap_interval);
+      return;
+    }
+  }
+
+  if (patch_gfx_has_extension(extensions, "GLX_MESA_swap_control")) {
+    glXSwapIntervalMESA_t swap_interval_mesa =
+        (glXSwapIntervalMESA_t) get_proc_address(
+            (const GLubyte *) "glXSwapIntervalMESA");
+
+    if (swap_interval_mesa &&
+        swap_interval_mesa((unsigned int) patch_gfx_swap_interval) == 0) {
+      log_info(
+          "Swap interval set to %d (GLX_MESA_swap_control)",
+          patch_gfx_swap_interval);
+      return;
+    }
+  }
+
+  /* SGI does not support disabling vsync (interval 0) */
+  if (patch_gfx_swap_interval > 0 &&
+      patch_gfx_has_extension(extensions, "GLX_SGI_swap_control")) {
+    glXSwapIntervalSGI_t swap_interval_sgi =
+        (glXSwapIntervalSGI_t) get_proc_address(
+            (const GLubyte *) "glXSwapIntervalSGI");
+
+    if (swap_interval_sgi && swap_interval_sgi(patch_gfx_swap_interval) == 0) {
+      log_info(
+          "Swap interval set to %d (GLX_SGI_swap_control)",
+          patch_gfx_swap_interval);
+      return;
+    }
+  }
+
+  log_warn(
+      "Setting swap interval %d failed, no supported swap control extension "
+      "available",
+      patch_gfx_swap_interval);
+}
+
+static void patch_gfx_scale_calc_dst_rect(
+    unsigned int src_width,
+    unsigned int src_height,
+    unsigned int dst_width,
+    unsigned int dst_height,
+    enum patch_gfx_scale_filter filter,
+    GLint *rect)
+{
+  unsigned int width;
+  unsigned int height;
+  unsigned int factor;
+
+  factor = 0;
+
+  if (filter == PATCH_GFX_SCALE_FILTER_INTEGER) {
+    factor = dst_width / src_width;
+
+    if (dst_height / src_height < factor) {
+      factor = dst_height / src_height;
+    }
+  }
+
+  if (factor > 0) {
+    width = src_width * factor;
+    height = src_height * factor;
+  } else if (
+      (uint64_t) src_width * dst_height > (uint64_t) dst_width * src_height) {
+    /* Source is wider than target, letterbox */
+    width = dst_width;
+    height = (uint64_t) src_height * dst_width / src_width;
+  } else {
+    /* Source is narrower than target, pillarbox */
+    width = (uint64_t) src_width * dst_height / src_height;
+    height = dst_height;
+  }
+
+  /* Centered, x0, y0, x1, y1 as required by glBlitFramebuffer */
+  rect[0] = (dst_width - width) / 2;
+  rect[1] = (dst_height - height) / 2;
+  rect[2] = rect[0] + width;
+  rect[3] = rect[1] + height;
+}
+
+static bool patch_gfx_scale_load_gl(void)
+{
+  glXGetProcAddressARB_t get_proc_address;
+  struct patch_gfx_scale_gl *gl;
+  const char *extensions;
+
+  gl = &patch_gfx_scale_gl;
+
+  get_proc_address =
+      (glXGetProcAddressARB_t) cnh_lib_get_func_addr("glXGetProcAddressARB");
+
+  gl->get_string = (glGetString_t) cnh_lib_get_func_addr("glGetString");
+  gl->get_booleanv = (glGetBooleanv_t) cnh_lib_get_func_addr("glGetBooleanv");
+  gl->get_floatv = (glGetFloatv_t) cnh_lib_get_func_addr("glGetFloatv");
+  gl->get_integerv = (glGetIntegerv_t) cnh_lib_get_func_addr("glGetIntegerv");
+  gl->is_enabled = (glIsEnabled_t) cnh_lib_get_func_addr("glIsEnabled");
+  gl->enable = (glEnable_t) cnh_lib_get_func_addr("glEnable");
+  gl->disable = (glDisable_t) cnh_lib_get_func_addr("glDisable");
+  gl->clear_color = (glClearColor_t) cnh_lib_get_func_addr("glClearColor");
+  gl->color_mask = (glColorMask_t) cnh_lib_get_func_addr("glColorMask");
+  gl->clear = (glClear_t) cnh_lib_get_func_addr("glClear");
+  gl->viewport = (glViewport_t) cnh_lib_get_func_addr("glViewport");
+  gl->get_current_context =
+      (glXGetCurrentContext_t) cnh_lib_get_func_addr("glXGetCurrentContext");
+
+  if (!get_proc_address || !gl->get_string || !gl->get_booleanv ||
+      !gl->get_floatv || !gl->get_integerv || !gl->is_enabled ||
+      !gl->enable || !gl->disable || !gl->clear_color || !gl->color_mask ||
+      !gl->clear || !gl->viewport || !gl->get_current_context) {
+    log_error("Loading GL functions failed");
+    return false;
+  }
+
+  extensions = (const char *) gl->get_string(GL_EXTENSIONS);
+
+  log_info(
+      "GL renderer %s, version %s",
+      gl->get_string(GL_RENDERER),
+      gl->get_string(GL_VERSION));
+
+  /* glXGetProcAddressARB returns stubs for any function name, check the
+     extension first */
+  if (!patch_gfx_has_extension(extensions, "GL_ARB_framebuffer_object")) {
+    log_error("GL_ARB_framebuffer_object not supported");
+    return false;
+  }
+
+  gl->gen_framebuffers = (PFNGLGENFRAMEBUFFERSPROC) get_proc_address(
+      (const GLubyte *) "glGenFramebuffers");
+  gl->bind_framebuffer = (PFNGLBINDFRAMEBUFFERPROC) get_proc_address(
+      (const GLubyte *) "glBindFramebuffer");
+  gl->framebuffer_renderbuffer =
+      (PFNGLFRAMEBUFFERRENDERBUFFERPROC) get_proc_address(
+          (const GLubyte *) "glFramebufferRenderbuffer");
+  gl->check_framebuffer_status =
+      (PFNGLCHECKFRAMEBUFFERSTATUSPROC) get_proc_address(
+          (const GLubyte *) "glCheckFramebufferStatus");
+  gl->gen_renderbuffers = (PFNGLGENRENDERBUFFERSPROC) get_proc_address(
+      (const GLubyte *) "glGenRenderbuffers");
+  gl->bind_renderbuffer = (PFNGLBINDRENDERBUFFERPROC) get_proc_address(
+      (const GLubyte *) "glBindRenderbuffer");
+  gl->renderbuffer_storage = (PFNGLRENDERBUFFERSTORAGEPROC) get_proc_address(
+      (const GLubyte *) "glRenderbufferStorage");
+  gl->blit_framebuffer = (PFNGLBLITFRAMEBUFFERPROC) get_proc_address(
+      (const GLubyte *) "glBlitFramebuffer");
+
+  if (!gl->gen_framebuffers || !gl->bind_framebuffer ||
+      !gl->framebuffer_renderbuffer || !gl->check_framebuffer_status ||
+      !gl->gen_renderbuffers || !gl->bind_renderbuffer ||
+      !gl->renderbuffer_storage || !gl->blit_framebuffer) {
+    log_error("Loading GL framebuffer object functions failed");
+    return false;
+  }
+
+  /* Optional, for measuring the cost of scaling */
+  if (patch_gfx_has_extension(extensions, "GL_ARB_timer_query")) {
+    gl->get_query_objectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)
+        get_proc_address((const GLubyte *) "glGetQueryObjectui64v");
+  } else if (patch_gfx_has_extension(extensions, "GL_EXT_timer_query")) {
+    gl->get_query_objectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)
+        get_proc_address((const GLubyte *) "glGetQueryObjectui64vEXT");
+  } else {
+    gl->get_query_objectui64v = NULL;
+  }
+
+  gl->gen_queries = (PFNGLGENQUERIESPROC) get_proc_address(
+      (const GLubyte *) "glGenQueries");
+  gl->begin_query = (PFNGLBEGINQUERYPROC) get_proc_address(
+      (const GLubyte *) "glBeginQuery");
+  gl->end_query =
+      (PFNGLENDQUERYPROC) get_proc_address((const GLubyte *) "glEndQuery");
+  gl->get_query_objectiv = (PFNGLGETQUERYOBJECTIVPROC) get_proc_address(
+      (const GLubyte *) "glGetQueryObjectiv");
+
+  patch_gfx_scale_timer_query = gl->get_query_objectui64v && gl->gen_queries &&
+      gl->begin_query && gl->end_query && gl->get_query_objectiv;
+
+  return true;
+}
+
+static void patch_gfx_scale_setup(void)
+{
+  struct patch_gfx_scale_gl *gl;
+  GLuint color;
+  GLuint depth_stencil;
+  GLenum status;
+
+  gl = &patch_gfx_scale_gl;
+
+  if (!patch_gfx_scale_load_gl()) {
+    log_error("Scaling not available");
+    return;
+  }
+
+  gl->gen_renderbuffers(1, &color);
+  gl->bind_renderbuffer(GL_RENDERBUFFER, color);
+  gl->renderbuffer_storage(
+      GL_RENDERBUFFER,
+      GL_RGBA8,
+      patch_gfx_scale_src_width,
+      patch_gfx_scale_src_height);
+
+  gl->gen_renderbuffers(1, &depth_stencil);
+  gl->bind_renderbuffer(GL_RENDERBUFFER, depth_stencil);
+  gl->renderbuffer_storage(
+      GL_RENDERBUFFER,
+      GL_DEPTH24_STENCIL8,
+      patch_gfx_scale_src_width,
+      patch_gfx_scale_src_height);
+
+  gl->bind_renderbuffer(GL_RENDERBUFFER, 0);
+
+  gl->gen_framebuffers(1, &patch_gfx_scale_fbo);
+  gl->bind_framebuffer(GL_FRAMEBUFFER, patch_gfx_scale_fbo);
+  gl->framebuffer_renderbuffer(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+  gl->framebuffer_renderbuffer(
+      GL_FRAMEBUFFER,
+      GL_DEPTH_STENCIL_ATTACHMENT,
+      GL_RENDERBUFFER,
+      depth_stencil);
+
+  status = gl->check_framebuffer_status(GL_FRAMEBUFFER);
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    log_error("Framebuffer object incomplete, status 0x%X", status);
+    gl->bind_framebuffer(GL_FRAMEBUFFER, 0);
+    patch_gfx_scale_fbo = 0;
+    return;
+  }
+
+  if (patch_gfx_scale_timer_query) {
+    gl->gen_queries(
+        PATCH_GFX_SCALE_TIMER_QUERIES, patch_gfx_scale_timer_queries);
+  } else {
+    log_warn("No timer query support, scaling cost is not measured");
+  }
+
+  /* The initial viewport of the context is the size of the window which is
+     larger than the FBO. Games setting the viewport on window resizes only
+     never set it */
+  gl->viewport(0, 0, patch_gfx_scale_src_width, patch_gfx_scale_src_height);
+
+  /* The game renders to the FBO from now on like it renders to the default
+     framebuffer */
+  log_info(
+      "Redirected rendering to %dx%d framebuffer object, blit to %d/%d - "
+      "%d/%d",
+      patch_gfx_scale_src_width,
+      patch_gfx_scale_src_height,
+      patch_gfx_scale_dst_rect[0],
+      patch_gfx_scale_dst_rect[1],
+      patch_gfx_scale_dst_rect[2],
+      patch_gfx_scale_dst_rect[3]);
+}
+
+static GLenum patch_gfx_scale_map_color_buffer(GLenum binding, GLenum mode)
+{
+  GLint fbo;
+
+  if (patch_gfx_scale_fbo == 0) {
+    return mode;
+  }
+
+  /* Buffers of the default framebuffer, the FBO standing in for it has a
+     single color attachment only. Anything else is an error on an FBO */
+  switch (mode) {
+    case GL_FRONT:
+    case GL_BACK:
+    case GL_LEFT:
+    case GL_FRONT_LEFT:
+    case GL_BACK_LEFT:
+    case GL_FRONT_AND_BACK:
+      break;
+
+    default:
+      return mode;
+  }
+
+  if (patch_gfx_scale_gl.get_current_context() != patch_gfx_scale_ctx) {
+    return mode;
+  }
+
+  patch_gfx_scale_gl.get_integerv(binding, &fbo);
+
+  if ((GLuint) fbo != patch_gfx_scale_fbo) {
+    return mode;
+  }
+
+  return GL_COLOR_ATTACHMENT0;
+}
+
+static void patch_gfx_scale_timer_collect(uint32_t index)
+{
+  struct patch_gfx_scale_gl *gl;
+  GLint available;
+  GLuint64 elapsed_ns;
+
+  gl = &patch_gfx_scale_gl;
+
+  if (!patch_gfx_scale_timer_pending[index]) {
+    return;
+  }
+
+  patch_gfx_scale_timer_pending[index] = false;
+
+  gl->get_query_objectiv(
+      patch_gfx_scale_timer_queries[index],
+      GL_QUERY_RESULT_AVAILABLE,
+      &available);
+
+  /* Never wait for the result, that stalls the pipeline */
+  if (!available) {
+    patch_gfx_scale_timer_not_ready++;
+    return;
+  }
+
+  gl->get_query_objectui64v(
+      patch_gfx_scale_timer_queries[index], GL_QUERY_RESULT, &elapsed_ns);
+
+  patch_gfx_scale_timer_samples++;
+  patch_gfx_scale_timer_sum_ns += elapsed_ns;
+
+  if (elapsed_ns > patch_gfx_scale_timer_worst_ns) {
+    patch_gfx_scale_timer_worst_ns = elapsed_ns;
+  }
+}
+
+static void patch_gfx_scale_timer_log(void)
+{
+  if (patch_gfx_scale_timer_samples > 0) {
+    log_info(
+        "Scaling GPU time: avg %llu us, worst %llu us (%d samples, %d not "
+        "ready)",
+        patch_gfx_scale_timer_sum_ns / patch_gfx_scale_timer_samples / 1000,
+        patch_gfx_scale_timer_worst_ns / 1000,
+        patch_gfx_scale_timer_samples,
+        patch_gfx_scale_timer_not_ready);
+  }
+
+  patch_gfx_scale_timer_samples = 0;
+  patch_gfx_scale_timer_not_ready = 0;
+  patch_gfx_scale_timer_sum_ns = 0;
+  patch_gfx_scale_timer_worst_ns = 0;
+}
+
+static void patch_gfx_scale_pre_swap(Display *dpy, GLXDrawable drawable)
+{
+  struct patch_gfx_scale_gl *gl;
+  GLboolean scissor_test;
+  GLboolean color_mask[4];
+  GLfloat clear_color[4];
+  GLuint query;
+
+  if (patch_gfx_scale_fbo == 0 || drawable != patch_gfx_scale_window) {
+    return;
+  }
+
+  gl = &patch_gfx_scale_gl;
+  query = patch_gfx_scale_timer_queries[patch_gfx_scale_timer_index];
+
+  if (patch_gfx_scale_timer_query) {
+    patch_gfx_scale_timer_collect(patch_gfx_scale_timer_index);
+    gl->begin_query(GL_TIME_ELAPSED, query);
+  }
+
+  /* Blitting and clearing are affected by the scissor test and clearing by
+     the color mask. Save the game's state and restore it afterwards */
+  scissor_test = gl->is_enabled(GL_SCISSOR_TEST);
+  gl->get_booleanv(GL_COLOR_WRITEMASK, color_mask);
+  gl->get_floatv(GL_COLOR_CLEAR_VALUE, clear_color);
+
+  gl->disable(GL_SCISSOR_TEST);
+  gl->color_mask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+  gl->bind_framebuffer(GL_READ_FRAMEBUFFER, patch_gfx_scale_fbo);
+  gl->bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+  /* Pillar-/letterbox bars */
+  gl->clear_color(0.0f, 0.0f, 0.0f, 1.0f);
+  gl->clear(GL_COLOR_BUFFER_BIT);
+
+  gl->blit_framebuffer(
+      0,
+      0,
+      patch_gfx_scale_src_width,
+      patch_gfx_scale_src_height,
+      patch_gfx_scale_dst_rect[0],
+      patch_gfx_scale_dst_rect[1],
+      patch_gfx_scale_dst_rect[2],
+      patch_gfx_scale_dst_rect[3],
+      GL_COLOR_BUFFER_BIT,
+      patch_gfx_scale_filter == PATCH_GFX_SCALE_FILTER_LINEAR ? GL_LINEAR :
+                                                                GL_NEAREST);
+
+  gl->clear_color(
+      clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+  gl->color_mask(color_mask[0], color_mask[1], color_mask[2], color_mask[3]);
+
+  if (scissor_test) {
+    gl->enable(GL_SCISSOR_TEST);
+  }
+
+  if (patch_gfx_scale_timer_query) {
+    gl->end_query(GL_TIME_ELAPSED);
+
+    patch_gfx_scale_timer_pending[patch_gfx_scale_timer_index] = true;
+    patch_gfx_scale_timer_index =
+        (patch_gfx_scale_timer_index + 1) % PATCH_GFX_SCALE_TIMER_QUERIES;
+
+    if (++patch_gfx_scale_timer_frames % PATCH_GFX_SCALE_TIMER_LOG_FRAMES ==
+        0) {
+      patch_gfx_scale_timer_log();
+    }
+  }
+}
+
+static void patch_gfx_scale_post_swap(Display *dpy, GLXDrawable drawable)
+{
+  if (patch_gfx_scale_fbo == 0 || drawable != patch_gfx_scale_window) {
+    return;
+  }
+
+  /* Back to rendering the next frame to the FBO */
+  patch_gfx_scale_gl.bind_framebuffer(GL_FRAMEBUFFER, patch_gfx_scale_fbo);
+}
+
 Window XCreateWindow(
     Display *display,
     Window parent,
@@ -89,6 +686,65 @@ Window XCreateWindow(
     }
   }
 
+  /* Create the game's (top level) window with the target resolution. The game
+     keeps rendering with its native resolution to an FBO, see glXMakeCurrent */
+  if (patch_gfx_scale_mode != PATCH_GFX_SCALE_MODE_INVALID &&
+      patch_gfx_scale_window == None && parent == DefaultRootWindow(display)) {
+    const struct patch_gfx_scale_resolution *res;
+    Window window;
+
+    res = &patch_gfx_scale_resolutions[patch_gfx_scale_mode];
+
+    if (width != res->src_width || height != res->src_height) {
+      log_warn(
+          "Game window %dx%d does not match source resolution %dx%d of scaling "
+          "mode %d, scaling from %dx%d",
+          width,
+          height,
+          res->src_width,
+          res->src_height,
+          patch_gfx_scale_mode,
+          width,
+          height);
+    }
+
+    patch_gfx_scale_src_width = width;
+    patch_gfx_scale_src_height = height;
+
+    patch_gfx_scale_calc_dst_rect(
+        width,
+        height,
+        res->dst_width,
+        res->dst_height,
+        patch_gfx_scale_filter,
+        patch_gfx_scale_dst_rect);
+
+    window = patch_gfx_real_XCreateWindow(
+        display,
+        parent,
+        x,
+        y,
+        res->dst_width,
+        res->dst_height,
+        border_width,
+        depth,
+        _class,
+        visual,
+        valuemask,
+        attributes);
+
+    log_info(
+        "Created window %dx%d for scaling from %dx%d",
+        res->dst_width,
+        res->dst_height,
+        width,
+        height);
+
+    patch_gfx_scale_window = window;
+
+    return window;
+  }
+
   return patch_gfx_real_XCreateWindow(
       display,
       parent,
@@ -159,17 +815,91 @@ XVisualInfo *glXChooseVisual(Display *dpy, int screen, int *attribList)
   return res;
 }
 
+Bool glXMakeCurrent(Display *dpy, GLXDrawable drawable, GLXContext ctx)
+{
+  Bool res;
+
+  if (!patch_gfx_real_glXMakeCurrent) {
+    patch_gfx_real_glXMakeCurrent =
+        (glXMakeCurrent_t) cnh_lib_get_func_addr("glXMakeCurrent");
+  }
+
+  res = patch_gfx_real_glXMakeCurrent(dpy, drawable, ctx);
+
+  /* Swap control applies to the current context/drawable. Apply once for
+     every newly created context made current */
+  if (res && patch_gfx_swap_interval_enabled && ctx != NULL &&
+      drawable != None && ctx != patch_gfx_swap_interval_applied_ctx) {
+    patch_gfx_apply_swap_interval(dpy, drawable);
+    patch_gfx_swap_interval_applied_ctx = ctx;
+  }
+
+  /* FBOs are not shared between contexts, setup once for the context
+     rendering to the game's window */
+  if (res && patch_gfx_scale_window != None && ctx != NULL &&
+      drawable == patch_gfx_scale_window && patch_gfx_scale_ctx == NULL) {
+    patch_gfx_scale_ctx = ctx;
+    patch_gfx_scale_setup();
+  }
+
+  return res;
+}
+
+void glDrawBuffer(GLenum mode)
+{
+  if (!patch_gfx_real_glDrawBuffer) {
+    patch_gfx_real_glDrawBuffer =
+        (glDrawBuffer_t) cnh_lib_get_func_addr("glDrawBuffer");
+  }
+
+  patch_gfx_real_glDrawBuffer(
+      patch_gfx_scale_map_color_buffer(GL_DRAW_FRAMEBUFFER_BINDING, mode));
+}
+
+void glReadBuffer(GLenum mode)
+{
+  if (!patch_gfx_real_glReadBuffer) {
+    patch_gfx_real_glReadBuffer =
+        (glReadBuffer_t) cnh_lib_get_func_addr("glReadBuffer");
+  }
+
+  patch_gfx_real_glReadBuffer(
+      patch_gfx_scale_map_color_buffer(GL_READ_FRAMEBUFFER_BINDING, mode));
+}
+
 void patch_gfx_init()
 {
   patch_gfx_initialized = true;
   log_info("Initialized");
 }
 
-// Note, consider improving scaling, see
-// http://www.david-amador.com/2013/04/opengl-2d-independent-resolution-rendering/
-void patch_gfx_scale(enum patch_gfx_scale_mode scale_mode)
+void patch_gfx_scale(
+    enum patch_gfx_scale_mode scale_mode, enum patch_gfx_scale_filter filter)
+{
+  if (scale_mode <= PATCH_GFX_SCALE_MODE_INVALID ||
+      scale_mode > PATCH_GFX_SCALE_MODE_HD_720_TO_HD_1080) {
+    log_error("Invalid scaling mode %d", scale_mode);
+    return;
+  }
+
+  if (filter > PATCH_GFX_SCALE_FILTER_INTEGER) {
+    log_warn("Invalid scaling filter %d, defaulting to linear", filter);
+    filter = PATCH_GFX_SCALE_FILTER_LINEAR;
+  }
+
+  patch_gfx_scale_mode = scale_mode;
+  patch_gfx_scale_filter = filter;
+
+  patch_gfx_frame_time_set_swap_handlers(
+      patch_gfx_scale_pre_swap, patch_gfx_scale_post_swap);
+
+  log_info("Scaling mode %d, filter %d", scale_mode, filter);
+}
+
+void patch_gfx_force_swap_interval(int interval)
 {
-  log_error(
-      "GFX scaling enabled but will not work. Temporarily removed due to "
-      "issues with loading libGL.so");
+  patch_gfx_swap_interval = interval;
+  patch_gfx_swap_interval_enabled = true;
+
+  log_info("Forcing swap interval %d", interval);
 }
@@ -12,6 +12,16 @@ enum patch_gfx_scale_mode {
   PATCH_GFX_SCALE_MODE_HD_720_TO_HD_1080 = 4,
 };
 
+/**
+ * Filters for scaling the native resolution output to the target resolution
+ */
+enum patch_gfx_scale_filter {
+  PATCH_GFX_SCALE_FILTER_LINEAR = 0,
+  PATCH_GFX_SCALE_FILTER_NEAREST = 1,
+  /* Nearest, largest integer factor that fits the target resolution */
+  PATCH_GFX_SCALE_FILTER_INTEGER = 2,
+};
+
 /**
  * Initialize the patch module
  *
@@ -22,6 +32,25 @@ void patch_gfx_init();
 /**
  * Scale the rendered output according to the given mode (see enum)
  *
+ * The game's window is created with the target resolution and the game's
+ * default framebuffer is redirected to an offscreen framebuffer (FBO) with the
+ * native resolution of the game. On every buffer swap, the FBO is blitted to
+ * the window using the given filter. Selecting the default framebuffer's
+ * buffers (e.g. GL_BACK) with glDrawBuffer/glReadBuffer selects the FBO's
+ * color buffer instead. Requires GL_ARB_framebuffer_object
+ *
  * @param scale_mode The scaling mode to apply
+ * @param filter Filter to apply when blitting to the window
+ */
+void patch_gfx_scale(
+    enum patch_gfx_scale_mode scale_mode, enum patch_gfx_scale_filter filter);
+
+/**
+ * Force a swap interval (vsync) once the game makes its GL context current.
+ * Uses GLX_EXT_swap_control, GLX_MESA_swap_control or GLX_SGI_swap_control,
+ * whichever is available
+ *
+ * @param interval Number of vertical blanks to wait for on each buffer swap,
+ *        0 to disable vsync
  */
-void patch_gfx_scale(enum patch_gfx_scale_mode scale_mode);
+void patch_gfx_force_swap_interval(int interval);
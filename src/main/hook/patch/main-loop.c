@@ -2,7 +2,9 @@
 
 #include <X11/Xutil.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "ptapi/io/x11-input-hook.h"
 
@@ -11,7 +13,25 @@
 
 #include "hook/patch/main-loop.h"
 
+#include "util/defs.h"
 #include "util/log.h"
+#include "util/mem.h"
+#include "util/time.h"
+
+/* X11 keycodes are in the range 8 - 255. Shift and Lock are masked out
+   before the lookup. NumLock (Mod2) and AltGr (Mod5) still change the keysym
+   of a keycode and get their own sections in the table */
+#define PATCH_MAIN_LOOP_KEYCODE_NUM 256
+#define PATCH_MAIN_LOOP_KEYCODE_TABLE_SIZE (PATCH_MAIN_LOOP_KEYCODE_NUM * 4)
+
+/* Entry layout of the keycode table. Keysyms use 29 bits at most which leaves
+   the upper bits for flags */
+#define PATCH_MAIN_LOOP_KEYCODE_VALID 0x80000000
+#define PATCH_MAIN_LOOP_KEYCODE_SWALLOW 0x40000000
+#define PATCH_MAIN_LOOP_KEYCODE_KEYSYM_MASK 0x1FFFFFFF
+
+/* Log the overhead stats every n key events */
+#define PATCH_MAIN_LOOP_STATS_LOG_INTERVAL 4096
 
 typedef int (*XPending_t)(Display *display);
 typedef int (*XNextEvent_t)(Display *display, XEvent *event_return);
@@ -19,6 +39,27 @@ typedef int (*XNextEvent_t)(Display *display, XEvent *event_return);
 typedef const struct ptapi_io_x11_input_hook_handler *(
     *ptapi_io_x11_input_handler_hook_t)(void);
 
+/* Overhead counters of the X11 event hook. Key event times include keysym
+   lookup, filtering and dispatching to the input handlers but not the time
+   spent in the real XNextEvent call. Only accessed by the thread pumping X11
+   events which also logs them */
+struct patch_main_loop_stats {
+  uint64_t events;
+  uint64_t key_events;
+  uint64_t key_events_total_ns;
+  uint64_t key_events_max_ns;
+  uint64_t keycode_table_hits;
+  uint64_t keycode_table_misses;
+};
+
+/* Immutable once published. Registering a new handler creates a new copy and
+   swaps the published pointer. Old copies are never freed because a dispatch
+   might still be iterating them (registration happens once on startup) */
+struct patch_main_loop_input_handlers {
+  size_t count;
+  const struct ptapi_io_x11_input_hook_handler *handlers[];
+};
+
 static XPending_t _patch_main_loop_real_XPending;
 static XNextEvent_t _patch_main_loop_real_XNextEvent;
 
@@ -26,13 +67,153 @@ static void
 _patch_main_loop_sigalarm_handler(int signal, __sighandler_t orig_handler);
 static bool _patch_main_loop_is_key_repeated(Display *display, XEvent *event);
 
+/* Built-in inputs of the game: test (F1), service (F2) and clear (F3) */
+static const KeySym _patch_main_loop_built_in_keys[] = {
+    XK_F1,
+    XK_F2,
+    XK_F3,
+};
+
+/* Built-in inputs of the MK3 linux ports */
+static const KeySym _patch_main_loop_mk3_linux_ports_built_in_keys[] = {
+    XK_g,
+    XK_h,
+    XK_j,
+    XK_k,
+    XK_l,
+    XK_q,
+    XK_e,
+    XK_s,
+    XK_z,
+    XK_c,
+    XK_KP_7,
+    XK_KP_9,
+    XK_KP_5,
+    XK_KP_1,
+    XK_KP_3,
+};
+
 static __sighandler_t _patch_main_loop_sigalarm_orig_handler;
 static bool _patch_main_loop_disable_built_in_inputs;
 static bool _patch_main_loop_disable_mk3_linux_ports_built_in_inputs;
 static pthread_mutex_t _patch_main_loop_input_handlers_lock;
-static const struct ptapi_io_x11_input_hook_handler *
-    *_patch_main_loop_input_handlers;
-static size_t _patch_main_loop_num_input_handlers;
+static struct patch_main_loop_input_handlers *_Atomic
+    _patch_main_loop_input_handlers;
+static atomic_uint
+    _patch_main_loop_keycode_table[PATCH_MAIN_LOOP_KEYCODE_TABLE_SIZE];
+static struct patch_main_loop_stats _patch_main_loop_stats;
+
+static bool _patch_main_loop_is_key_in_list(
+    KeySym key, const KeySym *list, size_t list_len)
+{
+  for (size_t i = 0; i < list_len; i++) {
+    if (list[i] == key) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void _patch_main_loop_keycode_table_reset(void)
+{
+  for (size_t i = 0; i < PATCH_MAIN_LOOP_KEYCODE_TABLE_SIZE; i++) {
+    atomic_store_explicit(
+        &_patch_main_loop_keycode_table[i], 0, memory_order_relaxed);
+  }
+}
+
+/* Resolve the keysym of a key event. The first event of a keycode runs
+   XLookupString and the swallow checks, any further events are a single table
+   lookup */
+static uint32_t _patch_main_loop_keycode_lookup(XKeyEvent *event)
+{
+  uint32_t index;
+  uint32_t entry;
+  KeySym key;
+
+  if (event->keycode >= PATCH_MAIN_LOOP_KEYCODE_NUM) {
+    XLookupString(event, 0, 0, &key, 0);
+    return PATCH_MAIN_LOOP_KEYCODE_VALID |
+        ((uint32_t) key & PATCH_MAIN_LOOP_KEYCODE_KEYSYM_MASK);
+  }
+
+  index = event->keycode;
+
+  if (event->state & Mod2Mask) {
+    index += PATCH_MAIN_LOOP_KEYCODE_NUM;
+  }
+
+  if (event->state & Mod5Mask) {
+    index += PATCH_MAIN_LOOP_KEYCODE_NUM * 2;
+  }
+
+  entry = atomic_load_explicit(
+      &_patch_main_loop_keycode_table[index], memory_order_relaxed);
+
+  if (entry & PATCH_MAIN_LOOP_KEYCODE_VALID) {
+    _patch_main_loop_stats.keycode_table_hits++;
+    return entry;
+  }
+
+  _patch_main_loop_stats.keycode_table_misses++;
+
+  XLookupString(event, 0, 0, &key, 0);
+
+  entry = PATCH_MAIN_LOOP_KEYCODE_VALID |
+      ((uint32_t) key & PATCH_MAIN_LOOP_KEYCODE_KEYSYM_MASK);
+
+  /* Swallow some keys to disable them */
+  if (_patch_main_loop_disable_built_in_inputs &&
+      _patch_main_loop_is_key_in_list(
+          key,
+          _patch_main_loop_built_in_keys,
+          lengthof(_patch_main_loop_built_in_keys))) {
+    entry |= PATCH_MAIN_LOOP_KEYCODE_SWALLOW;
+  }
+
+  /* Swallow all built-in inputs of the MK3 ports */
+  if (_patch_main_loop_disable_mk3_linux_ports_built_in_inputs &&
+      _patch_main_loop_is_key_in_list(
+          key,
+          _patch_main_loop_mk3_linux_ports_built_in_keys,
+          lengthof(_patch_main_loop_mk3_linux_ports_built_in_keys))) {
+    entry |= PATCH_MAIN_LOOP_KEYCODE_SWALLOW;
+  }
+
+  atomic_store_explicit(
+      &_patch_main_loop_keycode_table[index], entry, memory_order_relaxed);
+
+  return entry;
+}
+
+static void _patch_main_loop_update_stats(uint64_t start_ns)
+{
+  uint64_t elapsed_ns;
+
+  elapsed_ns = util_time_get_monotonic_ns() - start_ns;
+
+  _patch_main_loop_stats.key_events++;
+  _patch_main_loop_stats.key_events_total_ns += elapsed_ns;
+
+  if (elapsed_ns > _patch_main_loop_stats.key_events_max_ns) {
+    _patch_main_loop_stats.key_events_max_ns = elapsed_ns;
+  }
+
+  if (_patch_main_loop_stats.key_events % PATCH_MAIN_LOOP_STATS_LOG_INTERVAL ==
+      0) {
+    log_debug(
+        "Events %llu, key events %llu, avg key event overhead %llu ns, max "
+        "%llu ns, keycode table hits %llu, misses %llu",
+        _patch_main_loop_stats.events,
+        _patch_main_loop_stats.key_events,
+        _patch_main_loop_stats.key_events_total_ns /
+            _patch_main_loop_stats.key_events,
+        _patch_main_loop_stats.key_events_max_ns,
+        _patch_main_loop_stats.keycode_table_hits,
+        _patch_main_loop_stats.keycode_table_misses);
+  }
+}
 
 void patch_main_loop_init(
     bool fix_sigalarm_main_loop,
@@ -52,13 +233,17 @@ void patch_main_loop_init(
 
   pthread_mutex_init(&_patch_main_loop_input_handlers_lock, NULL);
 
+  _patch_main_loop_keycode_table_reset();
+  memset(&_patch_main_loop_stats, 0, sizeof(struct patch_main_loop_stats));
+
   log_info("Initialized, disable built-in inputs %d", disable_built_in_inputs);
 }
 
 void patch_main_loop_add_x11_input_handler(const char *lib_with_handler_impl)
 {
-  const struct ptapi_io_x11_input_hook_handler **new_array;
-  size_t new_size;
+  struct patch_main_loop_input_handlers *cur;
+  struct patch_main_loop_input_handlers *new;
+  size_t cur_count;
   void *lib_handle;
   ptapi_io_x11_input_handler_hook_t input_handler_hook_func;
   const struct ptapi_io_x11_input_hook_handler *input_handler_hook;
@@ -86,22 +271,28 @@ void patch_main_loop_add_x11_input_handler(const char *lib_with_handler_impl)
     return;
   }
 
+  /* Serializes writers only, dispatch reads the published copy lock-free */
   pthread_mutex_lock(&_patch_main_loop_input_handlers_lock);
 
-  new_size = _patch_main_loop_num_input_handlers + 1;
-  new_array = realloc(
-      _patch_main_loop_input_handlers,
-      new_size * sizeof(struct ptapi_io_input_hook_handler *));
+  cur = atomic_load(&_patch_main_loop_input_handlers);
+  cur_count = cur ? cur->count : 0;
 
-  if (new_array != NULL) {
-    _patch_main_loop_input_handlers = new_array;
+  new = util_xmalloc(
+      sizeof(struct patch_main_loop_input_handlers) +
+      (cur_count + 1) * sizeof(struct ptapi_io_x11_input_hook_handler *));
 
-    _patch_main_loop_input_handlers[_patch_main_loop_num_input_handlers++] =
-        input_handler_hook;
-  } else {
-    log_die("Out of memory");
+  if (cur) {
+    memcpy(
+        new->handlers,
+        cur->handlers,
+        cur_count * sizeof(struct ptapi_io_x11_input_hook_handler *));
   }
 
+  new->handlers[cur_count] = input_handler_hook;
+  new->count = cur_count + 1;
+
+  atomic_store(&_patch_main_loop_input_handlers, new);
+
   pthread_mutex_unlock(&_patch_main_loop_input_handlers_lock);
 
   log_debug(
@@ -128,7 +319,10 @@ int XPending(Display *display)
 int XNextEvent(Display *display, XEvent *event_return)
 {
   int res;
+  uint64_t start_ns;
+  uint32_t entry;
   KeySym key;
+  const struct patch_main_loop_input_handlers *input_handlers;
 
   if (!_patch_main_loop_real_XNextEvent) {
     _patch_main_loop_real_XNextEvent =
@@ -138,87 +332,77 @@ int XNextEvent(Display *display, XEvent *event_return)
   /* Trap KeyPress and KeyRelease events */
   res = _patch_main_loop_real_XNextEvent(display, event_return);
 
+  _patch_main_loop_stats.events++;
+
   switch (event_return->type) {
     case KeyPress: {
+      start_ns = util_time_get_monotonic_ns();
+
       /* Mask out the modifier states X11 sets and read again */
       event_return->xkey.state &= ~ShiftMask;
       event_return->xkey.state &= ~LockMask;
 
-      XLookupString(&event_return->xkey, 0, 0, &key, 0);
+      entry = _patch_main_loop_keycode_lookup(&event_return->xkey);
+      key = entry & PATCH_MAIN_LOOP_KEYCODE_KEYSYM_MASK;
 
-      /* Swallow some keys to disable them */
-      if (_patch_main_loop_disable_built_in_inputs) {
-        if (key == XK_F1 || key == XK_F2 || key == XK_F3) {
-          event_return->type = GenericEvent;
-        }
-      }
-
-      /* Swallow all built-in inputs of the MK3 ports */
-      if (_patch_main_loop_disable_mk3_linux_ports_built_in_inputs) {
-        if (key == XK_g || key == XK_h || key == XK_j || key == XK_k ||
-            key == XK_l || key == XK_q || key == XK_e || key == XK_s ||
-            key == XK_z || key == XK_c || key == XK_KP_7 || key == XK_KP_9 ||
-            key == XK_KP_5 || key == XK_KP_1 || key == XK_KP_3) {
-          event_return->type = GenericEvent;
-        }
+      if (entry & PATCH_MAIN_LOOP_KEYCODE_SWALLOW) {
+        event_return->type = GenericEvent;
       }
 
       /* Dispatch to external input handlers */
-      if (_patch_main_loop_num_input_handlers > 0) {
-        pthread_mutex_lock(&_patch_main_loop_input_handlers_lock);
+      input_handlers = atomic_load_explicit(
+          &_patch_main_loop_input_handlers, memory_order_acquire);
 
-        for (size_t i = 0; i < _patch_main_loop_num_input_handlers; i++) {
-          if (_patch_main_loop_input_handlers[i]->dispatch_key_press) {
-            _patch_main_loop_input_handlers[i]->dispatch_key_press(key);
+      if (input_handlers) {
+        for (size_t i = 0; i < input_handlers->count; i++) {
+          if (input_handlers->handlers[i]->dispatch_key_press) {
+            input_handlers->handlers[i]->dispatch_key_press(key);
           }
         }
-
-        pthread_mutex_unlock(&_patch_main_loop_input_handlers_lock);
       }
 
+      _patch_main_loop_update_stats(start_ns);
+
       break;
     }
 
     case KeyRelease: {
+      start_ns = util_time_get_monotonic_ns();
+
       /* Mask out the modifier states X11 sets and read again */
       event_return->xkey.state &= ~ShiftMask;
       event_return->xkey.state &= ~LockMask;
 
-      XLookupString(&event_return->xkey, 0, 0, &key, 0);
+      entry = _patch_main_loop_keycode_lookup(&event_return->xkey);
+      key = entry & PATCH_MAIN_LOOP_KEYCODE_KEYSYM_MASK;
 
-      /* Swallow some keys to disable them */
-      if (_patch_main_loop_disable_built_in_inputs) {
-        if (key == XK_F1 || key == XK_F2 || key == XK_F3) {
-          event_return->type = GenericEvent;
-        }
-      }
-
-      /* Swallow all built-in inputs of the MK3 ports */
-      if (_patch_main_loop_disable_mk3_linux_ports_built_in_inputs) {
-        if (key == XK_g || key == XK_h || key == XK_j || key == XK_k ||
-            key == XK_l || key == XK_q || key == XK_e || key == XK_s ||
-            key == XK_z || key == XK_c || key == XK_KP_7 || key == XK_KP_9 ||
-            key == XK_KP_5 || key == XK_KP_1 || key == XK_KP_3) {
-          event_return->type = GenericEvent;
-        }
+      if (entry & PATCH_MAIN_LOOP_KEYCODE_SWALLOW) {
+        event_return->type = GenericEvent;
       }
 
       /* Dispatch to external input handlers */
-      if (_patch_main_loop_num_input_handlers > 0) {
+      input_handlers = atomic_load_explicit(
+          &_patch_main_loop_input_handlers, memory_order_acquire);
+
+      if (input_handlers) {
         /* Dispatch release if key is not repeated */
         if (!_patch_main_loop_is_key_repeated(display, event_return)) {
-          pthread_mutex_lock(&_patch_main_loop_input_handlers_lock);
-
-          for (size_t i = 0; i < _patch_main_loop_num_input_handlers; i++) {
-            if (_patch_main_loop_input_handlers[i]->dispatch_key_release) {
-              _patch_main_loop_input_handlers[i]->dispatch_key_release(key);
+          for (size_t i = 0; i < input_handlers->count; i++) {
+            if (input_handlers->handlers[i]->dispatch_key_release) {
+              input_handlers->handlers[i]->dispatch_key_release(key);
             }
           }
-
-          pthread_mutex_unlock(&_patch_main_loop_input_handlers_lock);
         }
       }
 
+      _patch_main_loop_update_stats(start_ns);
+
+      break;
+    }
+
+    case MappingNotify: {
+      /* Keyboard mapping changed, keysyms need to be resolved again */
+      _patch_main_loop_keycode_table_reset();
       break;
     }
 
@@ -38,6 +38,7 @@
 
 #include <X11/Xutil.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * Initialize the patch module
@@ -1,6 +1,7 @@
 #define LOG_MODULE "patch-net-profile"
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <string.h>
 
 #include "asset/nx2/lib/usb-rank.h"
@@ -10,6 +11,7 @@
 
 #include "capnhook/hook/filehook.h"
 
+#include "pumpnet/lib/profile-token-watcher.h"
 #include "pumpnet/lib/profile-token.h"
 #include "pumpnet/lib/pumpnet.h"
 
@@ -20,6 +22,7 @@
 #define PUMPNET_MAX_NUM_PLAYERS 2
 #define PUMPNET_PROFILE_FILE_NAME "pumpnet.bin"
 #define PUMPNET_TRY_CONNECT_TIMEOUT_MS 2000
+#define PUMPNET_TOKEN_WATCH_POLL_INTERVAL_MS 1000
 
 struct profile_virtual_mnt_point_file_info {
   int player;
@@ -35,9 +38,15 @@ struct profile_virtual_mnt_point_info {
   } player[PUMPNET_MAX_NUM_PLAYERS];
 };
 
+// open profile file, state of each file (and player) is locked separately to
+// not block the other player, e.g. while downloading
 struct profile_virtual_file {
+  // published once the file is opened and cleared on close, compared without
+  // locking by the lookup on every file operation of the game
+  FILE *_Atomic handle;
+  // protects everything below
+  pthread_mutex_t mutex;
   uint64_t player_ref_id;
-  FILE *handle;
   const struct profile_virtual_mnt_point_file_info *file_info;
   size_t buffer_pos;
   uint8_t *buffer;
@@ -46,6 +55,22 @@ struct profile_virtual_file {
 
 struct profile_virtual_mnt_point {
   struct profile_virtual_file files[PUMPNET_LIB_FILE_TYPE_COUNT];
+  // protects everything below
+  pthread_mutex_t mutex;
+  pthread_cond_t cond_prefetch_released;
+  // save and rank are downloaded together on opening the first of them or
+  // once the token of the player appears
+  struct pumpnet_lib_prefetch *prefetch;
+  uint64_t prefetch_player_ref_id;
+  bool prefetch_taken[PUMPNET_LIB_FILE_TYPE_COUNT];
+  // opens waiting on the prefetch, not freed until all are done
+  uint32_t prefetch_users;
+  // files of the player open in the game. token changes are deferred until
+  // the last one is closed, e.g. the profile is saved after the usb stick of
+  // the player was pulled already
+  uint32_t open_files;
+  bool token_change_pending;
+  uint64_t token_pending_player_ref_id;
 };
 
 static enum cnh_result
@@ -123,7 +148,8 @@ static const struct profile_virtual_mnt_point_info
     *_patch_net_profile_file_info_ref;
 static struct profile_virtual_mnt_point
     _patch_net_profile_virtual_mnt_points[PUMPNET_MAX_NUM_PLAYERS];
-static pthread_mutex_t _patch_net_profile_mutex;
+static struct pumpnet_lib_profile_token_watcher
+    *_patch_net_profile_token_watcher;
 
 static enum cnh_result _patch_net_profile_filehook(struct cnh_filehook_irp *irp)
 {
@@ -198,7 +224,7 @@ static enum cnh_result _patch_net_profile_fread(
 {
   uint32_t len;
 
-  pthread_mutex_lock(&_patch_net_profile_mutex);
+  pthread_mutex_lock(&virtual_file->mutex);
 
   log_debug(
       "fread %s, pos 0x%X, bytes %d",
@@ -222,7 +248,7 @@ static enum cnh_result _patch_net_profile_fread(
   virtual_file->buffer_pos += len;
   irp->read.pos += len;
 
-  pthread_mutex_unlock(&_patch_net_profile_mutex);
+  pthread_mutex_unlock(&virtual_file->mutex);
 
   return CNH_RESULT_SUCCESS;
 }
@@ -232,7 +258,7 @@ static enum cnh_result _patch_net_profile_fwrite(
 {
   uint32_t len;
 
-  pthread_mutex_lock(&_patch_net_profile_mutex);
+  pthread_mutex_lock(&virtual_file->mutex);
 
   log_debug(
       "fwrite %s, pos 0x%X, bytes %d",
@@ -255,7 +281,7 @@ static enum cnh_result _patch_net_profile_fwrite(
   virtual_file->is_written = true;
   irp->write.pos += len;
 
-  pthread_mutex_unlock(&_patch_net_profile_mutex);
+  pthread_mutex_unlock(&virtual_file->mutex);
 
   return CNH_RESULT_SUCCESS;
 }
@@ -263,7 +289,7 @@ static enum cnh_result _patch_net_profile_fwrite(
 static enum cnh_result _patch_net_profile_fseek(
     struct cnh_filehook_irp *irp, struct profile_virtual_file *virtual_file)
 {
-  pthread_mutex_lock(&_patch_net_profile_mutex);
+  pthread_mutex_lock(&virtual_file->mutex);
 
   switch (irp->seek_origin) {
     case SEEK_SET:
@@ -290,7 +316,7 @@ static enum cnh_result _patch_net_profile_fseek(
       irp->seek_offset,
       irp->seek_origin);
 
-  pthread_mutex_unlock(&_patch_net_profile_mutex);
+  pthread_mutex_unlock(&virtual_file->mutex);
 
   return CNH_RESULT_SUCCESS;
 }
@@ -298,11 +324,11 @@ static enum cnh_result _patch_net_profile_fseek(
 static enum cnh_result _patch_net_profile_ftell(
     struct cnh_filehook_irp *irp, struct profile_virtual_file *virtual_file)
 {
-  pthread_mutex_lock(&_patch_net_profile_mutex);
+  pthread_mutex_lock(&virtual_file->mutex);
 
   irp->tell_offset = virtual_file->buffer_pos;
 
-  pthread_mutex_unlock(&_patch_net_profile_mutex);
+  pthread_mutex_unlock(&virtual_file->mutex);
 
   return CNH_RESULT_SUCCESS;
 }
@@ -310,11 +336,11 @@ static enum cnh_result _patch_net_profile_ftell(
 static enum cnh_result _patch_net_profile_feof(
     struct cnh_filehook_irp *irp, struct profile_virtual_file *virtual_file)
 {
-  pthread_mutex_lock(&_patch_net_profile_mutex);
+  pthread_mutex_lock(&virtual_file->mutex);
 
   irp->eof = virtual_file->buffer_pos == virtual_file->file_info->file_size;
 
-  pthread_mutex_unlock(&_patch_net_profile_mutex);
+  pthread_mutex_unlock(&virtual_file->mutex);
 
   return CNH_RESULT_SUCCESS;
 }
@@ -324,10 +350,20 @@ static enum cnh_result _patch_net_profile_feof(
 static struct profile_virtual_file *
 _patch_net_profile_get_virtual_mnt_point(FILE *handle)
 {
+  struct profile_virtual_file *virtual_file;
+
+  // not open files don't have a handle
+  if (!handle) {
+    return NULL;
+  }
+
   for (int i = 0; i < PUMPNET_MAX_NUM_PLAYERS; i++) {
     for (int j = 0; j < PUMPNET_LIB_FILE_TYPE_COUNT; j++) {
-      if (_patch_net_profile_virtual_mnt_points->files[j].handle == handle) {
-        return &_patch_net_profile_virtual_mnt_points->files[j];
+      virtual_file = &_patch_net_profile_virtual_mnt_points[i].files[j];
+
+      if (atomic_load_explicit(&virtual_file->handle, memory_order_acquire) ==
+          handle) {
+        return virtual_file;
       }
     }
   }
@@ -374,13 +410,14 @@ static struct profile_virtual_file *_patch_net_profile_setup_virtual_file(
   virtual_file =
       &_patch_net_profile_virtual_mnt_points[player].files[file_type];
 
+  pthread_mutex_lock(&virtual_file->mutex);
+
   // sanity checks
-  log_assert(!virtual_file->handle);
+  log_assert(!atomic_load(&virtual_file->handle));
   log_assert(!virtual_file->file_info);
   log_assert(!virtual_file->buffer);
 
   virtual_file->player_ref_id = player_ref_id;
-  virtual_file->handle = cnh_filehook_open_dummy_file_handle();
   virtual_file->file_info =
       &_patch_net_profile_file_info_ref->player[player].file_info[file_type];
   virtual_file->buffer_pos = 0;
@@ -388,12 +425,28 @@ static struct profile_virtual_file *_patch_net_profile_setup_virtual_file(
 
   virtual_file->buffer = (uint8_t *) malloc(virtual_file->file_info->file_size);
 
+  pthread_mutex_unlock(&virtual_file->mutex);
+
   log_debug(
       "Setup virtual file done, size %d", virtual_file->file_info->file_size);
 
   return virtual_file;
 }
 
+// make the file visible to the file operations of the game, after the data is
+// downloaded
+static FILE *_patch_net_profile_publish_virtual_file(
+    struct profile_virtual_file *virtual_file)
+{
+  FILE *handle;
+
+  handle = cnh_filehook_open_dummy_file_handle();
+
+  atomic_store_explicit(&virtual_file->handle, handle, memory_order_release);
+
+  return handle;
+}
+
 static void _patch_net_profile_destroy_virtual_file(
     uint8_t player, enum pumpnet_lib_file_type file_type)
 {
@@ -405,16 +458,18 @@ static void _patch_net_profile_destroy_virtual_file(
   virtual_file =
       &_patch_net_profile_virtual_mnt_points[player].files[file_type];
 
-  // sanity checks
-  log_assert(virtual_file->handle);
+  pthread_mutex_lock(&virtual_file->mutex);
+
+  // sanity checks, not published
+  log_assert(!atomic_load(&virtual_file->handle));
   log_assert(virtual_file->file_info);
   log_assert(virtual_file->buffer);
 
-  cnh_filehook_close_dummy_file_handle(virtual_file->handle);
-  virtual_file->handle = NULL;
   virtual_file->file_info = NULL;
   free(virtual_file->buffer);
   virtual_file->buffer = NULL;
+
+  pthread_mutex_unlock(&virtual_file->mutex);
 }
 
 static bool _patch_net_profile_get_token(int player, uint64_t *player_ref_id)
@@ -446,12 +501,228 @@ static bool _patch_net_profile_get_token(int player, uint64_t *player_ref_id)
   return false;
 }
 
+// mutex of the mount point must be held. returns the prefetch of the mount
+// point, if any, to be freed once the mutex is released
+static struct pumpnet_lib_prefetch *
+_patch_net_profile_detach_prefetch(struct profile_virtual_mnt_point *mnt_point)
+{
+  struct pumpnet_lib_prefetch *prefetch;
+
+  // opens of the player are still waiting on it
+  while (mnt_point->prefetch_users > 0) {
+    pthread_cond_wait(&mnt_point->cond_prefetch_released, &mnt_point->mutex);
+  }
+
+  prefetch = mnt_point->prefetch;
+  mnt_point->prefetch = NULL;
+
+  return prefetch;
+}
+
+// no mutex held, waits for the downloads still running. the watcher and the
+// file hooks of the player must not be blocked by that
+static void
+_patch_net_profile_free_prefetch(struct pumpnet_lib_prefetch *prefetch)
+{
+  if (prefetch) {
+    pumpnet_lib_prefetch_free(prefetch);
+  }
+}
+
+static void _patch_net_profile_drop_prefetch(int player)
+{
+  struct profile_virtual_mnt_point *mnt_point;
+  struct pumpnet_lib_prefetch *prefetch;
+
+  mnt_point = &_patch_net_profile_virtual_mnt_points[player];
+
+  pthread_mutex_lock(&mnt_point->mutex);
+  prefetch = _patch_net_profile_detach_prefetch(mnt_point);
+  pthread_mutex_unlock(&mnt_point->mutex);
+
+  _patch_net_profile_free_prefetch(prefetch);
+}
+
+static void
+_patch_net_profile_start_prefetch(int player, uint64_t player_ref_id)
+{
+  struct profile_virtual_mnt_point *mnt_point;
+
+  mnt_point = &_patch_net_profile_virtual_mnt_points[player];
+
+  log_debug("Starting prefetch, player %d", player);
+
+  mnt_point->prefetch = pumpnet_lib_prefetch_start(
+      player_ref_id,
+      _patch_net_profile_file_info_ref->player[player]
+          .file_info[PUMPNET_LIB_FILE_TYPE_SAVE]
+          .file_size,
+      _patch_net_profile_file_info_ref->player[player]
+          .file_info[PUMPNET_LIB_FILE_TYPE_RANK]
+          .file_size);
+  mnt_point->prefetch_player_ref_id = player_ref_id;
+  memset(mnt_point->prefetch_taken, 0, sizeof(mnt_point->prefetch_taken));
+}
+
+static struct pumpnet_lib_prefetch *_patch_net_profile_take_prefetch(
+    int player, enum pumpnet_lib_file_type file_type, uint64_t player_ref_id)
+{
+  struct profile_virtual_mnt_point *mnt_point;
+  struct pumpnet_lib_prefetch *prefetch;
+  struct pumpnet_lib_prefetch *outdated;
+
+  mnt_point = &_patch_net_profile_virtual_mnt_points[player];
+  outdated = NULL;
+
+  pthread_mutex_lock(&mnt_point->mutex);
+
+  // different profile or file already taken, e.g. re-opened in a new session
+  if (mnt_point->prefetch &&
+      (mnt_point->prefetch_player_ref_id != player_ref_id ||
+       mnt_point->prefetch_taken[file_type])) {
+    outdated = _patch_net_profile_detach_prefetch(mnt_point);
+  }
+
+  if (!mnt_point->prefetch) {
+    _patch_net_profile_start_prefetch(player, player_ref_id);
+  }
+
+  mnt_point->prefetch_taken[file_type] = true;
+  mnt_point->prefetch_users++;
+  prefetch = mnt_point->prefetch;
+
+  pthread_mutex_unlock(&mnt_point->mutex);
+
+  _patch_net_profile_free_prefetch(outdated);
+
+  return prefetch;
+}
+
+static void _patch_net_profile_release_prefetch(int player)
+{
+  struct profile_virtual_mnt_point *mnt_point;
+
+  mnt_point = &_patch_net_profile_virtual_mnt_points[player];
+
+  pthread_mutex_lock(&mnt_point->mutex);
+
+  log_assert(mnt_point->prefetch_users > 0);
+
+  if (--mnt_point->prefetch_users == 0) {
+    pthread_cond_broadcast(&mnt_point->cond_prefetch_released);
+  }
+
+  pthread_mutex_unlock(&mnt_point->mutex);
+}
+
+// mutex of the mount point must be held. returns the prefetch of the previous
+// token, if any, to be freed once the mutex is released
+static struct pumpnet_lib_prefetch *_patch_net_profile_apply_token(
+    struct profile_virtual_mnt_point *mnt_point,
+    int player,
+    uint64_t player_ref_id)
+{
+  struct pumpnet_lib_prefetch *outdated;
+
+  outdated = NULL;
+
+  if (mnt_point->prefetch &&
+      mnt_point->prefetch_player_ref_id != player_ref_id) {
+    outdated = _patch_net_profile_detach_prefetch(mnt_point);
+  }
+
+  if (!mnt_point->prefetch &&
+      player_ref_id != PUMPNET_LIB_PROFILE_TOKEN_INVALID) {
+    log_info("Token of player %d appeared, prefetching profile", player);
+
+    _patch_net_profile_start_prefetch(player, player_ref_id);
+  }
+
+  return outdated;
+}
+
+// called by the token watcher, the download runs while the player is still
+// on the login screen and is taken once the game opens the profile files
+static void _patch_net_profile_token_changed(
+    size_t player, uint64_t player_ref_id, void *ctx)
+{
+  struct profile_virtual_mnt_point *mnt_point;
+  struct pumpnet_lib_prefetch *outdated;
+
+  mnt_point = &_patch_net_profile_virtual_mnt_points[player];
+  outdated = NULL;
+
+  pthread_mutex_lock(&mnt_point->mutex);
+
+  if (mnt_point->open_files > 0) {
+    log_debug(
+        "Token of player %d changed with %d files open, deferred until closed",
+        player,
+        mnt_point->open_files);
+
+    mnt_point->token_change_pending = true;
+    mnt_point->token_pending_player_ref_id = player_ref_id;
+  } else {
+    outdated = _patch_net_profile_apply_token(mnt_point, player, player_ref_id);
+  }
+
+  pthread_mutex_unlock(&mnt_point->mutex);
+
+  _patch_net_profile_free_prefetch(outdated);
+}
+
+static void _patch_net_profile_file_opened(int player)
+{
+  struct profile_virtual_mnt_point *mnt_point;
+
+  mnt_point = &_patch_net_profile_virtual_mnt_points[player];
+
+  pthread_mutex_lock(&mnt_point->mutex);
+  mnt_point->open_files++;
+  pthread_mutex_unlock(&mnt_point->mutex);
+}
+
+static void _patch_net_profile_file_closed(int player, bool is_written)
+{
+  struct profile_virtual_mnt_point *mnt_point;
+  struct pumpnet_lib_prefetch *written;
+  struct pumpnet_lib_prefetch *outdated;
+
+  mnt_point = &_patch_net_profile_virtual_mnt_points[player];
+  written = NULL;
+  outdated = NULL;
+
+  pthread_mutex_lock(&mnt_point->mutex);
+
+  // prefetched data of the player is outdated now, dropped before a deferred
+  // token change starts prefetching the next profile
+  if (is_written) {
+    written = _patch_net_profile_detach_prefetch(mnt_point);
+  }
+
+  log_assert(mnt_point->open_files > 0);
+
+  if (--mnt_point->open_files == 0 && mnt_point->token_change_pending) {
+    mnt_point->token_change_pending = false;
+
+    outdated = _patch_net_profile_apply_token(
+        mnt_point, player, mnt_point->token_pending_player_ref_id);
+  }
+
+  pthread_mutex_unlock(&mnt_point->mutex);
+
+  _patch_net_profile_free_prefetch(written);
+  _patch_net_profile_free_prefetch(outdated);
+}
+
 static bool _patch_net_profile_download_profile_file(
     struct profile_virtual_file *virtual_file)
 {
   int player;
   enum pumpnet_lib_file_type file_type;
   uint64_t player_ref_id;
+  struct pumpnet_lib_prefetch *prefetch;
+  bool res;
 
   player = virtual_file->file_info->player;
   file_type = virtual_file->file_info->file_type;
@@ -462,11 +733,20 @@ static bool _patch_net_profile_download_profile_file(
       player,
       file_type);
 
-  if (!pumpnet_lib_get(
-          file_type,
-          player_ref_id,
-          virtual_file->buffer,
-          virtual_file->file_info->file_size)) {
+  prefetch = _patch_net_profile_take_prefetch(player, file_type, player_ref_id);
+
+  // blocks only if the data has not arrived, yet. no locks held, the other
+  // player is not blocked. the buffer is not accessed by anyone else before
+  // the open returns the handle
+  res = pumpnet_lib_prefetch_wait(
+      prefetch,
+      file_type,
+      virtual_file->buffer,
+      virtual_file->file_info->file_size);
+
+  _patch_net_profile_release_prefetch(player);
+
+  if (!res) {
     log_error(
         "Downloading file player %d, file_type %d, failed", player, file_type);
     return false;
@@ -496,15 +776,13 @@ static enum cnh_result _patch_net_profile_open_pumpnet_profile_file(
         _patch_net_profile_setup_virtual_file(player, file_type, player_ref_id);
 
     if (_patch_net_profile_download_profile_file(virtual_file)) {
-      irp->file = virtual_file->handle;
-      pthread_mutex_unlock(&_patch_net_profile_mutex);
+      _patch_net_profile_file_opened(player);
+      irp->file = _patch_net_profile_publish_virtual_file(virtual_file);
 
       return CNH_RESULT_SUCCESS;
     } else {
       _patch_net_profile_destroy_virtual_file(player, file_type);
 
-      pthread_mutex_unlock(&_patch_net_profile_mutex);
-
       return CNH_RESULT_NO_SUCH_FILE_OR_DIR;
     }
   }
@@ -513,26 +791,19 @@ static enum cnh_result _patch_net_profile_open_pumpnet_profile_file(
 }
 
 static bool _patch_net_profile_upload_profile_file(
-    struct profile_virtual_file *virtual_file)
+    int player,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const uint8_t *buffer,
+    size_t size)
 {
-  int player;
-  enum pumpnet_lib_file_type file_type;
-  uint64_t player_ref_id;
-
-  player = virtual_file->file_info->player;
-  file_type = virtual_file->file_info->file_type;
-  player_ref_id = virtual_file->player_ref_id;
-
   log_info(
       "Profile file player %d, file_type %d, uploading to server...",
       player,
       file_type);
 
-  if (!pumpnet_lib_put(
-          file_type,
-          player_ref_id,
-          virtual_file->buffer,
-          virtual_file->file_info->file_size)) {
+  // queued and uploaded in the background if the upload journal is enabled
+  if (!pumpnet_lib_put_async(file_type, player_ref_id, buffer, size)) {
     log_error(
         "Uploading file player %d, file_type %d, failed", player, file_type);
     return false;
@@ -547,21 +818,61 @@ static bool _patch_net_profile_close_pumpnet_profile_file(
     struct profile_virtual_file *virtual_file)
 {
   bool res = true;
+  bool is_written;
+  int player;
+  enum pumpnet_lib_file_type file_type;
+  uint64_t player_ref_id;
+  FILE *handle;
+  uint8_t *buffer;
+  size_t size;
+
+  // detach the state from the file, the upload below may block (synchronous
+  // without upload journal) and must not hold the lock
+  pthread_mutex_lock(&virtual_file->mutex);
+
+  handle = atomic_exchange(&virtual_file->handle, NULL);
+  is_written = virtual_file->is_written;
+  player = virtual_file->file_info->player;
+  file_type = virtual_file->file_info->file_type;
+  player_ref_id = virtual_file->player_ref_id;
+  buffer = virtual_file->buffer;
+  size = virtual_file->file_info->file_size;
+
+  virtual_file->file_info = NULL;
+  virtual_file->buffer = NULL;
 
-  pthread_mutex_lock(&_patch_net_profile_mutex);
+  pthread_mutex_unlock(&virtual_file->mutex);
 
-  if (virtual_file->is_written) {
-    res = _patch_net_profile_upload_profile_file(virtual_file);
+  log_debug(
+      "Closed virtual file, player %d, file_type %d", player, file_type);
+
+  if (is_written) {
+    res = _patch_net_profile_upload_profile_file(
+        player, file_type, player_ref_id, buffer, size);
   }
 
-  _patch_net_profile_destroy_virtual_file(
-      virtual_file->file_info->player, virtual_file->file_info->file_type);
+  _patch_net_profile_file_closed(player, is_written);
 
-  pthread_mutex_unlock(&_patch_net_profile_mutex);
+  cnh_filehook_close_dummy_file_handle(handle);
+  free(buffer);
 
   return res;
 }
 
+// the game changes the working directory, resolve relative paths while it is
+// still the one the hook was started in. creates the file or directory if it
+// does not exist
+static char *_patch_net_profile_get_abs_path(const char *path, bool is_dir)
+{
+  if (!util_fs_path_exists(path) &&
+      !(is_dir ? util_fs_mkdir(path) : util_fs_mkfile(path))) {
+    log_error("Creating %s %s failed", is_dir ? "directory" : "file", path);
+    return NULL;
+  }
+
+  return util_fs_get_abs_path(path);
+}
+
 // =====================================================================================================================
 
 void patch_net_profile_init(
@@ -569,9 +880,15 @@ void patch_net_profile_init(
     const char *pumpnet_server_addr,
     uint64_t machine_id,
     const char *cert_dir_path,
+    const char *upload_journal_path,
+    const char *cache_dir_path,
+    const char *trace_path,
+    bool compression,
     bool verbose_debug_log)
 {
   uint8_t idx;
+  char token_paths[PUMPNET_MAX_NUM_PLAYERS][128];
+  const char *token_path_ptrs[PUMPNET_MAX_NUM_PLAYERS];
 
   /* use a switch instead of offset'ing the enum for additional safety and block
    * unsupported games */
@@ -625,24 +942,107 @@ void patch_net_profile_init(
       _patch_net_profile_virtual_mnt_points[j].files[i].handle = NULL;
       _patch_net_profile_virtual_mnt_points[j].files[i].file_info = NULL;
       _patch_net_profile_virtual_mnt_points[j].files[i].buffer = NULL;
+      pthread_mutex_init(
+          &_patch_net_profile_virtual_mnt_points[j].files[i].mutex, NULL);
     }
   }
 
+  for (int i = 0; i < PUMPNET_MAX_NUM_PLAYERS; i++) {
+    _patch_net_profile_virtual_mnt_points[i].prefetch = NULL;
+    _patch_net_profile_virtual_mnt_points[i].prefetch_users = 0;
+    _patch_net_profile_virtual_mnt_points[i].open_files = 0;
+    _patch_net_profile_virtual_mnt_points[i].token_change_pending = false;
+    pthread_mutex_init(&_patch_net_profile_virtual_mnt_points[i].mutex, NULL);
+    pthread_cond_init(
+        &_patch_net_profile_virtual_mnt_points[i].cond_prefetch_released,
+        NULL);
+  }
+
+  if (compression) {
+    pumpnet_lib_configure_transport(PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE);
+  }
+
   pumpnet_lib_init(
       game, pumpnet_server_addr, machine_id, cert_dir_path, verbose_debug_log);
 
+  if (upload_journal_path && upload_journal_path[0] != '\0') {
+    char *abs_path =
+        _patch_net_profile_get_abs_path(upload_journal_path, false);
+
+    // not fatal, the game is not blocked as long as the server is reachable
+    if (!abs_path || !pumpnet_lib_init_upload_journal(abs_path)) {
+      log_error(
+          "Enabling upload journal %s failed, uploading synchronously",
+          upload_journal_path);
+    }
+
+    free(abs_path);
+  }
+
+  if (cache_dir_path && cache_dir_path[0] != '\0') {
+    char *abs_path = _patch_net_profile_get_abs_path(cache_dir_path, true);
+
+    // not fatal, profiles are always downloaded then
+    if (!abs_path || !pumpnet_lib_init_profile_cache(abs_path)) {
+      log_error(
+          "Enabling profile cache %s failed, caching disabled",
+          cache_dir_path);
+    }
+
+    free(abs_path);
+  }
+
+  if (trace_path && trace_path[0] != '\0') {
+    if (!pumpnet_lib_init_trace(trace_path)) {
+      log_error("Enabling tracing to %s failed, tracing disabled", trace_path);
+    }
+  }
+
   cnh_filehook_push_handler(_patch_net_profile_filehook);
 
-  pthread_mutex_init(&_patch_net_profile_mutex, NULL);
+  for (int i = 0; i < PUMPNET_MAX_NUM_PLAYERS; i++) {
+    sprintf(token_paths[i], "/mnt/%d/%s", i, PUMPNET_PROFILE_FILE_NAME);
+    token_path_ptrs[i] = token_paths[i];
+  }
+
+  // not fatal, profiles are downloaded once the game opens them
+  _patch_net_profile_token_watcher = pumpnet_lib_profile_token_watcher_start(
+      token_path_ptrs,
+      PUMPNET_MAX_NUM_PLAYERS,
+      PUMPNET_TOKEN_WATCH_POLL_INTERVAL_MS,
+      _patch_net_profile_token_changed,
+      NULL);
+
+  if (!_patch_net_profile_token_watcher) {
+    log_error("Starting token watcher failed, prefetching on open only");
+  }
 
   log_info("Initialized: game %d, server %s", game, pumpnet_server_addr);
 }
 
 void patch_net_profile_shutdown()
 {
+  if (_patch_net_profile_token_watcher) {
+    pumpnet_lib_profile_token_watcher_stop(_patch_net_profile_token_watcher);
+    _patch_net_profile_token_watcher = NULL;
+  }
+
+  for (int i = 0; i < PUMPNET_MAX_NUM_PLAYERS; i++) {
+    _patch_net_profile_drop_prefetch(i);
+  }
+
   pumpnet_lib_shutdown();
 
-  pthread_mutex_destroy(&_patch_net_profile_mutex);
+  for (int i = 0; i < PUMPNET_MAX_NUM_PLAYERS; i++) {
+    for (int j = 0; j < PUMPNET_LIB_FILE_TYPE_COUNT; j++) {
+      pthread_mutex_destroy(
+          &_patch_net_profile_virtual_mnt_points[i].files[j].mutex);
+    }
+
+    pthread_cond_destroy(
+        &_patch_net_profile_virtual_mnt_points[i].cond_prefetch_released);
+    pthread_mutex_destroy(&_patch_net_profile_virtual_mnt_points[i].mutex);
+  }
 
   log_info("Shut down");
 }
\ No newline at end of file
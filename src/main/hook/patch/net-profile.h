@@ -15,6 +15,15 @@
  * @param machine_id Machine ID to use for authentication
  * @param cert_dir_path Path to a directory containing the client cert, client
  * key and CA cert bundle to enable https communication
+ * @param upload_journal_path Path to a journal file to upload profiles
+ * asynchronously, NULL or empty to upload synchronously. Relative to the
+ * current working directory on init
+ * @param cache_dir_path Path to a directory to cache profiles in, NULL or empty
+ * to disable the cache. Relative to the current working directory on init
+ * @param trace_path Path to a file to trace requests to, NULL or empty to
+ * disable tracing
+ * @param compression Compress profile data sent to and received from the
+ * server (deflate), if supported by the server
  * @param verbose_debug_log Enable verbose debug log output, e.g. network
  * backend logging/traffic.
  */
@@ -23,6 +32,10 @@ void patch_net_profile_init(
     const char *pumpnet_server_addr,
     uint64_t machine_id,
     const char *cert_dir_path,
+    const char *upload_journal_path,
+    const char *cache_dir_path,
+    const char *trace_path,
+    bool compression,
     bool verbose_debug_log);
 
 /**
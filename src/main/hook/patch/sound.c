@@ -2,24 +2,405 @@
 
 #include <alsa/asoundlib.h>
 #include <grp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include <sys/types.h>
 
 #include "capnhook/hook/lib.h"
 
 #include "util/log.h"
+#include "util/str.h"
+#include "util/time.h"
+
+#define PATCH_SOUND_PCM_POOL_MAX_SIZE 32
+#define PATCH_SOUND_PCM_POOL_LOG_OPENS 256
 
 typedef int (*snd_pcm_open_t)(
     snd_pcm_t **pcmp, const char *name, snd_pcm_stream_t stream, int mode);
+typedef int (*snd_pcm_close_t)(snd_pcm_t *pcm);
+/* snd_pcm_hw_params_t is taken by alsa */
+typedef int (*snd_pcm_hw_params_func_t)(
+    snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
+typedef int (*snd_pcm_set_params_t)(
+    snd_pcm_t *pcm,
+    snd_pcm_format_t format,
+    snd_pcm_access_t access,
+    unsigned int channels,
+    unsigned int rate,
+    int soft_resample,
+    unsigned int latency);
+
+/* A handle opened by the game which is kept open and configured when the
+   game closes it */
+struct patch_sound_pcm_pool_entry {
+  snd_pcm_t *pcm;
+  char *name;
+  snd_pcm_stream_t stream;
+  int mode;
+  bool in_use;
+  bool configured;
+  snd_pcm_format_t format;
+  unsigned int rate;
+  unsigned int channels;
+};
+
+struct patch_sound_pcm_pool_stats {
+  uint64_t opens;
+  uint64_t hits;
+  uint64_t skipped_configs;
+  uint64_t open_ns;
+  uint64_t checkout_ns;
+};
 
 static snd_pcm_open_t patch_sound_real_snd_pcm_open;
+static snd_pcm_close_t patch_sound_real_snd_pcm_close;
+static snd_pcm_hw_params_func_t patch_sound_real_snd_pcm_hw_params;
+static snd_pcm_set_params_t patch_sound_real_snd_pcm_set_params;
 
 static const char *patch_sound_dev_name;
 
+static uint32_t patch_sound_buffer_time_max_us;
+static uint32_t patch_sound_period_time_max_us;
+
+/* Last logged setup to not spam the log on every sound effect */
+static pthread_mutex_t patch_sound_latency_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static snd_pcm_uframes_t patch_sound_latency_log_buffer_size;
+static snd_pcm_uframes_t patch_sound_latency_log_period_size;
+static unsigned int patch_sound_latency_log_rate;
+
+static pthread_mutex_t patch_sound_pcm_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t patch_sound_pcm_pool_size;
+static struct patch_sound_pcm_pool_entry
+    patch_sound_pcm_pool[PATCH_SOUND_PCM_POOL_MAX_SIZE];
+static struct patch_sound_pcm_pool_stats patch_sound_pcm_pool_stats;
+
+static struct patch_sound_pcm_pool_entry *
+patch_sound_pcm_pool_find(snd_pcm_t *pcm)
+{
+  for (size_t i = 0; i < patch_sound_pcm_pool_size; i++) {
+    if (patch_sound_pcm_pool[i].pcm == pcm) {
+      return &patch_sound_pcm_pool[i];
+    }
+  }
+
+  return NULL;
+}
+
+static bool patch_sound_pcm_pool_checkout(
+    snd_pcm_t **pcmp, const char *name, snd_pcm_stream_t stream, int mode)
+{
+  struct patch_sound_pcm_pool_entry *entry;
+  struct patch_sound_pcm_pool_entry *candidate;
+
+  candidate = NULL;
+
+  pthread_mutex_lock(&patch_sound_pcm_pool_lock);
+
+  for (size_t i = 0; i < patch_sound_pcm_pool_size; i++) {
+    entry = &patch_sound_pcm_pool[i];
+
+    if (entry->pcm && !entry->in_use && entry->stream == stream &&
+        entry->mode == mode && !strcmp(entry->name, name)) {
+      candidate = entry;
+
+      /* Prefer handles that skip configuration */
+      if (entry->configured) {
+        break;
+      }
+    }
+  }
+
+  if (candidate) {
+    candidate->in_use = true;
+    *pcmp = candidate->pcm;
+  }
+
+  pthread_mutex_unlock(&patch_sound_pcm_pool_lock);
+
+  return candidate != NULL;
+}
+
+static void patch_sound_pcm_pool_track(
+    snd_pcm_t *pcm, const char *name, snd_pcm_stream_t stream, int mode)
+{
+  struct patch_sound_pcm_pool_entry *entry;
+
+  pthread_mutex_lock(&patch_sound_pcm_pool_lock);
+
+  /* Pool full, the handle is opened and closed as usual */
+  entry = patch_sound_pcm_pool_find(NULL);
+
+  if (entry) {
+    entry->pcm = pcm;
+    entry->name = util_str_dup(name);
+    entry->stream = stream;
+    entry->mode = mode;
+    entry->in_use = true;
+    entry->configured = false;
+  }
+
+  pthread_mutex_unlock(&patch_sound_pcm_pool_lock);
+}
+
+static bool patch_sound_pcm_pool_return(snd_pcm_t *pcm)
+{
+  struct patch_sound_pcm_pool_entry *entry;
+  int ret;
+
+  pthread_mutex_lock(&patch_sound_pcm_pool_lock);
+  entry = patch_sound_pcm_pool_find(pcm);
+  pthread_mutex_unlock(&patch_sound_pcm_pool_lock);
+
+  if (!entry) {
+    return false;
+  }
+
+  /* Same as closing: stop and discard pending frames. Keep the setup and
+     prepare for the next checkout. The entry stays in use until reset */
+  snd_pcm_drop(pcm);
+  ret = snd_pcm_prepare(pcm);
+
+  pthread_mutex_lock(&patch_sound_pcm_pool_lock);
+
+  if (ret < 0) {
+    log_warn(
+        "Resetting pooled pcm %p failed, closing: %s", pcm, snd_strerror(ret));
+
+    free(entry->name);
+    memset(entry, 0, sizeof(struct patch_sound_pcm_pool_entry));
+  } else {
+    entry->in_use = false;
+  }
+
+  pthread_mutex_unlock(&patch_sound_pcm_pool_lock);
+
+  if (ret < 0) {
+    patch_sound_real_snd_pcm_close(pcm);
+  }
+
+  return true;
+}
+
+static bool patch_sound_pcm_pool_is_configured(
+    snd_pcm_t *pcm,
+    snd_pcm_format_t format,
+    unsigned int rate,
+    unsigned int channels)
+{
+  struct patch_sound_pcm_pool_entry *entry;
+  bool res;
+
+  pthread_mutex_lock(&patch_sound_pcm_pool_lock);
+
+  entry = patch_sound_pcm_pool_find(pcm);
+  res = entry && entry->configured && entry->format == format &&
+      entry->rate == rate && entry->channels == channels;
+
+  if (res) {
+    patch_sound_pcm_pool_stats.skipped_configs++;
+  }
+
+  pthread_mutex_unlock(&patch_sound_pcm_pool_lock);
+
+  return res;
+}
+
+static void patch_sound_pcm_pool_set_configured(
+    snd_pcm_t *pcm,
+    snd_pcm_format_t format,
+    unsigned int rate,
+    unsigned int channels)
+{
+  struct patch_sound_pcm_pool_entry *entry;
+
+  pthread_mutex_lock(&patch_sound_pcm_pool_lock);
+
+  entry = patch_sound_pcm_pool_find(pcm);
+
+  if (entry) {
+    entry->configured = true;
+    entry->format = format;
+    entry->rate = rate;
+    entry->channels = channels;
+  }
+
+  pthread_mutex_unlock(&patch_sound_pcm_pool_lock);
+}
+
+static void patch_sound_pcm_pool_update_stats(bool hit, uint64_t time_ns)
+{
+  struct patch_sound_pcm_pool_stats *stats;
+
+  stats = &patch_sound_pcm_pool_stats;
+
+  pthread_mutex_lock(&patch_sound_pcm_pool_lock);
+
+  stats->opens++;
+
+  if (hit) {
+    stats->hits++;
+    stats->checkout_ns += time_ns;
+  } else {
+    stats->open_ns += time_ns;
+  }
+
+  if (stats->opens % PATCH_SOUND_PCM_POOL_LOG_OPENS == 0) {
+    log_debug(
+        "Opens %llu, pool hits %llu (avg %llu us), misses avg %llu us, "
+        "skipped configurations %llu",
+        stats->opens,
+        stats->hits,
+        stats->hits > 0 ? stats->checkout_ns / stats->hits / 1000 : 0,
+        stats->opens > stats->hits ?
+            stats->open_ns / (stats->opens - stats->hits) / 1000 :
+            0,
+        stats->skipped_configs);
+  }
+
+  pthread_mutex_unlock(&patch_sound_pcm_pool_lock);
+}
+
+static bool patch_sound_latency_requires_clamp(
+    const snd_pcm_hw_params_t *params,
+    unsigned int *buffer_time_us,
+    unsigned int *period_time_us)
+{
+  unsigned int requested;
+  bool clamp;
+
+  clamp = false;
+
+  /* Not set by the game (yet), alsa picks the max buffer time by default */
+  if (snd_pcm_hw_params_get_buffer_time(params, &requested, NULL) < 0) {
+    requested = UINT32_MAX;
+  }
+
+  *buffer_time_us = requested;
+
+  if (patch_sound_buffer_time_max_us > 0 &&
+      requested > patch_sound_buffer_time_max_us) {
+    *buffer_time_us = patch_sound_buffer_time_max_us;
+    clamp = true;
+  }
+
+  if (snd_pcm_hw_params_get_period_time(params, &requested, NULL) < 0) {
+    requested = UINT32_MAX;
+  }
+
+  *period_time_us = requested;
+
+  if (patch_sound_period_time_max_us > 0 &&
+      requested > patch_sound_period_time_max_us) {
+    *period_time_us = patch_sound_period_time_max_us;
+    clamp = true;
+  }
+
+  /* At least two periods per buffer */
+  if (clamp && *period_time_us > *buffer_time_us / 2) {
+    *period_time_us = *buffer_time_us / 2;
+  }
+
+  return clamp;
+}
+
+static void
+patch_sound_latency_clamp(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+  snd_pcm_hw_params_t *clamped;
+  snd_pcm_access_t access;
+  snd_pcm_format_t format;
+  unsigned int channels;
+  unsigned int rate;
+  unsigned int rate_resample;
+  unsigned int buffer_time_us;
+  unsigned int period_time_us;
+
+  if (!patch_sound_latency_requires_clamp(
+          params, &buffer_time_us, &period_time_us)) {
+    return;
+  }
+
+  /* The game's request narrowed the configuration space already, e.g. with
+     snd_pcm_hw_params_set_buffer_time_near. Rebuild it from scratch with the
+     game's sample format and the clamped sizes */
+  if (snd_pcm_hw_params_get_access(params, &access) < 0 ||
+      snd_pcm_hw_params_get_format(params, &format) < 0 ||
+      snd_pcm_hw_params_get_channels(params, &channels) < 0 ||
+      snd_pcm_hw_params_get_rate(params, &rate, NULL) < 0 ||
+      snd_pcm_hw_params_get_rate_resample(pcm, params, &rate_resample) < 0) {
+    log_warn("Sample format of pcm %p not fully specified, not clamping", pcm);
+    return;
+  }
+
+  snd_pcm_hw_params_alloca(&clamped);
+
+  if (snd_pcm_hw_params_any(pcm, clamped) < 0 ||
+      snd_pcm_hw_params_set_rate_resample(pcm, clamped, rate_resample) < 0 ||
+      snd_pcm_hw_params_set_access(pcm, clamped, access) < 0 ||
+      snd_pcm_hw_params_set_format(pcm, clamped, format) < 0 ||
+      snd_pcm_hw_params_set_channels(pcm, clamped, channels) < 0 ||
+      snd_pcm_hw_params_set_rate(pcm, clamped, rate, 0) < 0 ||
+      snd_pcm_hw_params_set_buffer_time_near(
+          pcm, clamped, &buffer_time_us, NULL) < 0 ||
+      snd_pcm_hw_params_set_period_time_near(
+          pcm, clamped, &period_time_us, NULL) < 0) {
+    log_warn(
+        "Clamping buffer time %d us, period time %d us not supported by pcm "
+        "%p, using game's setup",
+        buffer_time_us,
+        period_time_us,
+        pcm);
+    return;
+  }
+
+  snd_pcm_hw_params_copy(params, clamped);
+}
+
+static void patch_sound_latency_log(const snd_pcm_hw_params_t *params)
+{
+  snd_pcm_uframes_t buffer_size;
+  snd_pcm_uframes_t period_size;
+  unsigned int rate;
+  bool changed;
+
+  if (snd_pcm_hw_params_get_buffer_size(params, &buffer_size) < 0 ||
+      snd_pcm_hw_params_get_period_size(params, &period_size, NULL) < 0 ||
+      snd_pcm_hw_params_get_rate(params, &rate, NULL) < 0 || rate == 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&patch_sound_latency_log_lock);
+
+  changed = buffer_size != patch_sound_latency_log_buffer_size ||
+      period_size != patch_sound_latency_log_period_size ||
+      rate != patch_sound_latency_log_rate;
+
+  patch_sound_latency_log_buffer_size = buffer_size;
+  patch_sound_latency_log_period_size = period_size;
+  patch_sound_latency_log_rate = rate;
+
+  pthread_mutex_unlock(&patch_sound_latency_log_lock);
+
+  if (changed) {
+    log_info(
+        "Effective latency: buffer %lu frames (%llu us), period %lu frames "
+        "(%llu us), rate %d",
+        buffer_size,
+        (uint64_t) buffer_size * 1000 * 1000 / rate,
+        period_size,
+        (uint64_t) period_size * 1000 * 1000 / rate,
+        rate);
+  }
+}
+
 int snd_pcm_open(
     snd_pcm_t **pcmp, const char *name, snd_pcm_stream_t stream, int mode)
 {
   int ret = 0;
   int retry_count = 5;
+  uint64_t start_ns;
 
   log_debug("snd_pcm_open: %s, stream %d, mode %d", name, stream, mode);
 
@@ -35,6 +416,16 @@ int snd_pcm_open(
     name = patch_sound_dev_name;
   }
 
+  start_ns = util_time_get_monotonic_ns();
+
+  if (patch_sound_pcm_pool_size > 0 &&
+      patch_sound_pcm_pool_checkout(pcmp, name, stream, mode)) {
+    patch_sound_pcm_pool_update_stats(
+        true, util_time_get_monotonic_ns() - start_ns);
+
+    return 0;
+  }
+
   /*
      Notes about exceed and how it fucked up using alsa:
      - Opening the same (hw:0) device multiple times without closing
@@ -56,6 +447,116 @@ int snd_pcm_open(
 
   if (ret < 0) {
     log_error("snd_pcm_open failed: %s", snd_strerror(ret));
+  } else if (patch_sound_pcm_pool_size > 0) {
+    patch_sound_pcm_pool_track(*pcmp, name, stream, mode);
+    patch_sound_pcm_pool_update_stats(
+        false, util_time_get_monotonic_ns() - start_ns);
+  }
+
+  return ret;
+}
+
+int snd_pcm_close(snd_pcm_t *pcm)
+{
+  if (!patch_sound_real_snd_pcm_close) {
+    patch_sound_real_snd_pcm_close =
+        (snd_pcm_close_t) cnh_lib_get_func_addr("snd_pcm_close");
+  }
+
+  if (patch_sound_pcm_pool_size > 0 && pcm &&
+      patch_sound_pcm_pool_return(pcm)) {
+    return 0;
+  }
+
+  return patch_sound_real_snd_pcm_close(pcm);
+}
+
+int snd_pcm_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+  snd_pcm_format_t format;
+  unsigned int rate;
+  unsigned int channels;
+  bool pooled;
+  int ret;
+
+  if (!patch_sound_real_snd_pcm_hw_params) {
+    patch_sound_real_snd_pcm_hw_params =
+        (snd_pcm_hw_params_func_t) cnh_lib_get_func_addr("snd_pcm_hw_params");
+  }
+
+  if (!pcm || !params) {
+    return patch_sound_real_snd_pcm_hw_params(pcm, params);
+  }
+
+  /* Not fully specified, let alsa choose */
+  if (snd_pcm_hw_params_get_format(params, &format) < 0 ||
+      snd_pcm_hw_params_get_rate(params, &rate, NULL) < 0 ||
+      snd_pcm_hw_params_get_channels(params, &channels) < 0) {
+    pooled = false;
+  } else {
+    pooled = patch_sound_pcm_pool_size > 0;
+  }
+
+  if (pooled &&
+      patch_sound_pcm_pool_is_configured(pcm, format, rate, channels)) {
+    /* Return the actual setup like a real call, the game might query it */
+    return snd_pcm_hw_params_current(pcm, params);
+  }
+
+  if (patch_sound_buffer_time_max_us > 0 ||
+      patch_sound_period_time_max_us > 0) {
+    patch_sound_latency_clamp(pcm, params);
+  }
+
+  ret = patch_sound_real_snd_pcm_hw_params(pcm, params);
+
+  if (ret == 0) {
+    patch_sound_latency_log(params);
+
+    if (pooled) {
+      patch_sound_pcm_pool_set_configured(pcm, format, rate, channels);
+    }
+  }
+
+  return ret;
+}
+
+int snd_pcm_set_params(
+    snd_pcm_t *pcm,
+    snd_pcm_format_t format,
+    snd_pcm_access_t access,
+    unsigned int channels,
+    unsigned int rate,
+    int soft_resample,
+    unsigned int latency)
+{
+  int ret;
+
+  if (!patch_sound_real_snd_pcm_set_params) {
+    patch_sound_real_snd_pcm_set_params =
+        (snd_pcm_set_params_t) cnh_lib_get_func_addr("snd_pcm_set_params");
+  }
+
+  if (patch_sound_pcm_pool_size > 0 && pcm &&
+      patch_sound_pcm_pool_is_configured(pcm, format, rate, channels)) {
+    return 0;
+  }
+
+  /* Latency is the buffer time */
+  if (patch_sound_buffer_time_max_us > 0 &&
+      latency > patch_sound_buffer_time_max_us) {
+    log_debug(
+        "Clamping latency %d us to %d us",
+        latency,
+        patch_sound_buffer_time_max_us);
+    latency = patch_sound_buffer_time_max_us;
+  }
+
+  ret = patch_sound_real_snd_pcm_set_params(
+      pcm, format, access, channels, rate, soft_resample, latency);
+
+  if (ret == 0 && patch_sound_pcm_pool_size > 0 && pcm) {
+    patch_sound_pcm_pool_set_configured(pcm, format, rate, channels);
   }
 
   return ret;
@@ -66,4 +567,31 @@ void patch_sound_init(const char *dev_name)
   patch_sound_dev_name = dev_name;
 
   log_info("Initialized");
-}
\ No newline at end of file
+}
+
+void patch_sound_latency_init(
+    uint32_t buffer_time_max_us, uint32_t period_time_max_us)
+{
+  patch_sound_buffer_time_max_us = buffer_time_max_us;
+  patch_sound_period_time_max_us = period_time_max_us;
+
+  log_info(
+      "Clamping buffer time to max %d us, period time to max %d us",
+      buffer_time_max_us,
+      period_time_max_us);
+}
+
+void patch_sound_pcm_pool_init(size_t size)
+{
+  if (size > PATCH_SOUND_PCM_POOL_MAX_SIZE) {
+    log_warn(
+        "PCM pool size %d exceeds max %d, limiting",
+        size,
+        PATCH_SOUND_PCM_POOL_MAX_SIZE);
+    size = PATCH_SOUND_PCM_POOL_MAX_SIZE;
+  }
+
+  patch_sound_pcm_pool_size = size;
+
+  log_info("PCM handle pool enabled, size %d", size);
+}
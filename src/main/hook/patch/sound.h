@@ -1,10 +1,21 @@
 /**
  * Patch the sound device to open for sound output. Allows us to use a
  * different device than hw:0 (e.g. HDMI sound output)
+ *
+ * Optionally, keep the PCM handles the game opens in a pool. Exceed era
+ * engines open and close a PCM for every sound effect which pays the full cost
+ * of opening and configuring the device each time.
+ *
+ * Furthermore, optionally clamp the buffer and period sizes the games request
+ * which are tuned for hardware of their time, often resulting in more than
+ * 100 ms of audio latency.
  */
 #ifndef PATCH_SOUND_H
 #define PATCH_SOUND_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /**
  * Initialize the patch module
  *
@@ -12,4 +23,26 @@
  */
 void patch_sound_init(const char *dev_name);
 
+/**
+ * Clamp the buffer and period time of any PCM the game configures. Applied
+ * when the game sets its hw params, i.e. covers any of the
+ * snd_pcm_hw_params_set_*_near calls as well as snd_pcm_set_params. The
+ * effective latency is logged
+ *
+ * @param buffer_time_max_us Max buffer time in us, 0 to not clamp
+ * @param period_time_max_us Max period time in us, 0 to not clamp
+ */
+void patch_sound_latency_init(
+    uint32_t buffer_time_max_us, uint32_t period_time_max_us);
+
+/**
+ * Enable the PCM handle pool. Closing a handle resets it (drop and prepare)
+ * and keeps it open and configured. Opening the same device again checks out
+ * a pooled handle. Configuring it again (hw params) with the same format, rate
+ * and channels is skipped
+ *
+ * @param size Max number of handles to keep in the pool
+ */
+void patch_sound_pcm_pool_init(size_t size);
+
 #endif
\ No newline at end of file
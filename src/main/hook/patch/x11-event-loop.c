@@ -1,9 +1,15 @@
 #define LOG_MODULE "patch-x11-event-loop"
 
 #include <X11/Xutil.h>
+#include <errno.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #include "capnhook/hook/lib.h"
 
@@ -11,13 +17,13 @@
 
 #include "util/log.h"
 #include "util/mem.h"
-#include "util/time.h"
 
 struct patch_x11_event_loop_ctx {
   Display *display;
   Window window;
   pthread_t thread;
   atomic_int run;
+  int shutdown_fd;
 };
 
 typedef Window (*XCreateWindow_t)(
@@ -69,95 +75,147 @@ patch_x11_event_loop_is_key_repeated(Display *display, XEvent *event)
   return false;
 }
 
+static void patch_x11_event_loop_process_event(Display *display, XEvent *event)
+{
+  KeySym key;
+
+  switch (event->type) {
+    case KeyPress: {
+      /* Mask out the modifier states X11 sets and read again */
+      event->xkey.state &= ~ShiftMask;
+      event->xkey.state &= ~LockMask;
+
+      XLookupString(&event->xkey, 0, 0, &key, 0);
+
+      /* Dispatch to external input handlers */
+      if (patch_x11_event_loop_num_input_handlers > 0) {
+        pthread_mutex_lock(&patch_x11_event_loop_input_handlers_lock);
+
+        for (size_t i = 0; i < patch_x11_event_loop_num_input_handlers; i++) {
+          if (patch_x11_event_loop_input_handlers[i]->dispatch_key_press) {
+            patch_x11_event_loop_input_handlers[i]->dispatch_key_press(key);
+          }
+        }
+
+        pthread_mutex_unlock(&patch_x11_event_loop_input_handlers_lock);
+      }
+
+      break;
+    }
+
+    case KeyRelease: {
+      /* Mask out the modifier states X11 sets and read again */
+      event->xkey.state &= ~ShiftMask;
+      event->xkey.state &= ~LockMask;
+
+      XLookupString(&event->xkey, 0, 0, &key, 0);
+
+      /* Dispatch to external input handlers */
+      if (patch_x11_event_loop_num_input_handlers > 0) {
+        /* Dispatch release if key is not repeated */
+        if (!patch_x11_event_loop_is_key_repeated(display, event)) {
+          pthread_mutex_lock(&patch_x11_event_loop_input_handlers_lock);
+
+          for (size_t i = 0; i < patch_x11_event_loop_num_input_handlers;
+               i++) {
+            if (patch_x11_event_loop_input_handlers[i]->dispatch_key_release) {
+              patch_x11_event_loop_input_handlers[i]->dispatch_key_release(
+                  key);
+            }
+          }
+
+          pthread_mutex_unlock(&patch_x11_event_loop_input_handlers_lock);
+        }
+      }
+
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
 static void *patch_x11_event_loop_run(void *args)
 {
+  Display *display;
+  struct pollfd fds[2];
+
   log_info("Running X11 event loop thread");
 
   struct patch_x11_event_loop_ctx *ctx =
       (struct patch_x11_event_loop_ctx *) args;
 
-  if (XSelectInput(ctx->display, ctx->window, KeyPressMask | KeyReleaseMask) ==
+  /* Use a dedicated connection to the X server for the event loop. The X11
+     server delivers the selected events of the game's window to this
+     connection only. Nobody else reads from its socket which makes it safe
+     to block on it. Blocking on the game's connection can miss events that
+     were already read into Xlib's queue by another thread of the game */
+  if (!patch_x11_event_loop_real_XOpenDisplay) {
+    patch_x11_event_loop_real_XOpenDisplay =
+        (XOpenDisplay_t) cnh_lib_get_func_addr("XOpenDisplay");
+  }
+
+  display = patch_x11_event_loop_real_XOpenDisplay(
+      DisplayString(ctx->display));
+
+  if (!display) {
+    log_error("Opening X11 event loop display connection failed");
+    return NULL;
+  }
+
+  if (XSelectInput(display, ctx->window, KeyPressMask | KeyReleaseMask) ==
       BadWindow) {
     log_error("XSelectInput failed");
+    XCloseDisplay(display);
     return NULL;
   }
 
   XGrabKeyboard(
-      ctx->display, ctx->window, 1, GrabModeAsync, GrabModeAsync, CurrentTime);
+      display, ctx->window, 1, GrabModeAsync, GrabModeAsync, CurrentTime);
+
+  fds[0].fd = ConnectionNumber(display);
+  fds[0].events = POLLIN;
+  fds[1].fd = ctx->shutdown_fd;
+  fds[1].events = POLLIN;
 
   while (atomic_load(&ctx->run) > 0) {
-    while (atomic_load(&ctx->run) > 0 && XPending(ctx->display) > 0) {
+    /* Flushes outstanding requests and drains everything that is available
+       without blocking */
+    while (atomic_load(&ctx->run) > 0 && XPending(display) > 0) {
       XEvent event;
-      KeySym key;
 
-      if (XNextEvent(ctx->display, &event) != Success) {
+      if (XNextEvent(display, &event) != Success) {
         log_error("XNextEvent");
         continue;
       }
 
-      switch (event.type) {
-        case KeyPress: {
-          /* Mask out the modifier states X11 sets and read again */
-          event.xkey.state &= ~ShiftMask;
-          event.xkey.state &= ~LockMask;
-
-          XLookupString(&event.xkey, 0, 0, &key, 0);
-
-          /* Dispatch to external input handlers */
-          if (patch_x11_event_loop_num_input_handlers > 0) {
-            pthread_mutex_lock(&patch_x11_event_loop_input_handlers_lock);
-
-            for (size_t i = 0; i < patch_x11_event_loop_num_input_handlers;
-                 i++) {
-              if (patch_x11_event_loop_input_handlers[i]->dispatch_key_press) {
-                patch_x11_event_loop_input_handlers[i]->dispatch_key_press(key);
-              }
-            }
-
-            pthread_mutex_unlock(&patch_x11_event_loop_input_handlers_lock);
-          }
-
-          break;
-        }
+      patch_x11_event_loop_process_event(display, &event);
+    }
 
-        case KeyRelease: {
-          /* Mask out the modifier states X11 sets and read again */
-          event.xkey.state &= ~ShiftMask;
-          event.xkey.state &= ~LockMask;
-
-          XLookupString(&event.xkey, 0, 0, &key, 0);
-
-          /* Dispatch to external input handlers */
-          if (patch_x11_event_loop_num_input_handlers > 0) {
-            /* Dispatch release if key is not repeated */
-            if (!patch_x11_event_loop_is_key_repeated(ctx->display, &event)) {
-              pthread_mutex_lock(&patch_x11_event_loop_input_handlers_lock);
-
-              for (size_t i = 0; i < patch_x11_event_loop_num_input_handlers;
-                   i++) {
-                if (patch_x11_event_loop_input_handlers[i]
-                        ->dispatch_key_release) {
-                  patch_x11_event_loop_input_handlers[i]->dispatch_key_release(
-                      key);
-                }
-              }
-
-              pthread_mutex_unlock(&patch_x11_event_loop_input_handlers_lock);
-            }
-          }
+    /* Sleep until the X server sends something or shutdown is signaled */
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
 
-          break;
-        }
+      log_error("Polling X11 connection failed: %s", strerror(errno));
+      break;
+    }
 
-        default:
-          break;
-      }
+    if (fds[1].revents & POLLIN) {
+      break;
     }
 
-    // Avoid CPU banging
-    util_time_sleep_ms(1);
+    if (fds[0].revents & (POLLERR | POLLHUP)) {
+      log_error("X11 connection closed");
+      break;
+    }
   }
 
+  XUngrabKeyboard(display, CurrentTime);
+  XCloseDisplay(display);
+
   log_info("Finished X11 event loop thread");
 
   return NULL;
@@ -234,6 +292,11 @@ Window XCreateWindow(
     patch_x11_event_loop_ctx->display = display;
     patch_x11_event_loop_ctx->window = w;
     patch_x11_event_loop_ctx->run = ATOMIC_VAR_INIT(1);
+    patch_x11_event_loop_ctx->shutdown_fd = eventfd(0, EFD_CLOEXEC);
+
+    if (patch_x11_event_loop_ctx->shutdown_fd < 0) {
+      log_die("Creating eventfd for X11 event loop failed");
+    }
 
     pthread_create(
         &patch_x11_event_loop_ctx->thread,
@@ -257,8 +320,18 @@ int XDestroyWindow(Display *display, Window w)
   if (patch_x11_event_loop_enabled && patch_x11_event_loop_ctx) {
     log_debug("Stopping X11 event loop thread...");
 
+    uint64_t signal = 1;
+
     atomic_store(&patch_x11_event_loop_ctx->run, 0);
+
+    /* Wake up the thread blocking in poll */
+    if (write(patch_x11_event_loop_ctx->shutdown_fd, &signal, sizeof(signal)) !=
+        sizeof(signal)) {
+      log_error("Signaling X11 event loop shutdown failed");
+    }
+
     pthread_join(patch_x11_event_loop_ctx->thread, NULL);
+    close(patch_x11_event_loop_ctx->shutdown_fd);
     free(patch_x11_event_loop_ctx);
     patch_x11_event_loop_ctx = NULL;
 
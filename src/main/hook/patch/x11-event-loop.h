@@ -6,6 +6,10 @@
  * keyboard button presses and releases. This is required for Pro 1/2 because
  * the game has all X11 input handling removed. Therefore, we cannot use any
  * ptapi io implementations using X11, e.g. keyboard inputs.
+ *
+ * The loop runs on a separate thread with its own connection to the X server
+ * and blocks until events arrive (or the window is destroyed), i.e. it does
+ * not consume any CPU time while idle.
  */
 void patch_x11_event_loop_init();
 
@@ -10,6 +10,8 @@
 
 #include "hook/core/piu-utils.h"
 
+#include "hook/patch/alarm-timer.h"
+#include "hook/patch/gfx-frame-time.h"
 #include "hook/patch/gfx.h"
 #include "hook/patch/hook-mon.h"
 #include "hook/patch/main-loop.h"
@@ -143,7 +145,20 @@ static void x2hook_patch_gfx_init(struct x2hook_options *options)
   patch_gfx_init();
 
   if (options->patch.gfx.scaling_mode != PATCH_GFX_SCALE_MODE_INVALID) {
-    patch_gfx_scale(options->patch.gfx.scaling_mode);
+    patch_gfx_scale(
+        options->patch.gfx.scaling_mode, options->patch.gfx.scaling_filter);
+  }
+
+  if (options->patch.gfx.swap_interval >= 0) {
+    patch_gfx_force_swap_interval(options->patch.gfx.swap_interval);
+  }
+
+  if (options->patch.gfx.frame_stats_interval > 0) {
+    patch_gfx_frame_time_init(options->patch.gfx.frame_stats_interval);
+  }
+
+  if (options->patch.gfx.frame_limit > 0) {
+    patch_gfx_frame_time_limit_init(options->patch.gfx.frame_limit);
   }
 }
 
@@ -165,7 +180,13 @@ static void x2hook_patch_main_loop_init(struct x2hook_options *options)
   log_assert(options);
 
   patch_main_loop_init(
-      true, options->patch.main_loop.disable_built_in_inputs, false);
+      !options->patch.main_loop.alarm_timer,
+      options->patch.main_loop.disable_built_in_inputs,
+      false);
+
+  if (options->patch.main_loop.alarm_timer) {
+    patch_alarm_timer_init();
+  }
 
   if (options->patch.main_loop.x11_input_handler_api_lib) {
     char *abs_path_x11_input_hook_lib = util_fs_get_abs_path(
@@ -181,6 +202,17 @@ static void x2hook_patch_sound_init(struct x2hook_options *options)
   log_assert(options);
 
   patch_sound_init(options->patch.sound.device);
+
+  if (options->patch.sound.buffer_time_max_us > 0 ||
+      options->patch.sound.period_time_max_us > 0) {
+    patch_sound_latency_init(
+        options->patch.sound.buffer_time_max_us,
+        options->patch.sound.period_time_max_us);
+  }
+
+  if (options->patch.sound.pcm_pool_size > 0) {
+    patch_sound_pcm_pool_init(options->patch.sound.pcm_pool_size);
+  }
 }
 
 static void x2hook_patch_sigsegv_init(struct x2hook_options *options)
@@ -254,6 +286,7 @@ void x2hook_trap_before_main(int argc, char **argv)
 
 void x2hook_trap_after_main(void)
 {
+  patch_gfx_frame_time_shutdown();
   patch_piuio_shutdown();
 }
 
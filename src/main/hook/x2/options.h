@@ -15,6 +15,10 @@ struct x2hook_options {
   struct patch {
     struct gfx {
       uint8_t scaling_mode;
+      uint8_t scaling_filter;
+      uint32_t frame_stats_interval;
+      int swap_interval;
+      uint32_t frame_limit;
     } gfx;
 
     struct hook_mon {
@@ -28,6 +32,7 @@ struct x2hook_options {
     struct main_loop {
       bool disable_built_in_inputs;
       const char *x11_input_handler_api_lib;
+      bool alarm_timer;
     } main_loop;
 
     struct piuio {
@@ -37,6 +42,9 @@ struct x2hook_options {
 
     struct sound {
       const char *device;
+      uint32_t buffer_time_max_us;
+      uint32_t period_time_max_us;
+      uint8_t pcm_pool_size;
     } sound;
 
     struct sigsegv {
@@ -0,0 +1,246 @@
+#define LOG_MODULE "ptapi-io-piuio-record-util"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ptapi/io/piuio/record-util/record.h"
+
+#include "util/fs.h"
+#include "util/log.h"
+#include "util/mem.h"
+#include "util/str.h"
+#include "util/time.h"
+
+#define PTAPI_IO_PIUIO_RECORD_UTIL_SENSORS 5
+#define PTAPI_IO_PIUIO_RECORD_UTIL_SYS_BIT_OFFSET \
+  (2 * PTAPI_IO_PIUIO_SENSOR_GROUP_NUM * PTAPI_IO_PIUIO_RECORD_UTIL_SENSORS)
+
+static void _ptapi_io_piuio_record_util_set_bit(
+    uint8_t *packed, uint32_t bit, bool value)
+{
+  if (value) {
+    packed[bit / 8] |= (uint8_t) (1 << (bit % 8));
+  }
+}
+
+static bool
+_ptapi_io_piuio_record_util_get_bit(const uint8_t *packed, uint32_t bit)
+{
+  return (packed[bit / 8] >> (bit % 8)) & 1;
+}
+
+bool ptapi_io_piuio_record_util_conf_load(
+    const char *path, struct ptapi_io_piuio_record_util_conf *conf)
+{
+  log_assert(path);
+  log_assert(conf);
+
+  char *buffer;
+  size_t size;
+  char **lines;
+  size_t line_count;
+
+  memset(conf, 0, sizeof(struct ptapi_io_piuio_record_util_conf));
+
+  util_str_cpy(
+      conf->lib_path, sizeof(conf->lib_path), "./ptapi-io-piuio-null.so");
+  util_str_cpy(
+      conf->record_path, sizeof(conf->record_path), "./piuio-record.bin");
+  conf->loop = false;
+
+  if (!util_file_load(path, (void **) &buffer, &size, true)) {
+    log_error("Loading record config file %s failed", path);
+    return false;
+  }
+
+  lines = util_str_split(buffer, "\n", &line_count);
+  free(buffer);
+
+  for (size_t i = 0; i < line_count; i++) {
+    char *sep;
+
+    util_str_trim(lines[i]);
+
+    if (lines[i][0] == '\0' || lines[i][0] == '#') {
+      continue;
+    }
+
+    sep = strchr(lines[i], '=');
+
+    if (!sep) {
+      log_warn("Invalid config line, missing '=': %s", lines[i]);
+      continue;
+    }
+
+    *sep = '\0';
+
+    if (!strcmp(lines[i], "lib")) {
+      util_str_cpy(conf->lib_path, sizeof(conf->lib_path), sep + 1);
+    } else if (!strcmp(lines[i], "file")) {
+      util_str_cpy(conf->record_path, sizeof(conf->record_path), sep + 1);
+    } else if (!strcmp(lines[i], "loop")) {
+      conf->loop = !strcmp(sep + 1, "1") || !strcmp(sep + 1, "true");
+    } else {
+      log_warn("Unknown config key: %s", lines[i]);
+    }
+  }
+
+  util_str_free_split(lines, line_count);
+
+  return true;
+}
+
+void ptapi_io_piuio_record_util_state_pack(
+    const struct ptapi_io_piuio_record_util_state *state, uint8_t *packed)
+{
+  uint32_t bit;
+
+  memset(packed, 0, PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE);
+
+  bit = 0;
+
+  for (uint8_t player = 0; player < 2; player++) {
+    for (uint8_t group = 0; group < PTAPI_IO_PIUIO_SENSOR_GROUP_NUM; group++) {
+      const struct ptapi_io_piuio_pad_inputs *pad = &state->pad[player][group];
+
+      _ptapi_io_piuio_record_util_set_bit(packed, bit++, pad->lu);
+      _ptapi_io_piuio_record_util_set_bit(packed, bit++, pad->ru);
+      _ptapi_io_piuio_record_util_set_bit(packed, bit++, pad->cn);
+      _ptapi_io_piuio_record_util_set_bit(packed, bit++, pad->ld);
+      _ptapi_io_piuio_record_util_set_bit(packed, bit++, pad->rd);
+    }
+  }
+
+  bit = PTAPI_IO_PIUIO_RECORD_UTIL_SYS_BIT_OFFSET;
+
+  _ptapi_io_piuio_record_util_set_bit(packed, bit++, state->sys.test);
+  _ptapi_io_piuio_record_util_set_bit(packed, bit++, state->sys.service);
+  _ptapi_io_piuio_record_util_set_bit(packed, bit++, state->sys.clear);
+  _ptapi_io_piuio_record_util_set_bit(packed, bit++, state->sys.coin);
+  _ptapi_io_piuio_record_util_set_bit(packed, bit++, state->sys.coin2);
+}
+
+void ptapi_io_piuio_record_util_state_unpack(
+    const uint8_t *packed, struct ptapi_io_piuio_record_util_state *state)
+{
+  uint32_t bit;
+
+  bit = 0;
+
+  for (uint8_t player = 0; player < 2; player++) {
+    for (uint8_t group = 0; group < PTAPI_IO_PIUIO_SENSOR_GROUP_NUM; group++) {
+      struct ptapi_io_piuio_pad_inputs *pad = &state->pad[player][group];
+
+      pad->lu = _ptapi_io_piuio_record_util_get_bit(packed, bit++);
+      pad->ru = _ptapi_io_piuio_record_util_get_bit(packed, bit++);
+      pad->cn = _ptapi_io_piuio_record_util_get_bit(packed, bit++);
+      pad->ld = _ptapi_io_piuio_record_util_get_bit(packed, bit++);
+      pad->rd = _ptapi_io_piuio_record_util_get_bit(packed, bit++);
+    }
+  }
+
+  bit = PTAPI_IO_PIUIO_RECORD_UTIL_SYS_BIT_OFFSET;
+
+  state->sys.test = _ptapi_io_piuio_record_util_get_bit(packed, bit++);
+  state->sys.service = _ptapi_io_piuio_record_util_get_bit(packed, bit++);
+  state->sys.clear = _ptapi_io_piuio_record_util_get_bit(packed, bit++);
+  state->sys.coin = _ptapi_io_piuio_record_util_get_bit(packed, bit++);
+  state->sys.coin2 = _ptapi_io_piuio_record_util_get_bit(packed, bit++);
+}
+
+uint64_t ptapi_io_piuio_record_util_time_now_us(void)
+{
+  return util_time_get_monotonic_ns() / 1000;
+}
+
+FILE *ptapi_io_piuio_record_util_file_create(const char *path)
+{
+  log_assert(path);
+
+  FILE *file;
+  struct ptapi_io_piuio_record_util_header header;
+
+  file = fopen(path, "wb");
+
+  if (!file) {
+    log_error("Opening record file %s for writing failed", path);
+    return NULL;
+  }
+
+  memcpy(header.magic, PTAPI_IO_PIUIO_RECORD_UTIL_MAGIC, sizeof(header.magic));
+  header.version = PTAPI_IO_PIUIO_RECORD_UTIL_VERSION;
+
+  if (fwrite(&header, sizeof(header), 1, file) != 1) {
+    log_error("Writing header to record file %s failed", path);
+    fclose(file);
+    return NULL;
+  }
+
+  return file;
+}
+
+bool ptapi_io_piuio_record_util_file_load(
+    const char *path,
+    struct ptapi_io_piuio_record_util_entry **entries,
+    size_t *count)
+{
+  log_assert(path);
+  log_assert(entries);
+  log_assert(count);
+
+  uint8_t *buffer;
+  size_t size;
+  struct ptapi_io_piuio_record_util_header *header;
+  size_t payload_size;
+
+  if (!util_file_load(path, (void **) &buffer, &size, false)) {
+    log_error("Loading record file %s failed", path);
+    return false;
+  }
+
+  header = (struct ptapi_io_piuio_record_util_header *) buffer;
+
+  if (size < sizeof(struct ptapi_io_piuio_record_util_header) ||
+      memcmp(
+          header->magic,
+          PTAPI_IO_PIUIO_RECORD_UTIL_MAGIC,
+          sizeof(header->magic)) != 0) {
+    log_error("Invalid record file %s, bad magic", path);
+    free(buffer);
+    return false;
+  }
+
+  if (header->version != PTAPI_IO_PIUIO_RECORD_UTIL_VERSION) {
+    log_error(
+        "Unsupported record file version %d in %s", header->version, path);
+    free(buffer);
+    return false;
+  }
+
+  payload_size = size - sizeof(struct ptapi_io_piuio_record_util_header);
+
+  if (payload_size % sizeof(struct ptapi_io_piuio_record_util_entry) != 0) {
+    log_warn("Record file %s truncated, ignoring trailing partial entry", path);
+  }
+
+  *count = payload_size / sizeof(struct ptapi_io_piuio_record_util_entry);
+
+  if (*count == 0) {
+    log_error("Record file %s does not contain any entries", path);
+    free(buffer);
+    return false;
+  }
+
+  *entries =
+      util_xmalloc(*count * sizeof(struct ptapi_io_piuio_record_util_entry));
+
+  memcpy(
+      *entries,
+      buffer + sizeof(struct ptapi_io_piuio_record_util_header),
+      *count * sizeof(struct ptapi_io_piuio_record_util_entry));
+
+  free(buffer);
+
+  return true;
+}
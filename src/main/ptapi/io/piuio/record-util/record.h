@@ -0,0 +1,100 @@
+#ifndef PTAPI_IO_PIUIO_RECORD_UTIL_RECORD_H
+#define PTAPI_IO_PIUIO_RECORD_UTIL_RECORD_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ptapi/io/piuio.h"
+
+#define PTAPI_IO_PIUIO_RECORD_UTIL_MAGIC "PIUREC"
+#define PTAPI_IO_PIUIO_RECORD_UTIL_VERSION 1
+#define PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE 6
+
+/**
+ * Header at the start of every record file
+ */
+struct ptapi_io_piuio_record_util_header {
+  char magic[6];
+  uint16_t version;
+} __attribute__((__packed__));
+
+/**
+ * Single input state change. The delta is relative to the previous entry (or
+ * the start of the recording for the first entry). 2 players x 4 sensor
+ * groups x 5 sensors + 5 sys inputs = 45 bits packed into the state field.
+ */
+struct ptapi_io_piuio_record_util_entry {
+  uint32_t delta_us;
+  uint8_t state[PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE];
+} __attribute__((__packed__));
+
+/**
+ * Unpacked input state of all players, sensor groups and sys inputs
+ */
+struct ptapi_io_piuio_record_util_state {
+  struct ptapi_io_piuio_pad_inputs pad[2][PTAPI_IO_PIUIO_SENSOR_GROUP_NUM];
+  struct ptapi_io_piuio_sys_inputs sys;
+};
+
+/**
+ * Configuration shared by the record and replay backends. Read from a text
+ * file with key=value entries per line.
+ */
+struct ptapi_io_piuio_record_util_conf {
+  char lib_path[PATH_MAX];
+  char record_path[PATH_MAX];
+  bool loop;
+};
+
+/**
+ * Load the configuration file. Missing keys are set to their defaults.
+ *
+ * @param path Path to the configuration file
+ * @param conf Pointer to a conf struct to fill in
+ * @return True on success, false on error
+ */
+bool ptapi_io_piuio_record_util_conf_load(
+    const char *path, struct ptapi_io_piuio_record_util_conf *conf);
+
+/**
+ * Pack an unpacked input state into the state field of an entry
+ */
+void ptapi_io_piuio_record_util_state_pack(
+    const struct ptapi_io_piuio_record_util_state *state, uint8_t *packed);
+
+/**
+ * Unpack the state field of an entry
+ */
+void ptapi_io_piuio_record_util_state_unpack(
+    const uint8_t *packed, struct ptapi_io_piuio_record_util_state *state);
+
+/**
+ * Get the current CLOCK_MONOTONIC time in microseconds
+ */
+uint64_t ptapi_io_piuio_record_util_time_now_us(void);
+
+/**
+ * Open a new record file for writing and write the header
+ *
+ * @param path Path of the file to create (existing files are overwritten)
+ * @return File handle or NULL on error
+ */
+FILE *ptapi_io_piuio_record_util_file_create(const char *path);
+
+/**
+ * Load a full record file into memory
+ *
+ * @param path Path to the record file
+ * @param entries Pointer to return an allocated buffer with all entries to
+ *        (caller has to free)
+ * @param count Pointer to return the number of entries to
+ * @return True on success, false on error or invalid file
+ */
+bool ptapi_io_piuio_record_util_file_load(
+    const char *path,
+    struct ptapi_io_piuio_record_util_entry **entries,
+    size_t *count);
+
+#endif
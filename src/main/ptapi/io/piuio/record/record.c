@@ -0,0 +1,241 @@
+/**
+ * Implementation of the piuio API. Wraps another piuio API implementation and
+ * records all input state changes with timestamps to a compact binary file.
+ * The recording can be played back with the replay implementation.
+ */
+#define LOG_MODULE "ptapi-io-piuio-record"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ptapi/io/piuio.h"
+#include "ptapi/io/piuio/record-util/record.h"
+#include "ptapi/io/piuio/util/lib.h"
+
+#include "util/log.h"
+#include "util/proc.h"
+#include "util/str.h"
+
+#define CONFIG_FILENAME "/piuio-record.conf"
+
+static struct ptapi_io_piuio_api ptapi_io_piuio_record_api;
+static FILE *ptapi_io_piuio_record_file;
+static uint64_t ptapi_io_piuio_record_last_time_us;
+static uint8_t ptapi_io_piuio_record_last_state
+    [PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE];
+static struct ptapi_io_piuio_record_util_state ptapi_io_piuio_record_state;
+static size_t ptapi_io_piuio_record_entries;
+
+static bool ptapi_io_piuio_record_write_entry(
+    uint32_t delta_us, const uint8_t *state)
+{
+  struct ptapi_io_piuio_record_util_entry entry;
+
+  entry.delta_us = delta_us;
+  memcpy(entry.state, state, PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE);
+
+  if (fwrite(&entry, sizeof(entry), 1, ptapi_io_piuio_record_file) != 1) {
+    log_error("Writing record entry failed");
+    return false;
+  }
+
+  ptapi_io_piuio_record_entries++;
+
+  return true;
+}
+
+static void ptapi_io_piuio_record_state_changed(const uint8_t *state)
+{
+  uint64_t now;
+  uint64_t delta;
+
+  now = ptapi_io_piuio_record_util_time_now_us();
+  delta = now - ptapi_io_piuio_record_last_time_us;
+
+  // Deltas not fitting the entry are split up by repeating the previous state
+  while (delta > UINT32_MAX) {
+    if (!ptapi_io_piuio_record_write_entry(
+            UINT32_MAX, ptapi_io_piuio_record_last_state)) {
+      return;
+    }
+
+    delta -= UINT32_MAX;
+  }
+
+  if (!ptapi_io_piuio_record_write_entry((uint32_t) delta, state)) {
+    return;
+  }
+
+  // At most once per frame, don't lose the tail of the recording if the game
+  // crashes or gets killed
+  if (fflush(ptapi_io_piuio_record_file) != 0) {
+    log_error("Flushing record file failed");
+  }
+
+  ptapi_io_piuio_record_last_time_us = now;
+  memcpy(
+      ptapi_io_piuio_record_last_state,
+      state,
+      PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE);
+}
+
+const char *ptapi_io_piuio_ident(void)
+{
+  return "record";
+}
+
+bool ptapi_io_piuio_open(void)
+{
+  char path[PATH_MAX];
+  char *config_path;
+  struct ptapi_io_piuio_record_util_conf conf;
+
+  // The game changes the working directory to the 'game' sub-folder. Therefore,
+  // ./my-config does not work here.
+  if (!util_proc_get_folder_path_executable_no_ld_linux(path, sizeof(path))) {
+    log_error("Getting executable folder path failed.");
+    return false;
+  }
+
+  config_path = util_str_merge(path, CONFIG_FILENAME);
+
+  log_info("Loading configuration: %s", config_path);
+
+  if (!ptapi_io_piuio_record_util_conf_load(config_path, &conf)) {
+    free(config_path);
+    return false;
+  }
+
+  free(config_path);
+
+  log_info("Loading wrapped piuio lib: %s", conf.lib_path);
+
+  if (!ptapi_io_piuio_util_lib_load(
+          conf.lib_path, &ptapi_io_piuio_record_api)) {
+    log_error("Loading wrapped piuio lib %s failed", conf.lib_path);
+    return false;
+  }
+
+  log_info(
+      "Wrapped piuio lib: %s, recording to: %s",
+      ptapi_io_piuio_record_api.ident(),
+      conf.record_path);
+
+  if (!ptapi_io_piuio_record_api.open()) {
+    log_error("Opening wrapped piuio lib failed");
+    return false;
+  }
+
+  ptapi_io_piuio_record_file =
+      ptapi_io_piuio_record_util_file_create(conf.record_path);
+
+  if (!ptapi_io_piuio_record_file) {
+    ptapi_io_piuio_record_api.close();
+    return false;
+  }
+
+  memset(
+      &ptapi_io_piuio_record_state,
+      0,
+      sizeof(struct ptapi_io_piuio_record_util_state));
+  memset(
+      ptapi_io_piuio_record_last_state,
+      0,
+      PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE);
+
+  ptapi_io_piuio_record_last_time_us = ptapi_io_piuio_record_util_time_now_us();
+  ptapi_io_piuio_record_entries = 0;
+
+  return true;
+}
+
+void ptapi_io_piuio_close(void)
+{
+  ptapi_io_piuio_record_api.close();
+
+  if (ptapi_io_piuio_record_file) {
+    fclose(ptapi_io_piuio_record_file);
+    ptapi_io_piuio_record_file = NULL;
+  }
+
+  log_info(
+      "Recording closed, %zu state changes recorded",
+      ptapi_io_piuio_record_entries);
+}
+
+bool ptapi_io_piuio_recv(void)
+{
+  uint8_t state[PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE];
+
+  if (!ptapi_io_piuio_record_api.recv()) {
+    return false;
+  }
+
+  // Snapshot the full input state once per poll. The game reads the sensor
+  // groups from this snapshot
+  for (uint8_t player = 0; player < 2; player++) {
+    for (uint8_t group = 0; group < PTAPI_IO_PIUIO_SENSOR_GROUP_NUM; group++) {
+      memset(
+          &ptapi_io_piuio_record_state.pad[player][group],
+          0,
+          sizeof(struct ptapi_io_piuio_pad_inputs));
+      ptapi_io_piuio_record_api.get_input_pad(
+          player, group, &ptapi_io_piuio_record_state.pad[player][group]);
+    }
+  }
+
+  memset(
+      &ptapi_io_piuio_record_state.sys,
+      0,
+      sizeof(struct ptapi_io_piuio_sys_inputs));
+  ptapi_io_piuio_record_api.get_input_sys(&ptapi_io_piuio_record_state.sys);
+
+  ptapi_io_piuio_record_util_state_pack(&ptapi_io_piuio_record_state, state);
+
+  if (memcmp(
+          state,
+          ptapi_io_piuio_record_last_state,
+          PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE) != 0) {
+    ptapi_io_piuio_record_state_changed(state);
+  }
+
+  return true;
+}
+
+bool ptapi_io_piuio_send(void)
+{
+  return ptapi_io_piuio_record_api.send();
+}
+
+void ptapi_io_piuio_get_input_pad(
+    uint8_t player,
+    enum ptapi_io_piuio_sensor_group sensor_group,
+    struct ptapi_io_piuio_pad_inputs *inputs)
+{
+  memcpy(
+      inputs,
+      &ptapi_io_piuio_record_state.pad[player][sensor_group],
+      sizeof(struct ptapi_io_piuio_pad_inputs));
+}
+
+void ptapi_io_piuio_get_input_sys(struct ptapi_io_piuio_sys_inputs *inputs)
+{
+  memcpy(
+      inputs,
+      &ptapi_io_piuio_record_state.sys,
+      sizeof(struct ptapi_io_piuio_sys_inputs));
+}
+
+void ptapi_io_piuio_set_output_pad(
+    uint8_t player, const struct ptapi_io_piuio_pad_outputs *outputs)
+{
+  ptapi_io_piuio_record_api.set_output_pad(
+      player, (struct ptapi_io_piuio_pad_outputs *) outputs);
+}
+
+void ptapi_io_piuio_set_output_cab(
+    const struct ptapi_io_piuio_cab_outputs *outputs)
+{
+  ptapi_io_piuio_record_api.set_output_cab(outputs);
+}
@@ -0,0 +1,163 @@
+/**
+ * Implementation of the piuio API. Replays a recording created with the record
+ * implementation. Input state changes are emitted with their recorded timing
+ * relative to the first poll, based on CLOCK_MONOTONIC.
+ */
+#define LOG_MODULE "ptapi-io-piuio-replay"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ptapi/io/piuio.h"
+#include "ptapi/io/piuio/record-util/record.h"
+
+#include "util/log.h"
+#include "util/proc.h"
+#include "util/str.h"
+
+#define CONFIG_FILENAME "/piuio-record.conf"
+
+static struct ptapi_io_piuio_record_util_entry *ptapi_io_piuio_replay_entries;
+static size_t ptapi_io_piuio_replay_entry_count;
+static size_t ptapi_io_piuio_replay_pos;
+static bool ptapi_io_piuio_replay_loop;
+static bool ptapi_io_piuio_replay_started;
+static uint64_t ptapi_io_piuio_replay_next_time_us;
+static struct ptapi_io_piuio_record_util_state ptapi_io_piuio_replay_state;
+
+const char *ptapi_io_piuio_ident(void)
+{
+  return "replay";
+}
+
+bool ptapi_io_piuio_open(void)
+{
+  char path[PATH_MAX];
+  char *config_path;
+  struct ptapi_io_piuio_record_util_conf conf;
+
+  // The game changes the working directory to the 'game' sub-folder. Therefore,
+  // ./my-config does not work here.
+  if (!util_proc_get_folder_path_executable_no_ld_linux(path, sizeof(path))) {
+    log_error("Getting executable folder path failed.");
+    return false;
+  }
+
+  config_path = util_str_merge(path, CONFIG_FILENAME);
+
+  log_info("Loading configuration: %s", config_path);
+
+  if (!ptapi_io_piuio_record_util_conf_load(config_path, &conf)) {
+    free(config_path);
+    return false;
+  }
+
+  free(config_path);
+
+  if (!ptapi_io_piuio_record_util_file_load(
+          conf.record_path,
+          &ptapi_io_piuio_replay_entries,
+          &ptapi_io_piuio_replay_entry_count)) {
+    return false;
+  }
+
+  log_info(
+      "Replaying %s, %zu state changes, loop %d",
+      conf.record_path,
+      ptapi_io_piuio_replay_entry_count,
+      conf.loop);
+
+  memset(
+      &ptapi_io_piuio_replay_state,
+      0,
+      sizeof(struct ptapi_io_piuio_record_util_state));
+
+  ptapi_io_piuio_replay_pos = 0;
+  ptapi_io_piuio_replay_loop = conf.loop;
+  ptapi_io_piuio_replay_started = false;
+
+  return true;
+}
+
+void ptapi_io_piuio_close(void)
+{
+  free(ptapi_io_piuio_replay_entries);
+  ptapi_io_piuio_replay_entries = NULL;
+}
+
+bool ptapi_io_piuio_recv(void)
+{
+  uint64_t now;
+
+  now = ptapi_io_piuio_record_util_time_now_us();
+
+  // Timing is relative to the first poll and not to open as the game might
+  // take a while between opening the device and actually polling it
+  if (!ptapi_io_piuio_replay_started) {
+    ptapi_io_piuio_replay_started = true;
+    ptapi_io_piuio_replay_next_time_us =
+        now + ptapi_io_piuio_replay_entries[0].delta_us;
+  }
+
+  // Deadlines are accumulated from the previous deadline and not from the
+  // time the change was applied. Late polls do not drift the remaining replay
+  while (ptapi_io_piuio_replay_pos < ptapi_io_piuio_replay_entry_count &&
+         now >= ptapi_io_piuio_replay_next_time_us) {
+    ptapi_io_piuio_record_util_state_unpack(
+        ptapi_io_piuio_replay_entries[ptapi_io_piuio_replay_pos].state,
+        &ptapi_io_piuio_replay_state);
+
+    ptapi_io_piuio_replay_pos++;
+
+    if (ptapi_io_piuio_replay_pos == ptapi_io_piuio_replay_entry_count) {
+      if (!ptapi_io_piuio_replay_loop) {
+        log_info("Replay finished");
+        break;
+      }
+
+      log_debug("Replay finished, looping");
+      ptapi_io_piuio_replay_pos = 0;
+    }
+
+    ptapi_io_piuio_replay_next_time_us +=
+        ptapi_io_piuio_replay_entries[ptapi_io_piuio_replay_pos].delta_us;
+  }
+
+  return true;
+}
+
+bool ptapi_io_piuio_send(void)
+{
+  return true;
+}
+
+void ptapi_io_piuio_get_input_pad(
+    uint8_t player,
+    enum ptapi_io_piuio_sensor_group sensor_group,
+    struct ptapi_io_piuio_pad_inputs *inputs)
+{
+  memcpy(
+      inputs,
+      &ptapi_io_piuio_replay_state.pad[player][sensor_group],
+      sizeof(struct ptapi_io_piuio_pad_inputs));
+}
+
+void ptapi_io_piuio_get_input_sys(struct ptapi_io_piuio_sys_inputs *inputs)
+{
+  memcpy(
+      inputs,
+      &ptapi_io_piuio_replay_state.sys,
+      sizeof(struct ptapi_io_piuio_sys_inputs));
+}
+
+void ptapi_io_piuio_set_output_pad(
+    uint8_t player, const struct ptapi_io_piuio_pad_outputs *outputs)
+{
+  /* Outputs are not recorded */
+}
+
+void ptapi_io_piuio_set_output_cab(
+    const struct ptapi_io_piuio_cab_outputs *outputs)
+{
+  /* Outputs are not recorded */
+}
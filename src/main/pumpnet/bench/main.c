@@ -0,0 +1,350 @@
+/**
+ * Benchmark of the pumpnet http layer: Runs get and put requests of a NX2 save
+ * against a loopback mock server (or an actual server) for each transport
+ * (base64, binary, binary deflate) and reports requests per second, latency
+ * percentiles and body bytes on the wire. Run with pool size 0 and > 0 to
+ * compare creating a connection per request with re-using connections
+ */
+#define LOG_MODULE "pumpnet-bench"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "asset/nx2/lib/usb-save.h"
+
+#include "pumpnet/lib/http.h"
+#include "pumpnet/lib/protocol.h"
+#include "pumpnet/mock/server.h"
+
+#include "util/fs.h"
+#include "util/log.h"
+#include "util/mem.h"
+#include "util/str.h"
+#include "util/time.h"
+
+struct bench_ctx {
+  const char *address;
+  bool is_post;
+  size_t requests;
+  void *req;
+  size_t req_size;
+  size_t resp_size;
+  uint64_t *latencies_ns;
+  size_t send_encoded_size;
+  size_t recv_encoded_size;
+  size_t failed;
+};
+
+static const char *bench_transport_str[PUMPNET_LIB_HTTP_TRANSPORT_COUNT] = {
+    "base64",
+    "binary",
+    "binary deflate",
+};
+
+static void *bench_client_proc(void *arg)
+{
+  struct bench_ctx *ctx;
+  struct pumpnet_lib_http_request request;
+  uint64_t start_ns;
+
+  ctx = (struct bench_ctx *) arg;
+
+  request.address = ctx->address;
+  request.send_data = ctx->req;
+  request.send_size = ctx->req_size;
+  request.recv_data = util_xmalloc(ctx->resp_size + 1);
+  request.recv_size = ctx->resp_size;
+  request.is_post = ctx->is_post;
+  request.timeout_ms = 0;
+  request.if_none_match = NULL;
+  memset(&request.timing, 0, sizeof(struct pumpnet_lib_http_timing));
+
+  for (size_t i = 0; i < ctx->requests; i++) {
+    request.trace_id = i;
+
+    start_ns = util_time_get_monotonic_ns();
+
+    if (!pumpnet_lib_http_get_put_request(&request) ||
+        request.http_code != HTTP_CODE_OK) {
+      ctx->failed++;
+    }
+
+    ctx->latencies_ns[i] = util_time_get_monotonic_ns() - start_ns;
+    ctx->send_encoded_size += request.send_encoded_size;
+    ctx->recv_encoded_size += request.recv_encoded_size;
+  }
+
+  free(request.recv_data);
+
+  return NULL;
+}
+
+static int bench_compare_u64(const void *a, const void *b)
+{
+  uint64_t va;
+  uint64_t vb;
+
+  va = *((const uint64_t *) a);
+  vb = *((const uint64_t *) b);
+
+  return va < vb ? -1 : va > vb ? 1 : 0;
+}
+
+static double bench_percentile_ms(const uint64_t *sorted, size_t count, int p)
+{
+  return sorted[(count - 1) * p / 100] / 1000.0 / 1000.0;
+}
+
+/* Generated save with some progress, encrypted like the game uploads it */
+static void *bench_create_save(size_t *size)
+{
+  struct asset_nx2_usb_save *save;
+
+  save = asset_nx2_usb_save_new();
+
+  save->stats.mileage = 123456;
+  save->stats.play_count = 789;
+
+  for (int i = 0; i < ASSET_NX2_USB_SAVE_SONG_MAX; i += 2) {
+    save->stats.song_unlocks[i].song = 1;
+    save->stats.song_unlocks[i].mode = 0x1F;
+
+    for (int j = 0; j < ASSET_NX2_USB_SAVE_NUM_MODES; j++) {
+      save->stats.song_scores[i][j].score = 100000 + rand() % 900000;
+      strcpy(save->stats.song_scores[i][j].player_id, save->stats.player_id);
+    }
+  }
+
+  asset_nx2_usb_save_finalize(save);
+  asset_nx2_usb_save_encrypt((uint8_t *) save, sizeof(*save));
+
+  *size = sizeof(*save);
+
+  return save;
+}
+
+static bool bench_run(
+    const char *address,
+    bool is_post,
+    void *req,
+    size_t req_size,
+    size_t resp_size,
+    size_t requests,
+    size_t num_threads,
+    size_t pool_size)
+{
+  struct bench_ctx *ctxs;
+  pthread_t *threads;
+  uint64_t *latencies_ns;
+  size_t failed;
+  size_t total;
+  size_t send_encoded_size;
+  size_t recv_encoded_size;
+  uint64_t start_ns;
+  double elapsed_sec;
+
+  total = requests * num_threads;
+  latencies_ns = util_xmalloc(sizeof(uint64_t) * total);
+  ctxs = util_xmalloc(sizeof(struct bench_ctx) * num_threads);
+  threads = util_xmalloc(sizeof(pthread_t) * num_threads);
+
+  start_ns = util_time_get_monotonic_ns();
+
+  for (size_t i = 0; i < num_threads; i++) {
+    ctxs[i].address = address;
+    ctxs[i].is_post = is_post;
+    ctxs[i].requests = requests;
+    ctxs[i].req = req;
+    ctxs[i].req_size = req_size;
+    ctxs[i].resp_size = resp_size;
+    ctxs[i].latencies_ns = latencies_ns + i * requests;
+    ctxs[i].send_encoded_size = 0;
+    ctxs[i].recv_encoded_size = 0;
+    ctxs[i].failed = 0;
+
+    if (pthread_create(&threads[i], NULL, bench_client_proc, &ctxs[i]) != 0) {
+      log_die("Creating client thread failed");
+    }
+  }
+
+  failed = 0;
+  send_encoded_size = 0;
+  recv_encoded_size = 0;
+
+  for (size_t i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+    failed += ctxs[i].failed;
+    send_encoded_size += ctxs[i].send_encoded_size;
+    recv_encoded_size += ctxs[i].recv_encoded_size;
+  }
+
+  elapsed_sec =
+      (util_time_get_monotonic_ns() - start_ns) / 1000.0 / 1000.0 / 1000.0;
+
+  qsort(latencies_ns, total, sizeof(uint64_t), bench_compare_u64);
+
+  printf(
+      "%s, %s, %s, pool size %zu, threads %zu: %zu requests (%zu failed) in "
+      "%.3f sec, %.1f req/sec, latency p50 %.3f ms, p99 %.3f ms, max %.3f "
+      "ms, body bytes sent %zu, received %zu per request\n",
+      address,
+      bench_transport_str[pumpnet_lib_http_get_transport()],
+      is_post ? "put" : "get",
+      pool_size,
+      num_threads,
+      total,
+      failed,
+      elapsed_sec,
+      total / elapsed_sec,
+      bench_percentile_ms(latencies_ns, total, 50),
+      bench_percentile_ms(latencies_ns, total, 99),
+      bench_percentile_ms(latencies_ns, total, 100),
+      send_encoded_size / total,
+      recv_encoded_size / total);
+
+  free(threads);
+  free(ctxs);
+  free(latencies_ns);
+
+  return failed == 0;
+}
+
+int main(int argc, char **argv)
+{
+  struct pumpnet_lib_get_save_req get_req;
+  struct pumpnet_lib_put_save_req *put_req;
+  struct pumpnet_lib_http_request warm_up;
+  struct pumpnet_mock_server_config server_config;
+  struct pumpnet_mock_server *server;
+  void *get_resp;
+  void *save;
+  size_t save_size;
+  size_t put_req_size;
+  char *address;
+  size_t requests;
+  size_t pool_size;
+  size_t num_threads;
+  bool success;
+  char mock_address[64];
+
+  if (argc < 3) {
+    printf(
+        "Usage: %s <requests per thread> <pool size, 0 = no pooling> "
+        "[threads, default 1] [server address, default loopback mock server] "
+        "[nx2 save file, default generated save]\n",
+        argv[0]);
+    return -1;
+  }
+
+  util_log_set_level(LOG_LEVEL_WARN);
+
+  requests = strtoul(argv[1], NULL, 10);
+  pool_size = strtoul(argv[2], NULL, 10);
+  num_threads = argc > 3 ? strtoul(argv[3], NULL, 10) : 1;
+
+  if (requests == 0 || num_threads == 0) {
+    fprintf(stderr, "Invalid number of requests or threads\n");
+    return -1;
+  }
+
+  if (argc > 5) {
+    if (!util_file_load(argv[5], &save, &save_size, false)) {
+      fprintf(stderr, "Loading save file %s failed\n", argv[5]);
+      return -1;
+    }
+  } else {
+    save = bench_create_save(&save_size);
+  }
+
+  memset(&get_req, 0, sizeof(get_req));
+
+  server = NULL;
+
+  if (argc > 4 && strlen(argv[4]) > 0) {
+    address = util_str_dup(argv[4]);
+  } else {
+    pumpnet_mock_server_config_init(&server_config);
+    server = pumpnet_mock_server_start(&server_config);
+
+    if (!server) {
+      fprintf(stderr, "Starting mock server failed\n");
+      return -1;
+    }
+
+    pumpnet_mock_server_put(
+        server,
+        "nx2",
+        PUMPNET_LIB_FILE_TYPE_SAVE,
+        get_req.player_ref_id,
+        save,
+        save_size);
+
+    sprintf(
+        mock_address,
+        "http://127.0.0.1:%d" USBPROFILE_ENDPOINT "/nx2/save",
+        pumpnet_mock_server_get_port(server));
+    address = util_str_dup(mock_address);
+  }
+
+  put_req_size = sizeof(struct pumpnet_lib_put_save_req) + save_size;
+  put_req = util_xmalloc(put_req_size);
+  memset(put_req, 0, sizeof(struct pumpnet_lib_put_save_req));
+  put_req->size = save_size;
+  memcpy(put_req->data, save, save_size);
+
+  get_resp = util_xmalloc(sizeof(struct pumpnet_lib_get_save_resp) + save_size);
+
+  success = true;
+
+  for (int i = 0; i < PUMPNET_LIB_HTTP_TRANSPORT_COUNT; i++) {
+    pumpnet_lib_http_init(NULL, pool_size, i, false);
+
+    // negotiate the transport before measuring
+    warm_up.trace_id = 0;
+    warm_up.address = address;
+    warm_up.send_data = &get_req;
+    warm_up.send_size = sizeof(get_req);
+    warm_up.recv_data = get_resp;
+    warm_up.recv_size = sizeof(struct pumpnet_lib_get_save_resp) + save_size;
+    warm_up.is_post = false;
+    warm_up.timeout_ms = 0;
+    warm_up.if_none_match = NULL;
+    memset(&warm_up.timing, 0, sizeof(struct pumpnet_lib_http_timing));
+
+    pumpnet_lib_http_get_put_request(&warm_up);
+
+    success &= bench_run(
+        address,
+        false,
+        &get_req,
+        sizeof(get_req),
+        sizeof(struct pumpnet_lib_get_save_resp) + save_size,
+        requests,
+        num_threads,
+        pool_size);
+    success &= bench_run(
+        address,
+        true,
+        put_req,
+        put_req_size,
+        sizeof(struct pumpnet_lib_put_save_resp),
+        requests,
+        num_threads,
+        pool_size);
+
+    pumpnet_lib_http_shutdown();
+  }
+
+  if (server) {
+    pumpnet_mock_server_stop(server);
+  }
+
+  free(get_resp);
+  free(put_req);
+  free(save);
+  free(address);
+
+  return success ? 0 : -2;
+}
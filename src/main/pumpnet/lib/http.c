@@ -1,15 +1,23 @@
 #define LOG_MODULE "http"
 
 #include <curl/curl.h>
+#include <pthread.h>
 #include <stdint.h>
+#include <strings.h>
+#include <zlib.h>
+
+#include "pumpnet/lib/http.h"
 
 #include "util/base64.h"
 #include "util/fs.h"
 #include "util/log.h"
 #include "util/mem.h"
 #include "util/str.h"
+#include "util/time.h"
 
-#define MEDIA_TYPE "text/plain"
+#define MEDIA_TYPE_BASE64 "text/plain"
+#define MEDIA_TYPE_BINARY "application/octet-stream"
+#define CONTENT_ENCODING_DEFLATE "deflate"
 #define RECV_BUFFER_SIZE 1024 * 512
 #define CLIENT_CRT "/client-crt.pem"
 #define CLIENT_KEY "/client-key.pem"
@@ -21,6 +29,32 @@ struct pumpnet_lib_http_buffer {
   size_t pos;
 };
 
+// curl handle with its receive buffer, kept alive in the pool to re-use the
+// connection of the handle
+struct pumpnet_lib_http_conn {
+  CURL *handle;
+  void *recv_data;
+  bool in_use;
+};
+
+struct pumpnet_lib_http_transfer {
+  struct pumpnet_lib_http_conn *conn;
+  enum pumpnet_lib_http_transport send_transport;
+  // send data encoded to a separate buffer, raw binary data is sent as it is
+  bool send_data_owned;
+  struct pumpnet_lib_http_buffer send_buffer;
+  struct pumpnet_lib_http_buffer recv_buffer;
+  // encoding and entity tag of the response body, from the response headers
+  bool recv_binary;
+  bool recv_deflate;
+  char recv_etag[PUMPNET_LIB_HTTP_ETAG_SIZE];
+  // request specific headers, NULL to use the shared ones of the transport
+  struct curl_slist *headers;
+  // server rejected the binary request body, send again as base64
+  bool resend_base64;
+  uint32_t encode_us;
+};
+
 static size_t _pumpnet_lib_http_curl_cb_write_data(
     void *ptr, size_t size, size_t nmemb, void *ctx)
 {
@@ -76,6 +110,113 @@ static size_t _pumpnet_lib_http_curl_cb_read_data(
   return read;
 }
 
+// curl rewinds the send data if it has to send the request again, e.g. if a
+// re-used connection was closed by the server
+static int _pumpnet_lib_http_curl_cb_seek_data(
+    void *ctx, curl_off_t offset, int origin)
+{
+  struct pumpnet_lib_http_buffer *buffer;
+
+  buffer = (struct pumpnet_lib_http_buffer *) ctx;
+
+  if (origin != SEEK_SET || offset < 0 || (size_t) offset > buffer->size) {
+    return CURL_SEEKFUNC_CANTSEEK;
+  }
+
+  buffer->pos = (size_t) offset;
+
+  return CURL_SEEKFUNC_OK;
+}
+
+// case insensitive match of a (not null terminated) header line with a header
+// name and the start of its value
+static bool _pumpnet_lib_http_header_matches(
+    const char *line, size_t len, const char *name, const char *value)
+{
+  size_t name_len;
+  size_t value_len;
+
+  name_len = strlen(name);
+  value_len = strlen(value);
+
+  if (len < name_len || strncasecmp(line, name, name_len) != 0) {
+    return false;
+  }
+
+  line += name_len;
+  len -= name_len;
+
+  while (len > 0 && *line == ' ') {
+    line++;
+    len--;
+  }
+
+  return len >= value_len && strncasecmp(line, value, value_len) == 0;
+}
+
+// copy the value of a header line without leading and trailing whitespace,
+// empty if it does not fit the buffer
+static void _pumpnet_lib_http_header_get_value(
+    const char *line, size_t len, char *buffer, size_t size)
+{
+  const char *value;
+
+  buffer[0] = '\0';
+  value = memchr(line, ':', len);
+
+  if (!value) {
+    return;
+  }
+
+  len -= value + 1 - line;
+  value++;
+
+  while (len > 0 && (*value == ' ' || *value == '\t')) {
+    value++;
+    len--;
+  }
+
+  while (len > 0 && (value[len - 1] == '\r' || value[len - 1] == '\n' ||
+                     value[len - 1] == ' ' || value[len - 1] == '\t')) {
+    len--;
+  }
+
+  if (len >= size) {
+    return;
+  }
+
+  memcpy(buffer, value, len);
+  buffer[len] = '\0';
+}
+
+static size_t _pumpnet_lib_http_curl_cb_header(
+    char *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct pumpnet_lib_http_transfer *transfer;
+  size_t len;
+
+  transfer = (struct pumpnet_lib_http_transfer *) ctx;
+  len = size * nmemb;
+
+  // status line of a new response, e.g. after 100 continue
+  if (len >= 5 && strncmp(ptr, "HTTP/", 5) == 0) {
+    transfer->recv_binary = false;
+    transfer->recv_deflate = false;
+    transfer->recv_etag[0] = '\0';
+  } else if (_pumpnet_lib_http_header_matches(ptr, len, "ETag:", "")) {
+    _pumpnet_lib_http_header_get_value(
+        ptr, len, transfer->recv_etag, sizeof(transfer->recv_etag));
+  } else if (_pumpnet_lib_http_header_matches(
+                 ptr, len, "Content-Type:", MEDIA_TYPE_BINARY)) {
+    transfer->recv_binary = true;
+  } else if (_pumpnet_lib_http_header_matches(
+                 ptr, len, "Content-Encoding:", CONTENT_ENCODING_DEFLATE)) {
+    transfer->recv_deflate = true;
+  }
+
+  return len;
+}
+
 int _pumpnet_libcurl_debug_callback(
     CURL *handle, curl_infotype type, char *data, size_t size, void *userptr)
 {
@@ -114,7 +255,224 @@ static char *pumpnet_lib_http_client_key_path;
 static char *pumpnet_lib_http_ca_bundle_crt_path;
 static bool pumpnet_lib_http_verbose_debug_log;
 
-void pumpnet_lib_http_init(const char *cert_dir_path, bool verbose_debug_log)
+static pthread_mutex_t pumpnet_lib_http_transport_mutex =
+    PTHREAD_MUTEX_INITIALIZER;
+static enum pumpnet_lib_http_transport pumpnet_lib_http_transport;
+static enum pumpnet_lib_http_transport pumpnet_lib_http_transport_negotiated;
+
+// request headers for each transport of the request body
+static struct curl_slist
+    *pumpnet_lib_http_headers[PUMPNET_LIB_HTTP_TRANSPORT_COUNT];
+static struct curl_slist *pumpnet_lib_http_resolve;
+
+static pthread_mutex_t pumpnet_lib_http_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct pumpnet_lib_http_conn *pumpnet_lib_http_pool;
+static size_t pumpnet_lib_http_pool_size;
+
+// DNS cache and TLS sessions shared by all handles. Not the connections, a
+// shared connection cache requires libcurl 7.57 and serializes the transfers
+// of all threads on its lock. Every pooled handle keeps its own connection
+static CURLSH *pumpnet_lib_http_share;
+static pthread_mutex_t pumpnet_lib_http_share_mutex[CURL_LOCK_DATA_LAST];
+
+static void _pumpnet_lib_http_share_lock(
+    CURL *handle, curl_lock_data data, curl_lock_access access, void *ctx)
+{
+  pthread_mutex_lock(&pumpnet_lib_http_share_mutex[data]);
+}
+
+static void
+_pumpnet_lib_http_share_unlock(CURL *handle, curl_lock_data data, void *ctx)
+{
+  pthread_mutex_unlock(&pumpnet_lib_http_share_mutex[data]);
+}
+
+static bool _pumpnet_lib_http_conn_is_pooled(
+    const struct pumpnet_lib_http_conn *conn)
+{
+  return conn >= pumpnet_lib_http_pool &&
+      conn < pumpnet_lib_http_pool + pumpnet_lib_http_pool_size;
+}
+
+static void _pumpnet_lib_http_conn_release(struct pumpnet_lib_http_conn *conn)
+{
+  if (_pumpnet_lib_http_conn_is_pooled(conn)) {
+    pthread_mutex_lock(&pumpnet_lib_http_pool_mutex);
+    conn->in_use = false;
+    pthread_mutex_unlock(&pumpnet_lib_http_pool_mutex);
+  } else {
+    if (conn->handle) {
+      curl_easy_cleanup(conn->handle);
+    }
+
+    free(conn->recv_data);
+    free(conn);
+  }
+}
+
+static struct pumpnet_lib_http_conn *_pumpnet_lib_http_conn_acquire()
+{
+  struct pumpnet_lib_http_conn *conn;
+
+  conn = NULL;
+
+  pthread_mutex_lock(&pumpnet_lib_http_pool_mutex);
+
+  for (size_t i = 0; i < pumpnet_lib_http_pool_size; i++) {
+    if (!pumpnet_lib_http_pool[i].in_use) {
+      conn = &pumpnet_lib_http_pool[i];
+      conn->in_use = true;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&pumpnet_lib_http_pool_mutex);
+
+  // pool disabled or all handles busy, fall back to a temporary handle
+  if (!conn) {
+    conn = util_xmalloc(sizeof(struct pumpnet_lib_http_conn));
+    memset(conn, 0, sizeof(struct pumpnet_lib_http_conn));
+  }
+
+  if (conn->handle) {
+    // keeps the connection and caches of the handle alive, options only
+    curl_easy_reset(conn->handle);
+  } else {
+    conn->handle = curl_easy_init();
+
+    if (!conn->handle) {
+      _pumpnet_lib_http_conn_release(conn);
+      return NULL;
+    }
+  }
+
+  if (!conn->recv_data) {
+    conn->recv_data = util_xmalloc(RECV_BUFFER_SIZE);
+  }
+
+  return conn;
+}
+
+static const char *_pumpnet_lib_http_transport_str(
+    enum pumpnet_lib_http_transport transport)
+{
+  switch (transport) {
+    case PUMPNET_LIB_HTTP_TRANSPORT_BASE64:
+      return "base64";
+    case PUMPNET_LIB_HTTP_TRANSPORT_BINARY:
+      return "binary";
+    case PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE:
+      return "binary deflate";
+    default:
+      return "unknown";
+  }
+}
+
+// timer of curl since the start of the transfer, the double variants are
+// used as the _T (us) ones are not available with older curl versions
+static uint32_t _pumpnet_lib_http_get_timer_us(CURL *handle, CURLINFO info)
+{
+  double time_sec;
+
+  time_sec = 0;
+
+  if (curl_easy_getinfo(handle, info, &time_sec) != CURLE_OK || time_sec < 0) {
+    return 0;
+  }
+
+  return (uint32_t) (time_sec * 1000 * 1000);
+}
+
+static uint32_t
+_pumpnet_lib_http_get_phase_us(uint32_t end_us, uint32_t start_us)
+{
+  // timers of phases not reached, e.g. on connection errors, are 0
+  return end_us > start_us ? end_us - start_us : 0;
+}
+
+static void _pumpnet_lib_http_add_timing(
+    struct pumpnet_lib_http_timing *timing, CURL *handle)
+{
+  uint32_t namelookup_us;
+  uint32_t connect_us;
+  uint32_t appconnect_us;
+  uint32_t pretransfer_us;
+  uint32_t starttransfer_us;
+  uint32_t total_us;
+
+  namelookup_us =
+      _pumpnet_lib_http_get_timer_us(handle, CURLINFO_NAMELOOKUP_TIME);
+  connect_us = _pumpnet_lib_http_get_timer_us(handle, CURLINFO_CONNECT_TIME);
+  appconnect_us =
+      _pumpnet_lib_http_get_timer_us(handle, CURLINFO_APPCONNECT_TIME);
+  pretransfer_us =
+      _pumpnet_lib_http_get_timer_us(handle, CURLINFO_PRETRANSFER_TIME);
+  starttransfer_us =
+      _pumpnet_lib_http_get_timer_us(handle, CURLINFO_STARTTRANSFER_TIME);
+  total_us = _pumpnet_lib_http_get_timer_us(handle, CURLINFO_TOTAL_TIME);
+
+  timing->dns_us += namelookup_us;
+  timing->connect_us +=
+      _pumpnet_lib_http_get_phase_us(connect_us, namelookup_us);
+
+  // 0 without a tls handshake
+  if (appconnect_us > 0) {
+    timing->tls_us += _pumpnet_lib_http_get_phase_us(appconnect_us, connect_us);
+  }
+
+  timing->first_byte_us +=
+      _pumpnet_lib_http_get_phase_us(starttransfer_us, pretransfer_us);
+  timing->transfer_us +=
+      _pumpnet_lib_http_get_phase_us(total_us, starttransfer_us);
+  timing->total_us += total_us;
+}
+
+static struct curl_slist *_pumpnet_lib_http_create_headers(
+    enum pumpnet_lib_http_transport send_transport, const char *if_none_match)
+{
+  struct curl_slist *headers;
+  char *header;
+
+  if (send_transport == PUMPNET_LIB_HTTP_TRANSPORT_BASE64) {
+    headers = curl_slist_append(NULL, "Content-Type: " MEDIA_TYPE_BASE64);
+  } else {
+    headers = curl_slist_append(NULL, "Content-Type: " MEDIA_TYPE_BINARY);
+  }
+
+  if (send_transport == PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE) {
+    headers = curl_slist_append(
+        headers, "Content-Encoding: " CONTENT_ENCODING_DEFLATE);
+  }
+
+  if (pumpnet_lib_http_transport >= PUMPNET_LIB_HTTP_TRANSPORT_BINARY) {
+    headers = curl_slist_append(
+        headers,
+        "Accept: " MEDIA_TYPE_BINARY ", " MEDIA_TYPE_BASE64 ";q=0.5");
+  }
+
+  if (pumpnet_lib_http_transport >= PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE) {
+    headers = curl_slist_append(
+        headers, "Accept-Encoding: " CONTENT_ENCODING_DEFLATE);
+  }
+
+  // send the body right away instead of waiting a round trip for the server
+  // to confirm with 100 continue (curl default for bodies > 1 kb)
+  headers = curl_slist_append(headers, "Expect:");
+
+  if (if_none_match) {
+    header = util_str_merge("If-None-Match: ", if_none_match);
+    headers = curl_slist_append(headers, header);
+    free(header);
+  }
+
+  return headers;
+}
+
+void pumpnet_lib_http_init(
+    const char *cert_dir_path,
+    size_t pool_size,
+    enum pumpnet_lib_http_transport transport,
+    bool verbose_debug_log)
 {
   if (cert_dir_path) {
     char *absolute_path = util_fs_get_abs_path(cert_dir_path);
@@ -131,17 +489,100 @@ void pumpnet_lib_http_init(const char *cert_dir_path, bool verbose_debug_log)
 
   pumpnet_lib_http_verbose_debug_log = verbose_debug_log;
 
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+
+  pumpnet_lib_http_transport = transport;
+  pumpnet_lib_http_transport_negotiated = PUMPNET_LIB_HTTP_TRANSPORT_BASE64;
+
+  for (int i = 0; i <= transport; i++) {
+    pumpnet_lib_http_headers[i] = _pumpnet_lib_http_create_headers(i, NULL);
+  }
+
+  if (pumpnet_lib_http_client_crt_path) {
+    pumpnet_lib_http_resolve =
+        curl_slist_append(NULL, "pumpnet:443:185.41.243.94");
+  }
+
+  if (pool_size > 0) {
+    pumpnet_lib_http_pool =
+        util_xmalloc(sizeof(struct pumpnet_lib_http_conn) * pool_size);
+    memset(
+        pumpnet_lib_http_pool,
+        0,
+        sizeof(struct pumpnet_lib_http_conn) * pool_size);
+    pumpnet_lib_http_pool_size = pool_size;
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+      pthread_mutex_init(&pumpnet_lib_http_share_mutex[i], NULL);
+    }
+
+    pumpnet_lib_http_share = curl_share_init();
+
+    curl_share_setopt(
+        pumpnet_lib_http_share,
+        CURLSHOPT_LOCKFUNC,
+        _pumpnet_lib_http_share_lock);
+    curl_share_setopt(
+        pumpnet_lib_http_share,
+        CURLSHOPT_UNLOCKFUNC,
+        _pumpnet_lib_http_share_unlock);
+    curl_share_setopt(
+        pumpnet_lib_http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(
+        pumpnet_lib_http_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  }
+
   log_info(
-      "Initialized, client crt %s, client key %s, ca bundle crt %s, verbose "
-      "debug log %d",
+      "Initialized, client crt %s, client key %s, ca bundle crt %s, pool size "
+      "%d, transport %s, verbose debug log %d",
       pumpnet_lib_http_client_crt_path,
       pumpnet_lib_http_client_key_path,
       pumpnet_lib_http_ca_bundle_crt_path,
+      pool_size,
+      _pumpnet_lib_http_transport_str(transport),
       verbose_debug_log);
 }
 
 void pumpnet_lib_http_shutdown()
 {
+  // handles first, they might still reference the share
+  for (size_t i = 0; i < pumpnet_lib_http_pool_size; i++) {
+    if (pumpnet_lib_http_pool[i].handle) {
+      curl_easy_cleanup(pumpnet_lib_http_pool[i].handle);
+    }
+
+    free(pumpnet_lib_http_pool[i].recv_data);
+  }
+
+  if (pumpnet_lib_http_pool) {
+    free(pumpnet_lib_http_pool);
+    pumpnet_lib_http_pool = NULL;
+    pumpnet_lib_http_pool_size = 0;
+  }
+
+  if (pumpnet_lib_http_share) {
+    curl_share_cleanup(pumpnet_lib_http_share);
+    pumpnet_lib_http_share = NULL;
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+      pthread_mutex_destroy(&pumpnet_lib_http_share_mutex[i]);
+    }
+  }
+
+  for (int i = 0; i < PUMPNET_LIB_HTTP_TRANSPORT_COUNT; i++) {
+    if (pumpnet_lib_http_headers[i]) {
+      curl_slist_free_all(pumpnet_lib_http_headers[i]);
+      pumpnet_lib_http_headers[i] = NULL;
+    }
+  }
+
+  if (pumpnet_lib_http_resolve) {
+    curl_slist_free_all(pumpnet_lib_http_resolve);
+    pumpnet_lib_http_resolve = NULL;
+  }
+
+  curl_global_cleanup();
+
   if (pumpnet_lib_http_client_crt_path) {
     free(pumpnet_lib_http_client_crt_path);
   }
@@ -155,45 +596,218 @@ void pumpnet_lib_http_shutdown()
   }
 }
 
-bool pumpnet_lib_http_get_put(
-    uint64_t trace_id,
-    const char *address,
-    void *send_data,
-    size_t send_size,
-    void *recv_data,
-    size_t recv_size,
-    uint32_t *http_code,
-    bool is_post)
+enum pumpnet_lib_http_transport pumpnet_lib_http_get_transport()
 {
-  log_assert(address);
-  log_assert(send_data);
-  log_assert(recv_data);
-  log_assert(http_code);
+  enum pumpnet_lib_http_transport transport;
 
-  CURL *curl_handle;
-  CURLcode res;
-  struct pumpnet_lib_http_buffer send_buffer;
-  struct pumpnet_lib_http_buffer recv_buffer;
-  struct curl_slist *host = NULL;
+  pthread_mutex_lock(&pumpnet_lib_http_transport_mutex);
+  transport = pumpnet_lib_http_transport_negotiated;
+  pthread_mutex_unlock(&pumpnet_lib_http_transport_mutex);
+
+  return transport;
+}
+
+static void _pumpnet_lib_http_set_transport(
+    enum pumpnet_lib_http_transport transport)
+{
+  if (transport > pumpnet_lib_http_transport) {
+    transport = pumpnet_lib_http_transport;
+  }
+
+  pthread_mutex_lock(&pumpnet_lib_http_transport_mutex);
+
+  if (pumpnet_lib_http_transport_negotiated != transport) {
+    log_info(
+        "Transport negotiated with server: %s",
+        _pumpnet_lib_http_transport_str(transport));
+
+    pumpnet_lib_http_transport_negotiated = transport;
+  }
+
+  pthread_mutex_unlock(&pumpnet_lib_http_transport_mutex);
+}
 
-  *http_code = 0;
+static void _pumpnet_lib_http_encode_send_data(
+    const struct pumpnet_lib_http_request *request,
+    struct pumpnet_lib_http_transfer *transfer)
+{
+  uLongf compressed_size;
+  void *compressed;
+
+  transfer->send_transport = pumpnet_lib_http_get_transport();
+  transfer->send_buffer.pos = 0;
+
+  switch (transfer->send_transport) {
+    case PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE:
+      compressed_size = compressBound(request->send_size);
+      compressed = util_xmalloc(compressed_size);
+
+      // encrypted profile data does not compress well, send it uncompressed
+      // if compressing does not pay off
+      if (compress2(
+              compressed,
+              &compressed_size,
+              request->send_data,
+              request->send_size,
+              Z_BEST_SPEED) == Z_OK &&
+          compressed_size < request->send_size) {
+        transfer->send_data_owned = true;
+        transfer->send_buffer.data = compressed;
+        transfer->send_buffer.size = compressed_size;
+        break;
+      }
+
+      free(compressed);
+      transfer->send_transport = PUMPNET_LIB_HTTP_TRANSPORT_BINARY;
+
+      // fall through
+    case PUMPNET_LIB_HTTP_TRANSPORT_BINARY:
+      transfer->send_data_owned = false;
+      transfer->send_buffer.data = request->send_data;
+      transfer->send_buffer.size = request->send_size;
+      break;
 
-  curl_handle = curl_easy_init();
+    case PUMPNET_LIB_HTTP_TRANSPORT_BASE64:
+    default:
+      transfer->send_transport = PUMPNET_LIB_HTTP_TRANSPORT_BASE64;
+      transfer->send_data_owned = true;
+      transfer->send_buffer.data = util_base64_encode(
+          request->send_data,
+          request->send_size,
+          &transfer->send_buffer.size);
+      break;
+  }
+}
 
-  if (!curl_handle) {
-    log_error("[%llX] Initializing curl backend failed", trace_id);
+static void _pumpnet_lib_http_free_send_data(
+    struct pumpnet_lib_http_transfer *transfer)
+{
+  if (transfer->send_data_owned) {
+    free(transfer->send_buffer.data);
+  }
+
+  transfer->send_buffer.data = NULL;
+
+  if (transfer->headers) {
+    curl_slist_free_all(transfer->headers);
+    transfer->headers = NULL;
+  }
+}
+
+static bool _pumpnet_lib_http_decode_recv_data(
+    struct pumpnet_lib_http_request *request,
+    struct pumpnet_lib_http_transfer *transfer)
+{
+  uint8_t *recv_decoded;
+  size_t recv_size_decoded;
+  uLongf recv_size_inflated;
+  int res;
+
+  if (!transfer->recv_binary) {
+    if (transfer->recv_deflate) {
+      log_error(
+          "[%llX][%s][%d] Unsupported content encoding of base64 response",
+          request->trace_id,
+          request->address,
+          request->is_post);
+      return false;
+    }
+
+    recv_decoded = util_base64_decode(
+        transfer->recv_buffer.data,
+        transfer->recv_buffer.pos,
+        &recv_size_decoded);
+
+    if (recv_size_decoded != request->recv_size) {
+      log_error(
+          "[%llX][%s][%d] Invalid recv data size: %d != %d",
+          request->trace_id,
+          request->address,
+          request->is_post,
+          recv_size_decoded,
+          request->recv_size);
+
+      free(recv_decoded);
+      return false;
+    }
+
+    memcpy(request->recv_data, recv_decoded, request->recv_size);
+    free(recv_decoded);
+
+    return true;
+  }
+
+  if (transfer->recv_deflate) {
+    recv_size_inflated = request->recv_size;
+
+    res = uncompress(
+        request->recv_data,
+        &recv_size_inflated,
+        transfer->recv_buffer.data,
+        transfer->recv_buffer.pos);
+
+    if (res != Z_OK || recv_size_inflated != request->recv_size) {
+      log_error(
+          "[%llX][%s][%d] Inflating recv data failed (%d), size %d != %d",
+          request->trace_id,
+          request->address,
+          request->is_post,
+          res,
+          recv_size_inflated,
+          request->recv_size);
+      return false;
+    }
+
+    return true;
+  }
+
+  if (transfer->recv_buffer.pos != request->recv_size) {
+    log_error(
+        "[%llX][%s][%d] Invalid recv data size: %d != %d",
+        request->trace_id,
+        request->address,
+        request->is_post,
+        transfer->recv_buffer.pos,
+        request->recv_size);
     return false;
   }
 
-  send_buffer.data =
-      util_base64_encode(send_data, send_size, &send_buffer.size);
-  send_buffer.pos = 0;
+  memcpy(request->recv_data, transfer->recv_buffer.data, request->recv_size);
 
-  recv_buffer.data = util_xmalloc(RECV_BUFFER_SIZE);
-  recv_buffer.size = RECV_BUFFER_SIZE;
-  recv_buffer.pos = 0;
+  return true;
+}
+
+static bool _pumpnet_lib_http_transfer_begin(
+    const struct pumpnet_lib_http_request *request,
+    struct pumpnet_lib_http_transfer *transfer)
+{
+  CURL *curl_handle;
+  uint64_t start_us;
 
-  if (is_post) {
+  transfer->conn = _pumpnet_lib_http_conn_acquire();
+
+  if (!transfer->conn) {
+    log_error("[%llX] Initializing curl backend failed", request->trace_id);
+    return false;
+  }
+
+  curl_handle = transfer->conn->handle;
+
+  start_us = util_time_get_monotonic_ns() / 1000;
+  _pumpnet_lib_http_encode_send_data(request, transfer);
+  transfer->encode_us = util_time_get_monotonic_ns() / 1000 - start_us;
+
+  transfer->recv_binary = false;
+  transfer->recv_deflate = false;
+  transfer->recv_etag[0] = '\0';
+  transfer->resend_base64 = false;
+  transfer->headers = NULL;
+
+  transfer->recv_buffer.data = transfer->conn->recv_data;
+  transfer->recv_buffer.size = RECV_BUFFER_SIZE;
+  transfer->recv_buffer.pos = 0;
+
+  if (request->is_post) {
     curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
   } else {
     curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
@@ -206,9 +820,13 @@ bool pumpnet_lib_http_get_put(
         curl_handle, CURLOPT_DEBUGFUNCTION, _pumpnet_libcurl_debug_callback);
   }
 
+  if (pumpnet_lib_http_share) {
+    curl_easy_setopt(curl_handle, CURLOPT_SHARE, pumpnet_lib_http_share);
+    curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPALIVE, 1L);
+  }
+
   if (pumpnet_lib_http_client_crt_path) {
-    host = curl_slist_append(NULL, "pumpnet:443:185.41.243.94");
-    curl_easy_setopt(curl_handle, CURLOPT_RESOLVE, host);
+    curl_easy_setopt(curl_handle, CURLOPT_RESOLVE, pumpnet_lib_http_resolve);
     curl_easy_setopt(
         curl_handle, CURLOPT_SSLCERT, pumpnet_lib_http_client_crt_path);
     curl_easy_setopt(
@@ -222,99 +840,308 @@ bool pumpnet_lib_http_get_put(
   // It seems like some libcurl revisions cut off the content after processing
   // it using the provided CURLOPT_READFUNCTION if the size is not force set
   // like this
-  curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, send_buffer.size);
+  curl_easy_setopt(
+      curl_handle, CURLOPT_POSTFIELDSIZE, transfer->send_buffer.size);
 
-  curl_easy_setopt(curl_handle, CURLOPT_URL, address);
+  curl_easy_setopt(curl_handle, CURLOPT_URL, request->address);
   curl_easy_setopt(
       curl_handle, CURLOPT_READFUNCTION, _pumpnet_lib_http_curl_cb_read_data);
-  curl_easy_setopt(curl_handle, CURLOPT_READDATA, &send_buffer);
+  curl_easy_setopt(curl_handle, CURLOPT_READDATA, &transfer->send_buffer);
+  curl_easy_setopt(
+      curl_handle, CURLOPT_SEEKFUNCTION, _pumpnet_lib_http_curl_cb_seek_data);
+  curl_easy_setopt(curl_handle, CURLOPT_SEEKDATA, &transfer->send_buffer);
   curl_easy_setopt(
       curl_handle, CURLOPT_WRITEFUNCTION, _pumpnet_lib_http_curl_cb_write_data);
-  curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &recv_buffer);
+  curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &transfer->recv_buffer);
+  curl_easy_setopt(
+      curl_handle, CURLOPT_HEADERFUNCTION, _pumpnet_lib_http_curl_cb_header);
+  curl_easy_setopt(curl_handle, CURLOPT_HEADERDATA, transfer);
+
+  if (request->if_none_match) {
+    transfer->headers = _pumpnet_lib_http_create_headers(
+        transfer->send_transport, request->if_none_match);
+
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, transfer->headers);
+  } else {
+    curl_easy_setopt(
+        curl_handle,
+        CURLOPT_HTTPHEADER,
+        pumpnet_lib_http_headers[transfer->send_transport]);
+  }
 
-  struct curl_slist *hs = NULL;
-  hs = curl_slist_append(hs, "Content-Type: " MEDIA_TYPE);
-  curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, hs);
+  if (request->timeout_ms > 0) {
+    // no signals for timeouts, not thread safe
+    curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(
+        curl_handle, CURLOPT_TIMEOUT_MS, (long) request->timeout_ms);
+  }
 
   log_debug(
-      "[%llX][%s] %s %d %d",
-      trace_id,
-      address,
-      is_post ? "POST" : "GET",
-      send_size,
-      recv_size);
+      "[%llX][%s] %s %d %d, %s %d",
+      request->trace_id,
+      request->address,
+      request->is_post ? "POST" : "GET",
+      request->send_size,
+      request->recv_size,
+      _pumpnet_lib_http_transport_str(transfer->send_transport),
+      transfer->send_buffer.size);
 
-  res = curl_easy_perform(curl_handle);
+  return true;
+}
 
-  curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, http_code);
+static bool _pumpnet_lib_http_transfer_end(
+    struct pumpnet_lib_http_request *request,
+    struct pumpnet_lib_http_transfer *transfer,
+    CURLcode res)
+{
+  enum pumpnet_lib_http_transport recv_transport;
+  long http_code;
+  uint64_t start_us;
+  bool success;
 
-  log_debug(
-      "[%llX][%s] %s: %d (%d %d)",
-      trace_id,
-      address,
-      is_post ? "POST" : "GET",
-      *http_code,
-      recv_buffer.pos,
-      send_buffer.pos);
+  http_code = 0;
+  curl_easy_getinfo(transfer->conn->handle, CURLINFO_RESPONSE_CODE, &http_code);
+  request->http_code = (uint32_t) http_code;
+  request->send_encoded_size = transfer->send_buffer.pos;
+  request->recv_encoded_size = transfer->recv_buffer.pos;
+  strcpy(request->etag, transfer->recv_etag);
 
-  if (host) {
-    curl_slist_free_all(host);
-  }
+  _pumpnet_lib_http_add_timing(&request->timing, transfer->conn->handle);
+  request->timing.encode_us += transfer->encode_us;
 
-  curl_slist_free_all(hs);
+  log_debug(
+      "[%llX][%s] %s: %d (%d %d)",
+      request->trace_id,
+      request->address,
+      request->is_post ? "POST" : "GET",
+      request->http_code,
+      transfer->recv_buffer.pos,
+      transfer->send_buffer.pos);
 
-  curl_easy_cleanup(curl_handle);
+  _pumpnet_lib_http_free_send_data(transfer);
 
   if (res != CURLE_OK) {
     log_error(
         "[%llX][%s][%d] Performing curl request failed: %s",
-        trace_id,
-        address,
-        is_post,
+        request->trace_id,
+        request->address,
+        request->is_post,
         curl_easy_strerror(res));
 
-    free(send_buffer.data);
-    free(recv_buffer.data);
+    _pumpnet_lib_http_conn_release(transfer->conn);
     return false;
   }
 
-  if (send_buffer.pos != send_buffer.size) {
+  if (request->http_code == HTTP_CODE_UNSUPPORTED_MEDIA_TYPE &&
+      transfer->send_transport != PUMPNET_LIB_HTTP_TRANSPORT_BASE64) {
+    log_warn(
+        "[%llX][%s][%d] Server rejected %s request body, falling back to "
+        "base64",
+        request->trace_id,
+        request->address,
+        request->is_post,
+        _pumpnet_lib_http_transport_str(transfer->send_transport));
+
+    _pumpnet_lib_http_set_transport(PUMPNET_LIB_HTTP_TRANSPORT_BASE64);
+    transfer->resend_base64 = true;
+
+    _pumpnet_lib_http_conn_release(transfer->conn);
+    return false;
+  }
+
+  if (transfer->send_buffer.pos != transfer->send_buffer.size) {
     log_error(
         "[%llX][%s][%d] Invalid send data size: %d != %d",
-        trace_id,
-        address,
-        is_post,
-        send_buffer.pos,
-        send_buffer.size);
-
-    free(send_buffer.data);
-    free(recv_buffer.data);
+        request->trace_id,
+        request->address,
+        request->is_post,
+        transfer->send_buffer.pos,
+        transfer->send_buffer.size);
+
+    _pumpnet_lib_http_conn_release(transfer->conn);
     return false;
   }
 
-  free(send_buffer.data);
+  // server supports the transport of the response for request bodies, too
+  if (request->http_code == HTTP_CODE_OK && transfer->recv_binary) {
+    recv_transport = transfer->recv_deflate ?
+        PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE :
+        PUMPNET_LIB_HTTP_TRANSPORT_BINARY;
 
-  size_t recv_size_decoded;
-  uint8_t *tmp_recv_decoded =
-      util_base64_decode(recv_buffer.data, recv_buffer.pos, &recv_size_decoded);
+    if (recv_transport > pumpnet_lib_http_get_transport()) {
+      _pumpnet_lib_http_set_transport(recv_transport);
+    }
+  }
 
-  free(recv_buffer.data);
+  // no body, the client already has the data
+  if (request->http_code == HTTP_CODE_NOT_MODIFIED && request->if_none_match) {
+    success = true;
+  } else {
+    start_us = util_time_get_monotonic_ns() / 1000;
+    success = _pumpnet_lib_http_decode_recv_data(request, transfer);
+    request->timing.decode_us += util_time_get_monotonic_ns() / 1000 - start_us;
+  }
 
-  if (recv_size_decoded != recv_size) {
-    log_error(
-        "[%llX][%s][%d] Invalid recv data size: %d != %d",
-        trace_id,
-        address,
-        is_post,
-        recv_size_decoded,
-        recv_size);
+  _pumpnet_lib_http_conn_release(transfer->conn);
+
+  return success;
+}
+
+bool pumpnet_lib_http_get_put_request(struct pumpnet_lib_http_request *request)
+{
+  log_assert(request);
 
-    free(tmp_recv_decoded);
+  struct pumpnet_lib_http_transfer transfer;
+  CURLcode res;
+
+  request->http_code = 0;
+  request->success = false;
+  request->send_encoded_size = 0;
+  request->recv_encoded_size = 0;
+  request->etag[0] = '\0';
+
+  do {
+    if (!_pumpnet_lib_http_transfer_begin(request, &transfer)) {
+      return false;
+    }
+
+    res = curl_easy_perform(transfer.conn->handle);
+
+    request->success = _pumpnet_lib_http_transfer_end(request, &transfer, res);
+  } while (transfer.resend_base64);
+
+  return request->success;
+}
+
+bool pumpnet_lib_http_get_put(
+    uint64_t trace_id,
+    const char *address,
+    void *send_data,
+    size_t send_size,
+    void *recv_data,
+    size_t recv_size,
+    uint32_t *http_code,
+    bool is_post,
+    uint32_t timeout_ms)
+{
+  log_assert(address);
+  log_assert(send_data);
+  log_assert(recv_data);
+  log_assert(http_code);
+
+  struct pumpnet_lib_http_request request;
+
+  request.trace_id = trace_id;
+  request.address = address;
+  request.send_data = send_data;
+  request.send_size = send_size;
+  request.recv_data = recv_data;
+  request.recv_size = recv_size;
+  request.is_post = is_post;
+  request.timeout_ms = timeout_ms;
+  request.if_none_match = NULL;
+  memset(&request.timing, 0, sizeof(struct pumpnet_lib_http_timing));
+
+  pumpnet_lib_http_get_put_request(&request);
+
+  *http_code = request.http_code;
+
+  return request.success;
+}
+
+bool pumpnet_lib_http_get_put_multi(
+    struct pumpnet_lib_http_request *requests, size_t count)
+{
+  log_assert(requests);
+
+  struct pumpnet_lib_http_transfer *transfers;
+  CURLM *multi_handle;
+  CURLMsg *msg;
+  int running;
+  int msgs_left;
+  bool success;
+
+  for (size_t i = 0; i < count; i++) {
+    requests[i].http_code = 0;
+    requests[i].success = false;
+    requests[i].send_encoded_size = 0;
+    requests[i].recv_encoded_size = 0;
+    requests[i].etag[0] = '\0';
+  }
+
+  multi_handle = curl_multi_init();
+
+  if (!multi_handle) {
+    log_error("Initializing curl multi backend failed");
     return false;
   }
 
-  memcpy(recv_data, tmp_recv_decoded, recv_size);
-  free(tmp_recv_decoded);
+  transfers = util_xmalloc(sizeof(struct pumpnet_lib_http_transfer) * count);
+  memset(transfers, 0, sizeof(struct pumpnet_lib_http_transfer) * count);
+
+  for (size_t i = 0; i < count; i++) {
+    if (_pumpnet_lib_http_transfer_begin(&requests[i], &transfers[i])) {
+      curl_easy_setopt(
+          transfers[i].conn->handle, CURLOPT_PRIVATE, &transfers[i]);
+      curl_multi_add_handle(multi_handle, transfers[i].conn->handle);
+    } else {
+      transfers[i].conn = NULL;
+    }
+  }
 
-  return true;
-}
\ No newline at end of file
+  do {
+    if (curl_multi_perform(multi_handle, &running) != CURLM_OK) {
+      log_error("Performing curl multi requests failed");
+      break;
+    }
+
+    while ((msg = curl_multi_info_read(multi_handle, &msgs_left))) {
+      struct pumpnet_lib_http_transfer *transfer;
+      size_t idx;
+
+      if (msg->msg != CURLMSG_DONE) {
+        continue;
+      }
+
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+      idx = transfer - transfers;
+
+      curl_multi_remove_handle(multi_handle, msg->easy_handle);
+
+      requests[idx].success = _pumpnet_lib_http_transfer_end(
+          &requests[idx], transfer, msg->data.result);
+      transfer->conn = NULL;
+    }
+
+    if (running > 0) {
+      curl_multi_wait(multi_handle, NULL, 0, 1000, NULL);
+    }
+  } while (running > 0);
+
+  // aborted transfers, e.g. multi failure
+  for (size_t i = 0; i < count; i++) {
+    if (transfers[i].conn) {
+      curl_multi_remove_handle(multi_handle, transfers[i].conn->handle);
+      _pumpnet_lib_http_free_send_data(&transfers[i]);
+      _pumpnet_lib_http_conn_release(transfers[i].conn);
+    }
+  }
+
+  curl_multi_cleanup(multi_handle);
+
+  // binary request bodies rejected, transport is base64 now
+  for (size_t i = 0; i < count; i++) {
+    if (transfers[i].resend_base64) {
+      pumpnet_lib_http_get_put_request(&requests[i]);
+    }
+  }
+  free(transfers);
+
+  success = true;
+
+  for (size_t i = 0; i < count; i++) {
+    success &= requests[i].success;
+  }
+
+  return success;
+}
@@ -5,9 +5,92 @@
 #include <stdlib.h>
 
 #define HTTP_CODE_OK 200
+#define HTTP_CODE_NOT_MODIFIED 304
 #define HTTP_CODE_PRECONDITION_FAILED 412
+#define HTTP_CODE_UNSUPPORTED_MEDIA_TYPE 415
 
-void pumpnet_lib_http_init(const char *cert_dir_path, bool verbose_debug_log);
+// enough handles for concurrent save and rank transfers of both players
+#define PUMPNET_LIB_HTTP_DEFAULT_POOL_SIZE 4
+
+// max size of an entity tag including the null terminator, longer ones are
+// ignored
+#define PUMPNET_LIB_HTTP_ETAG_SIZE 128
+
+// encoding of the request and response bodies, ordered by preference
+enum pumpnet_lib_http_transport {
+  // base64 encoded text/plain, supported by every server
+  PUMPNET_LIB_HTTP_TRANSPORT_BASE64 = 0,
+  // raw application/octet-stream
+  PUMPNET_LIB_HTTP_TRANSPORT_BINARY = 1,
+  // application/octet-stream with deflate (zlib) content encoding
+  PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE = 2,
+  PUMPNET_LIB_HTTP_TRANSPORT_COUNT = 3,
+};
+
+// pool_size: number of curl handles kept alive to re-use connections (and TLS
+// sessions) across requests. 0 disables pooling, i.e. every request creates
+// a new handle and connection
+//
+// transport: max transport to use. requests start with base64 and advertise
+// the supported transports (Accept, Accept-Encoding), the request bodies
+// switch to the better transport once the server responds with it. falls
+// back to base64 if the server rejects a binary body (415)
+void pumpnet_lib_http_init(
+    const char *cert_dir_path,
+    size_t pool_size,
+    enum pumpnet_lib_http_transport transport,
+    bool verbose_debug_log);
+
+// transport negotiated with the server so far
+enum pumpnet_lib_http_transport pumpnet_lib_http_get_transport();
+
+// durations of the phases of a request in us, taken from the timers of curl.
+// added up, e.g. if a request is resent as base64, zero it before executing
+// a request. dns and connect are ~0 on a re-used connection
+struct pumpnet_lib_http_timing {
+  uint32_t dns_us;
+  uint32_t connect_us;
+  // 0 without https
+  uint32_t tls_us;
+  // sending the request until the first byte of the response, i.e. upload and
+  // server processing time
+  uint32_t first_byte_us;
+  // receiving the response from the first to the last byte
+  uint32_t transfer_us;
+  // all of the above, as measured by curl
+  uint32_t total_us;
+  // cpu time spent encoding the request body and decoding the response body
+  uint32_t encode_us;
+  uint32_t decode_us;
+};
+
+// single request executed by pumpnet_lib_http_get_put_request or of a batch
+// executed by pumpnet_lib_http_get_put_multi
+struct pumpnet_lib_http_request {
+  uint64_t trace_id;
+  const char *address;
+  void *send_data;
+  size_t send_size;
+  void *recv_data;
+  size_t recv_size;
+  bool is_post;
+  // max duration of the whole transfer, 0 for no limit
+  uint32_t timeout_ms;
+  // entity tag of the data already known to the client (If-None-Match), NULL
+  // for none. the server responds with 304 without a body if the data did not
+  // change, which counts as success
+  const char *if_none_match;
+  // result, set once the request completed
+  uint32_t http_code;
+  bool success;
+  // entity tag of the response (ETag), empty if none
+  char etag[PUMPNET_LIB_HTTP_ETAG_SIZE];
+  // sizes of the encoded bodies transferred, i.e. bytes on the wire excluding
+  // headers
+  size_t send_encoded_size;
+  size_t recv_encoded_size;
+  struct pumpnet_lib_http_timing timing;
+};
 
 void pumpnet_lib_http_shutdown();
 
@@ -19,4 +102,15 @@ bool pumpnet_lib_http_get_put(
     void *recv_data,
     size_t recv_size,
     uint32_t *http_code,
-    bool is_post);
\ No newline at end of file
+    bool is_post,
+    uint32_t timeout_ms);
+
+// execute a single request and block until it completed. returns the success
+// result field
+bool pumpnet_lib_http_get_put_request(struct pumpnet_lib_http_request *request);
+
+// execute multiple requests concurrently (curl multi) and block until all of
+// them completed. returns true if all requests were successful, check the
+// result fields of each request otherwise
+bool pumpnet_lib_http_get_put_multi(
+    struct pumpnet_lib_http_request *requests, size_t count);
\ No newline at end of file
@@ -0,0 +1,389 @@
+#define LOG_MODULE "pumpnet-profile-cache"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pumpnet/lib/profile-cache.h"
+
+#include "util/adler32.h"
+#include "util/fs.h"
+#include "util/log.h"
+#include "util/mem.h"
+#include "util/str.h"
+
+// "PNC1"
+#define CACHE_FILE_MAGIC 0x31434E50
+
+struct pumpnet_lib_profile_cache_header {
+  uint32_t magic;
+  uint32_t game;
+  uint64_t player_ref_id;
+  uint32_t file_type;
+  uint32_t size;
+  char etag[PUMPNET_LIB_HTTP_ETAG_SIZE];
+  // adler32 of the header with checksum 0 followed by the data
+  uint32_t checksum;
+} __attribute__((__packed__));
+
+struct pumpnet_lib_profile_cache {
+  char *dir_path;
+  enum asset_game_version game;
+  // serializes replacing and removing cache files
+  pthread_mutex_t mutex;
+};
+
+static const char *
+_pumpnet_lib_profile_cache_file_type_str(enum pumpnet_lib_file_type file_type)
+{
+  switch (file_type) {
+    case PUMPNET_LIB_FILE_TYPE_SAVE:
+      return "save";
+
+    case PUMPNET_LIB_FILE_TYPE_RANK:
+      return "rank";
+
+    case PUMPNET_LIB_FILE_TYPE_COUNT:
+    default:
+      log_die_illegal_state();
+      return NULL;
+  }
+}
+
+static void _pumpnet_lib_profile_cache_get_path(
+    const struct pumpnet_lib_profile_cache *cache,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const char *suffix,
+    char *path,
+    size_t size)
+{
+  util_str_format(
+      path,
+      size,
+      "%s/%d-%016llX-%s.bin%s",
+      cache->dir_path,
+      cache->game,
+      player_ref_id,
+      _pumpnet_lib_profile_cache_file_type_str(file_type),
+      suffix);
+}
+
+static uint32_t _pumpnet_lib_profile_cache_checksum(
+    const struct pumpnet_lib_profile_cache_header *header, const void *data)
+{
+  struct pumpnet_lib_profile_cache_header tmp;
+  uint32_t checksum;
+
+  memcpy(&tmp, header, sizeof(tmp));
+  tmp.checksum = 0;
+
+  checksum = util_adler32_calc(1, (const uint8_t *) &tmp, sizeof(tmp));
+
+  if (header->size > 0) {
+    checksum =
+        util_adler32_calc(checksum, (const uint8_t *) data, header->size);
+  }
+
+  return checksum;
+}
+
+static bool _pumpnet_lib_profile_cache_header_matches(
+    const struct pumpnet_lib_profile_cache *cache,
+    const struct pumpnet_lib_profile_cache_header *header,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id)
+{
+  return header->magic == CACHE_FILE_MAGIC && header->game == cache->game &&
+      header->player_ref_id == player_ref_id &&
+      header->file_type == file_type &&
+      memchr(header->etag, '\0', sizeof(header->etag)) != NULL;
+}
+
+static bool _pumpnet_lib_profile_cache_write_file(
+    const char *path, const void *data, size_t size)
+{
+  const uint8_t *pos;
+  size_t remaining;
+  ssize_t res;
+  int fd;
+
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if (fd < 0) {
+    log_error("Opening %s failed: %s", path, strerror(errno));
+    return false;
+  }
+
+  pos = (const uint8_t *) data;
+  remaining = size;
+
+  while (remaining > 0) {
+    res = write(fd, pos, remaining);
+
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      log_error("Writing %s failed: %s", path, strerror(errno));
+      close(fd);
+      return false;
+    }
+
+    pos += res;
+    remaining -= res;
+  }
+
+  // data has to be on disk before the rename replaces the previous file
+  if (fdatasync(fd) != 0) {
+    log_error("Syncing %s failed: %s", path, strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  close(fd);
+
+  return true;
+}
+
+struct pumpnet_lib_profile_cache *pumpnet_lib_profile_cache_open(
+    const char *dir_path, enum asset_game_version game)
+{
+  log_assert(dir_path);
+
+  struct pumpnet_lib_profile_cache *cache;
+
+  if (!util_fs_path_exists(dir_path) && !util_fs_mkdir(dir_path)) {
+    log_error("Creating cache directory %s failed", dir_path);
+    return NULL;
+  }
+
+  cache = util_xmalloc(sizeof(struct pumpnet_lib_profile_cache));
+  memset(cache, 0, sizeof(struct pumpnet_lib_profile_cache));
+
+  cache->dir_path = util_str_dup(dir_path);
+  cache->game = game;
+
+  pthread_mutex_init(&cache->mutex, NULL);
+
+  log_info("Opened profile cache %s, game %d", dir_path, game);
+
+  return cache;
+}
+
+bool pumpnet_lib_profile_cache_get_etag(
+    struct pumpnet_lib_profile_cache *cache,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    char *etag)
+{
+  log_assert(cache);
+  log_assert(file_type < PUMPNET_LIB_FILE_TYPE_COUNT);
+  log_assert(etag);
+
+  struct pumpnet_lib_profile_cache_header header;
+  char path[PATH_MAX];
+  FILE *file;
+  bool res;
+
+  _pumpnet_lib_profile_cache_get_path(
+      cache, file_type, player_ref_id, "", path, sizeof(path));
+
+  file = fopen(path, "rb");
+
+  if (!file) {
+    return false;
+  }
+
+  res = fread(&header, sizeof(header), 1, file) == 1 &&
+      _pumpnet_lib_profile_cache_header_matches(
+            cache, &header, file_type, player_ref_id) &&
+      header.etag[0] != '\0';
+
+  fclose(file);
+
+  if (res) {
+    util_str_cpy(etag, PUMPNET_LIB_HTTP_ETAG_SIZE, header.etag);
+  }
+
+  return res;
+}
+
+bool pumpnet_lib_profile_cache_load(
+    struct pumpnet_lib_profile_cache *cache,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    void *buffer,
+    size_t size,
+    size_t *data_size)
+{
+  log_assert(cache);
+  log_assert(file_type < PUMPNET_LIB_FILE_TYPE_COUNT);
+  log_assert(buffer);
+  log_assert(data_size);
+
+  struct pumpnet_lib_profile_cache_header header;
+  char path[PATH_MAX];
+  uint8_t *file;
+  size_t file_size;
+  const uint8_t *data;
+
+  _pumpnet_lib_profile_cache_get_path(
+      cache, file_type, player_ref_id, "", path, sizeof(path));
+
+  if (!util_fs_path_exists(path)) {
+    return false;
+  }
+
+  if (!util_file_load(path, (void **) &file, &file_size, false)) {
+    log_warn("Loading %s failed", path);
+    return false;
+  }
+
+  if (file_size < sizeof(header)) {
+    log_warn("Cache file %s truncated", path);
+    free(file);
+    return false;
+  }
+
+  memcpy(&header, file, sizeof(header));
+  data = file + sizeof(header);
+
+  if (!_pumpnet_lib_profile_cache_header_matches(
+          cache, &header, file_type, player_ref_id) ||
+      header.size != file_size - sizeof(header) ||
+      header.checksum != _pumpnet_lib_profile_cache_checksum(&header, data)) {
+    log_warn("Cache file %s corrupted", path);
+    free(file);
+    return false;
+  }
+
+  if (header.size > size) {
+    log_error(
+        "Cache file %s size greater than buffer size: %d > %d",
+        path,
+        header.size,
+        size);
+    free(file);
+    return false;
+  }
+
+  memcpy(buffer, data, header.size);
+  *data_size = header.size;
+
+  free(file);
+
+  return true;
+}
+
+bool pumpnet_lib_profile_cache_store(
+    struct pumpnet_lib_profile_cache *cache,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size,
+    const char *etag)
+{
+  log_assert(cache);
+  log_assert(file_type < PUMPNET_LIB_FILE_TYPE_COUNT);
+  log_assert(data);
+  log_assert(etag);
+
+  struct pumpnet_lib_profile_cache_header *header;
+  char path[PATH_MAX];
+  char tmp_path[PATH_MAX];
+  bool res;
+
+  if (strlen(etag) >= PUMPNET_LIB_HTTP_ETAG_SIZE) {
+    log_warn("Entity tag too long, not caching: %s", etag);
+    return false;
+  }
+
+  _pumpnet_lib_profile_cache_get_path(
+      cache, file_type, player_ref_id, "", path, sizeof(path));
+  _pumpnet_lib_profile_cache_get_path(
+      cache, file_type, player_ref_id, ".tmp", tmp_path, sizeof(tmp_path));
+
+  header = util_xmalloc(sizeof(struct pumpnet_lib_profile_cache_header) + size);
+  memset(header, 0, sizeof(struct pumpnet_lib_profile_cache_header));
+
+  header->magic = CACHE_FILE_MAGIC;
+  header->game = cache->game;
+  header->player_ref_id = player_ref_id;
+  header->file_type = file_type;
+  header->size = size;
+  util_str_cpy(header->etag, sizeof(header->etag), etag);
+  memcpy(header + 1, data, size);
+  header->checksum = _pumpnet_lib_profile_cache_checksum(header, header + 1);
+
+  pthread_mutex_lock(&cache->mutex);
+
+  // never leave a partially written cache file behind, e.g. on power loss
+  res = _pumpnet_lib_profile_cache_write_file(
+      tmp_path,
+      header,
+      sizeof(struct pumpnet_lib_profile_cache_header) + size);
+
+  if (res && rename(tmp_path, path) != 0) {
+    log_error(
+        "Renaming %s to %s failed: %s", tmp_path, path, strerror(errno));
+    res = false;
+  }
+
+  if (!res) {
+    unlink(tmp_path);
+  }
+
+  pthread_mutex_unlock(&cache->mutex);
+
+  free(header);
+
+  if (res) {
+    log_debug(
+        "Player %llX, file type %d, cached, etag %s",
+        player_ref_id,
+        file_type,
+        etag);
+  }
+
+  return res;
+}
+
+void pumpnet_lib_profile_cache_invalidate(
+    struct pumpnet_lib_profile_cache *cache,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id)
+{
+  log_assert(cache);
+  log_assert(file_type < PUMPNET_LIB_FILE_TYPE_COUNT);
+
+  char path[PATH_MAX];
+
+  _pumpnet_lib_profile_cache_get_path(
+      cache, file_type, player_ref_id, "", path, sizeof(path));
+
+  pthread_mutex_lock(&cache->mutex);
+
+  if (unlink(path) == 0) {
+    log_debug(
+        "Player %llX, file type %d, invalidated", player_ref_id, file_type);
+  }
+
+  pthread_mutex_unlock(&cache->mutex);
+}
+
+void pumpnet_lib_profile_cache_close(struct pumpnet_lib_profile_cache *cache)
+{
+  log_assert(cache);
+
+  pthread_mutex_destroy(&cache->mutex);
+
+  free(cache->dir_path);
+  free(cache);
+}
@@ -0,0 +1,63 @@
+#ifndef PUMPNET_LIB_PROFILE_CACHE_H
+#define PUMPNET_LIB_PROFILE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "asset/game-version.h"
+
+#include "pumpnet/lib/http.h"
+#include "pumpnet/lib/pumpnet.h"
+
+// Local cache of profile files, one cache file per game, player and file type
+// storing the data together with its entity tag (ETag) of the server. Gets
+// revalidate the cached data with the server (If-None-Match) which responds
+// with 304 without a body if the data did not change. Cache files are
+// checksummed and replaced atomically, a corrupted or truncated cache file is
+// a cache miss.
+
+struct pumpnet_lib_profile_cache;
+
+// open the cache located in the given directory, the directory is created if
+// it does not exist. returns NULL if the directory can't be created
+struct pumpnet_lib_profile_cache *pumpnet_lib_profile_cache_open(
+    const char *dir_path, enum asset_game_version game);
+
+// copy the entity tag of a cached file to etag, returns false if the file is
+// not cached. the data is not validated, see pumpnet_lib_profile_cache_load
+bool pumpnet_lib_profile_cache_get_etag(
+    struct pumpnet_lib_profile_cache *cache,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    char *etag);
+
+// validate a cached file and copy its data to the buffer (and the size of the
+// data to data_size). returns false if the file is not cached, corrupted or
+// too large for the buffer
+bool pumpnet_lib_profile_cache_load(
+    struct pumpnet_lib_profile_cache *cache,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    void *buffer,
+    size_t size,
+    size_t *data_size);
+
+// store (replace) a file with the entity tag the server returned for the data
+bool pumpnet_lib_profile_cache_store(
+    struct pumpnet_lib_profile_cache *cache,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size,
+    const char *etag);
+
+// remove a cached file, e.g. if the data on the server is not known anymore
+void pumpnet_lib_profile_cache_invalidate(
+    struct pumpnet_lib_profile_cache *cache,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id);
+
+void pumpnet_lib_profile_cache_close(struct pumpnet_lib_profile_cache *cache);
+
+#endif
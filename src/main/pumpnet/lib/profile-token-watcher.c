@@ -0,0 +1,312 @@
+#define LOG_MODULE "pumpnet-profile-token-watcher"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pumpnet/lib/profile-token-watcher.h"
+#include "pumpnet/lib/profile-token.h"
+
+#include "util/log.h"
+#include "util/mem.h"
+#include "util/str.h"
+
+#define PUMPNET_LIB_PROFILE_TOKEN_WATCHER_DIR_EVENTS                          \
+  (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE |     \
+   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+struct pumpnet_lib_profile_token_watcher_slot {
+  char *path;
+  char *dir_path;
+  // -1 if the directory is not watched (yet), e.g. does not exist
+  int wd;
+  // file of the token last loaded, to not load it again if unchanged
+  bool stat_valid;
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+  uint64_t player_ref_id;
+};
+
+struct pumpnet_lib_profile_token_watcher {
+  struct pumpnet_lib_profile_token_watcher_slot *slots;
+  size_t count;
+  uint32_t poll_interval_ms;
+  pumpnet_lib_profile_token_watcher_changed_t changed;
+  void *ctx;
+
+  int inotify_fd;
+  // -1 if not available, fallback to the poll interval
+  int mounts_fd;
+  // written to on stop to wake up the thread
+  int stop_pipe[2];
+
+  pthread_t thread;
+};
+
+static void _pumpnet_lib_profile_token_watcher_add_watches(
+    struct pumpnet_lib_profile_token_watcher *watcher)
+{
+  struct pumpnet_lib_profile_token_watcher_slot *slot;
+
+  for (size_t i = 0; i < watcher->count; i++) {
+    slot = &watcher->slots[i];
+
+    if (slot->wd != -1) {
+      continue;
+    }
+
+    // same wd for slots sharing a directory
+    slot->wd = inotify_add_watch(
+        watcher->inotify_fd,
+        slot->dir_path,
+        PUMPNET_LIB_PROFILE_TOKEN_WATCHER_DIR_EVENTS);
+
+    if (slot->wd != -1) {
+      log_debug("Watching %s", slot->dir_path);
+    }
+  }
+}
+
+static void _pumpnet_lib_profile_token_watcher_read_events(
+    struct pumpnet_lib_profile_token_watcher *watcher)
+{
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *event;
+  ssize_t len;
+
+  // the events do not matter, all tokens are checked afterwards, only track
+  // directories which are not watched anymore, e.g. deleted
+  while ((len = read(watcher->inotify_fd, buffer, sizeof(buffer))) > 0) {
+    for (char *ptr = buffer; ptr < buffer + len;
+         ptr += sizeof(struct inotify_event) + event->len) {
+      event = (const struct inotify_event *) ptr;
+
+      if (!(event->mask & (IN_IGNORED | IN_MOVE_SELF))) {
+        continue;
+      }
+
+      for (size_t i = 0; i < watcher->count; i++) {
+        if (watcher->slots[i].wd == event->wd) {
+          // a moved directory keeps its watch, watch the path again
+          if (event->mask & IN_MOVE_SELF) {
+            inotify_rm_watch(watcher->inotify_fd, event->wd);
+          }
+
+          watcher->slots[i].wd = -1;
+        }
+      }
+    }
+  }
+}
+
+static void _pumpnet_lib_profile_token_watcher_check_token(
+    struct pumpnet_lib_profile_token_watcher *watcher, size_t idx)
+{
+  struct pumpnet_lib_profile_token_watcher_slot *slot;
+  struct stat st;
+  uint64_t player_ref_id;
+
+  slot = &watcher->slots[idx];
+
+  if (stat(slot->path, &st) == 0 && S_ISREG(st.st_mode) &&
+      st.st_size == sizeof(uint64_t)) {
+    if (slot->stat_valid && slot->dev == st.st_dev &&
+        slot->ino == st.st_ino && slot->size == st.st_size &&
+        slot->mtime.tv_sec == st.st_mtim.tv_sec &&
+        slot->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+      return;
+    }
+
+    slot->stat_valid = true;
+    slot->dev = st.st_dev;
+    slot->ino = st.st_ino;
+    slot->size = st.st_size;
+    slot->mtime = st.st_mtim;
+
+    if (!pumpnet_lib_profile_token_load(slot->path, &player_ref_id)) {
+      player_ref_id = PUMPNET_LIB_PROFILE_TOKEN_INVALID;
+    }
+  } else {
+    // not there or still being written
+    slot->stat_valid = false;
+    player_ref_id = PUMPNET_LIB_PROFILE_TOKEN_INVALID;
+  }
+
+  if (player_ref_id == slot->player_ref_id) {
+    return;
+  }
+
+  slot->player_ref_id = player_ref_id;
+
+  if (player_ref_id == PUMPNET_LIB_PROFILE_TOKEN_INVALID) {
+    log_info("Token %s removed", slot->path);
+  } else {
+    log_info("Token %s, player %llX", slot->path, player_ref_id);
+  }
+
+  watcher->changed(idx, player_ref_id, watcher->ctx);
+}
+
+static void *_pumpnet_lib_profile_token_watcher_thread_proc(void *ctx)
+{
+  struct pumpnet_lib_profile_token_watcher *watcher;
+  struct pollfd fds[3];
+  nfds_t nfds;
+
+  watcher = (struct pumpnet_lib_profile_token_watcher *) ctx;
+
+  fds[0].fd = watcher->stop_pipe[0];
+  fds[0].events = POLLIN;
+  fds[1].fd = watcher->inotify_fd;
+  fds[1].events = POLLIN;
+  // the mount table signals changes with POLLPRI
+  fds[2].fd = watcher->mounts_fd;
+  fds[2].events = POLLPRI;
+  nfds = watcher->mounts_fd != -1 ? 3 : 2;
+
+  while (true) {
+    _pumpnet_lib_profile_token_watcher_add_watches(watcher);
+
+    for (size_t i = 0; i < watcher->count; i++) {
+      _pumpnet_lib_profile_token_watcher_check_token(watcher, i);
+    }
+
+    // timeout as fallback for events missed, e.g. tokens on network mounts
+    if (poll(fds, nfds, watcher->poll_interval_ms) == -1 && errno != EINTR) {
+      log_error("Polling failed: %s", strerror(errno));
+      break;
+    }
+
+    if (fds[0].revents) {
+      break;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      _pumpnet_lib_profile_token_watcher_read_events(watcher);
+    }
+  }
+
+  return NULL;
+}
+
+struct pumpnet_lib_profile_token_watcher *
+pumpnet_lib_profile_token_watcher_start(
+    const char **paths,
+    size_t count,
+    uint32_t poll_interval_ms,
+    pumpnet_lib_profile_token_watcher_changed_t changed,
+    void *ctx)
+{
+  log_assert(paths);
+  log_assert(count > 0);
+  log_assert(changed);
+
+  struct pumpnet_lib_profile_token_watcher *watcher;
+  struct pumpnet_lib_profile_token_watcher_slot *slot;
+  char *sep;
+  int inotify_fd;
+
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+  if (inotify_fd == -1) {
+    log_error("Initializing inotify failed: %s", strerror(errno));
+    return NULL;
+  }
+
+  watcher = util_xmalloc(sizeof(struct pumpnet_lib_profile_token_watcher));
+  memset(watcher, 0, sizeof(struct pumpnet_lib_profile_token_watcher));
+
+  watcher->slots = util_xmalloc(
+      sizeof(struct pumpnet_lib_profile_token_watcher_slot) * count);
+  memset(
+      watcher->slots,
+      0,
+      sizeof(struct pumpnet_lib_profile_token_watcher_slot) * count);
+
+  watcher->count = count;
+  watcher->poll_interval_ms = poll_interval_ms;
+  watcher->changed = changed;
+  watcher->ctx = ctx;
+  watcher->inotify_fd = inotify_fd;
+  watcher->mounts_fd = open("/proc/self/mounts", O_RDONLY | O_CLOEXEC);
+
+  for (size_t i = 0; i < count; i++) {
+    slot = &watcher->slots[i];
+
+    slot->path = util_str_dup(paths[i]);
+    slot->dir_path = util_str_dup(paths[i]);
+    slot->wd = -1;
+    slot->player_ref_id = PUMPNET_LIB_PROFILE_TOKEN_INVALID;
+
+    sep = strrchr(slot->dir_path, '/');
+
+    if (sep == slot->dir_path) {
+      sep[1] = '\0';
+    } else if (sep) {
+      sep[0] = '\0';
+    } else {
+      free(slot->dir_path);
+      slot->dir_path = util_str_dup(".");
+    }
+  }
+
+  if (pipe2(watcher->stop_pipe, O_CLOEXEC) != 0) {
+    log_die("Creating stop pipe failed: %s", strerror(errno));
+  }
+
+  if (pthread_create(
+          &watcher->thread,
+          NULL,
+          _pumpnet_lib_profile_token_watcher_thread_proc,
+          watcher) != 0) {
+    log_die("Creating token watcher thread failed");
+  }
+
+  log_info(
+      "Started, %d tokens, poll interval %d ms, mount table %s",
+      count,
+      poll_interval_ms,
+      watcher->mounts_fd != -1 ? "watched" : "not available");
+
+  return watcher;
+}
+
+void pumpnet_lib_profile_token_watcher_stop(
+    struct pumpnet_lib_profile_token_watcher *watcher)
+{
+  log_assert(watcher);
+
+  if (write(watcher->stop_pipe[1], "", 1) != 1) {
+    log_die("Stopping token watcher thread failed: %s", strerror(errno));
+  }
+
+  pthread_join(watcher->thread, NULL);
+
+  close(watcher->stop_pipe[0]);
+  close(watcher->stop_pipe[1]);
+
+  if (watcher->mounts_fd != -1) {
+    close(watcher->mounts_fd);
+  }
+
+  // removes all watches
+  close(watcher->inotify_fd);
+
+  for (size_t i = 0; i < watcher->count; i++) {
+    free(watcher->slots[i].path);
+    free(watcher->slots[i].dir_path);
+  }
+
+  free(watcher->slots);
+  free(watcher);
+
+  log_info("Stopped");
+}
@@ -0,0 +1,39 @@
+#ifndef PUMPNET_LIB_PROFILE_TOKEN_WATCHER_H
+#define PUMPNET_LIB_PROFILE_TOKEN_WATCHER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Watches the paths of profile token files, e.g. one per player on the mount
+// point of a usb stick, to start downloading the profile as soon as a token
+// appears instead of once the game opens the profile files. A thread waits on
+// inotify events of the directories of the tokens and changes of the mount
+// table (mounting a usb stick does not create inotify events on the mount
+// point) and re-checks all tokens on every event and in a fixed interval as
+// fallback.
+
+struct pumpnet_lib_profile_token_watcher;
+
+// called on the watcher thread if the token of a slot (index of its path)
+// appeared or changed. player_ref_id is PUMPNET_LIB_PROFILE_TOKEN_INVALID if
+// the token was removed
+typedef void (*pumpnet_lib_profile_token_watcher_changed_t)(
+    size_t slot, uint64_t player_ref_id, void *ctx);
+
+// start watching the token files of the given paths, the directories do not
+// have to exist, yet. tokens present already are reported right away (on the
+// watcher thread). returns NULL if inotify is not available
+struct pumpnet_lib_profile_token_watcher *
+pumpnet_lib_profile_token_watcher_start(
+    const char **paths,
+    size_t count,
+    uint32_t poll_interval_ms,
+    pumpnet_lib_profile_token_watcher_changed_t changed,
+    void *ctx);
+
+// stop the watcher thread and free the watcher, no callbacks once returned
+void pumpnet_lib_profile_token_watcher_stop(
+    struct pumpnet_lib_profile_token_watcher *watcher);
+
+#endif
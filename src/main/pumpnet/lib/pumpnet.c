@@ -1,10 +1,15 @@
 #define LOG_MODULE "pumpnet"
 
+#include <pthread.h>
 #include <string.h>
 
 #include "pumpnet/lib/http.h"
+#include "pumpnet/lib/profile-cache.h"
 #include "pumpnet/lib/protocol.h"
 #include "pumpnet/lib/pumpnet.h"
+#include "pumpnet/lib/retry.h"
+#include "pumpnet/lib/trace.h"
+#include "pumpnet/lib/upload-queue.h"
 
 #include "util/log.h"
 #include "util/mem.h"
@@ -12,8 +17,21 @@
 #include "util/str.h"
 #include "util/time.h"
 
-#define RETRY_COUNT_ON_ERROR 10
-#define RETRY_TIME_BACKOFF_MS 2000
+struct pumpnet_lib_prefetch_file {
+  // full response including the header
+  void *resp;
+  size_t resp_size;
+  bool done;
+  bool success;
+};
+
+struct pumpnet_lib_prefetch {
+  uint64_t player_ref_id;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  struct pumpnet_lib_prefetch_file files[PUMPNET_LIB_FILE_TYPE_COUNT];
+};
 
 static enum asset_game_version pumpnet_lib_game;
 static char *pumpnet_lib_server_addr;
@@ -22,6 +40,54 @@ static uint64_t pumpnet_lib_machine_id;
 static char *pumpnet_lib_server_endpoint_save;
 static char *pumpnet_lib_server_endpoint_rank;
 
+static struct pumpnet_lib_upload_queue *pumpnet_lib_upload_queue;
+static struct pumpnet_lib_profile_cache *pumpnet_lib_profile_cache;
+static struct pumpnet_lib_trace *pumpnet_lib_trace;
+
+// binary if the server supports it, compression is opt-in as encrypted
+// profile data hardly compresses
+static enum pumpnet_lib_http_transport pumpnet_lib_transport =
+    PUMPNET_LIB_HTTP_TRANSPORT_BINARY;
+
+// requests the game waits for, e.g. loading a profile, give up in time to
+// continue with local/offline mode
+static struct pumpnet_lib_retry_policy pumpnet_lib_retry_policy = {
+    .max_attempts = 6,
+    .base_delay_ms = 250,
+    .max_delay_ms = 4000,
+    .deadline_ms = 15000,
+};
+
+static struct pumpnet_lib_circuit_breaker_config
+    pumpnet_lib_circuit_breaker_config = {
+        .window_size = 20,
+        .min_requests = 5,
+        .failure_threshold_percent = 50,
+        .open_time_ms = 30000,
+};
+
+// single attempt per upload, the upload queue retries in the background
+static const struct pumpnet_lib_retry_policy pumpnet_lib_retry_policy_upload = {
+    .max_attempts = 1,
+    .base_delay_ms = 0,
+    .max_delay_ms = 0,
+    .deadline_ms = 30000,
+};
+
+// uploads are journaled, retry until the server is back
+static const struct pumpnet_lib_retry_policy
+    pumpnet_lib_retry_policy_upload_queue = {
+        .max_attempts = 0,
+        .base_delay_ms = 1000,
+        .max_delay_ms = 60000,
+        .deadline_ms = 0,
+};
+
+static struct pumpnet_lib_circuit_breaker pumpnet_lib_circuit_breaker;
+
+static pthread_mutex_t pumpnet_lib_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct pumpnet_lib_stats pumpnet_lib_stats;
+
 static char *_pumpnet_lib_get_endpoint_save(
     enum asset_game_version game, const char *server_addr)
 {
@@ -59,124 +125,461 @@ static uint64_t _pumpnet_lib_generate_tracing_id()
   return util_rand_gen_64();
 }
 
+static void _pumpnet_lib_stats_add(
+    uint32_t attempts, uint32_t retries, uint32_t failed, uint32_t rejected)
+{
+  pthread_mutex_lock(&pumpnet_lib_stats_mutex);
+
+  pumpnet_lib_stats.attempts += attempts;
+  pumpnet_lib_stats.retries += retries;
+  pumpnet_lib_stats.failed += failed;
+  pumpnet_lib_stats.rejected += rejected;
+
+  pthread_mutex_unlock(&pumpnet_lib_stats_mutex);
+}
+
+// server not reachable or not able to process the request right now
+static bool _pumpnet_lib_is_transient_error(uint32_t http_code)
+{
+  return http_code == 0 || http_code == HTTP_CODE_PRECONDITION_FAILED ||
+      http_code >= 500;
+}
+
+// data received or, on a conditional request, data of the client still valid
+static bool
+_pumpnet_lib_is_successful(const struct pumpnet_lib_http_request *request)
+{
+  return request->http_code == HTTP_CODE_OK ||
+      (request->http_code == HTTP_CODE_NOT_MODIFIED && request->if_none_match);
+}
+
 static bool _pumpnet_lib_get_put(
-    uint64_t trace_id,
-    const char *endpoint,
-    void *req_buffer,
-    size_t req_size,
-    void *resp_buffer,
-    size_t resp_size,
-    bool is_post)
+    struct pumpnet_lib_http_request *request,
+    const struct pumpnet_lib_retry_policy *policy,
+    struct pumpnet_lib_trace_span *span)
 {
-  uint32_t http_code;
+  uint64_t start_ms;
+  uint64_t elapsed_ms;
+  uint32_t delay_ms;
+  bool transient;
   bool success;
 
-  http_code = 0;
+  request->http_code = 0;
   success = false;
+  start_ms = util_time_get_monotonic_ns() / 1000 / 1000;
+
+  for (uint32_t i = 0; policy->max_attempts == 0 || i < policy->max_attempts;
+       i++) {
+    // remaining time of the deadline bounds the attempt
+    request->timeout_ms = 0;
+
+    if (policy->deadline_ms > 0) {
+      elapsed_ms = util_time_get_monotonic_ns() / 1000 / 1000 - start_ms;
+
+      if (elapsed_ms >= policy->deadline_ms) {
+        break;
+      }
+
+      request->timeout_ms = policy->deadline_ms - elapsed_ms;
+    }
+
+    if (!pumpnet_lib_circuit_breaker_allow(&pumpnet_lib_circuit_breaker)) {
+      log_warn(
+          "[%llX][%s][%s] Server unavailable, failing fast",
+          request->trace_id,
+          request->is_post ? "post" : "get",
+          request->address);
+
+      _pumpnet_lib_stats_add(0, 0, 0, 1);
+
+      request->http_code = 0;
+      success = false;
+      break;
+    }
+
+    // timing of this attempt only
+    memset(&request->timing, 0, sizeof(struct pumpnet_lib_http_timing));
+
+    success = pumpnet_lib_http_get_put_request(request);
+
+    _pumpnet_lib_stats_add(1, i > 0 ? 1 : 0, 0, 0);
+    pumpnet_lib_trace_span_add_attempt(span, request);
+
+    transient = _pumpnet_lib_is_transient_error(request->http_code);
+
+    pumpnet_lib_circuit_breaker_record(
+        &pumpnet_lib_circuit_breaker, !transient);
+
+    if (!transient) {
+      break;
+    }
+
+    if (policy->max_attempts != 0 && i + 1 >= policy->max_attempts) {
+      break;
+    }
+
+    delay_ms = pumpnet_lib_retry_policy_get_delay_ms(policy, i);
 
-  for (int i = 0; i < RETRY_COUNT_ON_ERROR; i++) {
-    success = pumpnet_lib_http_get_put(
-        trace_id,
-        endpoint,
-        req_buffer,
-        req_size,
-        resp_buffer,
-        resp_size,
-        &http_code,
-        is_post);
-
-    if (http_code == 0 || http_code == HTTP_CODE_PRECONDITION_FAILED) {
+    if (policy->deadline_ms > 0 &&
+        util_time_get_monotonic_ns() / 1000 / 1000 - start_ms + delay_ms >=
+            policy->deadline_ms) {
       log_warn(
-          "[%llX][%s][%s] Failed, http code %d, retrying (%d)...",
-          trace_id,
-          is_post ? "post" : "get",
-          endpoint,
-          http_code,
-          i);
-
-      util_time_sleep_ms(RETRY_TIME_BACKOFF_MS);
-    } else {
+          "[%llX][%s][%s] Failed, http code %d, deadline of %d ms exceeded",
+          request->trace_id,
+          request->is_post ? "post" : "get",
+          request->address,
+          request->http_code,
+          policy->deadline_ms);
       break;
     }
+
+    log_warn(
+        "[%llX][%s][%s] Failed, http code %d, retrying in %d ms (%d)...",
+        request->trace_id,
+        request->is_post ? "post" : "get",
+        request->address,
+        request->http_code,
+        delay_ms,
+        i);
+
+    pumpnet_lib_trace_span_add_backoff(span, delay_ms);
+    util_time_sleep_ms(delay_ms);
+  }
+
+  if (!success || !_pumpnet_lib_is_successful(request)) {
+    _pumpnet_lib_stats_add(0, 0, 1, 0);
   }
 
   if (!success) {
     log_error(
-        "[%llX][%s][%s] Failed", trace_id, is_post ? "post" : "get", endpoint);
+        "[%llX][%s][%s] Failed",
+        request->trace_id,
+        request->is_post ? "post" : "get",
+        request->address);
 
     return false;
-  } else if (http_code != 200) {
+  } else if (!_pumpnet_lib_is_successful(request)) {
     log_error(
         "[%llX][%s][%s] Get non successful: %d",
-        trace_id,
-        is_post ? "post" : "get",
-        endpoint,
-        http_code);
+        request->trace_id,
+        request->is_post ? "post" : "get",
+        request->address,
+        request->http_code);
     return false;
   }
 
   return true;
 }
 
-static bool
-_pumpnet_lib_get_rank(uint64_t player_ref_id, void *buffer, size_t size)
+static void
+_pumpnet_lib_trace_record(struct pumpnet_lib_trace_span *span, bool success)
 {
-  log_assert(buffer);
+  pumpnet_lib_trace_span_end(span, success);
 
-  struct pumpnet_lib_get_rank_req req;
-  struct pumpnet_lib_get_rank_resp *resp;
-  size_t resp_size;
-  uint64_t trace_id;
+  if (pumpnet_lib_trace) {
+    pumpnet_lib_trace_record(pumpnet_lib_trace, span);
+  }
+}
 
-  trace_id = _pumpnet_lib_generate_tracing_id();
+static const char *
+_pumpnet_lib_get_file_endpoint(enum pumpnet_lib_file_type file_type)
+{
+  switch (file_type) {
+    case PUMPNET_LIB_FILE_TYPE_SAVE:
+      return pumpnet_lib_server_endpoint_save;
 
-  req.trace_id = trace_id;
-  req.machine_id = pumpnet_lib_machine_id;
-  req.player_ref_id = player_ref_id;
+    case PUMPNET_LIB_FILE_TYPE_RANK:
+      return pumpnet_lib_server_endpoint_rank;
 
-  resp_size = sizeof(struct pumpnet_lib_get_rank_resp) + size;
-  resp = util_xmalloc(resp_size);
+    case PUMPNET_LIB_FILE_TYPE_COUNT:
+    default:
+      log_die_illegal_state();
+      return NULL;
+  }
+}
 
-  log_info("[%llX] Get rank", trace_id);
+static const char *
+_pumpnet_lib_get_file_type_str(enum pumpnet_lib_file_type file_type)
+{
+  switch (file_type) {
+    case PUMPNET_LIB_FILE_TYPE_SAVE:
+      return "save";
 
-  if (!_pumpnet_lib_get_put(
-          trace_id,
-          pumpnet_lib_server_endpoint_rank,
-          &req,
-          sizeof(req),
-          resp,
-          resp_size,
-          false)) {
-    free(resp);
-    return false;
+    case PUMPNET_LIB_FILE_TYPE_RANK:
+      return "rank";
+
+    case PUMPNET_LIB_FILE_TYPE_COUNT:
+    default:
+      log_die_illegal_state();
+      return NULL;
+  }
+}
+
+static void _pumpnet_lib_init_request(
+    struct pumpnet_lib_http_request *request,
+    uint64_t trace_id,
+    enum pumpnet_lib_file_type file_type,
+    void *send_data,
+    size_t send_size,
+    void *recv_data,
+    size_t recv_size,
+    bool is_post)
+{
+  memset(request, 0, sizeof(struct pumpnet_lib_http_request));
+
+  request->trace_id = trace_id;
+  request->address = _pumpnet_lib_get_file_endpoint(file_type);
+  request->send_data = send_data;
+  request->send_size = send_size;
+  request->recv_data = recv_data;
+  request->recv_size = recv_size;
+  request->is_post = is_post;
+  request->if_none_match = NULL;
+}
+
+// entity tag of the cached file to revalidate it with the server, NULL if
+// there is no cached file
+static const char *_pumpnet_lib_get_cached_etag(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    char *etag)
+{
+  if (!pumpnet_lib_profile_cache ||
+      !pumpnet_lib_profile_cache_get_etag(
+          pumpnet_lib_profile_cache, file_type, player_ref_id, etag)) {
+    return NULL;
+  }
+
+  return etag;
+}
+
+static void _pumpnet_lib_update_cache(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size,
+    const char *etag)
+{
+  if (!pumpnet_lib_profile_cache) {
+    return;
+  }
+
+  // without an entity tag, the data can't be revalidated. drop the outdated
+  // cached file instead
+  if (etag[0] == '\0' ||
+      !pumpnet_lib_profile_cache_store(
+          pumpnet_lib_profile_cache,
+          file_type,
+          player_ref_id,
+          data,
+          size,
+          etag)) {
+    pumpnet_lib_profile_cache_invalidate(
+        pumpnet_lib_profile_cache, file_type, player_ref_id);
+  }
+}
+
+// complete a successful get: serve the cached file if not modified, cache the
+// received data otherwise. the recv data of the request is a get resp
+static bool _pumpnet_lib_get_complete(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    struct pumpnet_lib_http_request *request,
+    struct pumpnet_lib_trace_span *span)
+{
+  // identical layout for save and rank
+  struct pumpnet_lib_get_save_resp *resp;
+  size_t size;
+  size_t data_size;
+
+  resp = (struct pumpnet_lib_get_save_resp *) request->recv_data;
+  size = request->recv_size - sizeof(struct pumpnet_lib_get_save_resp);
+
+  if (request->http_code == HTTP_CODE_NOT_MODIFIED) {
+    if (pumpnet_lib_profile_cache_load(
+            pumpnet_lib_profile_cache,
+            file_type,
+            player_ref_id,
+            resp->data,
+            size,
+            &data_size)) {
+      log_info(
+          "[%llX] Player %llX, %s not modified, served from cache",
+          request->trace_id,
+          player_ref_id,
+          _pumpnet_lib_get_file_type_str(file_type));
+
+      resp->size = data_size;
+      return true;
+    }
+
+    // cached file corrupted or removed since revalidating it
+    log_warn(
+        "[%llX] Player %llX, %s cache miss, get unconditionally",
+        request->trace_id,
+        player_ref_id,
+        _pumpnet_lib_get_file_type_str(file_type));
+
+    request->if_none_match = NULL;
+
+    if (!_pumpnet_lib_get_put(request, &pumpnet_lib_retry_policy, span)) {
+      return false;
+    }
   }
 
   if (resp->size > size) {
     log_error(
-        "[%llX] Rank resp size greater than buffer size: %d > %d",
-        trace_id,
+        "[%llX] %s resp size greater than buffer size: %d > %d",
+        request->trace_id,
+        _pumpnet_lib_get_file_type_str(file_type),
         resp->size,
         size);
-    free(resp);
     return false;
   }
 
-  memcpy(buffer, resp->data, resp->size);
-
-  free(resp);
+  _pumpnet_lib_update_cache(
+      file_type, player_ref_id, resp->data, resp->size, request->etag);
 
   return true;
 }
 
-static bool
-_pumpnet_lib_get_save(uint64_t player_ref_id, void *buffer, size_t size)
+static void *_pumpnet_lib_prefetch_thread_proc(void *ctx)
+{
+  struct pumpnet_lib_prefetch *prefetch;
+  // identical layout for save and rank
+  struct pumpnet_lib_get_save_req reqs[PUMPNET_LIB_FILE_TYPE_COUNT];
+  struct pumpnet_lib_http_request requests[PUMPNET_LIB_FILE_TYPE_COUNT];
+  char etags[PUMPNET_LIB_FILE_TYPE_COUNT][PUMPNET_LIB_HTTP_ETAG_SIZE];
+  struct pumpnet_lib_trace_span spans[PUMPNET_LIB_FILE_TYPE_COUNT];
+  struct pumpnet_lib_retry_policy policy;
+  uint64_t start_ms;
+  uint64_t elapsed_ms;
+  bool attempted;
+  bool transient;
+  bool success;
+
+  prefetch = (struct pumpnet_lib_prefetch *) ctx;
+  attempted = false;
+  start_ms = util_time_get_monotonic_ns() / 1000 / 1000;
+
+  for (int i = 0; i < PUMPNET_LIB_FILE_TYPE_COUNT; i++) {
+    reqs[i].trace_id = _pumpnet_lib_generate_tracing_id();
+    reqs[i].machine_id = pumpnet_lib_machine_id;
+    reqs[i].player_ref_id = prefetch->player_ref_id;
+
+    _pumpnet_lib_init_request(
+        &requests[i],
+        reqs[i].trace_id,
+        i,
+        &reqs[i],
+        sizeof(reqs[i]),
+        prefetch->files[i].resp,
+        prefetch->files[i].resp_size,
+        false);
+
+    requests[i].timeout_ms = pumpnet_lib_retry_policy.deadline_ms;
+    requests[i].if_none_match =
+        _pumpnet_lib_get_cached_etag(i, prefetch->player_ref_id, etags[i]);
+
+    pumpnet_lib_trace_span_begin(
+        &spans[i], reqs[i].trace_id, prefetch->player_ref_id, i, false);
+  }
+
+  log_info(
+      "[%llX][%llX] Prefetch save and rank",
+      reqs[PUMPNET_LIB_FILE_TYPE_SAVE].trace_id,
+      reqs[PUMPNET_LIB_FILE_TYPE_RANK].trace_id);
+
+  // fails fast with the fallback below if the server is unavailable
+  if (pumpnet_lib_circuit_breaker_allow(&pumpnet_lib_circuit_breaker)) {
+    pumpnet_lib_http_get_put_multi(requests, PUMPNET_LIB_FILE_TYPE_COUNT);
+
+    _pumpnet_lib_stats_add(PUMPNET_LIB_FILE_TYPE_COUNT, 0, 0, 0);
+
+    attempted = true;
+    transient = false;
+
+    for (int i = 0; i < PUMPNET_LIB_FILE_TYPE_COUNT; i++) {
+      transient |= _pumpnet_lib_is_transient_error(requests[i].http_code);
+      pumpnet_lib_trace_span_add_attempt(&spans[i], &requests[i]);
+    }
+
+    pumpnet_lib_circuit_breaker_record(
+        &pumpnet_lib_circuit_breaker, !transient);
+  }
+
+  for (int i = 0; i < PUMPNET_LIB_FILE_TYPE_COUNT; i++) {
+    success = requests[i].success && _pumpnet_lib_is_successful(&requests[i]);
+
+    if (!success && _pumpnet_lib_is_transient_error(requests[i].http_code)) {
+      // connection error or server not ready, retry with the regular backoff
+      // within what is left of the deadline of the multi attempt
+      policy = pumpnet_lib_retry_policy;
+      elapsed_ms = util_time_get_monotonic_ns() / 1000 / 1000 - start_ms;
+
+      if (policy.deadline_ms > 0 && elapsed_ms >= policy.deadline_ms) {
+        _pumpnet_lib_stats_add(0, 0, 1, 0);
+
+        log_error(
+            "[%llX][get][%s] Failed, deadline of %d ms exceeded",
+            requests[i].trace_id,
+            requests[i].address,
+            policy.deadline_ms);
+      } else {
+        if (policy.deadline_ms > 0) {
+          policy.deadline_ms -= elapsed_ms;
+        }
+
+        if (attempted) {
+          _pumpnet_lib_stats_add(0, 1, 0, 0);
+        }
+
+        success = _pumpnet_lib_get_put(&requests[i], &policy, &spans[i]);
+      }
+    } else if (!success) {
+      _pumpnet_lib_stats_add(0, 0, 1, 0);
+
+      log_error(
+          "[%llX][get][%s] Get non successful: %d",
+          requests[i].trace_id,
+          requests[i].address,
+          requests[i].http_code);
+    }
+
+    if (success) {
+      success = _pumpnet_lib_get_complete(
+          i, prefetch->player_ref_id, &requests[i], &spans[i]);
+    }
+
+    _pumpnet_lib_trace_record(&spans[i], success);
+
+    pthread_mutex_lock(&prefetch->mutex);
+    prefetch->files[i].done = true;
+    prefetch->files[i].success = success;
+    pthread_cond_broadcast(&prefetch->cond);
+    pthread_mutex_unlock(&prefetch->mutex);
+  }
+
+  return NULL;
+}
+
+static bool _pumpnet_lib_get(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    void *buffer,
+    size_t size)
 {
   log_assert(buffer);
 
+  // identical layout for save and rank
   struct pumpnet_lib_get_save_req req;
   struct pumpnet_lib_get_save_resp *resp;
+  struct pumpnet_lib_http_request request;
+  struct pumpnet_lib_trace_span span;
+  char etag[PUMPNET_LIB_HTTP_ETAG_SIZE];
   size_t resp_size;
   uint64_t trace_id;
+  bool success;
 
   trace_id = _pumpnet_lib_generate_tracing_id();
 
@@ -187,26 +590,32 @@ _pumpnet_lib_get_save(uint64_t player_ref_id, void *buffer, size_t size)
   resp_size = sizeof(struct pumpnet_lib_get_save_resp) + size;
   resp = util_xmalloc(resp_size);
 
-  log_info("[%llX] Get save", trace_id);
+  _pumpnet_lib_init_request(
+      &request,
+      trace_id,
+      file_type,
+      &req,
+      sizeof(req),
+      resp,
+      resp_size,
+      false);
 
-  if (!_pumpnet_lib_get_put(
-          trace_id,
-          pumpnet_lib_server_endpoint_save,
-          &req,
-          sizeof(req),
-          resp,
-          resp_size,
-          false)) {
-    free(resp);
-    return false;
-  }
+  request.if_none_match =
+      _pumpnet_lib_get_cached_etag(file_type, player_ref_id, etag);
 
-  if (resp->size > size) {
-    log_error(
-        "[%llX] Save resp size greater than buffer size: %d > %d",
-        trace_id,
-        resp->size,
-        size);
+  log_info(
+      "[%llX] Get %s", trace_id, _pumpnet_lib_get_file_type_str(file_type));
+
+  pumpnet_lib_trace_span_begin(
+      &span, trace_id, player_ref_id, file_type, false);
+
+  success =
+      _pumpnet_lib_get_put(&request, &pumpnet_lib_retry_policy, &span) &&
+      _pumpnet_lib_get_complete(file_type, player_ref_id, &request, &span);
+
+  _pumpnet_lib_trace_record(&span, success);
+
+  if (!success) {
     free(resp);
     return false;
   }
@@ -218,19 +627,28 @@ _pumpnet_lib_get_save(uint64_t player_ref_id, void *buffer, size_t size)
   return true;
 }
 
-static bool
-_pumpnet_lib_put_rank(uint64_t player_ref_id, const void *buffer, size_t size)
+static bool _pumpnet_lib_put(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *buffer,
+    size_t size,
+    const struct pumpnet_lib_retry_policy *policy,
+    uint32_t *http_code)
 {
   log_assert(buffer);
 
-  struct pumpnet_lib_put_rank_req *req;
-  struct pumpnet_lib_put_rank_resp resp;
+  // identical layout for save and rank
+  struct pumpnet_lib_put_save_req *req;
+  struct pumpnet_lib_put_save_resp resp;
+  struct pumpnet_lib_http_request request;
+  struct pumpnet_lib_trace_span span;
   size_t req_size;
   uint64_t trace_id;
+  bool success;
 
   trace_id = _pumpnet_lib_generate_tracing_id();
 
-  req_size = sizeof(struct pumpnet_lib_put_rank_req) + size;
+  req_size = sizeof(struct pumpnet_lib_put_save_req) + size;
   req = util_xmalloc(req_size);
 
   req->trace_id = trace_id;
@@ -239,63 +657,105 @@ _pumpnet_lib_put_rank(uint64_t player_ref_id, const void *buffer, size_t size)
   req->size = size;
   memcpy(req->data, buffer, size);
 
-  log_info("[%llX] Put rank", trace_id);
-
-  if (!_pumpnet_lib_get_put(
-          trace_id,
-          pumpnet_lib_server_endpoint_rank,
-          req,
-          req_size,
-          &resp,
-          sizeof(resp),
-          true)) {
-    free(req);
-    return false;
+  _pumpnet_lib_init_request(
+      &request,
+      trace_id,
+      file_type,
+      req,
+      req_size,
+      &resp,
+      sizeof(resp),
+      true);
+
+  log_info(
+      "[%llX] Put %s", trace_id, _pumpnet_lib_get_file_type_str(file_type));
+
+  pumpnet_lib_trace_span_begin(&span, trace_id, player_ref_id, file_type, true);
+
+  success = _pumpnet_lib_get_put(&request, policy, &span);
+  *http_code = request.http_code;
+
+  _pumpnet_lib_trace_record(&span, success);
+
+  // uploaded data is the latest one, cached if the server tagged it
+  if (success) {
+    _pumpnet_lib_update_cache(
+        file_type, player_ref_id, buffer, size, request.etag);
   }
 
   free(req);
 
-  return true;
+  return success;
 }
 
-static bool
-_pumpnet_lib_put_save(uint64_t player_ref_id, const void *buffer, size_t size)
+static bool _pumpnet_lib_get_pending_upload(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    void *buffer,
+    size_t size)
 {
-  log_assert(buffer);
+  if (!pumpnet_lib_upload_queue ||
+      !pumpnet_lib_upload_queue_get_pending(
+          pumpnet_lib_upload_queue, file_type, player_ref_id, buffer, size)) {
+    return false;
+  }
 
-  struct pumpnet_lib_put_save_req *req;
-  struct pumpnet_lib_put_save_resp resp;
-  size_t req_size;
-  uint64_t trace_id;
+  // server does not have the latest data until the upload completed
+  log_info(
+      "Player %llX, file type %d, served from pending upload",
+      player_ref_id,
+      file_type);
 
-  trace_id = _pumpnet_lib_generate_tracing_id();
+  return true;
+}
 
-  req_size = sizeof(struct pumpnet_lib_put_save_req) + size;
-  req = util_xmalloc(req_size);
+static enum pumpnet_lib_upload_queue_result _pumpnet_lib_upload_queue_put(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size,
+    void *ctx)
+{
+  uint32_t http_code;
 
-  req->trace_id = trace_id;
-  req->machine_id = pumpnet_lib_machine_id;
-  req->player_ref_id = player_ref_id;
-  req->size = size;
-  memcpy(req->data, buffer, size);
+  // retrying is up to the queue, which does not block the game
+  if (_pumpnet_lib_put(
+          file_type,
+          player_ref_id,
+          data,
+          size,
+          &pumpnet_lib_retry_policy_upload,
+          &http_code)) {
+    return PUMPNET_LIB_UPLOAD_QUEUE_RESULT_OK;
+  }
 
-  log_info("[%llX] Put save", trace_id);
-
-  if (!_pumpnet_lib_get_put(
-          trace_id,
-          pumpnet_lib_server_endpoint_save,
-          req,
-          req_size,
-          &resp,
-          sizeof(resp),
-          true)) {
-    free(req);
-    return false;
+  if (_pumpnet_lib_is_transient_error(http_code)) {
+    return PUMPNET_LIB_UPLOAD_QUEUE_RESULT_RETRY;
   }
 
-  free(req);
+  return PUMPNET_LIB_UPLOAD_QUEUE_RESULT_FAILED;
+}
 
-  return true;
+void pumpnet_lib_configure_retry(
+    const struct pumpnet_lib_retry_policy *policy,
+    const struct pumpnet_lib_circuit_breaker_config *circuit_breaker_config)
+{
+  log_assert(policy);
+  log_assert(circuit_breaker_config);
+
+  memcpy(
+      &pumpnet_lib_retry_policy,
+      policy,
+      sizeof(struct pumpnet_lib_retry_policy));
+  memcpy(
+      &pumpnet_lib_circuit_breaker_config,
+      circuit_breaker_config,
+      sizeof(struct pumpnet_lib_circuit_breaker_config));
+}
+
+void pumpnet_lib_configure_transport(enum pumpnet_lib_http_transport transport)
+{
+  pumpnet_lib_transport = transport;
 }
 
 void pumpnet_lib_init(
@@ -305,7 +765,17 @@ void pumpnet_lib_init(
     const char *cert_dir_path,
     bool verbose_debug_log)
 {
-  pumpnet_lib_http_init(cert_dir_path, verbose_debug_log);
+  pumpnet_lib_http_init(
+      cert_dir_path,
+      PUMPNET_LIB_HTTP_DEFAULT_POOL_SIZE,
+      pumpnet_lib_transport,
+      verbose_debug_log);
+  pumpnet_lib_circuit_breaker_init(
+      &pumpnet_lib_circuit_breaker, &pumpnet_lib_circuit_breaker_config);
+
+  pthread_mutex_lock(&pumpnet_lib_stats_mutex);
+  memset(&pumpnet_lib_stats, 0, sizeof(struct pumpnet_lib_stats));
+  pthread_mutex_unlock(&pumpnet_lib_stats_mutex);
 
   pumpnet_lib_game = game;
   pumpnet_lib_server_addr = util_str_dup(server_addr);
@@ -324,34 +794,92 @@ void pumpnet_lib_init(
       USBPROFILE_ENDPOINT);
 }
 
+bool pumpnet_lib_init_upload_journal(const char *journal_path)
+{
+  log_assert(journal_path);
+  log_assert(!pumpnet_lib_upload_queue);
+
+  pumpnet_lib_upload_queue = pumpnet_lib_upload_queue_open(
+      journal_path,
+      &pumpnet_lib_retry_policy_upload_queue,
+      _pumpnet_lib_upload_queue_put,
+      NULL);
+
+  return pumpnet_lib_upload_queue != NULL;
+}
+
+bool pumpnet_lib_init_profile_cache(const char *dir_path)
+{
+  log_assert(dir_path);
+  log_assert(!pumpnet_lib_profile_cache);
+
+  pumpnet_lib_profile_cache =
+      pumpnet_lib_profile_cache_open(dir_path, pumpnet_lib_game);
+
+  return pumpnet_lib_profile_cache != NULL;
+}
+
+bool pumpnet_lib_init_trace(const char *path)
+{
+  log_assert(path);
+  log_assert(!pumpnet_lib_trace);
+
+  pumpnet_lib_trace = pumpnet_lib_trace_open(
+      path,
+      util_str_ends_with(path, ".bin") ? PUMPNET_LIB_TRACE_FORMAT_BINARY :
+                                         PUMPNET_LIB_TRACE_FORMAT_JSONL);
+
+  return pumpnet_lib_trace != NULL;
+}
+
 void pumpnet_lib_shutdown()
 {
+  if (pumpnet_lib_upload_queue) {
+    pumpnet_lib_upload_queue_close(pumpnet_lib_upload_queue);
+    pumpnet_lib_upload_queue = NULL;
+  }
+
+  // after the upload queue which updates the cache on completed uploads
+  if (pumpnet_lib_profile_cache) {
+    pumpnet_lib_profile_cache_close(pumpnet_lib_profile_cache);
+    pumpnet_lib_profile_cache = NULL;
+  }
+
+  // after the upload queue which records spans of its uploads
+  if (pumpnet_lib_trace) {
+    pumpnet_lib_trace_close(pumpnet_lib_trace);
+    pumpnet_lib_trace = NULL;
+  }
+
   free(pumpnet_lib_server_endpoint_save);
   free(pumpnet_lib_server_endpoint_rank);
 
   pumpnet_lib_http_shutdown();
+  pumpnet_lib_circuit_breaker_fini(&pumpnet_lib_circuit_breaker);
 
   log_info("Shut down");
 }
 
+void pumpnet_lib_get_stats(struct pumpnet_lib_stats *stats)
+{
+  log_assert(stats);
+
+  pthread_mutex_lock(&pumpnet_lib_stats_mutex);
+  memcpy(stats, &pumpnet_lib_stats, sizeof(struct pumpnet_lib_stats));
+  pthread_mutex_unlock(&pumpnet_lib_stats_mutex);
+}
+
 bool pumpnet_lib_get(
     enum pumpnet_lib_file_type file_type,
     uint64_t player_ref_id,
     void *buffer,
     size_t size)
 {
-  switch (file_type) {
-    case PUMPNET_LIB_FILE_TYPE_SAVE:
-      return _pumpnet_lib_get_save(player_ref_id, buffer, size);
-
-    case PUMPNET_LIB_FILE_TYPE_RANK:
-      return _pumpnet_lib_get_rank(player_ref_id, buffer, size);
-
-    case PUMPNET_LIB_FILE_TYPE_COUNT:
-    default:
-      log_die_illegal_state();
-      return false;
+  if (_pumpnet_lib_get_pending_upload(file_type, player_ref_id, buffer, size)) {
+    return true;
   }
+
+  return _pumpnet_lib_get(file_type, player_ref_id, buffer, size);
 }
 
 bool pumpnet_lib_put(
@@ -360,16 +888,126 @@ bool pumpnet_lib_put(
     const void *buffer,
     size_t size)
 {
-  switch (file_type) {
-    case PUMPNET_LIB_FILE_TYPE_SAVE:
-      return _pumpnet_lib_put_save(player_ref_id, buffer, size);
+  uint32_t http_code;
 
-    case PUMPNET_LIB_FILE_TYPE_RANK:
-      return _pumpnet_lib_put_rank(player_ref_id, buffer, size);
+  return _pumpnet_lib_put(
+      file_type,
+      player_ref_id,
+      buffer,
+      size,
+      &pumpnet_lib_retry_policy,
+      &http_code);
+}
 
-    case PUMPNET_LIB_FILE_TYPE_COUNT:
-    default:
-      log_die_illegal_state();
-      return false;
+bool pumpnet_lib_put_async(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *buffer,
+    size_t size)
+{
+  if (!pumpnet_lib_upload_queue) {
+    return pumpnet_lib_put(file_type, player_ref_id, buffer, size);
   }
+
+  return pumpnet_lib_upload_queue_push(
+      pumpnet_lib_upload_queue, file_type, player_ref_id, buffer, size);
+}
+
+struct pumpnet_lib_prefetch *pumpnet_lib_prefetch_start(
+    uint64_t player_ref_id, size_t save_size, size_t rank_size)
+{
+  struct pumpnet_lib_prefetch *prefetch;
+
+  prefetch = util_xmalloc(sizeof(struct pumpnet_lib_prefetch));
+  memset(prefetch, 0, sizeof(struct pumpnet_lib_prefetch));
+
+  prefetch->player_ref_id = player_ref_id;
+
+  prefetch->files[PUMPNET_LIB_FILE_TYPE_SAVE].resp_size =
+      sizeof(struct pumpnet_lib_get_save_resp) + save_size;
+  prefetch->files[PUMPNET_LIB_FILE_TYPE_RANK].resp_size =
+      sizeof(struct pumpnet_lib_get_rank_resp) + rank_size;
+
+  for (int i = 0; i < PUMPNET_LIB_FILE_TYPE_COUNT; i++) {
+    prefetch->files[i].resp = util_xmalloc(prefetch->files[i].resp_size);
+  }
+
+  pthread_mutex_init(&prefetch->mutex, NULL);
+  pthread_cond_init(&prefetch->cond, NULL);
+
+  if (pthread_create(
+          &prefetch->thread,
+          NULL,
+          _pumpnet_lib_prefetch_thread_proc,
+          prefetch) != 0) {
+    log_die("Creating prefetch thread failed");
+  }
+
+  return prefetch;
+}
+
+bool pumpnet_lib_prefetch_wait(
+    struct pumpnet_lib_prefetch *prefetch,
+    enum pumpnet_lib_file_type file_type,
+    void *buffer,
+    size_t size)
+{
+  log_assert(prefetch);
+  log_assert(file_type < PUMPNET_LIB_FILE_TYPE_COUNT);
+  log_assert(buffer);
+
+  struct pumpnet_lib_prefetch_file *file;
+  // identical layout for save and rank
+  struct pumpnet_lib_get_save_resp *resp;
+
+  file = &prefetch->files[file_type];
+
+  // pending upload is newer than the data of the server
+  if (_pumpnet_lib_get_pending_upload(
+          file_type, prefetch->player_ref_id, buffer, size)) {
+    return true;
+  }
+
+  pthread_mutex_lock(&prefetch->mutex);
+
+  while (!file->done) {
+    pthread_cond_wait(&prefetch->cond, &prefetch->mutex);
+  }
+
+  pthread_mutex_unlock(&prefetch->mutex);
+
+  if (!file->success) {
+    return false;
+  }
+
+  resp = (struct pumpnet_lib_get_save_resp *) file->resp;
+
+  if (resp->size > size) {
+    log_error(
+        "Prefetch file type %d resp size greater than buffer size: %d > %d",
+        file_type,
+        resp->size,
+        size);
+    return false;
+  }
+
+  memcpy(buffer, resp->data, resp->size);
+
+  return true;
+}
+
+void pumpnet_lib_prefetch_free(struct pumpnet_lib_prefetch *prefetch)
+{
+  log_assert(prefetch);
+
+  pthread_join(prefetch->thread, NULL);
+
+  pthread_cond_destroy(&prefetch->cond);
+  pthread_mutex_destroy(&prefetch->mutex);
+
+  for (int i = 0; i < PUMPNET_LIB_FILE_TYPE_COUNT; i++) {
+    free(prefetch->files[i].resp);
+  }
+
+  free(prefetch);
 }
@@ -11,12 +11,28 @@
 
 #include "asset/game-version.h"
 
+#include "pumpnet/lib/http.h"
+#include "pumpnet/lib/retry.h"
+
+struct pumpnet_lib_prefetch;
+
 enum pumpnet_lib_file_type {
   PUMPNET_LIB_FILE_TYPE_SAVE = 0,
   PUMPNET_LIB_FILE_TYPE_RANK = 1,
   PUMPNET_LIB_FILE_TYPE_COUNT = 2,
 };
 
+// override the default retry policy of requests and the config of the circuit
+// breaker shared by all requests. call before init
+void pumpnet_lib_configure_retry(
+    const struct pumpnet_lib_retry_policy *policy,
+    const struct pumpnet_lib_circuit_breaker_config *circuit_breaker_config);
+
+// max transport (encoding) of request and response bodies, the actual one is
+// negotiated with the server. default binary without compression. call before
+// init
+void pumpnet_lib_configure_transport(enum pumpnet_lib_http_transport transport);
+
 void pumpnet_lib_init(
     enum asset_game_version game,
     const char *server_addr,
@@ -24,8 +40,38 @@ void pumpnet_lib_init(
     const char *cert_dir_path,
     bool verbose_debug_log);
 
+// enable asynchronous uploads (see pumpnet_lib_put_async) backed by a journal
+// file. pending uploads of the journal, e.g. after a power loss, are replayed.
+// returns false if the journal can't be opened
+bool pumpnet_lib_init_upload_journal(const char *journal_path);
+
+// cache downloaded and uploaded files in the given directory. gets revalidate
+// the cached files with the server which responds without the data if it did
+// not change. returns false if the directory can't be created
+bool pumpnet_lib_init_profile_cache(const char *dir_path);
+
+// trace all requests to the given file, one span per get and put with the
+// durations of the network phases, encoding/decoding and retries. binary
+// format if the path ends with .bin, JSON lines otherwise. histograms of the
+// spans are logged on shutdown. returns false if the file can't be opened
+bool pumpnet_lib_init_trace(const char *path);
+
 void pumpnet_lib_shutdown();
 
+// counters of the requests executed since init, e.g. to evaluate load tests
+struct pumpnet_lib_stats {
+  // http requests sent, including retries
+  uint64_t attempts;
+  // attempts repeating a previous one which failed with a transient error
+  uint64_t retries;
+  // requests failed after all attempts
+  uint64_t failed;
+  // requests failed fast without an attempt, circuit breaker open
+  uint64_t rejected;
+};
+
+void pumpnet_lib_get_stats(struct pumpnet_lib_stats *stats);
+
 bool pumpnet_lib_get(
     enum pumpnet_lib_file_type file_type,
     uint64_t player_ref_id,
@@ -38,4 +84,29 @@ bool pumpnet_lib_put(
     const void *buffer,
     size_t size);
 
+// queue an upload which is journaled and retried on a background thread,
+// returns once the data is persisted in the journal. uploads synchronously
+// (see pumpnet_lib_put) if the upload journal is not enabled
+bool pumpnet_lib_put_async(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *buffer,
+    size_t size);
+
+// start downloading save and rank of a player concurrently on a background
+// thread. save_size and rank_size are the max sizes of the file data
+struct pumpnet_lib_prefetch *pumpnet_lib_prefetch_start(
+    uint64_t player_ref_id, size_t save_size, size_t rank_size);
+
+// wait for the download of a file of a prefetch to complete (returns
+// immediately if already completed) and copy the data to the buffer
+bool pumpnet_lib_prefetch_wait(
+    struct pumpnet_lib_prefetch *prefetch,
+    enum pumpnet_lib_file_type file_type,
+    void *buffer,
+    size_t size);
+
+// wait for all downloads of a prefetch to complete and free it
+void pumpnet_lib_prefetch_free(struct pumpnet_lib_prefetch *prefetch);
+
 #endif
@@ -0,0 +1,204 @@
+#define LOG_MODULE "pumpnet-retry"
+
+#include <string.h>
+
+#include "pumpnet/lib/retry.h"
+
+#include "util/log.h"
+#include "util/rand.h"
+#include "util/time.h"
+
+#define WINDOW_SIZE_MAX 64
+
+static void _pumpnet_lib_circuit_breaker_open(
+    struct pumpnet_lib_circuit_breaker *breaker)
+{
+  breaker->state = PUMPNET_LIB_CIRCUIT_BREAKER_STATE_OPEN;
+  breaker->open_until_ns = util_time_get_monotonic_ns() +
+      (uint64_t) breaker->config.open_time_ms * 1000 * 1000;
+}
+
+static void _pumpnet_lib_circuit_breaker_reset_window(
+    struct pumpnet_lib_circuit_breaker *breaker)
+{
+  breaker->window = 0;
+  breaker->window_pos = 0;
+  breaker->window_count = 0;
+}
+
+uint32_t pumpnet_lib_retry_policy_get_delay_ms(
+    const struct pumpnet_lib_retry_policy *policy, uint32_t attempt)
+{
+  log_assert(policy);
+
+  uint64_t cap;
+
+  // saturate instead of overflowing the shift
+  if (attempt >= 32) {
+    cap = policy->max_delay_ms;
+  } else {
+    cap = (uint64_t) policy->base_delay_ms << attempt;
+
+    if (cap > policy->max_delay_ms) {
+      cap = policy->max_delay_ms;
+    }
+  }
+
+  return (uint32_t) (util_rand_gen_64() % (cap + 1));
+}
+
+void pumpnet_lib_circuit_breaker_init(
+    struct pumpnet_lib_circuit_breaker *breaker,
+    const struct pumpnet_lib_circuit_breaker_config *config)
+{
+  log_assert(breaker);
+  log_assert(config);
+  log_assert(config->window_size > 0);
+  log_assert(config->window_size <= WINDOW_SIZE_MAX);
+  log_assert(config->min_requests <= config->window_size);
+
+  memset(breaker, 0, sizeof(struct pumpnet_lib_circuit_breaker));
+  memcpy(
+      &breaker->config,
+      config,
+      sizeof(struct pumpnet_lib_circuit_breaker_config));
+
+  pthread_mutex_init(&breaker->mutex, NULL);
+
+  breaker->state = PUMPNET_LIB_CIRCUIT_BREAKER_STATE_CLOSED;
+}
+
+bool pumpnet_lib_circuit_breaker_allow(
+    struct pumpnet_lib_circuit_breaker *breaker)
+{
+  log_assert(breaker);
+
+  bool allow;
+
+  pthread_mutex_lock(&breaker->mutex);
+
+  switch (breaker->state) {
+    case PUMPNET_LIB_CIRCUIT_BREAKER_STATE_CLOSED:
+      allow = true;
+      break;
+
+    case PUMPNET_LIB_CIRCUIT_BREAKER_STATE_OPEN:
+      allow = util_time_get_monotonic_ns() >= breaker->open_until_ns;
+
+      if (allow) {
+        log_info("Half-open, probing server");
+
+        breaker->state = PUMPNET_LIB_CIRCUIT_BREAKER_STATE_HALF_OPEN;
+        breaker->probe_in_progress = true;
+      }
+
+      break;
+
+    case PUMPNET_LIB_CIRCUIT_BREAKER_STATE_HALF_OPEN:
+      // single probe only
+      allow = false;
+      break;
+
+    default:
+      log_die_illegal_state();
+      allow = false;
+      break;
+  }
+
+  pthread_mutex_unlock(&breaker->mutex);
+
+  return allow;
+}
+
+void pumpnet_lib_circuit_breaker_record(
+    struct pumpnet_lib_circuit_breaker *breaker, bool success)
+{
+  log_assert(breaker);
+
+  uint32_t failures;
+
+  pthread_mutex_lock(&breaker->mutex);
+
+  switch (breaker->state) {
+    case PUMPNET_LIB_CIRCUIT_BREAKER_STATE_CLOSED:
+      breaker->window &= ~(1ULL << breaker->window_pos);
+
+      if (!success) {
+        breaker->window |= 1ULL << breaker->window_pos;
+      }
+
+      breaker->window_pos =
+          (breaker->window_pos + 1) % breaker->config.window_size;
+
+      if (breaker->window_count < breaker->config.window_size) {
+        breaker->window_count++;
+      }
+
+      failures = __builtin_popcountll(breaker->window);
+
+      if (breaker->window_count >= breaker->config.min_requests &&
+          failures * 100 >= breaker->config.failure_threshold_percent *
+                  breaker->window_count) {
+        log_warn(
+            "Open, %d of %d recent requests failed, failing fast for %d ms",
+            failures,
+            breaker->window_count,
+            breaker->config.open_time_ms);
+
+        _pumpnet_lib_circuit_breaker_open(breaker);
+        _pumpnet_lib_circuit_breaker_reset_window(breaker);
+      }
+
+      break;
+
+    case PUMPNET_LIB_CIRCUIT_BREAKER_STATE_HALF_OPEN:
+      breaker->probe_in_progress = false;
+
+      if (success) {
+        log_info("Closed, probe successful");
+
+        breaker->state = PUMPNET_LIB_CIRCUIT_BREAKER_STATE_CLOSED;
+      } else {
+        log_warn(
+            "Open, probe failed, failing fast for %d ms",
+            breaker->config.open_time_ms);
+
+        _pumpnet_lib_circuit_breaker_open(breaker);
+      }
+
+      break;
+
+    case PUMPNET_LIB_CIRCUIT_BREAKER_STATE_OPEN:
+      // allowed before the breaker tripped and completed afterwards
+      break;
+
+    default:
+      log_die_illegal_state();
+      break;
+  }
+
+  pthread_mutex_unlock(&breaker->mutex);
+}
+
+enum pumpnet_lib_circuit_breaker_state
+pumpnet_lib_circuit_breaker_get_state(
+    struct pumpnet_lib_circuit_breaker *breaker)
+{
+  log_assert(breaker);
+
+  enum pumpnet_lib_circuit_breaker_state state;
+
+  pthread_mutex_lock(&breaker->mutex);
+  state = breaker->state;
+  pthread_mutex_unlock(&breaker->mutex);
+
+  return state;
+}
+
+void pumpnet_lib_circuit_breaker_fini(
+    struct pumpnet_lib_circuit_breaker *breaker)
+{
+  log_assert(breaker);
+
+  pthread_mutex_destroy(&breaker->mutex);
+}
@@ -0,0 +1,81 @@
+#ifndef PUMPNET_LIB_RETRY_H
+#define PUMPNET_LIB_RETRY_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Retry policy with exponential backoff and full jitter: the delay before
+// retry n is a random value in [0, min(max_delay_ms, base_delay_ms * 2^n)].
+// Randomizing the whole delay spreads the retries of many clients (e.g. all
+// cabinets of an arcade) instead of hitting a recovering server in lockstep.
+struct pumpnet_lib_retry_policy {
+  // including the first attempt, 0 for unlimited (bounded by the deadline)
+  uint32_t max_attempts;
+  uint32_t base_delay_ms;
+  uint32_t max_delay_ms;
+  // max duration of all attempts and delays of a request, 0 for no deadline
+  uint32_t deadline_ms;
+};
+
+// Circuit breaker shared by all requests to a server. Trips (open) once the
+// failure rate of the recent requests crosses a threshold, requests fail fast
+// without contacting the server while open. After open_time_ms, a single
+// probe request is let through (half-open) which either closes the breaker
+// again on success or re-opens it on failure.
+struct pumpnet_lib_circuit_breaker_config {
+  // number of recent request outcomes considered, max 64
+  uint32_t window_size;
+  // min outcomes in the window before the breaker can trip
+  uint32_t min_requests;
+  uint32_t failure_threshold_percent;
+  uint32_t open_time_ms;
+};
+
+enum pumpnet_lib_circuit_breaker_state {
+  PUMPNET_LIB_CIRCUIT_BREAKER_STATE_CLOSED = 0,
+  PUMPNET_LIB_CIRCUIT_BREAKER_STATE_OPEN = 1,
+  PUMPNET_LIB_CIRCUIT_BREAKER_STATE_HALF_OPEN = 2,
+};
+
+struct pumpnet_lib_circuit_breaker {
+  struct pumpnet_lib_circuit_breaker_config config;
+
+  pthread_mutex_t mutex;
+  enum pumpnet_lib_circuit_breaker_state state;
+  // ring buffer of the recent outcomes, bit set on failure
+  uint64_t window;
+  uint32_t window_pos;
+  uint32_t window_count;
+  uint64_t open_until_ns;
+  bool probe_in_progress;
+};
+
+// delay in ms before the retry following the given attempt (0 based)
+uint32_t pumpnet_lib_retry_policy_get_delay_ms(
+    const struct pumpnet_lib_retry_policy *policy, uint32_t attempt);
+
+void pumpnet_lib_circuit_breaker_init(
+    struct pumpnet_lib_circuit_breaker *breaker,
+    const struct pumpnet_lib_circuit_breaker_config *config);
+
+// check if a request may be executed. false if the breaker is open, i.e. the
+// request has to fail fast. every allowed request has to be followed by
+// recording its outcome
+bool pumpnet_lib_circuit_breaker_allow(
+    struct pumpnet_lib_circuit_breaker *breaker);
+
+// record the outcome of an allowed request. failure means the server was not
+// reachable or not able to process the request, not a rejected request
+void pumpnet_lib_circuit_breaker_record(
+    struct pumpnet_lib_circuit_breaker *breaker, bool success);
+
+enum pumpnet_lib_circuit_breaker_state
+pumpnet_lib_circuit_breaker_get_state(
+    struct pumpnet_lib_circuit_breaker *breaker);
+
+void pumpnet_lib_circuit_breaker_fini(
+    struct pumpnet_lib_circuit_breaker *breaker);
+
+#endif
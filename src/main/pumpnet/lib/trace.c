@@ -0,0 +1,425 @@
+#define LOG_MODULE "pumpnet-trace"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "pumpnet/lib/trace.h"
+
+#include "util/log.h"
+#include "util/mem.h"
+#include "util/time.h"
+
+struct pumpnet_lib_trace {
+  FILE *file;
+  enum pumpnet_lib_trace_format format;
+
+  // protects everything below
+  pthread_mutex_t mutex;
+  uint64_t spans;
+  uint64_t failed;
+  struct pumpnet_lib_trace_histogram histograms[PUMPNET_LIB_TRACE_PHASE_COUNT];
+};
+
+static const char *pumpnet_lib_trace_phase_str[PUMPNET_LIB_TRACE_PHASE_COUNT] =
+    {
+        "dns",
+        "connect",
+        "tls",
+        "first_byte",
+        "transfer",
+        "encode",
+        "decode",
+        "backoff",
+        "total",
+};
+
+static uint64_t _pumpnet_lib_trace_get_wall_time_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000 * 1000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+static uint32_t _pumpnet_lib_trace_get_bucket(uint32_t duration_us)
+{
+  uint32_t bucket;
+
+  bucket = 0;
+
+  while (duration_us > 0 && bucket < PUMPNET_LIB_TRACE_HISTOGRAM_BUCKETS - 1) {
+    duration_us >>= 1;
+    bucket++;
+  }
+
+  return bucket;
+}
+
+static void _pumpnet_lib_trace_histogram_add(
+    struct pumpnet_lib_trace_histogram *histogram, uint32_t duration_us)
+{
+  histogram->count++;
+  histogram->sum_us += duration_us;
+  histogram->buckets[_pumpnet_lib_trace_get_bucket(duration_us)]++;
+
+  if (duration_us > histogram->max_us) {
+    histogram->max_us = duration_us;
+  }
+}
+
+static bool _pumpnet_lib_trace_write_jsonl(
+    FILE *file, const struct pumpnet_lib_trace_span *span)
+{
+  fprintf(
+      file,
+      "{\"trace_id\":\"%016llX\",\"player_ref_id\":\"%016llX\","
+      "\"file_type\":\"%s\",\"method\":\"%s\",\"start_time_us\":%llu,"
+      "\"http_code\":%u,\"success\":%s,\"attempts\":%u,\"send_bytes\":%llu,"
+      "\"recv_bytes\":%llu",
+      (unsigned long long) span->trace_id,
+      (unsigned long long) span->player_ref_id,
+      span->file_type == PUMPNET_LIB_FILE_TYPE_SAVE ? "save" : "rank",
+      span->is_post ? "POST" : "GET",
+      (unsigned long long) span->start_time_us,
+      span->http_code,
+      span->success ? "true" : "false",
+      span->attempts,
+      (unsigned long long) span->send_encoded_size,
+      (unsigned long long) span->recv_encoded_size);
+
+  for (int i = 0; i < PUMPNET_LIB_TRACE_PHASE_COUNT; i++) {
+    fprintf(
+        file,
+        ",\"%s_us\":%u",
+        pumpnet_lib_trace_phase_str[i],
+        span->duration_us[i]);
+  }
+
+  return fprintf(file, "}\n") > 0;
+}
+
+static bool _pumpnet_lib_trace_write_binary(
+    FILE *file, const struct pumpnet_lib_trace_span *span)
+{
+  struct pumpnet_lib_trace_record record;
+
+  memset(&record, 0, sizeof(record));
+
+  record.trace_id = span->trace_id;
+  record.player_ref_id = span->player_ref_id;
+  record.start_time_us = span->start_time_us;
+  record.file_type = span->file_type;
+  record.is_post = span->is_post;
+  record.http_code = span->http_code;
+  record.success = span->success;
+  record.attempts = span->attempts;
+  record.send_encoded_size = span->send_encoded_size;
+  record.recv_encoded_size = span->recv_encoded_size;
+  memcpy(record.duration_us, span->duration_us, sizeof(record.duration_us));
+
+  return fwrite(&record, sizeof(record), 1, file) == 1;
+}
+
+// validate the header of an existing binary trace file or write it to a new
+// (empty) one
+static bool _pumpnet_lib_trace_init_binary(FILE *file, const char *path)
+{
+  struct pumpnet_lib_trace_file_header header;
+
+  fseek(file, 0, SEEK_END);
+
+  if (ftell(file) == 0) {
+    header.magic = PUMPNET_LIB_TRACE_FILE_MAGIC;
+    header.version = PUMPNET_LIB_TRACE_FILE_VERSION;
+    header.record_size = sizeof(struct pumpnet_lib_trace_record);
+
+    return fwrite(&header, sizeof(header), 1, file) == 1 && fflush(file) == 0;
+  }
+
+  fseek(file, 0, SEEK_SET);
+
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      header.magic != PUMPNET_LIB_TRACE_FILE_MAGIC ||
+      header.version != PUMPNET_LIB_TRACE_FILE_VERSION ||
+      header.record_size != sizeof(struct pumpnet_lib_trace_record)) {
+    log_error(
+        "%s is not a binary trace file of version %d",
+        path,
+        PUMPNET_LIB_TRACE_FILE_VERSION);
+    return false;
+  }
+
+  fseek(file, 0, SEEK_END);
+
+  return true;
+}
+
+void pumpnet_lib_trace_span_begin(
+    struct pumpnet_lib_trace_span *span,
+    uint64_t trace_id,
+    uint64_t player_ref_id,
+    enum pumpnet_lib_file_type file_type,
+    bool is_post)
+{
+  log_assert(span);
+
+  memset(span, 0, sizeof(struct pumpnet_lib_trace_span));
+
+  span->trace_id = trace_id;
+  span->player_ref_id = player_ref_id;
+  span->file_type = file_type;
+  span->is_post = is_post;
+  span->start_time_us = _pumpnet_lib_trace_get_wall_time_us();
+  span->start_ns = util_time_get_monotonic_ns();
+}
+
+void pumpnet_lib_trace_span_add_attempt(
+    struct pumpnet_lib_trace_span *span,
+    const struct pumpnet_lib_http_request *request)
+{
+  log_assert(span);
+  log_assert(request);
+
+  const struct pumpnet_lib_http_timing *timing;
+
+  timing = &request->timing;
+
+  span->attempts++;
+  span->http_code = request->http_code;
+  span->send_encoded_size += request->send_encoded_size;
+  span->recv_encoded_size += request->recv_encoded_size;
+
+  span->duration_us[PUMPNET_LIB_TRACE_PHASE_DNS] += timing->dns_us;
+  span->duration_us[PUMPNET_LIB_TRACE_PHASE_CONNECT] += timing->connect_us;
+  span->duration_us[PUMPNET_LIB_TRACE_PHASE_TLS] += timing->tls_us;
+  span->duration_us[PUMPNET_LIB_TRACE_PHASE_FIRST_BYTE] +=
+      timing->first_byte_us;
+  span->duration_us[PUMPNET_LIB_TRACE_PHASE_TRANSFER] += timing->transfer_us;
+  span->duration_us[PUMPNET_LIB_TRACE_PHASE_ENCODE] += timing->encode_us;
+  span->duration_us[PUMPNET_LIB_TRACE_PHASE_DECODE] += timing->decode_us;
+}
+
+void pumpnet_lib_trace_span_add_backoff(
+    struct pumpnet_lib_trace_span *span, uint32_t delay_ms)
+{
+  log_assert(span);
+
+  span->duration_us[PUMPNET_LIB_TRACE_PHASE_BACKOFF] += delay_ms * 1000;
+}
+
+void pumpnet_lib_trace_span_end(
+    struct pumpnet_lib_trace_span *span, bool success)
+{
+  log_assert(span);
+
+  span->success = success;
+  span->duration_us[PUMPNET_LIB_TRACE_PHASE_TOTAL] =
+      (util_time_get_monotonic_ns() - span->start_ns) /
+      1000;
+}
+
+struct pumpnet_lib_trace *
+pumpnet_lib_trace_open(const char *path, enum pumpnet_lib_trace_format format)
+{
+  log_assert(path);
+
+  struct pumpnet_lib_trace *trace;
+  FILE *file;
+
+  file = fopen(path, format == PUMPNET_LIB_TRACE_FORMAT_BINARY ? "a+b" : "a");
+
+  if (!file) {
+    log_error("Opening trace file %s failed: %s", path, strerror(errno));
+    return NULL;
+  }
+
+  if (format == PUMPNET_LIB_TRACE_FORMAT_BINARY &&
+      !_pumpnet_lib_trace_init_binary(file, path)) {
+    fclose(file);
+    return NULL;
+  }
+
+  trace = util_xmalloc(sizeof(struct pumpnet_lib_trace));
+  memset(trace, 0, sizeof(struct pumpnet_lib_trace));
+
+  trace->file = file;
+  trace->format = format;
+
+  pthread_mutex_init(&trace->mutex, NULL);
+
+  log_info(
+      "Tracing requests to %s (%s)",
+      path,
+      format == PUMPNET_LIB_TRACE_FORMAT_BINARY ? "binary" : "jsonl");
+
+  return trace;
+}
+
+void pumpnet_lib_trace_record(
+    struct pumpnet_lib_trace *trace, const struct pumpnet_lib_trace_span *span)
+{
+  log_assert(trace);
+  log_assert(span);
+
+  bool res;
+
+  pthread_mutex_lock(&trace->mutex);
+
+  trace->spans++;
+
+  if (!span->success) {
+    trace->failed++;
+  }
+
+  for (int i = 0; i < PUMPNET_LIB_TRACE_PHASE_COUNT; i++) {
+    _pumpnet_lib_trace_histogram_add(
+        &trace->histograms[i], span->duration_us[i]);
+  }
+
+  if (trace->format == PUMPNET_LIB_TRACE_FORMAT_BINARY) {
+    res = _pumpnet_lib_trace_write_binary(trace->file, span);
+  } else {
+    res = _pumpnet_lib_trace_write_jsonl(trace->file, span);
+  }
+
+  // keep the spans before a crash or power loss
+  if (!res || fflush(trace->file) != 0) {
+    log_warn("[%llX] Writing span failed", span->trace_id);
+  }
+
+  pthread_mutex_unlock(&trace->mutex);
+}
+
+void pumpnet_lib_trace_get_histogram(
+    struct pumpnet_lib_trace *trace,
+    enum pumpnet_lib_trace_phase phase,
+    struct pumpnet_lib_trace_histogram *histogram)
+{
+  log_assert(trace);
+  log_assert(phase < PUMPNET_LIB_TRACE_PHASE_COUNT);
+  log_assert(histogram);
+
+  pthread_mutex_lock(&trace->mutex);
+  memcpy(
+      histogram,
+      &trace->histograms[phase],
+      sizeof(struct pumpnet_lib_trace_histogram));
+  pthread_mutex_unlock(&trace->mutex);
+}
+
+uint32_t pumpnet_lib_trace_histogram_get_percentile_us(
+    const struct pumpnet_lib_trace_histogram *histogram, uint32_t percentile)
+{
+  log_assert(histogram);
+  log_assert(percentile <= 100);
+
+  uint64_t rank;
+  uint64_t count;
+  uint32_t upper_us;
+
+  if (histogram->count == 0) {
+    return 0;
+  }
+
+  // rank of the percentile, 1 based
+  rank = (histogram->count * percentile + 99) / 100;
+
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  count = 0;
+
+  for (uint32_t i = 0; i < PUMPNET_LIB_TRACE_HISTOGRAM_BUCKETS; i++) {
+    count += histogram->buckets[i];
+
+    if (count >= rank) {
+      upper_us = i == 0 ? 0 : (uint32_t) ((1ULL << i) - 1);
+
+      // tighter bound for the last bucket
+      return upper_us < histogram->max_us ? upper_us : histogram->max_us;
+    }
+  }
+
+  return histogram->max_us;
+}
+
+void pumpnet_lib_trace_log_summary(struct pumpnet_lib_trace *trace)
+{
+  log_assert(trace);
+
+  const struct pumpnet_lib_trace_histogram *histogram;
+  uint64_t network_us;
+  uint64_t cpu_us;
+  uint64_t backoff_us;
+  uint64_t total_us;
+
+  pthread_mutex_lock(&trace->mutex);
+
+  log_info(
+      "Trace summary: %llu spans, %llu failed",
+      (unsigned long long) trace->spans,
+      (unsigned long long) trace->failed);
+
+  if (trace->spans == 0) {
+    pthread_mutex_unlock(&trace->mutex);
+    return;
+  }
+
+  for (int i = 0; i < PUMPNET_LIB_TRACE_PHASE_COUNT; i++) {
+    histogram = &trace->histograms[i];
+
+    log_info(
+        "%-10s mean %llu us, p50 <= %u us, p90 <= %u us, p99 <= %u us, max "
+        "%u us",
+        pumpnet_lib_trace_phase_str[i],
+        (unsigned long long) (histogram->sum_us / histogram->count),
+        pumpnet_lib_trace_histogram_get_percentile_us(histogram, 50),
+        pumpnet_lib_trace_histogram_get_percentile_us(histogram, 90),
+        pumpnet_lib_trace_histogram_get_percentile_us(histogram, 99),
+        histogram->max_us);
+  }
+
+  network_us = 0;
+
+  for (int i = PUMPNET_LIB_TRACE_PHASE_DNS;
+       i <= PUMPNET_LIB_TRACE_PHASE_TRANSFER;
+       i++) {
+    network_us += trace->histograms[i].sum_us;
+  }
+
+  cpu_us = trace->histograms[PUMPNET_LIB_TRACE_PHASE_ENCODE].sum_us +
+      trace->histograms[PUMPNET_LIB_TRACE_PHASE_DECODE].sum_us;
+  backoff_us = trace->histograms[PUMPNET_LIB_TRACE_PHASE_BACKOFF].sum_us;
+  total_us = trace->histograms[PUMPNET_LIB_TRACE_PHASE_TOTAL].sum_us;
+
+  // the rest is spent in pumpnet lib and curl, e.g. caching or waiting for a
+  // connection
+  if (total_us > 0) {
+    log_info(
+        "Share of total time: network %llu%%, encode/decode %llu%%, backoff "
+        "%llu%%",
+        (unsigned long long) (network_us * 100 / total_us),
+        (unsigned long long) (cpu_us * 100 / total_us),
+        (unsigned long long) (backoff_us * 100 / total_us));
+  }
+
+  pthread_mutex_unlock(&trace->mutex);
+}
+
+void pumpnet_lib_trace_close(struct pumpnet_lib_trace *trace)
+{
+  log_assert(trace);
+
+  pumpnet_lib_trace_log_summary(trace);
+
+  fclose(trace->file);
+
+  pthread_mutex_destroy(&trace->mutex);
+
+  free(trace);
+}
@@ -0,0 +1,149 @@
+#ifndef PUMPNET_LIB_TRACE_H
+#define PUMPNET_LIB_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "pumpnet/lib/http.h"
+#include "pumpnet/lib/pumpnet.h"
+
+// Trace of the requests of pumpnet lib: one span per get or put (of a file of
+// a player), including all of its attempts, with the durations of the
+// network phases (dns, connect, tls, first byte, transfer), encoding and
+// decoding of the bodies and the retry backoff. Spans are appended to a trace
+// file (JSON lines or binary) and aggregated to histograms which are logged
+// on close, e.g. to tell if slow profile loads are network or cpu bound.
+
+// "PNT1"
+#define PUMPNET_LIB_TRACE_FILE_MAGIC 0x31544E50
+#define PUMPNET_LIB_TRACE_FILE_VERSION 1
+
+// upper bound of the last histogram bucket, 2^31 us (~36 min)
+#define PUMPNET_LIB_TRACE_HISTOGRAM_BUCKETS 32
+
+enum pumpnet_lib_trace_format {
+  // one JSON object per line, human readable
+  PUMPNET_LIB_TRACE_FORMAT_JSONL = 0,
+  // header followed by packed records, compact
+  PUMPNET_LIB_TRACE_FORMAT_BINARY = 1,
+};
+
+enum pumpnet_lib_trace_phase {
+  PUMPNET_LIB_TRACE_PHASE_DNS = 0,
+  PUMPNET_LIB_TRACE_PHASE_CONNECT = 1,
+  PUMPNET_LIB_TRACE_PHASE_TLS = 2,
+  PUMPNET_LIB_TRACE_PHASE_FIRST_BYTE = 3,
+  PUMPNET_LIB_TRACE_PHASE_TRANSFER = 4,
+  PUMPNET_LIB_TRACE_PHASE_ENCODE = 5,
+  PUMPNET_LIB_TRACE_PHASE_DECODE = 6,
+  // delays between attempts
+  PUMPNET_LIB_TRACE_PHASE_BACKOFF = 7,
+  // whole request from the first attempt until completed
+  PUMPNET_LIB_TRACE_PHASE_TOTAL = 8,
+  PUMPNET_LIB_TRACE_PHASE_COUNT = 9,
+};
+
+struct pumpnet_lib_trace_span {
+  uint64_t trace_id;
+  uint64_t player_ref_id;
+  enum pumpnet_lib_file_type file_type;
+  bool is_post;
+  // wall clock time of the start, us since the epoch
+  uint64_t start_time_us;
+  // monotonic time of the start to measure the total duration
+  uint64_t start_ns;
+  // result of the last attempt
+  uint32_t http_code;
+  bool success;
+  // 0 if failed fast (circuit breaker open), retries are attempts - 1
+  uint32_t attempts;
+  // bytes on the wire of all attempts, excluding headers
+  uint64_t send_encoded_size;
+  uint64_t recv_encoded_size;
+  uint32_t duration_us[PUMPNET_LIB_TRACE_PHASE_COUNT];
+};
+
+// log2 histogram of durations: bucket 0 counts 0 us, bucket n durations in
+// [2^(n-1), 2^n) us
+struct pumpnet_lib_trace_histogram {
+  uint64_t count;
+  uint64_t sum_us;
+  uint32_t max_us;
+  uint64_t buckets[PUMPNET_LIB_TRACE_HISTOGRAM_BUCKETS];
+};
+
+// binary trace files: header followed by the records of the spans
+struct pumpnet_lib_trace_file_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t record_size;
+} __attribute__((__packed__));
+
+struct pumpnet_lib_trace_record {
+  uint64_t trace_id;
+  uint64_t player_ref_id;
+  uint64_t start_time_us;
+  uint32_t file_type;
+  uint32_t is_post;
+  uint32_t http_code;
+  uint32_t success;
+  uint32_t attempts;
+  uint64_t send_encoded_size;
+  uint64_t recv_encoded_size;
+  uint32_t duration_us[PUMPNET_LIB_TRACE_PHASE_COUNT];
+} __attribute__((__packed__));
+
+struct pumpnet_lib_trace;
+
+// start a span of a request, before its first attempt
+void pumpnet_lib_trace_span_begin(
+    struct pumpnet_lib_trace_span *span,
+    uint64_t trace_id,
+    uint64_t player_ref_id,
+    enum pumpnet_lib_file_type file_type,
+    bool is_post);
+
+// add an attempt of the request, i.e. its timing, sizes and result. the
+// timing of the request must only contain the attempt (zeroed before)
+void pumpnet_lib_trace_span_add_attempt(
+    struct pumpnet_lib_trace_span *span,
+    const struct pumpnet_lib_http_request *request);
+
+void pumpnet_lib_trace_span_add_backoff(
+    struct pumpnet_lib_trace_span *span, uint32_t delay_ms);
+
+// complete a span, sets the total duration
+void pumpnet_lib_trace_span_end(
+    struct pumpnet_lib_trace_span *span, bool success);
+
+// open a trace file to append spans to, created if it does not exist. returns
+// NULL if the file can't be opened or is a binary trace file of another
+// version
+struct pumpnet_lib_trace *
+pumpnet_lib_trace_open(const char *path, enum pumpnet_lib_trace_format format);
+
+// write a completed span to the trace file and add it to the histograms,
+// thread safe
+void pumpnet_lib_trace_record(
+    struct pumpnet_lib_trace *trace, const struct pumpnet_lib_trace_span *span);
+
+// copy the histogram of a phase of all spans recorded so far
+void pumpnet_lib_trace_get_histogram(
+    struct pumpnet_lib_trace *trace,
+    enum pumpnet_lib_trace_phase phase,
+    struct pumpnet_lib_trace_histogram *histogram);
+
+// upper bound of the bucket of the given percentile (0-100) of a histogram, 0
+// if empty
+uint32_t pumpnet_lib_trace_histogram_get_percentile_us(
+    const struct pumpnet_lib_trace_histogram *histogram, uint32_t percentile);
+
+// log the histograms of all phases and the share of network, cpu and backoff
+// time of the total time of all spans
+void pumpnet_lib_trace_log_summary(struct pumpnet_lib_trace *trace);
+
+// log the summary, close the trace file and free the trace
+void pumpnet_lib_trace_close(struct pumpnet_lib_trace *trace);
+
+#endif
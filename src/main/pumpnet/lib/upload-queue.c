@@ -0,0 +1,683 @@
+#define LOG_MODULE "pumpnet-upload-queue"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pumpnet/lib/upload-queue.h"
+
+#include "util/adler32.h"
+#include "util/fs.h"
+#include "util/list.h"
+#include "util/log.h"
+#include "util/mem.h"
+#include "util/str.h"
+#include "util/time.h"
+
+// "PNJ1"
+#define JOURNAL_RECORD_MAGIC 0x314A4E50
+
+enum pumpnet_lib_upload_queue_record_type {
+  // upload with data following the record
+  PUMPNET_LIB_UPLOAD_QUEUE_RECORD_TYPE_PUT = 1,
+  // upload with the seq of the record completed (successful or dropped)
+  PUMPNET_LIB_UPLOAD_QUEUE_RECORD_TYPE_DONE = 2,
+};
+
+struct pumpnet_lib_upload_queue_record {
+  uint32_t magic;
+  uint32_t type;
+  uint64_t seq;
+  uint64_t player_ref_id;
+  uint32_t file_type;
+  uint32_t size;
+  // adler32 of the record with checksum 0 followed by the data
+  uint32_t checksum;
+} __attribute__((__packed__));
+
+struct pumpnet_lib_upload_queue_entry {
+  struct util_list_node node;
+  uint64_t seq;
+  enum pumpnet_lib_file_type file_type;
+  uint64_t player_ref_id;
+  void *data;
+  size_t size;
+  bool in_progress;
+};
+
+struct pumpnet_lib_upload_queue {
+  char *journal_path;
+  int journal_fd;
+  struct pumpnet_lib_retry_policy retry_policy;
+  pumpnet_lib_upload_queue_put_t put;
+  void *ctx;
+
+  pthread_t thread;
+
+  // protects everything below and the journal
+  pthread_mutex_t mutex;
+  pthread_cond_t cond_work;
+  pthread_cond_t cond_empty;
+
+  struct util_list entries;
+  size_t pending;
+  uint64_t next_seq;
+  uint64_t retry_deadline_ns;
+  // consecutive failed attempts of the head entry
+  uint32_t retries;
+  bool stop;
+};
+
+static void _pumpnet_lib_upload_queue_ns_to_timespec(
+    uint64_t ns, struct timespec *ts)
+{
+  ts->tv_sec = ns / (1000 * 1000 * 1000);
+  ts->tv_nsec = ns % (1000 * 1000 * 1000);
+}
+
+static uint32_t _pumpnet_lib_upload_queue_record_checksum(
+    const struct pumpnet_lib_upload_queue_record *record, const void *data)
+{
+  struct pumpnet_lib_upload_queue_record tmp;
+  uint32_t checksum;
+
+  memcpy(&tmp, record, sizeof(tmp));
+  tmp.checksum = 0;
+
+  checksum = util_adler32_calc(1, (const uint8_t *) &tmp, sizeof(tmp));
+
+  if (record->size > 0) {
+    checksum =
+        util_adler32_calc(checksum, (const uint8_t *) data, record->size);
+  }
+
+  return checksum;
+}
+
+static bool _pumpnet_lib_upload_queue_journal_write(
+    struct pumpnet_lib_upload_queue *queue,
+    enum pumpnet_lib_upload_queue_record_type type,
+    const struct pumpnet_lib_upload_queue_entry *entry)
+{
+  struct pumpnet_lib_upload_queue_record *record;
+  size_t record_size;
+  size_t data_size;
+  uint8_t *pos;
+  size_t remaining;
+  ssize_t res;
+
+  data_size =
+      type == PUMPNET_LIB_UPLOAD_QUEUE_RECORD_TYPE_PUT ? entry->size : 0;
+  record_size = sizeof(struct pumpnet_lib_upload_queue_record) + data_size;
+
+  // single write, a torn record is detected by its checksum on replay
+  record = util_xmalloc(record_size);
+
+  record->magic = JOURNAL_RECORD_MAGIC;
+  record->type = type;
+  record->seq = entry->seq;
+  record->player_ref_id = entry->player_ref_id;
+  record->file_type = entry->file_type;
+  record->size = data_size;
+  memcpy(record + 1, entry->data, data_size);
+  record->checksum =
+      _pumpnet_lib_upload_queue_record_checksum(record, record + 1);
+
+  pos = (uint8_t *) record;
+  remaining = record_size;
+
+  while (remaining > 0) {
+    res = write(queue->journal_fd, pos, remaining);
+
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      log_error(
+          "Writing journal %s failed: %s",
+          queue->journal_path,
+          strerror(errno));
+      free(record);
+      return false;
+    }
+
+    pos += res;
+    remaining -= res;
+  }
+
+  free(record);
+
+  if (fdatasync(queue->journal_fd) != 0) {
+    log_error(
+        "Syncing journal %s failed: %s", queue->journal_path, strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+static void
+_pumpnet_lib_upload_queue_journal_reset(struct pumpnet_lib_upload_queue *queue)
+{
+  // all uploads completed, nothing to replay anymore
+  if (ftruncate(queue->journal_fd, 0) != 0 ||
+      fdatasync(queue->journal_fd) != 0) {
+    log_warn(
+        "Resetting journal %s failed: %s",
+        queue->journal_path,
+        strerror(errno));
+  }
+}
+
+static struct pumpnet_lib_upload_queue_entry *_pumpnet_lib_upload_queue_find(
+    struct pumpnet_lib_upload_queue *queue, uint64_t seq)
+{
+  struct util_list_node *node;
+
+  for (node = queue->entries.head; node; node = node->next) {
+    if (((struct pumpnet_lib_upload_queue_entry *) node)->seq == seq) {
+      return (struct pumpnet_lib_upload_queue_entry *) node;
+    }
+  }
+
+  return NULL;
+}
+
+static void _pumpnet_lib_upload_queue_remove(
+    struct pumpnet_lib_upload_queue *queue,
+    struct pumpnet_lib_upload_queue_entry *entry)
+{
+  util_list_remove(&queue->entries, &entry->node);
+  queue->pending--;
+
+  free(entry->data);
+  free(entry);
+}
+
+static void _pumpnet_lib_upload_queue_supersede(
+    struct pumpnet_lib_upload_queue *queue,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id)
+{
+  struct util_list_node *node;
+  struct pumpnet_lib_upload_queue_entry *entry;
+
+  node = queue->entries.head;
+
+  while (node) {
+    entry = (struct pumpnet_lib_upload_queue_entry *) node;
+    node = node->next;
+
+    if (entry->file_type == file_type &&
+        entry->player_ref_id == player_ref_id && !entry->in_progress) {
+      log_debug(
+          "Upload %llu, player %llX, file type %d, superseded",
+          entry->seq,
+          entry->player_ref_id,
+          entry->file_type);
+
+      _pumpnet_lib_upload_queue_remove(queue, entry);
+    }
+  }
+}
+
+static void _pumpnet_lib_upload_queue_append(
+    struct pumpnet_lib_upload_queue *queue,
+    uint64_t seq,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size)
+{
+  struct pumpnet_lib_upload_queue_entry *entry;
+
+  _pumpnet_lib_upload_queue_supersede(queue, file_type, player_ref_id);
+
+  entry = util_xmalloc(sizeof(struct pumpnet_lib_upload_queue_entry));
+  memset(entry, 0, sizeof(struct pumpnet_lib_upload_queue_entry));
+
+  entry->seq = seq;
+  entry->file_type = file_type;
+  entry->player_ref_id = player_ref_id;
+  entry->data = util_xmalloc(size);
+  entry->size = size;
+  memcpy(entry->data, data, size);
+
+  util_list_append(&queue->entries, &entry->node);
+  queue->pending++;
+}
+
+static bool
+_pumpnet_lib_upload_queue_replay(struct pumpnet_lib_upload_queue *queue)
+{
+  struct pumpnet_lib_upload_queue_record record;
+  struct pumpnet_lib_upload_queue_entry *entry;
+  uint8_t *journal;
+  size_t size;
+  size_t offset;
+  const uint8_t *data;
+  struct stat st;
+
+  // no journal or nothing pending
+  if (stat(queue->journal_path, &st) != 0 || st.st_size == 0) {
+    return true;
+  }
+
+  if (!util_file_load(queue->journal_path, (void **) &journal, &size, false)) {
+    log_error("Loading journal %s failed", queue->journal_path);
+    return false;
+  }
+
+  offset = 0;
+
+  while (size - offset >= sizeof(record)) {
+    memcpy(&record, journal + offset, sizeof(record));
+    data = journal + offset + sizeof(record);
+
+    if (record.magic != JOURNAL_RECORD_MAGIC ||
+        record.size > size - offset - sizeof(record) ||
+        record.file_type >= PUMPNET_LIB_FILE_TYPE_COUNT ||
+        record.checksum !=
+            _pumpnet_lib_upload_queue_record_checksum(&record, data)) {
+      break;
+    }
+
+    switch (record.type) {
+      case PUMPNET_LIB_UPLOAD_QUEUE_RECORD_TYPE_PUT:
+        _pumpnet_lib_upload_queue_append(
+            queue,
+            record.seq,
+            record.file_type,
+            record.player_ref_id,
+            data,
+            record.size);
+        break;
+
+      case PUMPNET_LIB_UPLOAD_QUEUE_RECORD_TYPE_DONE:
+        entry = _pumpnet_lib_upload_queue_find(queue, record.seq);
+
+        if (entry) {
+          _pumpnet_lib_upload_queue_remove(queue, entry);
+        }
+
+        break;
+
+      default:
+        log_warn("Unknown journal record type %d", record.type);
+        break;
+    }
+
+    if (record.seq >= queue->next_seq) {
+      queue->next_seq = record.seq + 1;
+    }
+
+    offset += sizeof(record) + record.size;
+  }
+
+  free(journal);
+
+  // torn or corrupted tail, e.g. power loss while writing. records are synced
+  // one by one, i.e. only the last one can be affected
+  if (offset < size) {
+    log_warn(
+        "Journal %s has %d invalid bytes at offset %d, truncating",
+        queue->journal_path,
+        size - offset,
+        offset);
+
+    if (truncate(queue->journal_path, offset) != 0) {
+      log_error(
+          "Truncating journal %s failed: %s",
+          queue->journal_path,
+          strerror(errno));
+      return false;
+    }
+  }
+
+  log_info(
+      "Replayed journal %s, %d pending uploads",
+      queue->journal_path,
+      queue->pending);
+
+  return true;
+}
+
+static void *_pumpnet_lib_upload_queue_thread_proc(void *ctx)
+{
+  struct pumpnet_lib_upload_queue *queue;
+  struct pumpnet_lib_upload_queue_entry *entry;
+  enum pumpnet_lib_upload_queue_result result;
+  struct timespec deadline;
+  uint32_t delay_ms;
+
+  queue = (struct pumpnet_lib_upload_queue *) ctx;
+
+  pthread_mutex_lock(&queue->mutex);
+
+  while (!queue->stop) {
+    entry = (struct pumpnet_lib_upload_queue_entry *) util_list_peek_head(
+        &queue->entries);
+
+    if (!entry) {
+      pthread_cond_wait(&queue->cond_work, &queue->mutex);
+      continue;
+    }
+
+    if (queue->retry_deadline_ns > util_time_get_monotonic_ns()) {
+      _pumpnet_lib_upload_queue_ns_to_timespec(
+          queue->retry_deadline_ns, &deadline);
+      pthread_cond_timedwait(&queue->cond_work, &queue->mutex, &deadline);
+      continue;
+    }
+
+    entry->in_progress = true;
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    result = queue->put(
+        entry->file_type,
+        entry->player_ref_id,
+        entry->data,
+        entry->size,
+        queue->ctx);
+
+    pthread_mutex_lock(&queue->mutex);
+
+    entry->in_progress = false;
+
+    if (result == PUMPNET_LIB_UPLOAD_QUEUE_RESULT_RETRY) {
+      delay_ms = pumpnet_lib_retry_policy_get_delay_ms(
+          &queue->retry_policy, queue->retries++);
+
+      log_warn(
+          "Upload %llu, player %llX, file type %d, failed, retrying in %d ms",
+          entry->seq,
+          entry->player_ref_id,
+          entry->file_type,
+          delay_ms);
+
+      queue->retry_deadline_ns = util_time_get_monotonic_ns() +
+          (uint64_t) delay_ms * 1000 * 1000;
+      continue;
+    }
+
+    if (result == PUMPNET_LIB_UPLOAD_QUEUE_RESULT_FAILED) {
+      log_error(
+          "Upload %llu, player %llX, file type %d, failed permanently, "
+          "dropping",
+          entry->seq,
+          entry->player_ref_id,
+          entry->file_type);
+    } else {
+      log_info(
+          "Upload %llu, player %llX, file type %d, successful",
+          entry->seq,
+          entry->player_ref_id,
+          entry->file_type);
+    }
+
+    queue->retry_deadline_ns = 0;
+    queue->retries = 0;
+
+    // if this fails, the upload is replayed on next open again
+    _pumpnet_lib_upload_queue_journal_write(
+        queue, PUMPNET_LIB_UPLOAD_QUEUE_RECORD_TYPE_DONE, entry);
+    _pumpnet_lib_upload_queue_remove(queue, entry);
+
+    if (queue->pending == 0) {
+      _pumpnet_lib_upload_queue_journal_reset(queue);
+      pthread_cond_broadcast(&queue->cond_empty);
+    }
+  }
+
+  pthread_mutex_unlock(&queue->mutex);
+
+  return NULL;
+}
+
+struct pumpnet_lib_upload_queue *pumpnet_lib_upload_queue_open(
+    const char *journal_path,
+    const struct pumpnet_lib_retry_policy *retry_policy,
+    pumpnet_lib_upload_queue_put_t put,
+    void *ctx)
+{
+  log_assert(journal_path);
+  log_assert(retry_policy);
+  log_assert(put);
+
+  struct pumpnet_lib_upload_queue *queue;
+  pthread_condattr_t cond_attr;
+
+  queue = util_xmalloc(sizeof(struct pumpnet_lib_upload_queue));
+  memset(queue, 0, sizeof(struct pumpnet_lib_upload_queue));
+
+  queue->journal_path = util_str_dup(journal_path);
+  memcpy(
+      &queue->retry_policy,
+      retry_policy,
+      sizeof(struct pumpnet_lib_retry_policy));
+  queue->put = put;
+  queue->ctx = ctx;
+  queue->next_seq = 1;
+
+  util_list_init(&queue->entries);
+
+  if (!_pumpnet_lib_upload_queue_replay(queue)) {
+    goto fail;
+  }
+
+  queue->journal_fd = open(
+      journal_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+  if (queue->journal_fd == -1) {
+    log_error("Opening journal %s failed: %s", journal_path, strerror(errno));
+    goto fail;
+  }
+
+  if (queue->pending == 0) {
+    _pumpnet_lib_upload_queue_journal_reset(queue);
+  }
+
+  pthread_mutex_init(&queue->mutex, NULL);
+
+  // timed waits for retries must not be affected by changes to the clock
+  pthread_condattr_init(&cond_attr);
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&queue->cond_work, &cond_attr);
+  pthread_cond_init(&queue->cond_empty, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+
+  if (pthread_create(
+          &queue->thread,
+          NULL,
+          _pumpnet_lib_upload_queue_thread_proc,
+          queue) != 0) {
+    log_die("Creating upload queue thread failed");
+  }
+
+  log_info(
+      "Opened, journal %s, retry delay %d-%d ms",
+      queue->journal_path,
+      queue->retry_policy.base_delay_ms,
+      queue->retry_policy.max_delay_ms);
+
+  return queue;
+
+fail:
+  while (!util_list_empty(&queue->entries)) {
+    _pumpnet_lib_upload_queue_remove(
+        queue,
+        (struct pumpnet_lib_upload_queue_entry *) util_list_peek_head(
+            &queue->entries));
+  }
+
+  free(queue->journal_path);
+  free(queue);
+
+  return NULL;
+}
+
+bool pumpnet_lib_upload_queue_push(
+    struct pumpnet_lib_upload_queue *queue,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size)
+{
+  log_assert(queue);
+  log_assert(file_type < PUMPNET_LIB_FILE_TYPE_COUNT);
+  log_assert(data);
+
+  struct pumpnet_lib_upload_queue_entry record_entry;
+  bool res;
+
+  pthread_mutex_lock(&queue->mutex);
+
+  record_entry.seq = queue->next_seq;
+  record_entry.file_type = file_type;
+  record_entry.player_ref_id = player_ref_id;
+  record_entry.data = (void *) data;
+  record_entry.size = size;
+
+  res = _pumpnet_lib_upload_queue_journal_write(
+      queue, PUMPNET_LIB_UPLOAD_QUEUE_RECORD_TYPE_PUT, &record_entry);
+
+  if (res) {
+    _pumpnet_lib_upload_queue_append(
+        queue, queue->next_seq, file_type, player_ref_id, data, size);
+    queue->next_seq++;
+
+    pthread_cond_signal(&queue->cond_work);
+
+    log_debug(
+        "Queued upload %llu, player %llX, file type %d, pending %d",
+        record_entry.seq,
+        player_ref_id,
+        file_type,
+        queue->pending);
+  }
+
+  pthread_mutex_unlock(&queue->mutex);
+
+  return res;
+}
+
+bool pumpnet_lib_upload_queue_get_pending(
+    struct pumpnet_lib_upload_queue *queue,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    void *buffer,
+    size_t size)
+{
+  log_assert(queue);
+  log_assert(buffer);
+
+  struct util_list_node *node;
+  struct pumpnet_lib_upload_queue_entry *entry;
+  struct pumpnet_lib_upload_queue_entry *latest;
+  bool res;
+
+  latest = NULL;
+
+  pthread_mutex_lock(&queue->mutex);
+
+  for (node = queue->entries.head; node; node = node->next) {
+    entry = (struct pumpnet_lib_upload_queue_entry *) node;
+
+    if (entry->file_type == file_type &&
+        entry->player_ref_id == player_ref_id) {
+      latest = entry;
+    }
+  }
+
+  res = latest && latest->size <= size;
+
+  if (res) {
+    memcpy(buffer, latest->data, latest->size);
+  }
+
+  pthread_mutex_unlock(&queue->mutex);
+
+  return res;
+}
+
+size_t pumpnet_lib_upload_queue_pending(struct pumpnet_lib_upload_queue *queue)
+{
+  log_assert(queue);
+
+  size_t pending;
+
+  pthread_mutex_lock(&queue->mutex);
+  pending = queue->pending;
+  pthread_mutex_unlock(&queue->mutex);
+
+  return pending;
+}
+
+bool pumpnet_lib_upload_queue_flush(
+    struct pumpnet_lib_upload_queue *queue, uint32_t timeout_ms)
+{
+  log_assert(queue);
+
+  struct timespec deadline;
+  bool res;
+
+  _pumpnet_lib_upload_queue_ns_to_timespec(
+      util_time_get_monotonic_ns() +
+          (uint64_t) timeout_ms * 1000 * 1000,
+      &deadline);
+
+  pthread_mutex_lock(&queue->mutex);
+
+  while (queue->pending > 0) {
+    if (pthread_cond_timedwait(&queue->cond_empty, &queue->mutex, &deadline) ==
+        ETIMEDOUT) {
+      break;
+    }
+  }
+
+  res = queue->pending == 0;
+
+  pthread_mutex_unlock(&queue->mutex);
+
+  return res;
+}
+
+void pumpnet_lib_upload_queue_close(struct pumpnet_lib_upload_queue *queue)
+{
+  log_assert(queue);
+
+  pthread_mutex_lock(&queue->mutex);
+  queue->stop = true;
+  pthread_cond_signal(&queue->cond_work);
+  pthread_mutex_unlock(&queue->mutex);
+
+  pthread_join(queue->thread, NULL);
+
+  if (queue->pending > 0) {
+    log_warn(
+        "Closing with %d pending uploads, replayed on next open",
+        queue->pending);
+  }
+
+  while (!util_list_empty(&queue->entries)) {
+    _pumpnet_lib_upload_queue_remove(
+        queue,
+        (struct pumpnet_lib_upload_queue_entry *) util_list_peek_head(
+            &queue->entries));
+  }
+
+  close(queue->journal_fd);
+
+  pthread_cond_destroy(&queue->cond_empty);
+  pthread_cond_destroy(&queue->cond_work);
+  pthread_mutex_destroy(&queue->mutex);
+
+  free(queue->journal_path);
+  free(queue);
+}
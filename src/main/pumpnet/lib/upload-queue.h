@@ -0,0 +1,77 @@
+#ifndef PUMPNET_LIB_UPLOAD_QUEUE_H
+#define PUMPNET_LIB_UPLOAD_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "pumpnet/lib/pumpnet.h"
+#include "pumpnet/lib/retry.h"
+
+// Write-behind queue for profile uploads. Every upload is appended to a local
+// journal file (checksummed, fsync'd) before it is queued, a worker thread
+// uploads the queued files in the background and retries on transient errors.
+// Uploads that did not complete, e.g. on power loss, are replayed from the
+// journal when opening the queue again.
+
+struct pumpnet_lib_upload_queue;
+
+enum pumpnet_lib_upload_queue_result {
+  PUMPNET_LIB_UPLOAD_QUEUE_RESULT_OK = 0,
+  // transient error, e.g. server not reachable, retry later
+  PUMPNET_LIB_UPLOAD_QUEUE_RESULT_RETRY = 1,
+  // permanent error, e.g. rejected by the server, drop the upload
+  PUMPNET_LIB_UPLOAD_QUEUE_RESULT_FAILED = 2,
+};
+
+// single upload attempt, called on the worker thread
+typedef enum pumpnet_lib_upload_queue_result (*pumpnet_lib_upload_queue_put_t)(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size,
+    void *ctx);
+
+// open (or create) the journal, queue any pending uploads of it and start the
+// worker thread. retry_policy provides the delays between retries, uploads
+// are retried until they succeed (max attempts and deadline are ignored).
+// returns NULL if the journal can't be opened
+struct pumpnet_lib_upload_queue *pumpnet_lib_upload_queue_open(
+    const char *journal_path,
+    const struct pumpnet_lib_retry_policy *retry_policy,
+    pumpnet_lib_upload_queue_put_t put,
+    void *ctx);
+
+// journal and queue an upload, returns once the upload is persisted. a pending
+// upload of the same player and file type which is not in progress, yet, is
+// superseded by this one
+bool pumpnet_lib_upload_queue_push(
+    struct pumpnet_lib_upload_queue *queue,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size);
+
+// copy the data of the latest pending upload of a player and file type to the
+// buffer, e.g. to not download outdated data from the server while the upload
+// is pending. returns false if there is no pending upload
+bool pumpnet_lib_upload_queue_get_pending(
+    struct pumpnet_lib_upload_queue *queue,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    void *buffer,
+    size_t size);
+
+// number of uploads not completed, yet
+size_t pumpnet_lib_upload_queue_pending(struct pumpnet_lib_upload_queue *queue);
+
+// wait until all uploads are completed or the timeout expired. returns false
+// on timeout
+bool pumpnet_lib_upload_queue_flush(
+    struct pumpnet_lib_upload_queue *queue, uint32_t timeout_ms);
+
+// stop the worker thread (waits for an upload in progress) and close the
+// journal. pending uploads stay in the journal and are replayed on next open
+void pumpnet_lib_upload_queue_close(struct pumpnet_lib_upload_queue *queue);
+
+#endif
@@ -0,0 +1,358 @@
+/**
+ * Load generator for pumpnet: Simulates many cabinets, each a thread running
+ * sessions of a random player of a shared player pool through pumpnet lib,
+ * i.e. download (prefetch) save and rank on login and upload both again once
+ * the session ends. Runs against an in-process mock server (with injected
+ * latency and errors) or an actual server. Reports throughput, latency
+ * percentiles per operation and the request, retry and failure counters of
+ * pumpnet lib. Exits with failure if any operation failed
+ */
+#define LOG_MODULE "pumpnet-load"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "asset/nx2/lib/usb-rank.h"
+#include "asset/nx2/lib/usb-save.h"
+
+#include "pumpnet/lib/pumpnet.h"
+#include "pumpnet/mock/server.h"
+
+#include "util/log.h"
+#include "util/mem.h"
+#include "util/rand.h"
+#include "util/str.h"
+#include "util/time.h"
+
+#define LOAD_PLAYERS_PER_CABINET 4
+
+enum load_op {
+  LOAD_OP_LOGIN = 0,
+  LOAD_OP_PUT_SAVE = 1,
+  LOAD_OP_PUT_RANK = 2,
+  LOAD_OP_COUNT = 3,
+};
+
+struct load_cabinet {
+  pthread_t thread;
+  size_t sessions;
+  size_t players;
+  // latencies of each session per operation
+  uint64_t *latencies_ns[LOAD_OP_COUNT];
+  size_t failed[LOAD_OP_COUNT];
+};
+
+static const char *load_op_str[LOAD_OP_COUNT] = {
+    "login (get save and rank)",
+    "put save",
+    "put rank",
+};
+
+static int load_cmp_uint64(const void *a, const void *b)
+{
+  uint64_t va = *(const uint64_t *) a;
+  uint64_t vb = *(const uint64_t *) b;
+
+  return (va > vb) - (va < vb);
+}
+
+static uint64_t load_percentile(const uint64_t *sorted, size_t count, int p)
+{
+  size_t idx;
+
+  if (count == 0) {
+    return 0;
+  }
+
+  idx = (count * p) / 100;
+
+  if (idx >= count) {
+    idx = count - 1;
+  }
+
+  return sorted[idx];
+}
+
+static void *load_cabinet_proc(void *arg)
+{
+  struct load_cabinet *cabinet;
+  struct pumpnet_lib_prefetch *prefetch;
+  uint8_t *save;
+  uint8_t *rank;
+  uint64_t player_ref_id;
+  uint64_t start;
+  bool success;
+
+  cabinet = (struct load_cabinet *) arg;
+
+  save = util_xmalloc(ASSET_NX2_USB_SAVE_SIZE);
+  rank = util_xmalloc(ASSET_NX2_USB_RANK_SIZE);
+
+  for (size_t i = 0; i < cabinet->sessions; i++) {
+    // players move between cabinets, e.g. of the same arcade
+    player_ref_id = 1 + util_rand_gen_32() % cabinet->players;
+
+    start = util_time_get_monotonic_ns();
+
+    prefetch = pumpnet_lib_prefetch_start(
+        player_ref_id, ASSET_NX2_USB_SAVE_SIZE, ASSET_NX2_USB_RANK_SIZE);
+
+    success = pumpnet_lib_prefetch_wait(
+        prefetch, PUMPNET_LIB_FILE_TYPE_SAVE, save, ASSET_NX2_USB_SAVE_SIZE);
+    success &= pumpnet_lib_prefetch_wait(
+        prefetch, PUMPNET_LIB_FILE_TYPE_RANK, rank, ASSET_NX2_USB_RANK_SIZE);
+
+    pumpnet_lib_prefetch_free(prefetch);
+
+    cabinet->latencies_ns[LOAD_OP_LOGIN][i] =
+        util_time_get_monotonic_ns() - start;
+
+    if (!success) {
+      cabinet->failed[LOAD_OP_LOGIN]++;
+      // new player, start with empty files
+      memset(save, 0, ASSET_NX2_USB_SAVE_SIZE);
+      memset(rank, 0, ASSET_NX2_USB_RANK_SIZE);
+    }
+
+    // played a song
+    save[i % ASSET_NX2_USB_SAVE_SIZE]++;
+    rank[i % ASSET_NX2_USB_RANK_SIZE]++;
+
+    start = util_time_get_monotonic_ns();
+
+    if (!pumpnet_lib_put(
+            PUMPNET_LIB_FILE_TYPE_SAVE,
+            player_ref_id,
+            save,
+            ASSET_NX2_USB_SAVE_SIZE)) {
+      cabinet->failed[LOAD_OP_PUT_SAVE]++;
+    }
+
+    cabinet->latencies_ns[LOAD_OP_PUT_SAVE][i] =
+        util_time_get_monotonic_ns() - start;
+
+    start = util_time_get_monotonic_ns();
+
+    if (!pumpnet_lib_put(
+            PUMPNET_LIB_FILE_TYPE_RANK,
+            player_ref_id,
+            rank,
+            ASSET_NX2_USB_RANK_SIZE)) {
+      cabinet->failed[LOAD_OP_PUT_RANK]++;
+    }
+
+    cabinet->latencies_ns[LOAD_OP_PUT_RANK][i] =
+        util_time_get_monotonic_ns() - start;
+  }
+
+  free(save);
+  free(rank);
+
+  return NULL;
+}
+
+static size_t load_report(
+    struct load_cabinet *cabinets,
+    size_t cabinet_count,
+    size_t sessions,
+    uint64_t duration_ns)
+{
+  struct pumpnet_lib_stats stats;
+  uint64_t *latencies_ns;
+  size_t count;
+  size_t failed;
+  size_t failed_total;
+
+  count = cabinet_count * sessions;
+  latencies_ns = util_xmalloc(sizeof(uint64_t) * count);
+  failed_total = 0;
+
+  printf(
+      "%zu cabinets, %zu sessions, %.3f sec, %.1f sessions/sec\n",
+      cabinet_count,
+      count,
+      duration_ns / 1e9,
+      count / (duration_ns / 1e9));
+
+  for (int op = 0; op < LOAD_OP_COUNT; op++) {
+    failed = 0;
+
+    for (size_t i = 0; i < cabinet_count; i++) {
+      memcpy(
+          latencies_ns + i * sessions,
+          cabinets[i].latencies_ns[op],
+          sizeof(uint64_t) * sessions);
+      failed += cabinets[i].failed[op];
+    }
+
+    qsort(latencies_ns, count, sizeof(uint64_t), load_cmp_uint64);
+
+    printf(
+        "%-26s failed %zu, latency ms p50 %.2f, p90 %.2f, p99 %.2f, max "
+        "%.2f\n",
+        load_op_str[op],
+        failed,
+        load_percentile(latencies_ns, count, 50) / 1e6,
+        load_percentile(latencies_ns, count, 90) / 1e6,
+        load_percentile(latencies_ns, count, 99) / 1e6,
+        latencies_ns[count - 1] / 1e6);
+
+    failed_total += failed;
+  }
+
+  free(latencies_ns);
+
+  pumpnet_lib_get_stats(&stats);
+
+  printf(
+      "requests: attempts %llu (%.1f/sec), retries %llu, failed %llu, "
+      "rejected %llu\n",
+      (unsigned long long) stats.attempts,
+      stats.attempts / (duration_ns / 1e9),
+      (unsigned long long) stats.retries,
+      (unsigned long long) stats.failed,
+      (unsigned long long) stats.rejected);
+
+  return failed_total;
+}
+
+static void _print_usage_and_exit(const char *program_name)
+{
+  log_info(
+      "Usage: %s <cabinets> <sessions per cabinet> [server addr, - for an "
+      "in-process mock server] [mock latency ms] [mock error rate %%] [mock "
+      "drop rate %%]",
+      program_name);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server_stats mock_stats;
+  struct pumpnet_mock_server *server;
+  struct load_cabinet *cabinets;
+  size_t cabinet_count;
+  size_t sessions;
+  char server_addr[256];
+  uint64_t start;
+  uint64_t duration_ns;
+  size_t failed;
+
+  if (argc < 3) {
+    _print_usage_and_exit(argv[0]);
+  }
+
+  util_log_set_level(LOG_LEVEL_WARN);
+
+  cabinet_count = strtoul(argv[1], NULL, 10);
+  sessions = strtoul(argv[2], NULL, 10);
+
+  if (cabinet_count == 0 || sessions == 0) {
+    _print_usage_and_exit(argv[0]);
+  }
+
+  server = NULL;
+
+  if (argc < 4 || !strcmp(argv[3], "-")) {
+    pumpnet_mock_server_config_init(&config);
+
+    config.payload_size[PUMPNET_LIB_FILE_TYPE_SAVE] = ASSET_NX2_USB_SAVE_SIZE;
+    config.payload_size[PUMPNET_LIB_FILE_TYPE_RANK] = ASSET_NX2_USB_RANK_SIZE;
+
+    if (argc > 4) {
+      config.latency_ms = strtoul(argv[4], NULL, 10);
+      // +-25 % to not answer all cabinets in lockstep
+      config.latency_jitter_ms = config.latency_ms / 2;
+      config.latency_ms -= config.latency_jitter_ms / 2;
+    }
+
+    if (argc > 5) {
+      config.error_rate_percent = strtoul(argv[5], NULL, 10);
+    }
+
+    if (argc > 6) {
+      config.drop_rate_percent = strtoul(argv[6], NULL, 10);
+    }
+
+    if (config.error_rate_percent + config.drop_rate_percent > 100) {
+      log_error("Error rate and drop rate exceed 100%%");
+      exit(EXIT_FAILURE);
+    }
+
+    server = pumpnet_mock_server_start(&config);
+
+    if (!server) {
+      log_error("Starting mock server failed");
+      exit(EXIT_FAILURE);
+    }
+
+    util_str_format(
+        server_addr,
+        sizeof(server_addr),
+        "http://127.0.0.1:%d",
+        pumpnet_mock_server_get_port(server));
+  } else {
+    util_str_cpy(server_addr, sizeof(server_addr), argv[3]);
+  }
+
+  pumpnet_lib_init(ASSET_GAME_VERSION_NX2, server_addr, 1, NULL, false);
+
+  cabinets = util_xmalloc(sizeof(struct load_cabinet) * cabinet_count);
+  memset(cabinets, 0, sizeof(struct load_cabinet) * cabinet_count);
+
+  start = util_time_get_monotonic_ns();
+
+  for (size_t i = 0; i < cabinet_count; i++) {
+    cabinets[i].sessions = sessions;
+    cabinets[i].players = cabinet_count * LOAD_PLAYERS_PER_CABINET;
+
+    for (int op = 0; op < LOAD_OP_COUNT; op++) {
+      cabinets[i].latencies_ns[op] =
+          util_xmalloc(sizeof(uint64_t) * sessions);
+    }
+
+    if (pthread_create(
+            &cabinets[i].thread, NULL, load_cabinet_proc, &cabinets[i]) !=
+        0) {
+      log_die("Creating cabinet thread %zu failed", i);
+    }
+  }
+
+  for (size_t i = 0; i < cabinet_count; i++) {
+    pthread_join(cabinets[i].thread, NULL);
+  }
+
+  duration_ns = util_time_get_monotonic_ns() - start;
+
+  failed = load_report(cabinets, cabinet_count, sessions, duration_ns);
+
+  pumpnet_lib_shutdown();
+
+  if (server) {
+    pumpnet_mock_server_get_stats(server, &mock_stats);
+    pumpnet_mock_server_stop(server);
+
+    printf(
+        "mock server: requests %llu, not modified %llu, errors %llu, drops "
+        "%llu, body bytes received %llu, sent %llu\n",
+        (unsigned long long) mock_stats.requests,
+        (unsigned long long) mock_stats.not_modified,
+        (unsigned long long) mock_stats.errors,
+        (unsigned long long) mock_stats.drops,
+        (unsigned long long) mock_stats.body_bytes_received,
+        (unsigned long long) mock_stats.body_bytes_sent);
+  }
+
+  for (size_t i = 0; i < cabinet_count; i++) {
+    for (int op = 0; op < LOAD_OP_COUNT; op++) {
+      free(cabinets[i].latencies_ns[op]);
+    }
+  }
+
+  free(cabinets);
+
+  return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
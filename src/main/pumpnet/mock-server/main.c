@@ -0,0 +1,113 @@
+/**
+ * Standalone mock pumpnet server, e.g. to run a game with the net profile
+ * patch or the load generator against without an actual server. Serves
+ * random data for players not uploaded, yet. Prints the stats of the server
+ * on SIGINT or SIGTERM and exits
+ */
+#define LOG_MODULE "pumpnet-mock-server"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "asset/nx2/lib/usb-rank.h"
+#include "asset/nx2/lib/usb-save.h"
+
+#include "pumpnet/mock/server.h"
+
+#include "util/log.h"
+
+static void _print_usage_and_exit(const char *program_name)
+{
+  log_info(
+      "Usage: %s <address> <port> [latency ms] [latency jitter ms] [error "
+      "rate %%] [drop rate %%] [save size] [rank size]",
+      program_name);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server_stats stats;
+  struct pumpnet_mock_server *server;
+  sigset_t set;
+  int sig;
+
+  if (argc < 3) {
+    _print_usage_and_exit(argv[0]);
+  }
+
+  util_log_set_level(LOG_LEVEL_INFO);
+
+  pumpnet_mock_server_config_init(&config);
+
+  config.address = argv[1];
+  config.port = strtol(argv[2], NULL, 10);
+  config.payload_size[PUMPNET_LIB_FILE_TYPE_SAVE] = ASSET_NX2_USB_SAVE_SIZE;
+  config.payload_size[PUMPNET_LIB_FILE_TYPE_RANK] = ASSET_NX2_USB_RANK_SIZE;
+
+  if (argc > 3) {
+    config.latency_ms = strtol(argv[3], NULL, 10);
+  }
+
+  if (argc > 4) {
+    config.latency_jitter_ms = strtol(argv[4], NULL, 10);
+  }
+
+  if (argc > 5) {
+    config.error_rate_percent = strtol(argv[5], NULL, 10);
+  }
+
+  if (argc > 6) {
+    config.drop_rate_percent = strtol(argv[6], NULL, 10);
+  }
+
+  if (argc > 7) {
+    config.payload_size[PUMPNET_LIB_FILE_TYPE_SAVE] = strtol(argv[7], NULL, 10);
+  }
+
+  if (argc > 8) {
+    config.payload_size[PUMPNET_LIB_FILE_TYPE_RANK] = strtol(argv[8], NULL, 10);
+  }
+
+  if (config.error_rate_percent + config.drop_rate_percent > 100) {
+    log_error("Error rate and drop rate exceed 100%%");
+    exit(EXIT_FAILURE);
+  }
+
+  // block before starting the server, the threads of the server inherit the
+  // mask and the signals are received by sigwait only
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  server = pumpnet_mock_server_start(&config);
+
+  if (!server) {
+    log_error("Starting server on %s:%s failed", argv[1], argv[2]);
+    exit(EXIT_FAILURE);
+  }
+
+  sigwait(&set, &sig);
+
+  pumpnet_mock_server_get_stats(server, &stats);
+  pumpnet_mock_server_stop(server);
+
+  printf(
+      "requests %llu, gets %llu (not modified %llu), puts %llu, errors %llu, "
+      "drops %llu, body bytes received %llu, sent %llu\n",
+      (unsigned long long) stats.requests,
+      (unsigned long long) stats.gets,
+      (unsigned long long) stats.not_modified,
+      (unsigned long long) stats.puts,
+      (unsigned long long) stats.errors,
+      (unsigned long long) stats.drops,
+      (unsigned long long) stats.body_bytes_received,
+      (unsigned long long) stats.body_bytes_sent);
+
+  return 0;
+}
@@ -0,0 +1,948 @@
+#define LOG_MODULE "pumpnet-mock-server"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "pumpnet/lib/protocol.h"
+#include "pumpnet/mock/server.h"
+
+#include "util/base64.h"
+#include "util/list.h"
+#include "util/log.h"
+#include "util/mem.h"
+#include "util/rand.h"
+#include "util/sock-tcp.h"
+#include "util/str.h"
+#include "util/time.h"
+
+// large enough for a base64 encoded put of a nxa save
+#define REQ_BUFFER_SIZE 1024 * 256
+#define METHOD_MAX_LEN 16
+#define PATH_MAX_LEN 256
+#define GAME_MAX_LEN 16
+#define ETAG_MAX_LEN 32
+#define MEDIA_TYPE_BINARY "application/octet-stream"
+#define MEDIA_TYPE_BASE64 "text/plain"
+
+#define SEND_TIMEOUT_MS 10000
+// idle keep-alive connections are closed, clients reconnect
+#define RECV_TIMEOUT_MS 30000
+
+struct pumpnet_mock_server_file {
+  struct util_list_node node;
+  char game[GAME_MAX_LEN];
+  enum pumpnet_lib_file_type file_type;
+  uint64_t player_ref_id;
+  uint64_t version;
+  // get response, encoded per transport on first use
+  struct pumpnet_lib_get_save_resp *resp;
+  size_t resp_size;
+  void *resp_encoded[PUMPNET_LIB_HTTP_TRANSPORT_COUNT];
+  size_t resp_encoded_size[PUMPNET_LIB_HTTP_TRANSPORT_COUNT];
+};
+
+struct pumpnet_mock_server_conn {
+  struct util_list_node node;
+  struct pumpnet_mock_server *server;
+  int handle;
+  unsigned int seed;
+};
+
+struct pumpnet_mock_server {
+  struct pumpnet_mock_server_config config;
+  int handle;
+  uint16_t port;
+  pthread_t thread;
+
+  // protects everything below
+  pthread_mutex_t mutex;
+  pthread_cond_t cond_conns;
+
+  struct util_list files;
+  struct util_list conns;
+  uint64_t next_version;
+  struct pumpnet_mock_server_stats stats;
+  // see pumpnet_mock_server_inject_faults
+  uint32_t fault_status;
+  uint32_t fault_count;
+};
+
+struct pumpnet_mock_server_resp {
+  uint32_t status;
+  enum pumpnet_lib_http_transport transport;
+  char etag[ETAG_MAX_LEN];
+  // encoded body
+  void *body;
+  size_t body_size;
+};
+
+static const char *_pumpnet_mock_server_status_str(uint32_t status)
+{
+  switch (status) {
+    case 200:
+      return "OK";
+
+    case 304:
+      return "Not Modified";
+
+    case 400:
+      return "Bad Request";
+
+    case 404:
+      return "Not Found";
+
+    case 415:
+      return "Unsupported Media Type";
+
+    case 503:
+      return "Service Unavailable";
+
+    default:
+      return "Unknown";
+  }
+}
+
+static bool
+_pumpnet_mock_server_send_all(int handle, const void *data, size_t size)
+{
+  const uint8_t *pos;
+  ssize_t res;
+
+  pos = (const uint8_t *) data;
+
+  while (size > 0) {
+    res = util_sock_tcp_send(handle, (void *) pos, size, SEND_TIMEOUT_MS);
+
+    if (res <= 0) {
+      return false;
+    }
+
+    pos += res;
+    size -= res;
+  }
+
+  return true;
+}
+
+// case insensitive search of a header with the given name, copies its value
+// without leading and trailing whitespace. false if not found or too long
+static bool _pumpnet_mock_server_get_header(
+    const char *header, const char *name, char *buffer, size_t size)
+{
+  const char *pos;
+  size_t len;
+
+  buffer[0] = '\0';
+  pos = strcasestr(header, name);
+
+  if (!pos) {
+    return false;
+  }
+
+  pos += strlen(name);
+  pos += strspn(pos, " \t");
+  len = strcspn(pos, "\r\n");
+
+  while (len > 0 && (pos[len - 1] == ' ' || pos[len - 1] == '\t')) {
+    len--;
+  }
+
+  if (len >= size) {
+    return false;
+  }
+
+  memcpy(buffer, pos, len);
+  buffer[len] = '\0';
+
+  return true;
+}
+
+static bool _pumpnet_mock_server_has_header(
+    const char *header, const char *name, const char *value)
+{
+  char buffer[256];
+
+  return _pumpnet_mock_server_get_header(
+             header, name, buffer, sizeof(buffer)) &&
+      strcasestr(buffer, value) != NULL;
+}
+
+static void *_pumpnet_mock_server_encode(
+    enum pumpnet_lib_http_transport transport,
+    const void *data,
+    size_t size,
+    size_t *encoded_size)
+{
+  uLongf compressed_size;
+  void *encoded;
+
+  switch (transport) {
+    case PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE:
+      compressed_size = compressBound(size);
+      encoded = util_xmalloc(compressed_size);
+      compress2(encoded, &compressed_size, data, size, Z_BEST_SPEED);
+      *encoded_size = compressed_size;
+      return encoded;
+
+    case PUMPNET_LIB_HTTP_TRANSPORT_BINARY:
+      encoded = util_xmalloc(size + 1);
+      memcpy(encoded, data, size);
+      *encoded_size = size;
+      return encoded;
+
+    case PUMPNET_LIB_HTTP_TRANSPORT_BASE64:
+    default:
+      return util_base64_encode(data, size, encoded_size);
+  }
+}
+
+static void *_pumpnet_mock_server_decode(
+    const void *body, size_t size, bool binary, bool deflate, size_t *out_size)
+{
+  uLongf inflated_size;
+  void *decoded;
+
+  if (!binary) {
+    return util_base64_decode(body, size, out_size);
+  }
+
+  if (!deflate) {
+    decoded = util_xmalloc(size + 1);
+    memcpy(decoded, body, size);
+    *out_size = size;
+    return decoded;
+  }
+
+  inflated_size = REQ_BUFFER_SIZE;
+  decoded = util_xmalloc(inflated_size);
+
+  if (uncompress(decoded, &inflated_size, body, size) != Z_OK) {
+    free(decoded);
+    return NULL;
+  }
+
+  *out_size = inflated_size;
+
+  return decoded;
+}
+
+// e.g. /usbprofile/v1/nx2/save
+static bool _pumpnet_mock_server_parse_path(
+    const char *path, char *game, enum pumpnet_lib_file_type *file_type)
+{
+  const char *pos;
+  size_t len;
+
+  if (!util_str_starts_with(path, USBPROFILE_ENDPOINT "/")) {
+    return false;
+  }
+
+  pos = path + strlen(USBPROFILE_ENDPOINT "/");
+  len = strcspn(pos, "/");
+
+  if (len == 0 || len >= GAME_MAX_LEN || pos[len] != '/') {
+    return false;
+  }
+
+  memcpy(game, pos, len);
+  game[len] = '\0';
+  pos += len + 1;
+
+  if (!strcmp(pos, "save")) {
+    *file_type = PUMPNET_LIB_FILE_TYPE_SAVE;
+  } else if (!strcmp(pos, "rank")) {
+    *file_type = PUMPNET_LIB_FILE_TYPE_RANK;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+static void
+_pumpnet_mock_server_file_free(struct pumpnet_mock_server_file *file)
+{
+  for (int i = 0; i < PUMPNET_LIB_HTTP_TRANSPORT_COUNT; i++) {
+    free(file->resp_encoded[i]);
+  }
+
+  free(file->resp);
+  free(file);
+}
+
+static struct pumpnet_mock_server_file *_pumpnet_mock_server_find(
+    struct pumpnet_mock_server *server,
+    const char *game,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id)
+{
+  struct util_list_node *node;
+  struct pumpnet_mock_server_file *file;
+
+  for (node = server->files.head; node; node = node->next) {
+    file = (struct pumpnet_mock_server_file *) node;
+
+    if (file->file_type == file_type && file->player_ref_id == player_ref_id &&
+        !strcmp(file->game, game)) {
+      return file;
+    }
+  }
+
+  return NULL;
+}
+
+// replaces an existing file, call with the mutex locked
+static struct pumpnet_mock_server_file *_pumpnet_mock_server_store(
+    struct pumpnet_mock_server *server,
+    const char *game,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size)
+{
+  struct pumpnet_mock_server_file *file;
+
+  file = _pumpnet_mock_server_find(server, game, file_type, player_ref_id);
+
+  if (file) {
+    util_list_remove(&server->files, &file->node);
+    _pumpnet_mock_server_file_free(file);
+  }
+
+  file = util_xmalloc(sizeof(struct pumpnet_mock_server_file));
+  memset(file, 0, sizeof(struct pumpnet_mock_server_file));
+
+  util_str_cpy(file->game, sizeof(file->game), game);
+  file->file_type = file_type;
+  file->player_ref_id = player_ref_id;
+  file->version = server->next_version++;
+  file->resp_size = sizeof(struct pumpnet_lib_get_save_resp) + size;
+  file->resp = util_xmalloc(file->resp_size);
+  file->resp->size = size;
+  memcpy(file->resp->data, data, size);
+
+  util_list_append(&server->files, &file->node);
+
+  return file;
+}
+
+static void _pumpnet_mock_server_handle_get(
+    struct pumpnet_mock_server_conn *conn,
+    const char *game,
+    enum pumpnet_lib_file_type file_type,
+    const void *body,
+    size_t body_size,
+    const char *if_none_match,
+    struct pumpnet_mock_server_resp *resp)
+{
+  struct pumpnet_mock_server *server;
+  const struct pumpnet_lib_get_save_req *req;
+  struct pumpnet_mock_server_file *file;
+  uint8_t *payload;
+  size_t payload_size;
+
+  server = conn->server;
+
+  if (body_size != sizeof(struct pumpnet_lib_get_save_req)) {
+    resp->status = 400;
+    return;
+  }
+
+  req = (const struct pumpnet_lib_get_save_req *) body;
+  payload_size = server->config.payload_size[file_type];
+
+  pthread_mutex_lock(&server->mutex);
+
+  server->stats.gets++;
+
+  file = _pumpnet_mock_server_find(server, game, file_type, req->player_ref_id);
+
+  // unknown player, e.g. of a load test
+  if (!file && payload_size > 0) {
+    payload = util_xmalloc(payload_size);
+
+    for (size_t i = 0; i < payload_size; i++) {
+      payload[i] = (uint8_t) rand_r(&conn->seed);
+    }
+
+    file = _pumpnet_mock_server_store(
+        server, game, file_type, req->player_ref_id, payload, payload_size);
+
+    free(payload);
+  }
+
+  if (!file) {
+    pthread_mutex_unlock(&server->mutex);
+    resp->status = 404;
+    return;
+  }
+
+  sprintf(resp->etag, "\"%llu\"", (unsigned long long) file->version);
+
+  if (!strcmp(if_none_match, resp->etag)) {
+    server->stats.not_modified++;
+    pthread_mutex_unlock(&server->mutex);
+    resp->status = 304;
+    return;
+  }
+
+  if (!file->resp_encoded[resp->transport]) {
+    file->resp_encoded[resp->transport] = _pumpnet_mock_server_encode(
+        resp->transport,
+        file->resp,
+        file->resp_size,
+        &file->resp_encoded_size[resp->transport]);
+  }
+
+  // copy, the file might be replaced while sending
+  resp->body_size = file->resp_encoded_size[resp->transport];
+  resp->body = util_xmalloc(resp->body_size + 1);
+  memcpy(resp->body, file->resp_encoded[resp->transport], resp->body_size);
+
+  pthread_mutex_unlock(&server->mutex);
+
+  resp->status = 200;
+}
+
+static void _pumpnet_mock_server_handle_put(
+    struct pumpnet_mock_server_conn *conn,
+    const char *game,
+    enum pumpnet_lib_file_type file_type,
+    const void *body,
+    size_t body_size,
+    struct pumpnet_mock_server_resp *resp)
+{
+  struct pumpnet_mock_server *server;
+  const struct pumpnet_lib_put_save_req *req;
+  struct pumpnet_mock_server_file *file;
+
+  server = conn->server;
+  req = (const struct pumpnet_lib_put_save_req *) body;
+
+  if (body_size < sizeof(struct pumpnet_lib_put_save_req) ||
+      req->size != body_size - sizeof(struct pumpnet_lib_put_save_req)) {
+    resp->status = 400;
+    return;
+  }
+
+  pthread_mutex_lock(&server->mutex);
+
+  server->stats.puts++;
+
+  file = _pumpnet_mock_server_store(
+      server, game, file_type, req->player_ref_id, req->data, req->size);
+
+  sprintf(resp->etag, "\"%llu\"", (unsigned long long) file->version);
+
+  pthread_mutex_unlock(&server->mutex);
+
+  // empty put response
+  resp->status = 200;
+  resp->body = _pumpnet_mock_server_encode(
+      resp->transport, "", 0, &resp->body_size);
+}
+
+static bool _pumpnet_mock_server_respond(
+    int handle, const struct pumpnet_mock_server_resp *resp)
+{
+  char header[512];
+  char etag_header[ETAG_MAX_LEN + 16];
+  int header_len;
+  bool has_body;
+
+  has_body = resp->status == 200;
+  etag_header[0] = '\0';
+
+  if (resp->etag[0] != '\0') {
+    sprintf(etag_header, "ETag: %s\r\n", resp->etag);
+  }
+
+  header_len = sprintf(
+      header,
+      "HTTP/1.1 %u %s\r\nContent-Type: %s\r\n%s%sContent-Length: %zu\r\n\r\n",
+      resp->status,
+      _pumpnet_mock_server_status_str(resp->status),
+      resp->transport == PUMPNET_LIB_HTTP_TRANSPORT_BASE64 ? MEDIA_TYPE_BASE64 :
+                                                             MEDIA_TYPE_BINARY,
+      resp->transport == PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE && has_body ?
+          "Content-Encoding: deflate\r\n" :
+          "",
+      etag_header,
+      has_body ? resp->body_size : 0);
+
+  if (!_pumpnet_mock_server_send_all(handle, header, header_len)) {
+    return false;
+  }
+
+  return !has_body ||
+      _pumpnet_mock_server_send_all(handle, resp->body, resp->body_size);
+}
+
+// returns false to close the connection
+static bool _pumpnet_mock_server_handle_request(
+    struct pumpnet_mock_server_conn *conn,
+    const char *req,
+    size_t header_len,
+    size_t req_len)
+{
+  struct pumpnet_mock_server *server;
+  struct pumpnet_mock_server_resp resp;
+  enum pumpnet_lib_http_transport transport;
+  enum pumpnet_lib_file_type file_type;
+  char method[METHOD_MAX_LEN];
+  char path[PATH_MAX_LEN];
+  char game[GAME_MAX_LEN];
+  char if_none_match[ETAG_MAX_LEN];
+  char *header;
+  void *body;
+  size_t body_size;
+  bool req_binary;
+  bool req_deflate;
+  uint32_t latency_ms;
+  uint32_t roll;
+  uint32_t fault_status;
+  bool fault;
+  bool res;
+
+  server = conn->server;
+
+  latency_ms = server->config.latency_ms;
+
+  if (server->config.latency_jitter_ms > 0) {
+    latency_ms += rand_r(&conn->seed) % (server->config.latency_jitter_ms + 1);
+  }
+
+  if (latency_ms > 0) {
+    util_time_sleep_ms(latency_ms);
+  }
+
+  roll = rand_r(&conn->seed) % 100;
+  fault = true;
+
+  pthread_mutex_lock(&server->mutex);
+
+  server->stats.requests++;
+  server->stats.body_bytes_received += req_len - header_len;
+
+  if (server->fault_count > 0) {
+    server->fault_count--;
+    fault_status = server->fault_status;
+  } else if (roll < server->config.drop_rate_percent) {
+    fault_status = 0;
+  } else if (
+      roll < server->config.drop_rate_percent +
+          server->config.error_rate_percent) {
+    fault_status = 503;
+  } else {
+    fault = false;
+  }
+
+  if (fault && fault_status == 0) {
+    server->stats.drops++;
+  } else if (fault) {
+    server->stats.errors++;
+  }
+
+  transport = server->config.transport;
+
+  pthread_mutex_unlock(&server->mutex);
+
+  memset(&resp, 0, sizeof(resp));
+
+  if (fault && fault_status == 0) {
+    return false;
+  }
+
+  if (fault) {
+    resp.status = fault_status;
+    return _pumpnet_mock_server_respond(conn->handle, &resp);
+  }
+
+  if (sscanf(req, "%15s %255s", method, path) != 2 ||
+      !_pumpnet_mock_server_parse_path(path, game, &file_type)) {
+    resp.status = 404;
+    return _pumpnet_mock_server_respond(conn->handle, &resp);
+  }
+
+  header = strndup(req, header_len);
+
+  req_binary = _pumpnet_mock_server_has_header(
+      header, "Content-Type:", MEDIA_TYPE_BINARY);
+  req_deflate =
+      _pumpnet_mock_server_has_header(header, "Content-Encoding:", "deflate");
+
+  // best transport accepted by the client
+  if (transport >= PUMPNET_LIB_HTTP_TRANSPORT_BINARY &&
+      _pumpnet_mock_server_has_header(header, "Accept:", MEDIA_TYPE_BINARY)) {
+    resp.transport = PUMPNET_LIB_HTTP_TRANSPORT_BINARY;
+
+    if (transport >= PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE &&
+        _pumpnet_mock_server_has_header(
+            header, "Accept-Encoding:", "deflate")) {
+      resp.transport = PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE;
+    }
+  } else {
+    resp.transport = PUMPNET_LIB_HTTP_TRANSPORT_BASE64;
+  }
+
+  _pumpnet_mock_server_get_header(
+      header, "If-None-Match:", if_none_match, sizeof(if_none_match));
+
+  free(header);
+
+  if ((req_binary && transport < PUMPNET_LIB_HTTP_TRANSPORT_BINARY) ||
+      (req_deflate && transport < PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE)) {
+    resp.status = 415;
+    return _pumpnet_mock_server_respond(conn->handle, &resp);
+  }
+
+  body = _pumpnet_mock_server_decode(
+      req + header_len,
+      req_len - header_len,
+      req_binary,
+      req_deflate,
+      &body_size);
+
+  if (!body) {
+    resp.status = 400;
+  } else if (!strcmp(method, "GET")) {
+    _pumpnet_mock_server_handle_get(
+        conn, game, file_type, body, body_size, if_none_match, &resp);
+  } else if (!strcmp(method, "POST")) {
+    _pumpnet_mock_server_handle_put(
+        conn, game, file_type, body, body_size, &resp);
+  } else {
+    resp.status = 404;
+  }
+
+  free(body);
+
+  res = _pumpnet_mock_server_respond(conn->handle, &resp);
+
+  if (res && resp.status == 200) {
+    pthread_mutex_lock(&server->mutex);
+    server->stats.body_bytes_sent += resp.body_size;
+    pthread_mutex_unlock(&server->mutex);
+  }
+
+  free(resp.body);
+
+  return res;
+}
+
+// reads requests (header and body by content length) and answers them until
+// the client closes the connection
+static void *_pumpnet_mock_server_conn_proc(void *arg)
+{
+  struct pumpnet_mock_server_conn *conn;
+  struct pumpnet_mock_server *server;
+  char *buffer;
+  size_t pos;
+  size_t header_len;
+  size_t req_len;
+  char *header_end;
+  char *content_length;
+  ssize_t res;
+
+  conn = (struct pumpnet_mock_server_conn *) arg;
+  server = conn->server;
+  buffer = util_xmalloc(REQ_BUFFER_SIZE);
+  pos = 0;
+
+  while (true) {
+    buffer[pos] = '\0';
+    header_end = strstr(buffer, "\r\n\r\n");
+
+    if (header_end) {
+      content_length = strcasestr(buffer, "Content-Length:");
+      header_len = header_end + 4 - buffer;
+      req_len = header_len;
+
+      if (content_length && content_length < header_end) {
+        req_len += strtoul(content_length + 15, NULL, 10);
+      }
+
+      if (req_len >= REQ_BUFFER_SIZE) {
+        log_warn("Request exceeds buffer, size %zu", req_len);
+        break;
+      }
+
+      if (pos >= req_len) {
+        if (!_pumpnet_mock_server_handle_request(
+                conn, buffer, header_len, req_len)) {
+          break;
+        }
+
+        memmove(buffer, buffer + req_len, pos - req_len);
+        pos -= req_len;
+        continue;
+      }
+    }
+
+    if (pos == REQ_BUFFER_SIZE - 1) {
+      log_warn("Request header exceeds buffer");
+      break;
+    }
+
+    // 0 on timeout or if the client closed the connection
+    res = util_sock_tcp_recv(
+        conn->handle, buffer + pos, REQ_BUFFER_SIZE - 1 - pos, RECV_TIMEOUT_MS);
+
+    if (res <= 0) {
+      break;
+    }
+
+    pos += res;
+  }
+
+  free(buffer);
+
+  util_sock_tcp_close(conn->handle);
+
+  pthread_mutex_lock(&server->mutex);
+  util_list_remove(&server->conns, &conn->node);
+  pthread_cond_broadcast(&server->cond_conns);
+  pthread_mutex_unlock(&server->mutex);
+
+  free(conn);
+
+  return NULL;
+}
+
+static void *_pumpnet_mock_server_proc(void *arg)
+{
+  struct pumpnet_mock_server *server;
+  struct pumpnet_mock_server_conn *conn;
+  pthread_t thread;
+  int handle;
+
+  server = (struct pumpnet_mock_server *) arg;
+
+  while (true) {
+    handle = util_sock_tcp_accept(server->handle);
+
+    // stopped
+    if (handle == -1) {
+      break;
+    }
+
+    conn = util_xmalloc(sizeof(struct pumpnet_mock_server_conn));
+    memset(conn, 0, sizeof(struct pumpnet_mock_server_conn));
+
+    conn->server = server;
+    conn->handle = handle;
+    conn->seed = util_rand_gen_32();
+
+    pthread_mutex_lock(&server->mutex);
+    util_list_append(&server->conns, &conn->node);
+    pthread_mutex_unlock(&server->mutex);
+
+    if (pthread_create(&thread, NULL, _pumpnet_mock_server_conn_proc, conn) !=
+        0) {
+      log_error("Creating connection thread failed");
+
+      pthread_mutex_lock(&server->mutex);
+      util_list_remove(&server->conns, &conn->node);
+      pthread_mutex_unlock(&server->mutex);
+
+      util_sock_tcp_close(handle);
+      free(conn);
+      continue;
+    }
+
+    pthread_detach(thread);
+  }
+
+  return NULL;
+}
+
+void pumpnet_mock_server_config_init(struct pumpnet_mock_server_config *config)
+{
+  log_assert(config);
+
+  memset(config, 0, sizeof(struct pumpnet_mock_server_config));
+
+  config->address = "127.0.0.1";
+  config->port = 0;
+  config->transport = PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE;
+}
+
+struct pumpnet_mock_server *
+pumpnet_mock_server_start(const struct pumpnet_mock_server_config *config)
+{
+  log_assert(config);
+  log_assert(config->address);
+  log_assert(config->transport < PUMPNET_LIB_HTTP_TRANSPORT_COUNT);
+  log_assert(config->error_rate_percent + config->drop_rate_percent <= 100);
+
+  struct pumpnet_mock_server *server;
+  int handle;
+
+  handle = util_sock_tcp_listen2(config->address, config->port, 64);
+
+  if (handle == -1) {
+    return NULL;
+  }
+
+  server = util_xmalloc(sizeof(struct pumpnet_mock_server));
+  memset(server, 0, sizeof(struct pumpnet_mock_server));
+
+  memcpy(
+      &server->config, config, sizeof(struct pumpnet_mock_server_config));
+  server->handle = handle;
+  server->port = util_sock_tcp_get_local_port(handle);
+  server->next_version = 1;
+
+  util_list_init(&server->files);
+  util_list_init(&server->conns);
+
+  pthread_mutex_init(&server->mutex, NULL);
+  pthread_cond_init(&server->cond_conns, NULL);
+
+  if (pthread_create(
+          &server->thread, NULL, _pumpnet_mock_server_proc, server) != 0) {
+    log_die("Creating server thread failed");
+  }
+
+  log_info(
+      "Listening on %s:%d, latency %d + %d ms, error rate %d%%, drop rate "
+      "%d%%",
+      config->address,
+      server->port,
+      config->latency_ms,
+      config->latency_jitter_ms,
+      config->error_rate_percent,
+      config->drop_rate_percent);
+
+  return server;
+}
+
+uint16_t pumpnet_mock_server_get_port(struct pumpnet_mock_server *server)
+{
+  log_assert(server);
+
+  return server->port;
+}
+
+void pumpnet_mock_server_put(
+    struct pumpnet_mock_server *server,
+    const char *game,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size)
+{
+  log_assert(server);
+  log_assert(game);
+  log_assert(strlen(game) < GAME_MAX_LEN);
+  log_assert(file_type < PUMPNET_LIB_FILE_TYPE_COUNT);
+  log_assert(data);
+
+  pthread_mutex_lock(&server->mutex);
+  _pumpnet_mock_server_store(
+      server, game, file_type, player_ref_id, data, size);
+  pthread_mutex_unlock(&server->mutex);
+}
+
+bool pumpnet_mock_server_get(
+    struct pumpnet_mock_server *server,
+    const char *game,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    void *buffer,
+    size_t size)
+{
+  log_assert(server);
+  log_assert(game);
+  log_assert(file_type < PUMPNET_LIB_FILE_TYPE_COUNT);
+  log_assert(buffer);
+
+  struct pumpnet_mock_server_file *file;
+  bool res;
+
+  pthread_mutex_lock(&server->mutex);
+
+  file = _pumpnet_mock_server_find(server, game, file_type, player_ref_id);
+  res = file && file->resp->size == size;
+
+  if (res) {
+    memcpy(buffer, file->resp->data, size);
+  }
+
+  pthread_mutex_unlock(&server->mutex);
+
+  return res;
+}
+
+void pumpnet_mock_server_set_transport(
+    struct pumpnet_mock_server *server,
+    enum pumpnet_lib_http_transport transport)
+{
+  log_assert(server);
+  log_assert(transport < PUMPNET_LIB_HTTP_TRANSPORT_COUNT);
+
+  pthread_mutex_lock(&server->mutex);
+  server->config.transport = transport;
+  pthread_mutex_unlock(&server->mutex);
+}
+
+void pumpnet_mock_server_inject_faults(
+    struct pumpnet_mock_server *server, uint32_t status, uint32_t count)
+{
+  log_assert(server);
+
+  pthread_mutex_lock(&server->mutex);
+  server->fault_status = status;
+  server->fault_count = count;
+  pthread_mutex_unlock(&server->mutex);
+}
+
+void pumpnet_mock_server_get_stats(
+    struct pumpnet_mock_server *server,
+    struct pumpnet_mock_server_stats *stats)
+{
+  log_assert(server);
+  log_assert(stats);
+
+  pthread_mutex_lock(&server->mutex);
+  memcpy(stats, &server->stats, sizeof(struct pumpnet_mock_server_stats));
+  pthread_mutex_unlock(&server->mutex);
+}
+
+void pumpnet_mock_server_stop(struct pumpnet_mock_server *server)
+{
+  log_assert(server);
+
+  struct util_list_node *node;
+
+  // unblocks accept
+  util_sock_tcp_shutdown(server->handle);
+  pthread_join(server->thread, NULL);
+  util_sock_tcp_close(server->handle);
+
+  pthread_mutex_lock(&server->mutex);
+
+  // unblocks recv of the connection threads which close the connections
+  for (node = server->conns.head; node; node = node->next) {
+    util_sock_tcp_shutdown(((struct pumpnet_mock_server_conn *) node)->handle);
+  }
+
+  while (!util_list_empty(&server->conns)) {
+    pthread_cond_wait(&server->cond_conns, &server->mutex);
+  }
+
+  pthread_mutex_unlock(&server->mutex);
+
+  while ((node = util_list_pop_head(&server->files)) != NULL) {
+    _pumpnet_mock_server_file_free((struct pumpnet_mock_server_file *) node);
+  }
+
+  pthread_cond_destroy(&server->cond_conns);
+  pthread_mutex_destroy(&server->mutex);
+
+  free(server);
+
+  log_info("Stopped");
+}
@@ -0,0 +1,104 @@
+#ifndef PUMPNET_MOCK_SERVER_H
+#define PUMPNET_MOCK_SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "pumpnet/lib/http.h"
+#include "pumpnet/lib/pumpnet.h"
+
+// Self-contained mock of a pumpnet server for tests and load tests: minimal
+// http/1.1 server (keep-alive, a thread per connection) implementing the get
+// and put endpoints of save and rank of all games. Files are stored in memory,
+// tagged (ETag) with a version to support conditional gets (If-None-Match).
+// Latency and errors are injected randomly as configured, or deterministically
+// with pumpnet_mock_server_inject_faults.
+
+struct pumpnet_mock_server;
+
+struct pumpnet_mock_server_config {
+  // address to listen on, e.g. 127.0.0.1 or 0.0.0.0
+  const char *address;
+  // 0 for any free port, see pumpnet_mock_server_get_port
+  uint16_t port;
+  // latency added to every response: latency_ms + random [0, jitter_ms]
+  uint32_t latency_ms;
+  uint32_t latency_jitter_ms;
+  // requests answered with 503 instead of processing them, in percent
+  uint32_t error_rate_percent;
+  // requests not answered, the connection is closed, in percent
+  uint32_t drop_rate_percent;
+  // size of the (random) data returned for files of players not uploaded,
+  // yet, e.g. the size of the save and rank file of the game. 0 to answer
+  // with 404 instead
+  size_t payload_size[PUMPNET_LIB_FILE_TYPE_COUNT];
+  // max transport supported, request bodies with a transport not supported
+  // are rejected with 415
+  enum pumpnet_lib_http_transport transport;
+};
+
+struct pumpnet_mock_server_stats {
+  uint64_t requests;
+  uint64_t gets;
+  uint64_t puts;
+  // gets answered with 304
+  uint64_t not_modified;
+  // injected errors and dropped requests, random and deterministic
+  uint64_t errors;
+  uint64_t drops;
+  // encoded bodies
+  uint64_t body_bytes_received;
+  uint64_t body_bytes_sent;
+};
+
+// initialize a config with defaults: loopback, any port, no latency, no
+// errors, 404 for unknown files, all transports
+void pumpnet_mock_server_config_init(struct pumpnet_mock_server_config *config);
+
+// start listening and serving requests on a background thread. returns NULL
+// if listening on the configured address and port fails
+struct pumpnet_mock_server *
+pumpnet_mock_server_start(const struct pumpnet_mock_server_config *config);
+
+uint16_t pumpnet_mock_server_get_port(struct pumpnet_mock_server *server);
+
+// store a file as if it was uploaded, e.g. to prepare the data of a test
+void pumpnet_mock_server_put(
+    struct pumpnet_mock_server *server,
+    const char *game,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size);
+
+// copy the data of a stored file, e.g. to check an upload. false if not
+// stored or the size differs
+bool pumpnet_mock_server_get(
+    struct pumpnet_mock_server *server,
+    const char *game,
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    void *buffer,
+    size_t size);
+
+// change the max transport supported, e.g. to simulate a server rollback
+void pumpnet_mock_server_set_transport(
+    struct pumpnet_mock_server *server,
+    enum pumpnet_lib_http_transport transport);
+
+// answer the next requests with an error instead of processing them, before
+// the random errors configured. status is the http status code to answer
+// with, e.g. 503, or 0 to close the connection without answering. count 0
+// stops injecting faults
+void pumpnet_mock_server_inject_faults(
+    struct pumpnet_mock_server *server, uint32_t status, uint32_t count);
+
+void pumpnet_mock_server_get_stats(
+    struct pumpnet_mock_server *server,
+    struct pumpnet_mock_server_stats *stats);
+
+// stop accepting connections, close all open connections and free the server
+void pumpnet_mock_server_stop(struct pumpnet_mock_server *server);
+
+#endif
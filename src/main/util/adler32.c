@@ -1,18 +1,254 @@
+#include <immintrin.h>
+
 #include "util/adler32.h"
+#include "util/cpu.h"
 
 #define BASE 65521
 
+/* Largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1, i.e. the number
+   of bytes that can be summed up before s2 has to be reduced */
+#define NMAX 5552
+
+/* Number of vector sized chunks per block of the SIMD paths. Limits the per
+   byte column sums to 128 * 255, i.e. they fit signed 16-bit lanes */
+#define SIMD_BLOCK_CHUNKS 128
+
+typedef uint32_t (*util_adler32_calc_t)(
+    uint32_t initval, const uint8_t *input, size_t length);
+
+static util_adler32_calc_t util_adler32_calc_func;
+
+static uint32_t
+util_adler32_calc_scalar(uint32_t initval, const uint8_t *input, size_t length)
+{
+  uint32_t s1 = initval & 0xffff;
+  uint32_t s2 = (initval >> 16) & 0xffff;
+  size_t block;
+
+  while (length > 0) {
+    block = length < NMAX ? length : NMAX;
+    length -= block;
+
+    while (block >= 8) {
+      s1 += input[0];
+      s2 += s1;
+      s1 += input[1];
+      s2 += s1;
+      s1 += input[2];
+      s2 += s1;
+      s1 += input[3];
+      s2 += s1;
+      s1 += input[4];
+      s2 += s1;
+      s1 += input[5];
+      s2 += s1;
+      s1 += input[6];
+      s2 += s1;
+      s1 += input[7];
+      s2 += s1;
+
+      input += 8;
+      block -= 8;
+    }
+
+    while (block > 0) {
+      s1 += *input++;
+      s2 += s1;
+      block--;
+    }
+
+    s1 %= BASE;
+    s2 %= BASE;
+  }
+
+  return (s2 << 16) | s1;
+}
+
+/*
+ * The SIMD paths process blocks of k chunks (16 or 32 bytes, see
+ * SIMD_BLOCK_CHUNKS) at once. For a chunk size of n bytes:
+ *
+ * s1 = s1_0 + sum(all bytes)
+ * s2 = s2_0 + n * k * s1_0 + n * ps + sum((n - j) * col_j)
+ *
+ * ps is the sum of the prefix sums of the chunks before each chunk, i.e. s1
+ * without s1_0 before adding a chunk, and col_j is the sum of the bytes at
+ * position j of all chunks. Byte sums are calculated with psadbw against zero,
+ * the column sums are accumulated in 16-bit lanes and weighted once per block.
+ */
+__attribute__((target("sse2"))) static uint32_t
+util_adler32_calc_sse2(uint32_t initval, const uint8_t *input, size_t length)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i weights_lo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+  const __m128i weights_hi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+  uint32_t s1 = initval & 0xffff;
+  uint32_t s2 = (initval >> 16) & 0xffff;
+  uint32_t sums[4];
+  size_t chunks;
+  __m128i v_s1;
+  __m128i v_ps;
+  __m128i v_col_lo;
+  __m128i v_col_hi;
+  __m128i v_s2;
+  __m128i bytes;
+
+  while (length >= 16) {
+    chunks = length / 16;
+
+    if (chunks > SIMD_BLOCK_CHUNKS) {
+      chunks = SIMD_BLOCK_CHUNKS;
+    }
+
+    length -= chunks * 16;
+    s2 += (uint32_t) (chunks * 16) * s1;
+
+    v_s1 = zero;
+    v_ps = zero;
+    v_col_lo = zero;
+    v_col_hi = zero;
+
+    for (size_t i = 0; i < chunks; i++) {
+      bytes = _mm_loadu_si128((const __m128i *) input);
+
+      v_ps = _mm_add_epi32(v_ps, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes, zero));
+      v_col_lo = _mm_add_epi16(v_col_lo, _mm_unpacklo_epi8(bytes, zero));
+      v_col_hi = _mm_add_epi16(v_col_hi, _mm_unpackhi_epi8(bytes, zero));
+
+      input += 16;
+    }
+
+    v_s2 = _mm_add_epi32(
+        _mm_madd_epi16(v_col_lo, weights_lo),
+        _mm_madd_epi16(v_col_hi, weights_hi));
+    v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 4));
+
+    _mm_storeu_si128((__m128i *) sums, v_s1);
+    s1 += sums[0] + sums[2];
+
+    _mm_storeu_si128((__m128i *) sums, v_s2);
+    s2 += sums[0] + sums[1] + sums[2] + sums[3];
+
+    s1 %= BASE;
+    s2 %= BASE;
+  }
+
+  return util_adler32_calc_scalar((s2 << 16) | s1, input, length);
+}
+
+__attribute__((target("avx2"))) static uint32_t
+util_adler32_calc_avx2(uint32_t initval, const uint8_t *input, size_t length)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  /* Unpacking interleaves within the 128-bit lanes: lo holds bytes 0-7 and
+     16-23, hi holds bytes 8-15 and 24-31 */
+  const __m256i weights_lo = _mm256_setr_epi16(
+      32, 31, 30, 29, 28, 27, 26, 25, 16, 15, 14, 13, 12, 11, 10, 9);
+  const __m256i weights_hi = _mm256_setr_epi16(
+      24, 23, 22, 21, 20, 19, 18, 17, 8, 7, 6, 5, 4, 3, 2, 1);
+  uint32_t s1 = initval & 0xffff;
+  uint32_t s2 = (initval >> 16) & 0xffff;
+  uint32_t sums[8];
+  size_t chunks;
+  __m256i v_s1;
+  __m256i v_ps;
+  __m256i v_col_lo;
+  __m256i v_col_hi;
+  __m256i v_s2;
+  __m256i bytes;
+
+  while (length >= 32) {
+    chunks = length / 32;
+
+    if (chunks > SIMD_BLOCK_CHUNKS) {
+      chunks = SIMD_BLOCK_CHUNKS;
+    }
+
+    length -= chunks * 32;
+    s2 += (uint32_t) (chunks * 32) * s1;
+
+    v_s1 = zero;
+    v_ps = zero;
+    v_col_lo = zero;
+    v_col_hi = zero;
+
+    for (size_t i = 0; i < chunks; i++) {
+      bytes = _mm256_loadu_si256((const __m256i *) input);
+
+      v_ps = _mm256_add_epi32(v_ps, v_s1);
+      v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes, zero));
+      v_col_lo =
+          _mm256_add_epi16(v_col_lo, _mm256_unpacklo_epi8(bytes, zero));
+      v_col_hi =
+          _mm256_add_epi16(v_col_hi, _mm256_unpackhi_epi8(bytes, zero));
+
+      input += 32;
+    }
+
+    v_s2 = _mm256_add_epi32(
+        _mm256_madd_epi16(v_col_lo, weights_lo),
+        _mm256_madd_epi16(v_col_hi, weights_hi));
+    v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 5));
+
+    _mm256_storeu_si256((__m256i *) sums, v_s1);
+    s1 += sums[0] + sums[2] + sums[4] + sums[6];
+
+    _mm256_storeu_si256((__m256i *) sums, v_s2);
+    s2 += sums[0] + sums[1] + sums[2] + sums[3] + sums[4] + sums[5] +
+        sums[6] + sums[7];
+
+    s1 %= BASE;
+    s2 %= BASE;
+  }
+
+  return util_adler32_calc_scalar((s2 << 16) | s1, input, length);
+}
+
+bool util_adler32_impl_supported(enum util_adler32_impl impl)
+{
+  switch (impl) {
+    case UTIL_ADLER32_IMPL_SCALAR:
+      return true;
+    case UTIL_ADLER32_IMPL_SSE2:
+      return util_cpu_has_sse2();
+    case UTIL_ADLER32_IMPL_AVX2:
+      return util_cpu_has_avx2();
+    default:
+      return false;
+  }
+}
+
+uint32_t util_adler32_calc_impl(
+    enum util_adler32_impl impl,
+    uint32_t initval,
+    const uint8_t *input,
+    size_t length)
+{
+  switch (impl) {
+    case UTIL_ADLER32_IMPL_SSE2:
+      return util_adler32_calc_sse2(initval, input, length);
+    case UTIL_ADLER32_IMPL_AVX2:
+      return util_adler32_calc_avx2(initval, input, length);
+    case UTIL_ADLER32_IMPL_SCALAR:
+    default:
+      return util_adler32_calc_scalar(initval, input, length);
+  }
+}
+
 uint32_t
 util_adler32_calc(uint32_t initval, const uint8_t *input, size_t length)
 {
-  unsigned int s1 = initval & 0xffff;
-  unsigned int s2 = (initval >> 16) & 0xffff;
-  unsigned int n;
-
-  for (n = 0; n < length; n++) {
-    s1 = (s1 + input[n]) % BASE;
-    s2 = (s2 + s1) % BASE;
+  /* Resolving concurrently is fine, all threads resolve to the same result */
+  if (!util_adler32_calc_func) {
+    if (util_cpu_has_avx2()) {
+      util_adler32_calc_func = util_adler32_calc_avx2;
+    } else if (util_cpu_has_sse2()) {
+      util_adler32_calc_func = util_adler32_calc_sse2;
+    } else {
+      util_adler32_calc_func = util_adler32_calc_scalar;
+    }
   }
 
-  return (s2 << 16) + s1;
-}
\ No newline at end of file
+  return util_adler32_calc_func(initval, input, length);
+}
@@ -1,11 +1,22 @@
 #ifndef UTIL_ADLER32_H
 #define UTIL_ADLER32_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
 /**
- * Calculate the adler32 checksum
+ * Available implementations of the checksum calculation
+ */
+enum util_adler32_impl {
+  UTIL_ADLER32_IMPL_SCALAR = 0,
+  UTIL_ADLER32_IMPL_SSE2 = 1,
+  UTIL_ADLER32_IMPL_AVX2 = 2,
+};
+
+/**
+ * Calculate the adler32 checksum. Uses the fastest implementation supported
+ * by the CPU (detected once on the first call)
  *
  * @param initval Initial value for calculation
  * @param input Input buffer to checksum
@@ -15,4 +26,29 @@
 uint32_t
 util_adler32_calc(uint32_t initval, const uint8_t *input, size_t length);
 
-#endif
\ No newline at end of file
+/**
+ * Check if an implementation is supported by the CPU
+ *
+ * @param impl Implementation to check
+ * @return True if supported, false otherwise
+ */
+bool util_adler32_impl_supported(enum util_adler32_impl impl);
+
+/**
+ * Calculate the adler32 checksum with a specific implementation, e.g. for
+ * testing and benchmarking. The implementation must be supported by the CPU
+ * (see util_adler32_impl_supported)
+ *
+ * @param impl Implementation to use
+ * @param initval Initial value for calculation
+ * @param input Input buffer to checksum
+ * @param length Length of the input buffer
+ * @return Adler32 value of input buffer
+ */
+uint32_t util_adler32_calc_impl(
+    enum util_adler32_impl impl,
+    uint32_t initval,
+    const uint8_t *input,
+    size_t length);
+
+#endif
@@ -0,0 +1,303 @@
+#define LOG_MODULE "util-batch"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/batch.h"
+#include "util/fs.h"
+#include "util/log.h"
+#include "util/mem.h"
+#include "util/str.h"
+#include "util/time.h"
+
+struct util_batch {
+  util_batch_proc_t proc;
+  void *ctx;
+
+  pthread_t *threads;
+  size_t num_threads;
+
+  /* Protects everything below */
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+
+  /* Ring buffer of pending items */
+  char **queue;
+  size_t queue_size;
+  size_t queue_head;
+  size_t queue_count;
+  bool finished;
+
+  uint64_t start_ns;
+  struct util_batch_result result;
+};
+
+static void *util_batch_worker(void *arg)
+{
+  struct util_batch *batch;
+  struct util_batch_error *error;
+  char *item;
+  char *msg;
+
+  batch = (struct util_batch *) arg;
+
+  while (true) {
+    pthread_mutex_lock(&batch->lock);
+
+    while (batch->queue_count == 0 && !batch->finished) {
+      pthread_cond_wait(&batch->not_empty, &batch->lock);
+    }
+
+    if (batch->queue_count == 0) {
+      pthread_mutex_unlock(&batch->lock);
+      break;
+    }
+
+    item = batch->queue[batch->queue_head];
+    batch->queue_head = (batch->queue_head + 1) % batch->queue_size;
+    batch->queue_count--;
+
+    pthread_cond_signal(&batch->not_full);
+    pthread_mutex_unlock(&batch->lock);
+
+    msg = batch->proc(item, batch->ctx);
+
+    pthread_mutex_lock(&batch->lock);
+
+    batch->result.processed++;
+
+    if (msg) {
+      batch->result.failed++;
+
+      error = util_array_append(struct util_batch_error, &batch->result.errors);
+      error->item = item;
+      error->msg = msg;
+    } else {
+      free(item);
+    }
+
+    pthread_mutex_unlock(&batch->lock);
+  }
+
+  return NULL;
+}
+
+struct util_batch *util_batch_start(
+    size_t num_threads, size_t queue_size, util_batch_proc_t proc, void *ctx)
+{
+  struct util_batch *batch;
+  long cpus;
+
+  log_assert(queue_size > 0);
+  log_assert(proc);
+
+  if (num_threads == 0) {
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cpus > 0 ? (size_t) cpus : 1;
+  }
+
+  batch = util_xmalloc(sizeof(struct util_batch));
+  memset(batch, 0, sizeof(struct util_batch));
+
+  batch->proc = proc;
+  batch->ctx = ctx;
+  batch->num_threads = num_threads;
+  batch->threads = util_xmalloc(sizeof(pthread_t) * num_threads);
+  batch->queue_size = queue_size;
+  batch->queue = util_xmalloc(sizeof(char *) * queue_size);
+
+  pthread_mutex_init(&batch->lock, NULL);
+  pthread_cond_init(&batch->not_empty, NULL);
+  pthread_cond_init(&batch->not_full, NULL);
+
+  util_array_init(&batch->result.errors);
+
+  batch->start_ns = util_time_get_monotonic_ns();
+
+  for (size_t i = 0; i < num_threads; i++) {
+    if (pthread_create(
+            &batch->threads[i], NULL, util_batch_worker, batch) != 0) {
+      log_die("Creating worker thread %d failed", i);
+    }
+  }
+
+  log_debug(
+      "Started %d worker threads, queue size %d", num_threads, queue_size);
+
+  return batch;
+}
+
+void util_batch_push(struct util_batch *batch, const char *item)
+{
+  log_assert(batch);
+  log_assert(item);
+
+  pthread_mutex_lock(&batch->lock);
+
+  while (batch->queue_count == batch->queue_size) {
+    pthread_cond_wait(&batch->not_full, &batch->lock);
+  }
+
+  batch->queue[(batch->queue_head + batch->queue_count) % batch->queue_size] =
+      util_str_dup(item);
+  batch->queue_count++;
+
+  pthread_cond_signal(&batch->not_empty);
+  pthread_mutex_unlock(&batch->lock);
+}
+
+static bool util_batch_push_dir(struct util_batch *batch, const char *path)
+{
+  DIR *dir;
+  struct dirent *entry;
+  const char *sep;
+  char *prefix;
+  char *item;
+
+  dir = opendir(path);
+
+  if (!dir) {
+    log_error("Opening directory %s failed", path);
+    return false;
+  }
+
+  sep = util_str_ends_with(path, "/") ? "" : "/";
+  prefix = util_str_merge(path, sep);
+
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+
+    item = util_xmalloc(strlen(prefix) + strlen(entry->d_name) + 2);
+    sprintf(item, "%s%s/", prefix, entry->d_name);
+
+    util_batch_push(batch, item);
+
+    free(item);
+  }
+
+  free(prefix);
+  closedir(dir);
+
+  return true;
+}
+
+static bool util_batch_push_list(struct util_batch *batch, const char *path)
+{
+  char *list;
+  char **lines;
+  size_t size;
+  size_t count;
+
+  if (!util_file_load(path, (void **) &list, &size, true)) {
+    log_error("Loading list file %s failed", path);
+    return false;
+  }
+
+  lines = util_str_split(list, "\r\n", &count);
+
+  for (size_t i = 0; i < count; i++) {
+    util_batch_push(batch, lines[i]);
+  }
+
+  util_str_free_split(lines, count);
+  free(list);
+
+  return true;
+}
+
+bool util_batch_push_path(struct util_batch *batch, const char *path)
+{
+  struct stat st;
+
+  log_assert(batch);
+  log_assert(path);
+
+  if (stat(path, &st) != 0) {
+    log_error("Path %s does not exist", path);
+    return false;
+  }
+
+  if (S_ISDIR(st.st_mode)) {
+    return util_batch_push_dir(batch, path);
+  } else {
+    return util_batch_push_list(batch, path);
+  }
+}
+
+void util_batch_finish(
+    struct util_batch *batch, struct util_batch_result *result)
+{
+  log_assert(batch);
+  log_assert(result);
+
+  pthread_mutex_lock(&batch->lock);
+  batch->finished = true;
+  pthread_cond_broadcast(&batch->not_empty);
+  pthread_mutex_unlock(&batch->lock);
+
+  for (size_t i = 0; i < batch->num_threads; i++) {
+    pthread_join(batch->threads[i], NULL);
+  }
+
+  batch->result.elapsed_ns = util_time_get_monotonic_ns() - batch->start_ns;
+
+  memcpy(result, &batch->result, sizeof(struct util_batch_result));
+
+  pthread_cond_destroy(&batch->not_full);
+  pthread_cond_destroy(&batch->not_empty);
+  pthread_mutex_destroy(&batch->lock);
+
+  free(batch->queue);
+  free(batch->threads);
+  free(batch);
+}
+
+void util_batch_result_print(
+    const struct util_batch_result *result, FILE *file)
+{
+  const struct util_batch_error *error;
+  double elapsed_sec;
+
+  log_assert(result);
+  log_assert(file);
+
+  elapsed_sec = result->elapsed_ns / 1000.0 / 1000.0 / 1000.0;
+
+  fprintf(
+      file,
+      "Processed %zu items in %.3f sec (%.1f items/sec), %zu succeeded, %zu "
+      "failed\n",
+      result->processed,
+      elapsed_sec,
+      elapsed_sec > 0 ? result->processed / elapsed_sec : 0,
+      result->processed - result->failed,
+      result->failed);
+
+  for (size_t i = 0; i < result->errors.nitems; i++) {
+    error = util_array_item(struct util_batch_error, &result->errors, i);
+
+    fprintf(file, "  %s: %s\n", error->item, error->msg);
+  }
+}
+
+void util_batch_result_fini(struct util_batch_result *result)
+{
+  struct util_batch_error *error;
+
+  log_assert(result);
+
+  for (size_t i = 0; i < result->errors.nitems; i++) {
+    error = util_array_item(struct util_batch_error, &result->errors, i);
+
+    free(error->item);
+    free(error->msg);
+  }
+
+  util_array_fini(&result->errors);
+}
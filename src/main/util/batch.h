@@ -0,0 +1,106 @@
+/**
+ * Process a large number of items, e.g. profile files, on a pool of worker
+ * threads. Items are passed to the workers through a bounded queue, i.e.
+ * pushing blocks while the workers are busy instead of buffering all items.
+ * Errors are collected per item and reported together with the throughput in
+ * a summary once all items are processed.
+ */
+#ifndef UTIL_BATCH_H
+#define UTIL_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "util/array.h"
+
+/**
+ * Process a single item, called concurrently by the worker threads
+ *
+ * @param item Item to process
+ * @param ctx Context passed to util_batch_start
+ * @return NULL on success, allocated error message (freed by the batch)
+ *         otherwise
+ */
+typedef char *(*util_batch_proc_t)(const char *item, void *ctx);
+
+struct util_batch;
+
+/**
+ * Error of a single item
+ */
+struct util_batch_error {
+  char *item;
+  char *msg;
+};
+
+/**
+ * Result of a batch
+ */
+struct util_batch_result {
+  size_t processed;
+  size_t failed;
+  uint64_t elapsed_ns;
+  /* struct util_batch_error, in order of completion */
+  struct util_array errors;
+};
+
+/**
+ * Start the worker threads of a batch
+ *
+ * @param num_threads Number of worker threads, 0 for the number of online
+ *        processors
+ * @param queue_size Max number of pending items before pushing blocks
+ * @param proc Function processing an item
+ * @param ctx Context passed to proc
+ * @return Batch handle
+ */
+struct util_batch *util_batch_start(
+    size_t num_threads, size_t queue_size, util_batch_proc_t proc, void *ctx);
+
+/**
+ * Push an item to the queue, blocks if the queue is full
+ *
+ * @param batch Batch handle
+ * @param item Item to push, copied
+ */
+void util_batch_push(struct util_batch *batch, const char *item);
+
+/**
+ * Push all items of a path. If the path is a directory, every entry (except
+ * hidden ones) of it is pushed as a path prefix, i.e. directory/entry/. If the
+ * path is a file, every non empty line is pushed as is (list file)
+ *
+ * @param batch Batch handle
+ * @param path Path to a directory or list file
+ * @return True on success, false if the path could not be read
+ */
+bool util_batch_push_path(struct util_batch *batch, const char *path);
+
+/**
+ * Wait for all pushed items to be processed and stop the worker threads
+ *
+ * @param batch Batch handle, invalid afterwards
+ * @param result Pointer to a result struct to fill, free with
+ *        util_batch_result_fini
+ */
+void util_batch_finish(
+    struct util_batch *batch, struct util_batch_result *result);
+
+/**
+ * Print a summary of the result (throughput and errors)
+ *
+ * @param result Result to print
+ * @param file File to print to, e.g. stdout
+ */
+void util_batch_result_print(
+    const struct util_batch_result *result, FILE *file);
+
+/**
+ * Free the resources of a result
+ *
+ * @param result Result to free
+ */
+void util_batch_result_fini(struct util_batch_result *result);
+
+#endif
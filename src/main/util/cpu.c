@@ -0,0 +1,53 @@
+#include <cpuid.h>
+
+#include "util/cpu.h"
+
+#define CPUID_1_ECX_OSXSAVE (1 << 27)
+#define CPUID_1_ECX_AVX (1 << 28)
+#define CPUID_1_EDX_SSE2 (1 << 26)
+#define CPUID_7_EBX_AVX2 (1 << 5)
+#define XCR0_SSE_AVX_STATE 0x6
+
+bool util_cpu_has_sse2(void)
+{
+  unsigned int eax;
+  unsigned int ebx;
+  unsigned int ecx;
+  unsigned int edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+
+  return (edx & CPUID_1_EDX_SSE2) != 0;
+}
+
+bool util_cpu_has_avx2(void)
+{
+  unsigned int eax;
+  unsigned int ebx;
+  unsigned int ecx;
+  unsigned int edx;
+  unsigned int xcr0;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+
+  if (!(ecx & CPUID_1_ECX_AVX) || !(ecx & CPUID_1_ECX_OSXSAVE)) {
+    return false;
+  }
+
+  /* The OS has to save the ymm registers on context switches */
+  __asm__("xgetbv" : "=a"(xcr0) : "c"(0) : "edx");
+
+  if ((xcr0 & XCR0_SSE_AVX_STATE) != XCR0_SSE_AVX_STATE) {
+    return false;
+  }
+
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+
+  return (ebx & CPUID_7_EBX_AVX2) != 0;
+}
@@ -0,0 +1,21 @@
+#ifndef UTIL_CPU_H
+#define UTIL_CPU_H
+
+#include <stdbool.h>
+
+/**
+ * Check if the CPU supports SSE2
+ *
+ * @return True if supported, false otherwise
+ */
+bool util_cpu_has_sse2(void);
+
+/**
+ * Check if the CPU supports AVX2 and the OS saves the ymm registers on context
+ * switches
+ *
+ * @return True if supported, false otherwise
+ */
+bool util_cpu_has_avx2(void);
+
+#endif
@@ -3,6 +3,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <netinet/tcp.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -138,6 +139,91 @@ int util_sock_tcp_connect3(uint32_t ipv4, uint16_t port)
   return handle;
 }
 
+int util_sock_tcp_listen2(const char *ipv4, uint16_t port, int backlog)
+{
+  struct sockaddr_in sa;
+
+  // store this IP address in sa:
+  inet_pton(AF_INET, ipv4, &(sa.sin_addr));
+
+  return util_sock_tcp_listen3(htonl(sa.sin_addr.s_addr), port, backlog);
+}
+
+int util_sock_tcp_listen3(uint32_t ipv4, uint16_t port, int backlog)
+{
+  int handle;
+  struct sockaddr_in addr;
+  int one;
+
+  handle = socket(AF_INET, SOCK_STREAM, 0);
+
+  if (handle == -1) {
+    log_error(
+        "Creating socket (%X, %d) failed: %s", ipv4, port, strerror(errno));
+    return -1;
+  }
+
+  // allow restarting a server right away, e.g. with connections in TIME_WAIT
+  one = 1;
+  setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(struct sockaddr_in));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(ipv4);
+
+  if (bind(handle, (const struct sockaddr *) &addr, sizeof(addr)) == -1) {
+    log_error("Binding to %X, %d failed: %s", ipv4, port, strerror(errno));
+    close(handle);
+    return -1;
+  }
+
+  if (listen(handle, backlog) == -1) {
+    log_error("Listening on %X, %d failed: %s", ipv4, port, strerror(errno));
+    close(handle);
+    return -1;
+  }
+
+  log_debug(
+      "Listening on %X, port %d", ipv4, util_sock_tcp_get_local_port(handle));
+
+  return handle;
+}
+
+int util_sock_tcp_accept(int handle)
+{
+  int remote_handle;
+  int one;
+
+  do {
+    remote_handle = accept(handle, NULL, NULL);
+  } while (remote_handle == -1 && errno == EINTR);
+
+  if (remote_handle == -1) {
+    return -1;
+  }
+
+  // request/response protocols, don't delay small writes
+  one = 1;
+  setsockopt(remote_handle, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  return remote_handle;
+}
+
+uint16_t util_sock_tcp_get_local_port(int handle)
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len;
+
+  addr_len = sizeof(addr);
+
+  if (getsockname(handle, (struct sockaddr *) &addr, &addr_len) == -1) {
+    return 0;
+  }
+
+  return ntohs(addr.sin_port);
+}
+
 ssize_t
 util_sock_tcp_send(int handle, void *buffer, size_t size, uint32_t timeout_ms)
 {
@@ -147,7 +233,8 @@ util_sock_tcp_send(int handle, void *buffer, size_t size, uint32_t timeout_ms)
 
   setsockopt(handle, SOL_SOCKET, SO_SNDTIMEO, (const char *) &tv, sizeof(tv));
 
-  ssize_t length = send(handle, buffer, size, 0);
+  // error instead of SIGPIPE if the remote closed the connection
+  ssize_t length = send(handle, buffer, size, MSG_NOSIGNAL);
 
   if (length < 0) {
     // same as EWOULDBLOCK
@@ -186,6 +273,11 @@ util_sock_tcp_recv(int handle, void *buffer, size_t size, uint32_t timeout_ms)
   return length;
 }
 
+void util_sock_tcp_shutdown(int handle)
+{
+  shutdown(handle, SHUT_RDWR);
+}
+
 void util_sock_tcp_close(int handle)
 {
   close(handle);
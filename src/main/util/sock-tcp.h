@@ -23,12 +23,29 @@ int util_sock_tcp_connect2(const char *ipv4, uint16_t port);
 
 int util_sock_tcp_connect3(uint32_t ipv4, uint16_t port);
 
+// listen for connections on the given address (e.g. 127.0.0.1 or 0.0.0.0)
+// and port, 0 to pick a free port (see util_sock_tcp_get_local_port).
+// returns -1 on error
+int util_sock_tcp_listen2(const char *ipv4, uint16_t port, int backlog);
+
+int util_sock_tcp_listen3(uint32_t ipv4, uint16_t port, int backlog);
+
+// block until a connection is accepted on a listening handle. returns -1 on
+// error, e.g. once the handle is shut down (see util_sock_tcp_shutdown)
+int util_sock_tcp_accept(int handle);
+
+uint16_t util_sock_tcp_get_local_port(int handle);
+
 ssize_t
 util_sock_tcp_send(int handle, void *buffer, size_t size, uint32_t timeout_ms);
 
 ssize_t
 util_sock_tcp_recv(int handle, void *buffer, size_t size, uint32_t timeout_ms);
 
+// shut down both directions of a connection, e.g. to unblock another thread
+// waiting in accept or recv on the handle
+void util_sock_tcp_shutdown(int handle);
+
 void util_sock_tcp_close(int handle);
 
 #endif
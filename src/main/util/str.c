@@ -209,4 +209,151 @@ void util_str_free_split(char **split, size_t count)
   }
 
   util_xfree((void **) &split);
-}
\ No newline at end of file
+}
+
+#define UTIL_STRBUF_DEFAULT_SIZE 256
+
+static void util_strbuf_reserve(struct util_strbuf *buf, size_t len)
+{
+  size_t size;
+
+  if (buf->len + len + 1 <= buf->size) {
+    return;
+  }
+
+  size = buf->size > 0 ? buf->size : UTIL_STRBUF_DEFAULT_SIZE;
+
+  while (size < buf->len + len + 1) {
+    size *= 2;
+  }
+
+  buf->str = util_xrealloc(buf->str, size);
+  buf->size = size;
+}
+
+void util_strbuf_init(struct util_strbuf *buf, size_t size)
+{
+  log_assert(buf);
+
+  if (size == 0) {
+    size = UTIL_STRBUF_DEFAULT_SIZE;
+  }
+
+  buf->str = util_xmalloc(size);
+  buf->str[0] = '\0';
+  buf->len = 0;
+  buf->size = size;
+}
+
+void util_strbuf_append(struct util_strbuf *buf, const char *str)
+{
+  size_t len;
+
+  log_assert(buf);
+  log_assert(str);
+
+  len = strlen(str);
+
+  util_strbuf_reserve(buf, len);
+
+  memcpy(buf->str + buf->len, str, len + 1);
+  buf->len += len;
+}
+
+void util_strbuf_append_format(struct util_strbuf *buf, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  util_strbuf_append_vformat(buf, fmt, ap);
+  va_end(ap);
+}
+
+void util_strbuf_append_vformat(
+    struct util_strbuf *buf, const char *fmt, va_list ap)
+{
+  va_list ap_copy;
+  int len;
+
+  log_assert(buf);
+  log_assert(fmt);
+
+  /* Try printing to the remaining space first, grow and retry if it did not
+     fit */
+  va_copy(ap_copy, ap);
+  len = vsnprintf(buf->str + buf->len, buf->size - buf->len, fmt, ap_copy);
+  va_end(ap_copy);
+
+  if (len < 0) {
+    abort();
+  }
+
+  if (buf->len + len + 1 > buf->size) {
+    util_strbuf_reserve(buf, len);
+
+    if (vsnprintf(buf->str + buf->len, buf->size - buf->len, fmt, ap) != len) {
+      abort();
+    }
+  }
+
+  buf->len += len;
+}
+
+void util_strbuf_append_buffer(
+    struct util_strbuf *buf, const uint8_t *data, size_t len)
+{
+  static const char digits[] = "0123456789ABCDEF";
+  char *pos;
+
+  log_assert(buf);
+  log_assert(data);
+
+  util_strbuf_reserve(buf, len * 3);
+
+  pos = buf->str + buf->len;
+
+  for (size_t i = 0; i < len; i++) {
+    *pos++ = digits[data[i] >> 4];
+    *pos++ = digits[data[i] & 0xF];
+    *pos++ = ' ';
+  }
+
+  *pos = '\0';
+  buf->len += len * 3;
+}
+
+void util_strbuf_clear(struct util_strbuf *buf)
+{
+  log_assert(buf);
+
+  buf->len = 0;
+
+  if (buf->str) {
+    buf->str[0] = '\0';
+  }
+}
+
+char *util_strbuf_detach(struct util_strbuf *buf)
+{
+  char *str;
+
+  log_assert(buf);
+
+  str = buf->str ? buf->str : util_str_dup("");
+
+  /* Allocated again on the next append */
+  buf->str = NULL;
+  buf->len = 0;
+  buf->size = 0;
+
+  return str;
+}
+
+void util_strbuf_fini(struct util_strbuf *buf)
+{
+  log_assert(buf);
+
+  util_xfree((void **) &buf->str);
+  buf->len = 0;
+  buf->size = 0;
+}
@@ -104,4 +104,83 @@ char **util_str_split(const char *str, const char *delim, size_t *count);
 
 void util_str_free_split(char **split, size_t count);
 
+/**
+ * Growable string buffer. Appending is amortized O(1), use this instead of
+ * repeatedly merging strings when building large strings
+ */
+struct util_strbuf {
+  char *str;
+  size_t len;
+  size_t size;
+};
+
+/**
+ * Initialize a string buffer
+ *
+ * @param buf Buffer to initialize
+ * @param size Initial size to allocate (grows if required), 0 for default
+ */
+void util_strbuf_init(struct util_strbuf *buf, size_t size);
+
+/**
+ * Append a string to a string buffer
+ *
+ * @param buf Buffer to append to
+ * @param str String to append
+ */
+void util_strbuf_append(struct util_strbuf *buf, const char *str);
+
+/**
+ * Append a formated string to a string buffer
+ *
+ * @param buf Buffer to append to
+ * @param fmt Format of the string to append
+ * @param ... Arguments for the format string
+ */
+void util_strbuf_append_format(struct util_strbuf *buf, const char *fmt, ...);
+
+/**
+ * Append a formated string to a string buffer
+ *
+ * @param buf Buffer to append to
+ * @param fmt Format of the string to append
+ * @param ap Argument list for format
+ */
+void util_strbuf_append_vformat(
+    struct util_strbuf *buf, const char *fmt, va_list ap);
+
+/**
+ * Append a buffer as hex digits to a string buffer, see util_str_buffer
+ *
+ * @param buf Buffer to append to
+ * @param data Data to print
+ * @param len Length of the data
+ */
+void util_strbuf_append_buffer(
+    struct util_strbuf *buf, const uint8_t *data, size_t len);
+
+/**
+ * Clear the contents of a string buffer, keeps the allocated memory for
+ * re-use
+ *
+ * @param buf Buffer to clear
+ */
+void util_strbuf_clear(struct util_strbuf *buf);
+
+/**
+ * Detach the string of a string buffer. The buffer is empty afterwards and
+ * can be re-used
+ *
+ * @param buf Buffer to detach the string from
+ * @return String of the buffer. Caller has to manage memory returned
+ */
+char *util_strbuf_detach(struct util_strbuf *buf);
+
+/**
+ * Free the memory of a string buffer
+ *
+ * @param buf Buffer to free
+ */
+void util_strbuf_fini(struct util_strbuf *buf);
+
 #endif
@@ -66,4 +66,13 @@ void util_time_get_current_time(struct util_time_timestamp *timestamp)
   timestamp->month = tm->tm_mon + 1;
   // Years since 1900
   timestamp->year = tm->tm_year + 1900;
+}
+
+uint64_t util_time_get_monotonic_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000 * 1000 * 1000 + (uint64_t) ts.tv_nsec;
 }
\ No newline at end of file
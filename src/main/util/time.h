@@ -23,4 +23,8 @@ void util_time_sleep_sec(uint64_t time_sec);
 
 void util_time_get_current_time(struct util_time_timestamp *timestamp);
 
+// Monotonic time in ns, e.g. to measure durations, not affected by changes of
+// the system time
+uint64_t util_time_get_monotonic_ns(void);
+
 #endif // UTIL_TIME_H
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka/cmocka.h>
+
+#include "crypt/usb-profile.h"
+
+/* Sizes of the nx2 save and rank files (save without review area) */
+#define SAVE_SIZE 30780
+#define RANK_SIZE 12296
+
+static uint8_t plain[SAVE_SIZE];
+static uint8_t buffer[SAVE_SIZE];
+static uint8_t expected[SAVE_SIZE];
+
+static void reference_decrypt(uint8_t *buf, size_t len)
+{
+  for (uint32_t a = len - 1; a > 0; --a) {
+    buf[a] = (buf[a] ^ buf[a - 1]) + ((a * 1234567) >> 8);
+  }
+}
+
+static void reference_encrypt(uint8_t *buf, size_t len)
+{
+  for (uint32_t a = 1; a < len; ++a) {
+    buf[a] = (buf[a] - ((a * 1234567) >> 8)) ^ buf[a - 1];
+  }
+}
+
+static void fill_random(uint8_t *buf, size_t length, uint32_t seed)
+{
+  for (size_t i = 0; i < length; i++) {
+    seed = seed * 1103515245 + 12345;
+    buf[i] = (uint8_t) (seed >> 16);
+  }
+}
+
+static void assert_decrypt(size_t len)
+{
+  memcpy(buffer, plain, len);
+  memcpy(expected, plain, len);
+
+  crypt_usb_profile_decrypt(buffer, len);
+  reference_decrypt(expected, len);
+
+  assert_memory_equal(buffer, expected, len);
+}
+
+static void assert_encrypt(size_t len)
+{
+  memcpy(buffer, plain, len);
+  memcpy(expected, plain, len);
+
+  crypt_usb_profile_encrypt(buffer, len);
+  reference_encrypt(expected, len);
+
+  assert_memory_equal(buffer, expected, len);
+
+  crypt_usb_profile_decrypt(buffer, len);
+
+  assert_memory_equal(buffer, plain, len);
+}
+
+static void test_usb_profile_short(void **state)
+{
+  fill_random(plain, sizeof(plain), 1);
+
+  buffer[0] = plain[0];
+  crypt_usb_profile_decrypt(buffer, 1);
+  assert_int_equal(buffer[0], plain[0]);
+
+  crypt_usb_profile_encrypt(buffer, 1);
+  assert_int_equal(buffer[0], plain[0]);
+
+  crypt_usb_profile_decrypt(buffer, 0);
+  crypt_usb_profile_encrypt(buffer, 0);
+}
+
+static void test_usb_profile_decrypt_lengths(void **state)
+{
+  fill_random(plain, sizeof(plain), 2);
+
+  /* More sizes than the keystream cache holds */
+  for (size_t len = 2; len < 8; len++) {
+    assert_decrypt(len);
+  }
+
+  assert_decrypt(17);
+  assert_decrypt(33);
+  assert_decrypt(100);
+}
+
+static void test_usb_profile_decrypt_sizes(void **state)
+{
+  fill_random(plain, sizeof(plain), 3);
+
+  assert_decrypt(SAVE_SIZE);
+  assert_decrypt(RANK_SIZE);
+}
+
+static void test_usb_profile_encrypt_sizes(void **state)
+{
+  fill_random(plain, sizeof(plain), 4);
+
+  assert_encrypt(SAVE_SIZE);
+  assert_encrypt(RANK_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_usb_profile_short),
+      cmocka_unit_test(test_usb_profile_decrypt_lengths),
+      cmocka_unit_test(test_usb_profile_decrypt_sizes),
+      cmocka_unit_test(test_usb_profile_encrypt_sizes)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,212 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka/cmocka.h>
+
+#include "capnhook/hook/lib.h"
+
+#include "hook/exc/io.h"
+#include "hook/exc/mempatch.h"
+
+#include "ptapi/io/piuio.h"
+
+#include "util/time.h"
+
+#define FRAMES 100
+/* Calls to check per frame, the game reads the sensors multiple times */
+#define CHECKS_PER_FRAME 3
+
+extern uint16_t exchook_io_check(void *obj);
+extern int32_t exchook_io_input(void *obj);
+
+/* Stands in for the game's code patched with jumps to the hooks, never
+   executed. Patching unprotects the page following the function, too */
+static uint8_t game_code[2][4096] __attribute__((aligned(4096)));
+
+static uint32_t game_input_stat;
+static uint32_t game_input_down;
+static uint32_t game_input_up;
+
+static struct exchook_mempatch_table patch_table;
+
+static uint32_t piuio_recv_count;
+
+static const char *piuio_ident_mock(void)
+{
+  return "mock";
+}
+
+static bool piuio_open_mock(void)
+{
+  return true;
+}
+
+static void piuio_close_mock(void)
+{
+}
+
+static bool piuio_recv_mock(void)
+{
+  piuio_recv_count++;
+
+  return true;
+}
+
+static bool piuio_send_mock(void)
+{
+  return true;
+}
+
+static void piuio_get_input_pad_mock(
+    uint8_t player,
+    enum ptapi_io_piuio_sensor_group sensor_group,
+    struct ptapi_io_piuio_pad_inputs *inputs)
+{
+}
+
+static void piuio_get_input_sys_mock(struct ptapi_io_piuio_sys_inputs *inputs)
+{
+}
+
+static void piuio_set_output_pad_mock(
+    uint8_t player, const struct ptapi_io_piuio_pad_outputs *outputs)
+{
+}
+
+static void
+piuio_set_output_cab_mock(const struct ptapi_io_piuio_cab_outputs *outputs)
+{
+}
+
+static int setup(void **state)
+{
+  struct cnh_lib_unit_test_func_mocks *func_mocks;
+  size_t func_mocks_cnt;
+
+  func_mocks_cnt = 9;
+  func_mocks = cnh_lib_allocate_func_mocks(func_mocks_cnt);
+
+  func_mocks[0].name = "ptapi_io_piuio_ident";
+  func_mocks[0].func = piuio_ident_mock;
+  func_mocks[1].name = "ptapi_io_piuio_open";
+  func_mocks[1].func = piuio_open_mock;
+  func_mocks[2].name = "ptapi_io_piuio_close";
+  func_mocks[2].func = piuio_close_mock;
+  func_mocks[3].name = "ptapi_io_piuio_recv";
+  func_mocks[3].func = piuio_recv_mock;
+  func_mocks[4].name = "ptapi_io_piuio_send";
+  func_mocks[4].func = piuio_send_mock;
+  func_mocks[5].name = "ptapi_io_piuio_get_input_pad";
+  func_mocks[5].func = piuio_get_input_pad_mock;
+  func_mocks[6].name = "ptapi_io_piuio_get_input_sys";
+  func_mocks[6].func = piuio_get_input_sys_mock;
+  func_mocks[7].name = "ptapi_io_piuio_set_output_pad";
+  func_mocks[7].func = piuio_set_output_pad_mock;
+  func_mocks[8].name = "ptapi_io_piuio_set_output_cab";
+  func_mocks[8].func = piuio_set_output_cab_mock;
+
+  cnh_lib_init_unit_test(func_mocks, func_mocks_cnt);
+
+  memset(&patch_table, 0, sizeof(patch_table));
+
+  patch_table.addr_io_check = (uintptr_t) &game_code[0][0];
+  patch_table.addr_io_light_all = (uintptr_t) &game_code[0][16];
+  patch_table.addr_io_light_neon = (uintptr_t) &game_code[0][32];
+  patch_table.addr_io_light_halogan = (uintptr_t) &game_code[0][48];
+  patch_table.addr_io_light_p1_ccfl = (uintptr_t) &game_code[0][64];
+  patch_table.addr_io_light_p2_ccfl = (uintptr_t) &game_code[0][80];
+  patch_table.addr_io_input = (uintptr_t) &game_code[0][96];
+  patch_table.addr_io_coin_input = (uintptr_t) &game_code[0][112];
+  patch_table.addr_io_coin_input_2 = (uintptr_t) &game_code[0][128];
+  patch_table.addr_io_coin_counter_2 = (uintptr_t) &game_code[0][144];
+  patch_table.addr_io_game_input_stat = (uintptr_t) &game_input_stat;
+  patch_table.addr_io_game_input_down = (uintptr_t) &game_input_down;
+  patch_table.addr_io_game_input_up = (uintptr_t) &game_input_up;
+
+  piuio_recv_count = 0;
+
+  return 0;
+}
+
+static int teardown(void **state)
+{
+  exchook_io_shutdown();
+
+  cnh_lib_shutdown_unit_test();
+
+  return 0;
+}
+
+/* A frame of the game: read the sensors a few times, then the inputs */
+static void run_frame(void)
+{
+  uint32_t sensores[2];
+
+  for (int i = 0; i < CHECKS_PER_FRAME; i++) {
+    exchook_io_check(sensores);
+  }
+
+  exchook_io_input(NULL);
+}
+
+static void test_io_poll_once_per_frame(void **state)
+{
+  exchook_io_init(&patch_table, "piuio-mock.so", false, 0);
+
+  for (int i = 0; i < FRAMES; i++) {
+    run_frame();
+  }
+
+  assert_int_equal(piuio_recv_count, FRAMES);
+}
+
+static void test_io_poll_interval_across_frames(void **state)
+{
+  uint64_t start_us;
+  uint64_t elapsed_us;
+
+  /* Way longer than running all frames takes */
+  exchook_io_init(&patch_table, "piuio-mock.so", false, 1000 * 1000);
+
+  start_us = util_time_get_monotonic_ns() / 1000;
+
+  for (int i = 0; i < FRAMES; i++) {
+    run_frame();
+  }
+
+  elapsed_us = util_time_get_monotonic_ns() / 1000 - start_us;
+
+  assert_true(elapsed_us < 1000 * 1000);
+  assert_int_equal(piuio_recv_count, 1);
+}
+
+static void test_io_poll_interval_expired(void **state)
+{
+  exchook_io_init(&patch_table, "piuio-mock.so", false, 10 * 1000);
+
+  run_frame();
+  run_frame();
+
+  assert_int_equal(piuio_recv_count, 1);
+
+  util_time_sleep_ms(20);
+
+  run_frame();
+  run_frame();
+
+  assert_int_equal(piuio_recv_count, 2);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup_teardown(
+          test_io_poll_once_per_frame, setup, teardown),
+      cmocka_unit_test_setup_teardown(
+          test_io_poll_interval_across_frames, setup, teardown),
+      cmocka_unit_test_setup_teardown(
+          test_io_poll_interval_expired, setup, teardown)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
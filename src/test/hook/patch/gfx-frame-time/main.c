@@ -0,0 +1,243 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka/cmocka.h>
+
+/* The histogram and the ring are internals of the module, test them directly
+   without the collector thread and the real clock */
+#include "hook/patch/gfx-frame-time.c"
+
+#define FRAME_TIME_60HZ_US 16700
+#define FRAME_TIME_STUTTER_US 50000
+
+static uint64_t now_ns;
+
+static void process_frames(uint32_t frames, uint32_t frame_time_us)
+{
+  for (uint32_t i = 0; i < frames; i++) {
+    now_ns += (uint64_t) frame_time_us * 1000;
+    patch_gfx_frame_time_process(now_ns);
+  }
+}
+
+static void push_frames(uint32_t frames, uint32_t frame_time_us)
+{
+  for (uint32_t i = 0; i < frames; i++) {
+    now_ns += (uint64_t) frame_time_us * 1000;
+    patch_gfx_frame_time_ring_push(now_ns);
+  }
+}
+
+static void set_ring_position(uint32_t pos)
+{
+  atomic_store(&patch_gfx_frame_time_ring_head, pos);
+  atomic_store(&patch_gfx_frame_time_ring_tail, pos);
+}
+
+static void get_total_stats(struct patch_gfx_frame_time_period_stats *stats)
+{
+  patch_gfx_frame_time_histogram_to_stats(&patch_gfx_frame_time_total, stats);
+}
+
+static int setup(void **state)
+{
+  /* Any non zero start, the first timestamp is the reference only */
+  now_ns = 1000 * 1000 * 1000;
+
+  patch_gfx_frame_time_prev_swap_ns = 0;
+  patch_gfx_frame_time_mode_bucket = 0;
+  memset(
+      &patch_gfx_frame_time_interval,
+      0,
+      sizeof(struct patch_gfx_frame_time_histogram));
+  memset(
+      &patch_gfx_frame_time_total,
+      0,
+      sizeof(struct patch_gfx_frame_time_histogram));
+
+  set_ring_position(0);
+  atomic_store(&patch_gfx_frame_time_lost_samples, 0);
+
+  return 0;
+}
+
+static void test_histogram_empty(void **state)
+{
+  struct patch_gfx_frame_time_period_stats stats;
+
+  /* Reference timestamp only, no frame time yet */
+  process_frames(1, FRAME_TIME_60HZ_US);
+
+  get_total_stats(&stats);
+
+  assert_int_equal(stats.frames, 0);
+  assert_int_equal(stats.dropped_frames, 0);
+  assert_int_equal(stats.mean_us, 0);
+  assert_int_equal(stats.p99_us, 0);
+  assert_int_equal(stats.worst_us, 0);
+}
+
+static void test_histogram_p99(void **state)
+{
+  struct patch_gfx_frame_time_period_stats stats;
+
+  process_frames(1, 0);
+  process_frames(995, FRAME_TIME_60HZ_US);
+  process_frames(5, FRAME_TIME_STUTTER_US);
+
+  get_total_stats(&stats);
+
+  assert_int_equal(stats.frames, 1000);
+  assert_int_equal(
+      stats.mean_us,
+      (995 * FRAME_TIME_60HZ_US + 5 * FRAME_TIME_STUTTER_US) / 1000);
+  assert_int_equal(stats.worst_us, FRAME_TIME_STUTTER_US);
+
+  /* 99 % of the frames are in the 16.7 ms bucket, upper bound of it */
+  assert_int_equal(stats.p99_us, 16800);
+
+  /* Most frequent frame time, center of the bucket */
+  assert_int_equal(patch_gfx_frame_time_refresh_interval_us(), 16750);
+
+  /* Every stutter frame missed two refresh intervals */
+  assert_int_equal(stats.dropped_frames, 5 * 2);
+}
+
+static void test_histogram_p99_in_tail(void **state)
+{
+  struct patch_gfx_frame_time_period_stats stats;
+
+  process_frames(1, 0);
+  process_frames(980, FRAME_TIME_60HZ_US);
+  process_frames(20, FRAME_TIME_STUTTER_US);
+
+  get_total_stats(&stats);
+
+  assert_int_equal(stats.frames, 1000);
+  assert_int_equal(
+      stats.mean_us,
+      (980 * FRAME_TIME_60HZ_US + 20 * FRAME_TIME_STUTTER_US) / 1000);
+
+  /* Upper bound of the 50 ms bucket is above the worst frame time */
+  assert_int_equal(stats.p99_us, FRAME_TIME_STUTTER_US);
+  assert_int_equal(stats.worst_us, FRAME_TIME_STUTTER_US);
+  assert_int_equal(stats.dropped_frames, 20 * 2);
+}
+
+static void test_histogram_p99_unbounded_bucket(void **state)
+{
+  struct patch_gfx_frame_time_period_stats stats;
+
+  /* Above the histogram's range, e.g. loading screens */
+  process_frames(1, 0);
+  process_frames(100, 250 * 1000);
+  process_frames(1, 300 * 1000);
+
+  get_total_stats(&stats);
+
+  assert_int_equal(stats.frames, 101);
+  assert_int_equal(stats.worst_us, 300 * 1000);
+  assert_int_equal(stats.p99_us, 300 * 1000);
+}
+
+static void test_histogram_interval_and_total(void **state)
+{
+  struct patch_gfx_frame_time_period_stats stats;
+
+  process_frames(1, 0);
+  process_frames(10, FRAME_TIME_60HZ_US);
+
+  /* Reset by publishing */
+  memset(
+      &patch_gfx_frame_time_interval,
+      0,
+      sizeof(struct patch_gfx_frame_time_histogram));
+
+  process_frames(10, 2 * FRAME_TIME_60HZ_US);
+
+  patch_gfx_frame_time_histogram_to_stats(
+      &patch_gfx_frame_time_interval, &stats);
+
+  assert_int_equal(stats.frames, 10);
+  assert_int_equal(stats.mean_us, 2 * FRAME_TIME_60HZ_US);
+  assert_int_equal(stats.dropped_frames, 10);
+
+  get_total_stats(&stats);
+
+  assert_int_equal(stats.frames, 20);
+  assert_int_equal(stats.dropped_frames, 10);
+}
+
+static void test_ring_wraparound(void **state)
+{
+  struct patch_gfx_frame_time_period_stats stats;
+  uint32_t frames;
+
+  /* Indices overflow within the first batch */
+  set_ring_position(UINT32_MAX - 100);
+
+  frames = 0;
+
+  for (int i = 0; i < 8; i++) {
+    push_frames(PATCH_GFX_FRAME_TIME_RING_SIZE / 2 + 1, FRAME_TIME_60HZ_US);
+    frames += PATCH_GFX_FRAME_TIME_RING_SIZE / 2 + 1;
+
+    patch_gfx_frame_time_collect();
+  }
+
+  assert_int_equal(atomic_load(&patch_gfx_frame_time_ring_head), frames - 101);
+  assert_int_equal(atomic_load(&patch_gfx_frame_time_ring_tail), frames - 101);
+  assert_int_equal(atomic_load(&patch_gfx_frame_time_lost_samples), 0);
+
+  get_total_stats(&stats);
+
+  /* Timestamps processed in order, a single frame time only */
+  assert_int_equal(stats.frames, frames - 1);
+  assert_int_equal(stats.mean_us, FRAME_TIME_60HZ_US);
+  assert_int_equal(stats.worst_us, FRAME_TIME_60HZ_US);
+  assert_int_equal(stats.dropped_frames, 0);
+}
+
+static void test_ring_full(void **state)
+{
+  struct patch_gfx_frame_time_period_stats stats;
+
+  set_ring_position(UINT32_MAX - 100);
+
+  /* Collector does not keep up, the latest timestamps are dropped */
+  push_frames(PATCH_GFX_FRAME_TIME_RING_SIZE + 10, FRAME_TIME_60HZ_US);
+
+  assert_int_equal(atomic_load(&patch_gfx_frame_time_lost_samples), 10);
+
+  patch_gfx_frame_time_collect();
+
+  get_total_stats(&stats);
+
+  assert_int_equal(stats.frames, PATCH_GFX_FRAME_TIME_RING_SIZE - 1);
+  assert_int_equal(stats.worst_us, FRAME_TIME_60HZ_US);
+
+  /* Space again, the gap of the lost timestamps is a long frame */
+  push_frames(1, FRAME_TIME_60HZ_US);
+  patch_gfx_frame_time_collect();
+
+  get_total_stats(&stats);
+
+  assert_int_equal(atomic_load(&patch_gfx_frame_time_lost_samples), 10);
+  assert_int_equal(stats.frames, PATCH_GFX_FRAME_TIME_RING_SIZE);
+  assert_int_equal(stats.worst_us, 11 * FRAME_TIME_60HZ_US);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup(test_histogram_empty, setup),
+      cmocka_unit_test_setup(test_histogram_p99, setup),
+      cmocka_unit_test_setup(test_histogram_p99_in_tail, setup),
+      cmocka_unit_test_setup(test_histogram_p99_unbounded_bucket, setup),
+      cmocka_unit_test_setup(test_histogram_interval_and_total, setup),
+      cmocka_unit_test_setup(test_ring_wraparound, setup),
+      cmocka_unit_test_setup(test_ring_full, setup)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,411 @@
+#define GL_GLEXT_PROTOTYPES
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glx.h>
+#include <X11/Xlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka/cmocka.h>
+
+#include "capnhook/hook/lib.h"
+
+#include "hook/patch/gfx.h"
+
+/* The game's GL context is a headless EGL context rendering to a pbuffer of
+   the window's size, e.g. with Mesa's llvmpipe (LIBGL_ALWAYS_SOFTWARE=1).
+   GLX and Xlib functions called by the hooks are mocked on top of it. The
+   tests are skipped if no such context is available */
+
+#define SRC_WIDTH 640
+#define SRC_HEIGHT 480
+#define DST_WIDTH 1280
+#define DST_HEIGHT 720
+
+/* 4:3 pillarboxed on 16:9 */
+#define DST_X0 160
+#define DST_X1 1120
+
+#define ROOT_WINDOW 0x100
+#define GAME_WINDOW 0x1234
+#define GAME_CTX ((GLXContext) 0x5678)
+
+typedef void (*gl_buffer_t)(GLenum mode);
+
+struct egl {
+  EGLDisplay display;
+  EGLSurface surface;
+  EGLContext ctx;
+};
+
+static struct egl egl;
+static bool egl_available;
+
+static gl_buffer_t real_glDrawBuffer;
+static gl_buffer_t real_glReadBuffer;
+
+static unsigned int swaps;
+
+static Screen game_screen;
+static struct {
+  /* Storage for the private display struct of Xlib, accessed by the
+     DefaultRootWindow macro only */
+  char data[sizeof(*(_XPrivDisplay) NULL)];
+} game_display_storage;
+
+static Display *game_display = (Display *) &game_display_storage;
+
+static bool egl_init(void)
+{
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+  EGLConfig config;
+  EGLint configs;
+
+  const EGLint config_attribs[] = {
+      EGL_SURFACE_TYPE,
+      EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE,
+      EGL_OPENGL_BIT,
+      EGL_RED_SIZE,
+      8,
+      EGL_GREEN_SIZE,
+      8,
+      EGL_BLUE_SIZE,
+      8,
+      EGL_NONE};
+  const EGLint surface_attribs[] = {
+      EGL_WIDTH, DST_WIDTH, EGL_HEIGHT, DST_HEIGHT, EGL_NONE};
+
+  get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress(
+      "eglGetPlatformDisplayEXT");
+
+  if (!get_platform_display) {
+    return false;
+  }
+
+  egl.display = get_platform_display(
+      EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+  if (egl.display == EGL_NO_DISPLAY ||
+      !eglInitialize(egl.display, NULL, NULL)) {
+    return false;
+  }
+
+  if (!eglChooseConfig(egl.display, config_attribs, &config, 1, &configs) ||
+      configs < 1 || !eglBindAPI(EGL_OPENGL_API)) {
+    eglTerminate(egl.display);
+    return false;
+  }
+
+  egl.surface = eglCreatePbufferSurface(egl.display, config, surface_attribs);
+  egl.ctx = eglCreateContext(egl.display, config, EGL_NO_CONTEXT, NULL);
+
+  if (egl.surface == EGL_NO_SURFACE || egl.ctx == EGL_NO_CONTEXT) {
+    eglTerminate(egl.display);
+    return false;
+  }
+
+  real_glDrawBuffer = (gl_buffer_t) eglGetProcAddress("glDrawBuffer");
+  real_glReadBuffer = (gl_buffer_t) eglGetProcAddress("glReadBuffer");
+
+  return real_glDrawBuffer && real_glReadBuffer;
+}
+
+/* Real functions of libX11 and libGL the hooks call */
+
+static Window XCreateWindow_mock(
+    Display *display,
+    Window parent,
+    int x,
+    int y,
+    unsigned int width,
+    unsigned int height,
+    unsigned int border_width,
+    int depth,
+    unsigned int _class,
+    Visual *visual,
+    unsigned long valuemask,
+    XSetWindowAttributes *attributes)
+{
+  assert_int_equal(width, DST_WIDTH);
+  assert_int_equal(height, DST_HEIGHT);
+
+  return GAME_WINDOW;
+}
+
+static Bool
+glXMakeCurrent_mock(Display *dpy, GLXDrawable drawable, GLXContext ctx)
+{
+  assert_int_equal(drawable, GAME_WINDOW);
+  assert_ptr_equal(ctx, GAME_CTX);
+
+  return eglMakeCurrent(egl.display, egl.surface, egl.surface, egl.ctx);
+}
+
+static GLXContext glXGetCurrentContext_mock(void)
+{
+  return eglGetCurrentContext() == egl.ctx ? GAME_CTX : NULL;
+}
+
+static void *glXGetProcAddressARB_mock(const GLubyte *procName)
+{
+  return eglGetProcAddress((const char *) procName);
+}
+
+static void glXSwapBuffers_mock(Display *dpy, GLXDrawable drawable)
+{
+  /* The pbuffer has no front buffer, the blit result stays readable */
+  swaps++;
+}
+
+static void glDrawBuffer_mock(GLenum mode)
+{
+  real_glDrawBuffer(mode);
+}
+
+static void glReadBuffer_mock(GLenum mode)
+{
+  real_glReadBuffer(mode);
+}
+
+static void read_window_pixel(int x, int y, uint8_t *rgba)
+{
+  GLint fbo;
+
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &fbo);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  glReadBuffer(GL_BACK);
+  glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+
+  assert_int_equal(glGetError(), GL_NO_ERROR);
+}
+
+static void assert_window_pixel(int x, int y, uint8_t r, uint8_t g, uint8_t b)
+{
+  uint8_t rgba[4];
+
+  read_window_pixel(x, y, rgba);
+
+  assert_int_equal(rgba[0], r);
+  assert_int_equal(rgba[1], g);
+  assert_int_equal(rgba[2], b);
+}
+
+static int group_setup(void **state)
+{
+  struct cnh_lib_unit_test_func_mocks *func_mocks;
+  size_t func_mocks_cnt;
+  Window window;
+
+  egl_available = egl_init();
+
+  if (!egl_available) {
+    return 0;
+  }
+
+  func_mocks_cnt = 18;
+  func_mocks = cnh_lib_allocate_func_mocks(func_mocks_cnt);
+
+  func_mocks[0].name = "XCreateWindow";
+  func_mocks[0].func = XCreateWindow_mock;
+  func_mocks[1].name = "glXMakeCurrent";
+  func_mocks[1].func = glXMakeCurrent_mock;
+  func_mocks[2].name = "glXGetCurrentContext";
+  func_mocks[2].func = glXGetCurrentContext_mock;
+  func_mocks[3].name = "glXGetProcAddressARB";
+  func_mocks[3].func = glXGetProcAddressARB_mock;
+  func_mocks[4].name = "glXSwapBuffers";
+  func_mocks[4].func = glXSwapBuffers_mock;
+  func_mocks[5].name = "glDrawBuffer";
+  func_mocks[5].func = glDrawBuffer_mock;
+  func_mocks[6].name = "glReadBuffer";
+  func_mocks[6].func = glReadBuffer_mock;
+  func_mocks[7].name = "glGetString";
+  func_mocks[7].func = glGetString;
+  func_mocks[8].name = "glGetBooleanv";
+  func_mocks[8].func = glGetBooleanv;
+  func_mocks[9].name = "glGetFloatv";
+  func_mocks[9].func = glGetFloatv;
+  func_mocks[10].name = "glGetIntegerv";
+  func_mocks[10].func = glGetIntegerv;
+  func_mocks[11].name = "glIsEnabled";
+  func_mocks[11].func = glIsEnabled;
+  func_mocks[12].name = "glEnable";
+  func_mocks[12].func = glEnable;
+  func_mocks[13].name = "glDisable";
+  func_mocks[13].func = glDisable;
+  func_mocks[14].name = "glClearColor";
+  func_mocks[14].func = glClearColor;
+  func_mocks[15].name = "glColorMask";
+  func_mocks[15].func = glColorMask;
+  func_mocks[16].name = "glClear";
+  func_mocks[16].func = glClear;
+  func_mocks[17].name = "glViewport";
+  func_mocks[17].func = glViewport;
+
+  cnh_lib_init_unit_test(func_mocks, func_mocks_cnt);
+
+  memset(&game_screen, 0, sizeof(game_screen));
+  memset(&game_display_storage, 0, sizeof(game_display_storage));
+  game_screen.root = ROOT_WINDOW;
+  ((_XPrivDisplay) game_display)->screens = &game_screen;
+  ((_XPrivDisplay) game_display)->default_screen = 0;
+
+  patch_gfx_scale(
+      PATCH_GFX_SCALE_MODE_SD_480_TO_PILLARBOX_HD_720,
+      PATCH_GFX_SCALE_FILTER_NEAREST);
+
+  /* Like the game, sets up the FBO once the context is current */
+  window = XCreateWindow(
+      game_display,
+      ROOT_WINDOW,
+      0,
+      0,
+      SRC_WIDTH,
+      SRC_HEIGHT,
+      0,
+      0,
+      InputOutput,
+      NULL,
+      0,
+      NULL);
+  assert_int_equal(window, GAME_WINDOW);
+
+  assert_true(glXMakeCurrent(game_display, GAME_WINDOW, GAME_CTX));
+
+  return 0;
+}
+
+static int group_teardown(void **state)
+{
+  if (!egl_available) {
+    return 0;
+  }
+
+  eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroyContext(egl.display, egl.ctx);
+  eglDestroySurface(egl.display, egl.surface);
+  eglTerminate(egl.display);
+
+  cnh_lib_shutdown_unit_test();
+
+  return 0;
+}
+
+static void test_scale_fbo_viewport(void **state)
+{
+  GLint fbo;
+  GLint viewport[4];
+
+  if (!egl_available) {
+    skip();
+  }
+
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+  assert_int_not_equal(fbo, 0);
+
+  /* Not the window's size */
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  assert_int_equal(viewport[0], 0);
+  assert_int_equal(viewport[1], 0);
+  assert_int_equal(viewport[2], SRC_WIDTH);
+  assert_int_equal(viewport[3], SRC_HEIGHT);
+}
+
+static void test_scale_draw_read_buffer(void **state)
+{
+  GLint buffer;
+
+  if (!egl_available) {
+    skip();
+  }
+
+  /* Invalid operations on an FBO if not mapped */
+  glDrawBuffer(GL_BACK);
+  assert_int_equal(glGetError(), GL_NO_ERROR);
+  glGetIntegerv(GL_DRAW_BUFFER, &buffer);
+  assert_int_equal(buffer, GL_COLOR_ATTACHMENT0);
+
+  glReadBuffer(GL_BACK);
+  assert_int_equal(glGetError(), GL_NO_ERROR);
+  glGetIntegerv(GL_READ_BUFFER, &buffer);
+  assert_int_equal(buffer, GL_COLOR_ATTACHMENT0);
+
+  glDrawBuffer(GL_FRONT_LEFT);
+  assert_int_equal(glGetError(), GL_NO_ERROR);
+  glGetIntegerv(GL_DRAW_BUFFER, &buffer);
+  assert_int_equal(buffer, GL_COLOR_ATTACHMENT0);
+
+  /* Not a buffer of the default framebuffer, passed through */
+  glDrawBuffer(GL_NONE);
+  assert_int_equal(glGetError(), GL_NO_ERROR);
+  glGetIntegerv(GL_DRAW_BUFFER, &buffer);
+  assert_int_equal(buffer, GL_NONE);
+
+  glDrawBuffer(GL_BACK);
+  assert_int_equal(glGetError(), GL_NO_ERROR);
+}
+
+static void test_scale_swap_blits_to_window(void **state)
+{
+  GLint fbo;
+  unsigned int prev_swaps;
+
+  if (!egl_available) {
+    skip();
+  }
+
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+
+  /* Game's frame: left half green, right half red */
+  glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(0, 0, SRC_WIDTH / 2, SRC_HEIGHT);
+  glClearColor(0.0f, 1.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  prev_swaps = swaps;
+
+  glXSwapBuffers(game_display, GAME_WINDOW);
+
+  assert_int_equal(swaps, prev_swaps + 1);
+  assert_int_equal(glGetError(), GL_NO_ERROR);
+
+  /* Pillarbox bars */
+  assert_window_pixel(DST_X0 / 2, DST_HEIGHT / 2, 0, 0, 0);
+  assert_window_pixel((DST_X1 + DST_WIDTH) / 2, DST_HEIGHT / 2, 0, 0, 0);
+
+  /* Scaled frame */
+  assert_window_pixel(DST_X0 + 10, 10, 0, 255, 0);
+  assert_window_pixel(DST_WIDTH / 2 - 10, DST_HEIGHT - 10, 0, 255, 0);
+  assert_window_pixel(DST_WIDTH / 2 + 10, 10, 255, 0, 0);
+  assert_window_pixel(DST_X1 - 10, DST_HEIGHT - 10, 255, 0, 0);
+
+  /* Game's state restored, rendering to the FBO again */
+  assert_true(glIsEnabled(GL_SCISSOR_TEST));
+  glDisable(GL_SCISSOR_TEST);
+
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+  assert_int_not_equal(fbo, 0);
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &fbo);
+  assert_int_not_equal(fbo, 0);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_scale_fbo_viewport),
+      cmocka_unit_test(test_scale_draw_read_buffer),
+      cmocka_unit_test(test_scale_swap_blits_to_window)};
+
+  return cmocka_run_group_tests(tests, group_setup, group_teardown);
+}
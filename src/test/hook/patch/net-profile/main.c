@@ -0,0 +1,229 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmocka/cmocka.h>
+
+#include "asset/nx2/lib/usb-rank.h"
+#include "asset/nx2/lib/usb-save.h"
+
+#include "capnhook/hook/filehook.h"
+#include "capnhook/hooklib/redir.h"
+
+#include "hook/patch/net-profile.h"
+
+#include "pumpnet/mock/server.h"
+
+#include "util/time.h"
+
+#define PLAYERS 2
+#define LATENCY_MS 400
+
+static const uint64_t player_ref_ids[PLAYERS] = {0x1001, 0x1002};
+
+struct player_ctx {
+  int player;
+  uint8_t *expected;
+  bool success;
+  uint64_t open_time_ms;
+};
+
+static struct pumpnet_mock_server *server;
+static char dir_path[64];
+static char token_paths[PLAYERS][128];
+static uint8_t saves[PLAYERS][ASSET_NX2_USB_SAVE_SIZE];
+static uint8_t ranks[PLAYERS][ASSET_NX2_USB_RANK_SIZE];
+
+static int setup(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  char addr[64];
+  char mnt_token_path[64];
+  FILE *file;
+
+  pumpnet_mock_server_config_init(&config);
+  config.latency_ms = LATENCY_MS;
+
+  server = pumpnet_mock_server_start(&config);
+  assert_non_null(server);
+
+  for (int i = 0; i < PLAYERS; i++) {
+    memset(saves[i], 0x10 + i, ASSET_NX2_USB_SAVE_SIZE);
+    memset(ranks[i], 0x20 + i, ASSET_NX2_USB_RANK_SIZE);
+
+    pumpnet_mock_server_put(
+        server,
+        "nx2",
+        PUMPNET_LIB_FILE_TYPE_SAVE,
+        player_ref_ids[i],
+        saves[i],
+        ASSET_NX2_USB_SAVE_SIZE);
+    pumpnet_mock_server_put(
+        server,
+        "nx2",
+        PUMPNET_LIB_FILE_TYPE_RANK,
+        player_ref_ids[i],
+        ranks[i],
+        ASSET_NX2_USB_RANK_SIZE);
+  }
+
+  /* Tokens of both players, as if usb sticks are plugged in */
+  strcpy(dir_path, "/tmp/test-hook-patch-net-profile-XXXXXX");
+  assert_non_null(mkdtemp(dir_path));
+
+  for (int i = 0; i < PLAYERS; i++) {
+    sprintf(token_paths[i], "%s/pumpnet%d.bin", dir_path, i);
+
+    file = fopen(token_paths[i], "wb");
+    assert_non_null(file);
+    assert_int_equal(
+        fwrite(&player_ref_ids[i], sizeof(uint64_t), 1, file), 1);
+    fclose(file);
+
+    sprintf(mnt_token_path, "/mnt/%d/pumpnet.bin", i);
+    cnh_redir_add(mnt_token_path, token_paths[i]);
+  }
+
+  cnh_filehook_push_handler(cnh_redir_filehook);
+
+  sprintf(addr, "http://127.0.0.1:%d", pumpnet_mock_server_get_port(server));
+
+  patch_net_profile_init(
+      ASSET_GAME_VERSION_NX2,
+      addr,
+      0,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+      false,
+      false);
+
+  return 0;
+}
+
+static int teardown(void **state)
+{
+  patch_net_profile_shutdown();
+  pumpnet_mock_server_stop(server);
+
+  for (int i = 0; i < PLAYERS; i++) {
+    unlink(token_paths[i]);
+  }
+
+  rmdir(dir_path);
+
+  return 0;
+}
+
+static void *player_proc(void *arg)
+{
+  struct player_ctx *ctx;
+  uint8_t buffer[ASSET_NX2_USB_SAVE_SIZE];
+  char path[64];
+  uint64_t start;
+  FILE *file;
+
+  ctx = (struct player_ctx *) arg;
+
+  sprintf(path, "/mnt/%d/nx2save.bin", ctx->player);
+
+  start = util_time_get_monotonic_ns() / 1000 / 1000;
+
+  file = fopen(path, "rb");
+
+  ctx->open_time_ms = util_time_get_monotonic_ns() / 1000 / 1000 - start;
+
+  if (!file) {
+    return NULL;
+  }
+
+  ctx->success = fread(buffer, ASSET_NX2_USB_SAVE_SIZE, 1, file) == 1 &&
+      !memcmp(buffer, ctx->expected, ASSET_NX2_USB_SAVE_SIZE);
+
+  fclose(file);
+
+  return NULL;
+}
+
+static void test_open_concurrent(void **state)
+{
+  struct player_ctx ctxs[PLAYERS];
+  pthread_t threads[PLAYERS];
+  uint64_t start;
+  uint64_t duration_ms;
+
+  start = util_time_get_monotonic_ns() / 1000 / 1000;
+
+  for (int i = 0; i < PLAYERS; i++) {
+    ctxs[i].player = i;
+    ctxs[i].expected = saves[i];
+    ctxs[i].success = false;
+
+    assert_int_equal(
+        pthread_create(&threads[i], NULL, player_proc, &ctxs[i]), 0);
+  }
+
+  for (int i = 0; i < PLAYERS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  duration_ms = util_time_get_monotonic_ns() / 1000 / 1000 - start;
+
+  for (int i = 0; i < PLAYERS; i++) {
+    assert_true(ctxs[i].success);
+    assert_true(ctxs[i].open_time_ms >= LATENCY_MS);
+  }
+
+  /* Downloaded side by side, not one player after the other */
+  assert_true(duration_ms < PLAYERS * LATENCY_MS);
+}
+
+static void test_player_2_file_ops(void **state)
+{
+  uint8_t buffer[ASSET_NX2_USB_RANK_SIZE];
+  FILE *file;
+
+  /* All operations on the handle of player 2 hit the virtual file */
+  file = fopen("/mnt/1/nx2rank.bin", "rb+");
+  assert_non_null(file);
+
+  assert_int_equal(fseek(file, 0, SEEK_END), 0);
+  assert_int_equal(ftell(file), ASSET_NX2_USB_RANK_SIZE);
+
+  rewind(file);
+
+  assert_int_equal(fread(buffer, ASSET_NX2_USB_RANK_SIZE, 1, file), 1);
+  assert_memory_equal(buffer, ranks[1], ASSET_NX2_USB_RANK_SIZE);
+
+  memset(buffer, 0x42, sizeof(buffer));
+
+  rewind(file);
+  assert_int_equal(fwrite(buffer, ASSET_NX2_USB_RANK_SIZE, 1, file), 1);
+
+  /* Uploaded on close */
+  assert_int_equal(fclose(file), 0);
+
+  file = fopen("/mnt/1/nx2rank.bin", "rb");
+  assert_non_null(file);
+
+  memset(buffer, 0, sizeof(buffer));
+
+  assert_int_equal(fread(buffer, ASSET_NX2_USB_RANK_SIZE, 1, file), 1);
+  assert_int_equal(buffer[0], 0x42);
+  assert_int_equal(buffer[ASSET_NX2_USB_RANK_SIZE - 1], 0x42);
+
+  fclose(file);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_open_concurrent),
+      cmocka_unit_test(test_player_2_file_ops)};
+
+  return cmocka_run_group_tests(tests, setup, teardown);
+}
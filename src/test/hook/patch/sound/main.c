@@ -0,0 +1,247 @@
+#include <alsa/asoundlib.h>
+#include <stdint.h>
+
+#include <cmocka/cmocka.h>
+
+#include "hook/patch/sound.h"
+
+#include "util/time.h"
+
+/* Discards all samples, no sound hardware required */
+#define DEVICE "null"
+
+#define RATE 48000
+#define CHANNELS 2
+
+#define BUFFER_TIME_MAX_US 20000
+#define PERIOD_TIME_MAX_US 5000
+
+/* Requested by the game, tuned for hardware of its time */
+#define GAME_BUFFER_TIME_US 500000
+#define GAME_PERIOD_TIME_US 100000
+
+/* Frames of a short sound effect */
+#define EFFECT_FRAMES 240
+
+#define BENCH_ITERATIONS 500
+#define PCM_POOL_SIZE 4
+
+/* Times are converted to frames, allow rounding of the near setters */
+static void assert_time_max(unsigned int time_us, unsigned int max_us)
+{
+  assert_true(time_us > 0);
+  assert_true(time_us <= max_us + max_us / 100);
+}
+
+static snd_pcm_t *open_pcm(void)
+{
+  snd_pcm_t *pcm;
+
+  assert_int_equal(snd_pcm_open(&pcm, DEVICE, SND_PCM_STREAM_PLAYBACK, 0), 0);
+
+  return pcm;
+}
+
+/* Configure the pcm like the games do with the near setters */
+static void configure_pcm(
+    snd_pcm_t *pcm,
+    snd_pcm_hw_params_t *params,
+    unsigned int buffer_time_us,
+    unsigned int period_time_us)
+{
+  assert_true(snd_pcm_hw_params_any(pcm, params) >= 0);
+  assert_int_equal(
+      snd_pcm_hw_params_set_access(
+          pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED),
+      0);
+  assert_int_equal(
+      snd_pcm_hw_params_set_format(pcm, params, SND_PCM_FORMAT_S16_LE), 0);
+  assert_int_equal(snd_pcm_hw_params_set_channels(pcm, params, CHANNELS), 0);
+  assert_int_equal(snd_pcm_hw_params_set_rate(pcm, params, RATE, 0), 0);
+  assert_int_equal(
+      snd_pcm_hw_params_set_buffer_time_near(
+          pcm, params, &buffer_time_us, NULL),
+      0);
+  assert_int_equal(
+      snd_pcm_hw_params_set_period_time_near(
+          pcm, params, &period_time_us, NULL),
+      0);
+
+  assert_int_equal(snd_pcm_hw_params(pcm, params), 0);
+}
+
+static int setup(void **state)
+{
+  patch_sound_latency_init(BUFFER_TIME_MAX_US, PERIOD_TIME_MAX_US);
+
+  return 0;
+}
+
+static void test_hw_params_clamped(void **state)
+{
+  snd_pcm_hw_params_t *params;
+  snd_pcm_format_t format;
+  unsigned int channels;
+  unsigned int rate;
+  unsigned int buffer_time_us;
+  unsigned int period_time_us;
+  snd_pcm_t *pcm;
+
+  snd_pcm_hw_params_alloca(&params);
+
+  pcm = open_pcm();
+
+  configure_pcm(pcm, params, GAME_BUFFER_TIME_US, GAME_PERIOD_TIME_US);
+
+  /* The setup applied is returned like a real call does */
+  assert_int_equal(
+      snd_pcm_hw_params_get_buffer_time(params, &buffer_time_us, NULL), 0);
+  assert_int_equal(
+      snd_pcm_hw_params_get_period_time(params, &period_time_us, NULL), 0);
+
+  assert_time_max(buffer_time_us, BUFFER_TIME_MAX_US);
+  assert_time_max(period_time_us, PERIOD_TIME_MAX_US);
+
+  /* Sample format of the game is kept */
+  assert_int_equal(snd_pcm_hw_params_current(pcm, params), 0);
+  assert_int_equal(snd_pcm_hw_params_get_format(params, &format), 0);
+  assert_int_equal(format, SND_PCM_FORMAT_S16_LE);
+  assert_int_equal(snd_pcm_hw_params_get_channels(params, &channels), 0);
+  assert_int_equal(channels, CHANNELS);
+  assert_int_equal(snd_pcm_hw_params_get_rate(params, &rate, NULL), 0);
+  assert_int_equal(rate, RATE);
+
+  assert_int_equal(snd_pcm_close(pcm), 0);
+}
+
+static void test_hw_params_below_max(void **state)
+{
+  snd_pcm_hw_params_t *params;
+  unsigned int buffer_time_us;
+  unsigned int period_time_us;
+  snd_pcm_t *pcm;
+
+  snd_pcm_hw_params_alloca(&params);
+
+  pcm = open_pcm();
+
+  /* Shorter than the max, not touched */
+  configure_pcm(pcm, params, BUFFER_TIME_MAX_US / 2, PERIOD_TIME_MAX_US / 2);
+
+  assert_int_equal(
+      snd_pcm_hw_params_get_buffer_time(params, &buffer_time_us, NULL), 0);
+  assert_int_equal(
+      snd_pcm_hw_params_get_period_time(params, &period_time_us, NULL), 0);
+
+  assert_time_max(buffer_time_us, BUFFER_TIME_MAX_US / 2);
+  assert_true(buffer_time_us >= BUFFER_TIME_MAX_US / 2 * 99 / 100);
+  assert_time_max(period_time_us, PERIOD_TIME_MAX_US / 2);
+  assert_true(period_time_us >= PERIOD_TIME_MAX_US / 2 * 99 / 100);
+
+  assert_int_equal(snd_pcm_close(pcm), 0);
+}
+
+static void test_set_params_clamped(void **state)
+{
+  snd_pcm_uframes_t buffer_size;
+  snd_pcm_uframes_t period_size;
+  snd_pcm_t *pcm;
+
+  pcm = open_pcm();
+
+  assert_int_equal(
+      snd_pcm_set_params(
+          pcm,
+          SND_PCM_FORMAT_S16_LE,
+          SND_PCM_ACCESS_RW_INTERLEAVED,
+          CHANNELS,
+          RATE,
+          1,
+          GAME_BUFFER_TIME_US),
+      0);
+
+  assert_int_equal(snd_pcm_get_params(pcm, &buffer_size, &period_size), 0);
+
+  /* Latency is the buffer time */
+  assert_time_max(
+      (unsigned int) ((uint64_t) buffer_size * 1000 * 1000 / RATE),
+      BUFFER_TIME_MAX_US);
+
+  assert_int_equal(snd_pcm_close(pcm), 0);
+}
+
+/* Open, configure, play and close a pcm for a sound effect like the exceed
+   era engines do */
+static void play_effect(void)
+{
+  int16_t samples[EFFECT_FRAMES * CHANNELS] = {0};
+  snd_pcm_t *pcm;
+
+  pcm = open_pcm();
+
+  assert_int_equal(
+      snd_pcm_set_params(
+          pcm,
+          SND_PCM_FORMAT_S16_LE,
+          SND_PCM_ACCESS_RW_INTERLEAVED,
+          CHANNELS,
+          RATE,
+          1,
+          BUFFER_TIME_MAX_US),
+      0);
+
+  assert_int_equal(snd_pcm_writei(pcm, samples, EFFECT_FRAMES), EFFECT_FRAMES);
+
+  assert_int_equal(snd_pcm_close(pcm), 0);
+}
+
+static uint64_t bench_effects(void)
+{
+  uint64_t start_ns;
+
+  start_ns = util_time_get_monotonic_ns();
+
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    play_effect();
+  }
+
+  return (util_time_get_monotonic_ns() - start_ns) / BENCH_ITERATIONS;
+}
+
+static void test_pcm_pool_bench(void **state)
+{
+  uint64_t no_pool_ns;
+  uint64_t pool_ns;
+  snd_pcm_t *pcm;
+  snd_pcm_t *pooled;
+
+  no_pool_ns = bench_effects();
+
+  patch_sound_pcm_pool_init(PCM_POOL_SIZE);
+
+  /* Closed handles are reset and checked out again */
+  pcm = open_pcm();
+  assert_int_equal(snd_pcm_close(pcm), 0);
+  pooled = open_pcm();
+  assert_ptr_equal(pooled, pcm);
+  assert_int_equal(snd_pcm_close(pooled), 0);
+
+  pool_ns = bench_effects();
+
+  print_message(
+      "Sound effect (open, configure, play, close): %llu ns without pool, "
+      "%llu ns with pool\n",
+      (unsigned long long) no_pool_ns,
+      (unsigned long long) pool_ns);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_hw_params_clamped),
+      cmocka_unit_test(test_hw_params_below_max),
+      cmocka_unit_test(test_set_params_clamped),
+      cmocka_unit_test(test_pcm_pool_bench)};
+
+  return cmocka_run_group_tests(tests, setup, NULL);
+}
@@ -0,0 +1,345 @@
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cmocka/cmocka.h>
+
+#include "capnhook/hook/lib.h"
+
+#include "hook/patch/x11-event-loop.h"
+
+#include "ptapi/io/x11-input-hook.h"
+
+#include "util/time.h"
+
+/* Stand-in for the X server: the event loop's connection is an eventfd that
+   gets readable whenever events are queued, the Xlib calls of the event loop
+   are stubbed below and serve the queued events */
+
+#define EVENTS_MAX 64
+#define KEYS 16
+#define WAIT_TIMEOUT_MS 2000
+#define IDLE_MS 200
+
+#define GAME_WINDOW 0x1234
+
+struct x_server {
+  pthread_mutex_t mutex;
+  XEvent events[EVENTS_MAX];
+  size_t head;
+  size_t count;
+  int fd;
+};
+
+static struct x_server x_server;
+static atomic_uint x_pending_calls;
+static atomic_uint x_selected_window;
+
+static atomic_uint key_presses;
+static atomic_uint key_releases;
+static atomic_ulong last_key;
+
+static char display_name[] = ":99";
+static struct {
+  /* Storage for the private display struct of Xlib, accessed by the
+     ConnectionNumber and DisplayString macros only */
+  char data[sizeof(*(_XPrivDisplay) NULL)];
+} game_display_storage, loop_display_storage;
+
+static Display *game_display = (Display *) &game_display_storage;
+static Display *loop_display = (Display *) &loop_display_storage;
+
+static void x_server_push_key(int type, unsigned int keycode)
+{
+  uint64_t signal;
+  XEvent *event;
+
+  pthread_mutex_lock(&x_server.mutex);
+
+  assert_true(x_server.count < EVENTS_MAX);
+
+  event = &x_server.events[(x_server.head + x_server.count) % EVENTS_MAX];
+  memset(event, 0, sizeof(XEvent));
+
+  event->xkey.type = type;
+  event->xkey.window = GAME_WINDOW;
+  event->xkey.keycode = keycode;
+  /* Far apart, not detected as a repeated key */
+  event->xkey.time = keycode * 100 + (type == KeyRelease ? 50 : 0);
+
+  x_server.count++;
+
+  pthread_mutex_unlock(&x_server.mutex);
+
+  signal = 1;
+  assert_int_equal(write(x_server.fd, &signal, sizeof(signal)), sizeof(signal));
+}
+
+/* Xlib stubs used by the event loop thread */
+
+int XPending(Display *display)
+{
+  uint64_t value;
+  int count;
+
+  assert_ptr_equal(display, loop_display);
+
+  atomic_fetch_add(&x_pending_calls, 1);
+
+  /* Like reading everything available from the socket */
+  if (read(x_server.fd, &value, sizeof(value)) < 0) {
+    value = 0;
+  }
+
+  pthread_mutex_lock(&x_server.mutex);
+  count = x_server.count;
+  pthread_mutex_unlock(&x_server.mutex);
+
+  return count;
+}
+
+int XPeekEvent(Display *display, XEvent *event)
+{
+  pthread_mutex_lock(&x_server.mutex);
+  assert_true(x_server.count > 0);
+  memcpy(event, &x_server.events[x_server.head], sizeof(XEvent));
+  pthread_mutex_unlock(&x_server.mutex);
+
+  return 0;
+}
+
+int XNextEvent(Display *display, XEvent *event)
+{
+  pthread_mutex_lock(&x_server.mutex);
+  assert_true(x_server.count > 0);
+  memcpy(event, &x_server.events[x_server.head], sizeof(XEvent));
+  x_server.head = (x_server.head + 1) % EVENTS_MAX;
+  x_server.count--;
+  pthread_mutex_unlock(&x_server.mutex);
+
+  return Success;
+}
+
+int XLookupString(
+    XKeyEvent *event,
+    char *buffer,
+    int bytes,
+    KeySym *keysym,
+    XComposeStatus *status)
+{
+  /* Identity mapping is good enough to identify the keys */
+  *keysym = event->keycode;
+
+  return 0;
+}
+
+int XSelectInput(Display *display, Window w, long event_mask)
+{
+  assert_ptr_equal(display, loop_display);
+
+  atomic_store(&x_selected_window, w);
+
+  return 1;
+}
+
+int XGrabKeyboard(
+    Display *display,
+    Window grab_window,
+    Bool owner_events,
+    int pointer_mode,
+    int keyboard_mode,
+    Time time)
+{
+  return GrabSuccess;
+}
+
+int XUngrabKeyboard(Display *display, Time time)
+{
+  return 1;
+}
+
+int XCloseDisplay(Display *display)
+{
+  assert_ptr_equal(display, loop_display);
+
+  return 0;
+}
+
+Status XInitThreads(void)
+{
+  return 1;
+}
+
+/* Real functions of libX11 the hooks call */
+
+static Display *XOpenDisplay_mock(const char *name)
+{
+  assert_string_equal(name, display_name);
+
+  return loop_display;
+}
+
+static Window XCreateWindow_mock(
+    Display *display,
+    Window parent,
+    int x,
+    int y,
+    unsigned int width,
+    unsigned int height,
+    unsigned int border_width,
+    int depth,
+    unsigned int _class,
+    Visual *visual,
+    unsigned long valuemask,
+    XSetWindowAttributes *attributes)
+{
+  return GAME_WINDOW;
+}
+
+static int XDestroyWindow_mock(Display *display, Window w)
+{
+  return 1;
+}
+
+/* Input handler library */
+
+static void dispatch_key_press(KeySym key)
+{
+  atomic_store(&last_key, key);
+  atomic_fetch_add(&key_presses, 1);
+}
+
+static void dispatch_key_release(KeySym key)
+{
+  atomic_store(&last_key, key);
+  atomic_fetch_add(&key_releases, 1);
+}
+
+static const struct ptapi_io_x11_input_hook_handler input_handler = {
+    .dispatch_key_press = dispatch_key_press,
+    .dispatch_key_release = dispatch_key_release,
+};
+
+static const struct ptapi_io_x11_input_hook_handler *input_handler_hook(void)
+{
+  return &input_handler;
+}
+
+static bool wait_keys(unsigned int presses, unsigned int releases)
+{
+  uint64_t start_ms;
+
+  start_ms = util_time_get_monotonic_ns() / 1000 / 1000;
+
+  while (atomic_load(&key_presses) < presses ||
+         atomic_load(&key_releases) < releases) {
+    if (util_time_get_monotonic_ns() / 1000 / 1000 - start_ms >
+        WAIT_TIMEOUT_MS) {
+      return false;
+    }
+
+    util_time_sleep_ms(1);
+  }
+
+  return true;
+}
+
+static int setup(void **state)
+{
+  struct cnh_lib_unit_test_func_mocks *func_mocks;
+  size_t func_mocks_cnt;
+
+  func_mocks_cnt = 4;
+  func_mocks = cnh_lib_allocate_func_mocks(func_mocks_cnt);
+
+  func_mocks[0].name = "XOpenDisplay";
+  func_mocks[0].func = XOpenDisplay_mock;
+  func_mocks[1].name = "XCreateWindow";
+  func_mocks[1].func = XCreateWindow_mock;
+  func_mocks[2].name = "XDestroyWindow";
+  func_mocks[2].func = XDestroyWindow_mock;
+  func_mocks[3].name = "ptapi_io_x11_input_handler_hook";
+  func_mocks[3].func = input_handler_hook;
+
+  cnh_lib_init_unit_test(func_mocks, func_mocks_cnt);
+
+  memset(&x_server, 0, sizeof(x_server));
+  pthread_mutex_init(&x_server.mutex, NULL);
+  x_server.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  assert_true(x_server.fd >= 0);
+
+  memset(&game_display_storage, 0, sizeof(game_display_storage));
+  memset(&loop_display_storage, 0, sizeof(loop_display_storage));
+  ((_XPrivDisplay) game_display)->display_name = display_name;
+  ((_XPrivDisplay) loop_display)->display_name = display_name;
+  ((_XPrivDisplay) loop_display)->fd = x_server.fd;
+
+  patch_x11_event_loop_init();
+  patch_x11_event_loop_add_input_handler("x11-input-handler.so");
+
+  return 0;
+}
+
+static int teardown(void **state)
+{
+  close(x_server.fd);
+  pthread_mutex_destroy(&x_server.mutex);
+
+  cnh_lib_shutdown_unit_test();
+
+  return 0;
+}
+
+static void test_events_delivered_idle_sleeps(void **state)
+{
+  Window window;
+  unsigned int calls;
+
+  window = XCreateWindow(
+      game_display, 0, 0, 0, 640, 480, 0, 0, InputOutput, NULL, 0, NULL);
+  assert_int_equal(window, GAME_WINDOW);
+
+  for (unsigned int i = 0; i < KEYS; i++) {
+    x_server_push_key(KeyPress, 10 + i);
+    x_server_push_key(KeyRelease, 10 + i);
+  }
+
+  assert_true(wait_keys(KEYS, KEYS));
+  assert_int_equal(atomic_load(&last_key), 10 + KEYS - 1);
+  assert_int_equal(atomic_load(&x_selected_window), GAME_WINDOW);
+
+  /* Nothing to do, the loop blocks in poll instead of checking XPending */
+  util_time_sleep_ms(20);
+  calls = atomic_load(&x_pending_calls);
+  util_time_sleep_ms(IDLE_MS);
+  assert_int_equal(atomic_load(&x_pending_calls), calls);
+
+  /* Woken up by the next event */
+  x_server_push_key(KeyPress, 42);
+
+  assert_true(wait_keys(KEYS + 1, KEYS));
+  assert_int_equal(atomic_load(&last_key), 42);
+
+  /* Stops the loop blocking in poll */
+  assert_int_equal(XDestroyWindow(game_display, window), 1);
+
+  /* No events received anymore */
+  x_server_push_key(KeyRelease, 42);
+  util_time_sleep_ms(20);
+  assert_int_equal(atomic_load(&key_releases), KEYS);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {cmocka_unit_test_setup_teardown(
+      test_events_delivered_idle_sleeps, setup, teardown)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,162 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmocka/cmocka.h>
+
+#include "ptapi/io/piuio/record-util/record.h"
+
+/* 2 players x 4 sensor groups x 5 sensors + 5 sys inputs */
+#define INPUTS 45
+
+/* All inputs are bools, in the order they are packed */
+static bool *get_input(struct ptapi_io_piuio_record_util_state *state, int i)
+{
+  return ((bool *) state) + i;
+}
+
+static int count_bits(const uint8_t *packed)
+{
+  int count;
+
+  count = 0;
+
+  for (int i = 0; i < PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE; i++) {
+    count += __builtin_popcount(packed[i]);
+  }
+
+  return count;
+}
+
+static void test_state_layout(void **state)
+{
+  assert_int_equal(
+      sizeof(struct ptapi_io_piuio_record_util_state), INPUTS * sizeof(bool));
+  assert_int_equal(sizeof(struct ptapi_io_piuio_record_util_entry), 10);
+}
+
+static void test_state_pack_unpack_single(void **state)
+{
+  struct ptapi_io_piuio_record_util_state in;
+  struct ptapi_io_piuio_record_util_state out;
+  uint8_t packed[PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE];
+
+  for (int i = 0; i < INPUTS; i++) {
+    memset(&in, 0, sizeof(in));
+    *get_input(&in, i) = true;
+
+    ptapi_io_piuio_record_util_state_pack(&in, packed);
+
+    /* Every input maps to a bit of its own */
+    assert_int_equal(count_bits(packed), 1);
+    assert_true(packed[i / 8] & (1 << (i % 8)));
+
+    memset(&out, 0xFF, sizeof(out));
+    ptapi_io_piuio_record_util_state_unpack(packed, &out);
+
+    assert_memory_equal(&in, &out, sizeof(in));
+  }
+}
+
+static void test_state_pack_unpack_patterns(void **state)
+{
+  struct ptapi_io_piuio_record_util_state in;
+  struct ptapi_io_piuio_record_util_state out;
+  uint8_t packed[PTAPI_IO_PIUIO_RECORD_UTIL_STATE_SIZE];
+
+  srand(1234);
+
+  for (int n = 0; n < 1000; n++) {
+    for (int i = 0; i < INPUTS; i++) {
+      *get_input(&in, i) = rand() % 2;
+    }
+
+    ptapi_io_piuio_record_util_state_pack(&in, packed);
+
+    /* Unused bits of the last byte stay clear */
+    assert_int_equal(packed[INPUTS / 8] >> (INPUTS % 8), 0);
+
+    ptapi_io_piuio_record_util_state_unpack(packed, &out);
+
+    assert_memory_equal(&in, &out, sizeof(in));
+  }
+}
+
+static void test_file_round_trip(void **state)
+{
+  struct ptapi_io_piuio_record_util_state in[3];
+  struct ptapi_io_piuio_record_util_state out;
+  struct ptapi_io_piuio_record_util_entry entry;
+  struct ptapi_io_piuio_record_util_entry *entries;
+  char path[] = "/tmp/test-ptapi-io-piuio-record-XXXXXX";
+  size_t count;
+  FILE *file;
+  int fd;
+
+  fd = mkstemp(path);
+  assert_true(fd != -1);
+  close(fd);
+
+  file = ptapi_io_piuio_record_util_file_create(path);
+  assert_non_null(file);
+
+  for (int i = 0; i < 3; i++) {
+    memset(&in[i], 0, sizeof(in[i]));
+    *get_input(&in[i], i * 20) = true;
+    *get_input(&in[i], INPUTS - 1) = true;
+
+    entry.delta_us = 1000 * (i + 1);
+    ptapi_io_piuio_record_util_state_pack(&in[i], entry.state);
+
+    assert_int_equal(fwrite(&entry, sizeof(entry), 1, file), 1);
+  }
+
+  /* Partial entry, e.g. killed while writing */
+  assert_int_equal(fwrite(&entry, 4, 1, file), 1);
+
+  fclose(file);
+
+  assert_true(ptapi_io_piuio_record_util_file_load(path, &entries, &count));
+  assert_int_equal(count, 3);
+
+  for (int i = 0; i < 3; i++) {
+    assert_int_equal(entries[i].delta_us, 1000 * (i + 1));
+
+    ptapi_io_piuio_record_util_state_unpack(entries[i].state, &out);
+    assert_memory_equal(&in[i], &out, sizeof(out));
+  }
+
+  free(entries);
+  unlink(path);
+}
+
+static void test_file_load_bad_magic(void **state)
+{
+  struct ptapi_io_piuio_record_util_entry *entries;
+  char path[] = "/tmp/test-ptapi-io-piuio-record-XXXXXX";
+  size_t count;
+  int fd;
+
+  fd = mkstemp(path);
+  assert_true(fd != -1);
+  assert_int_equal(write(fd, "NOTREC\x01\x00", 8), 8);
+  close(fd);
+
+  assert_false(ptapi_io_piuio_record_util_file_load(path, &entries, &count));
+
+  unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_state_layout),
+      cmocka_unit_test(test_state_pack_unpack_single),
+      cmocka_unit_test(test_state_pack_unpack_patterns),
+      cmocka_unit_test(test_file_round_trip),
+      cmocka_unit_test(test_file_load_bad_magic)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
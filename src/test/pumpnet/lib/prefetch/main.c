@@ -0,0 +1,196 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <cmocka/cmocka.h>
+
+#include "test-util/pumpnet.h"
+
+#include "pumpnet/lib/pumpnet.h"
+#include "pumpnet/mock/server.h"
+
+#include "util/mem.h"
+#include "util/time.h"
+
+/* Sizes of the nx2 usb save and rank files */
+#define SAVE_SIZE 30780
+#define RANK_SIZE 3296
+
+#define PLAYER_REF_ID 0x1234
+
+/* Artificial latency of the mock server to simulate a remote server */
+#define LATENCY_MS 200
+
+static struct pumpnet_mock_server *init(uint32_t latency_ms)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server *server;
+  uint8_t *data;
+
+  pumpnet_mock_server_config_init(&config);
+  config.latency_ms = latency_ms;
+  server = test_util_pumpnet_init_mock(&config);
+
+  data = util_xmalloc(SAVE_SIZE);
+
+  memset(data, 0x11, SAVE_SIZE);
+  pumpnet_mock_server_put(
+      server,
+      "nx2",
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      data,
+      SAVE_SIZE);
+
+  memset(data, 0x22, RANK_SIZE);
+  pumpnet_mock_server_put(
+      server,
+      "nx2",
+      PUMPNET_LIB_FILE_TYPE_RANK,
+      PLAYER_REF_ID,
+      data,
+      RANK_SIZE);
+
+  util_xfree((void **) &data);
+
+  return server;
+}
+
+static void assert_data(const uint8_t *data, size_t size, uint8_t pattern)
+{
+  for (size_t i = 0; i < size; i++) {
+    assert_int_equal(data[i], pattern);
+  }
+}
+
+static void test_prefetch(void **state)
+{
+  struct pumpnet_mock_server *server;
+  struct pumpnet_lib_prefetch *prefetch;
+  uint8_t *save;
+  uint8_t *rank;
+
+  save = util_xmalloc(SAVE_SIZE);
+  rank = util_xmalloc(RANK_SIZE);
+
+  server = init(0);
+
+  prefetch = pumpnet_lib_prefetch_start(PLAYER_REF_ID, SAVE_SIZE, RANK_SIZE);
+
+  /* Order of waiting does not matter */
+  assert_true(pumpnet_lib_prefetch_wait(
+      prefetch, PUMPNET_LIB_FILE_TYPE_RANK, rank, RANK_SIZE));
+  assert_true(pumpnet_lib_prefetch_wait(
+      prefetch, PUMPNET_LIB_FILE_TYPE_SAVE, save, SAVE_SIZE));
+
+  assert_data(save, SAVE_SIZE, 0x11);
+  assert_data(rank, RANK_SIZE, 0x22);
+
+  /* Waiting again after completion returns the data again */
+  memset(save, 0, SAVE_SIZE);
+
+  assert_true(pumpnet_lib_prefetch_wait(
+      prefetch, PUMPNET_LIB_FILE_TYPE_SAVE, save, SAVE_SIZE));
+  assert_data(save, SAVE_SIZE, 0x11);
+
+  pumpnet_lib_prefetch_free(prefetch);
+
+  test_util_pumpnet_shutdown_mock(server);
+
+  util_xfree((void **) &rank);
+  util_xfree((void **) &save);
+}
+
+static void test_prefetch_size_mismatch(void **state)
+{
+  struct pumpnet_mock_server *server;
+  struct pumpnet_lib_prefetch *prefetch;
+  uint8_t *save;
+
+  save = util_xmalloc(SAVE_SIZE);
+
+  server = init(0);
+
+  /* Response size differs from the size prefetched for */
+  prefetch = pumpnet_lib_prefetch_start(PLAYER_REF_ID, SAVE_SIZE, 16);
+
+  assert_true(pumpnet_lib_prefetch_wait(
+      prefetch, PUMPNET_LIB_FILE_TYPE_SAVE, save, SAVE_SIZE));
+  assert_false(pumpnet_lib_prefetch_wait(
+      prefetch, PUMPNET_LIB_FILE_TYPE_RANK, save, 16));
+
+  pumpnet_lib_prefetch_free(prefetch);
+
+  test_util_pumpnet_shutdown_mock(server);
+
+  util_xfree((void **) &save);
+}
+
+static void test_prefetch_faster_than_sequential(void **state)
+{
+  struct pumpnet_mock_server *server;
+  struct pumpnet_lib_prefetch *prefetch;
+  uint8_t *save;
+  uint8_t *rank;
+  uint64_t start_ms;
+  uint64_t sequential_ms;
+  uint64_t prefetch_ms;
+
+  save = util_xmalloc(SAVE_SIZE);
+  rank = util_xmalloc(RANK_SIZE);
+
+  server = init(LATENCY_MS);
+
+  start_ms = util_time_get_monotonic_ns() / 1000 / 1000;
+
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, save, SAVE_SIZE));
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_RANK, PLAYER_REF_ID, rank, RANK_SIZE));
+
+  sequential_ms = util_time_get_monotonic_ns() / 1000 / 1000 - start_ms;
+
+  memset(save, 0, SAVE_SIZE);
+  memset(rank, 0, RANK_SIZE);
+
+  start_ms = util_time_get_monotonic_ns() / 1000 / 1000;
+
+  prefetch = pumpnet_lib_prefetch_start(PLAYER_REF_ID, SAVE_SIZE, RANK_SIZE);
+
+  assert_true(pumpnet_lib_prefetch_wait(
+      prefetch, PUMPNET_LIB_FILE_TYPE_SAVE, save, SAVE_SIZE));
+  assert_true(pumpnet_lib_prefetch_wait(
+      prefetch, PUMPNET_LIB_FILE_TYPE_RANK, rank, RANK_SIZE));
+
+  prefetch_ms = util_time_get_monotonic_ns() / 1000 / 1000 - start_ms;
+
+  pumpnet_lib_prefetch_free(prefetch);
+
+  test_util_pumpnet_shutdown_mock(server);
+
+  printf(
+      "sequential %llu ms, prefetch %llu ms\n",
+      (unsigned long long) sequential_ms,
+      (unsigned long long) prefetch_ms);
+
+  assert_data(save, SAVE_SIZE, 0x11);
+  assert_data(rank, RANK_SIZE, 0x22);
+
+  /* Both sequential requests take at least one round trip each, concurrent
+     ones roughly a single round trip */
+  assert_true(sequential_ms >= 2 * LATENCY_MS);
+  assert_true(prefetch_ms * 4 < sequential_ms * 3);
+
+  util_xfree((void **) &rank);
+  util_xfree((void **) &save);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_prefetch),
+      cmocka_unit_test(test_prefetch_size_mismatch),
+      cmocka_unit_test(test_prefetch_faster_than_sequential)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,393 @@
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmocka/cmocka.h>
+
+#include "test-util/pumpnet.h"
+
+#include "pumpnet/lib/profile-cache.h"
+#include "pumpnet/lib/pumpnet.h"
+#include "pumpnet/mock/server.h"
+
+/* Size of the nx2 usb save */
+#define SAVE_SIZE 30780
+
+#define PLAYER_REF_ID 0x1234
+
+static char cache_dir_path[64];
+
+static struct pumpnet_mock_server *server;
+
+static void get_server_save(uint8_t *buffer)
+{
+  assert_true(pumpnet_mock_server_get(
+      server,
+      "nx2",
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      buffer,
+      SAVE_SIZE));
+}
+
+/* E.g. uploaded by another cabinet, tagged with a new version */
+static void update_server_save(uint8_t value)
+{
+  uint8_t buffer[SAVE_SIZE];
+
+  get_server_save(buffer);
+  memset(buffer, value, 1024);
+
+  pumpnet_mock_server_put(
+      server,
+      "nx2",
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      buffer,
+      SAVE_SIZE);
+}
+
+static uint64_t get_request_count(void)
+{
+  struct pumpnet_mock_server_stats stats;
+
+  pumpnet_mock_server_get_stats(server, &stats);
+
+  return stats.requests;
+}
+
+static uint64_t get_not_modified_count(void)
+{
+  struct pumpnet_mock_server_stats stats;
+
+  pumpnet_mock_server_get_stats(server, &stats);
+
+  return stats.not_modified;
+}
+
+/* Flip a byte of the data of all cache files of a file type */
+static void corrupt_cache_files(const char *file_type)
+{
+  struct dirent *entry;
+  char path[512];
+  FILE *file;
+  DIR *dir;
+  int c;
+
+  dir = opendir(cache_dir_path);
+  assert_non_null(dir);
+
+  while ((entry = readdir(dir)) != NULL) {
+    if (!strstr(entry->d_name, file_type)) {
+      continue;
+    }
+
+    sprintf(path, "%s/%s", cache_dir_path, entry->d_name);
+
+    file = fopen(path, "r+b");
+    assert_non_null(file);
+    assert_int_equal(fseek(file, -16, SEEK_END), 0);
+    c = fgetc(file);
+    assert_int_equal(fseek(file, -16, SEEK_END), 0);
+    fputc(c ^ 0xFF, file);
+    fclose(file);
+  }
+
+  closedir(dir);
+}
+
+static int setup(void **state)
+{
+  strcpy(cache_dir_path, "/tmp/test-pumpnet-profile-cache-XXXXXX");
+  assert_non_null(mkdtemp(cache_dir_path));
+
+  return 0;
+}
+
+static int teardown(void **state)
+{
+  struct dirent *entry;
+  char path[512];
+  DIR *dir;
+
+  dir = opendir(cache_dir_path);
+
+  if (dir) {
+    while ((entry = readdir(dir)) != NULL) {
+      if (entry->d_name[0] != '.') {
+        sprintf(path, "%s/%s", cache_dir_path, entry->d_name);
+        unlink(path);
+      }
+    }
+
+    closedir(dir);
+  }
+
+  rmdir(cache_dir_path);
+
+  return 0;
+}
+
+static void init(void)
+{
+  struct pumpnet_mock_server_config config;
+  uint8_t save[SAVE_SIZE];
+
+  pumpnet_mock_server_config_init(&config);
+  server = test_util_pumpnet_init_mock(&config);
+
+  /* Same data for save and rank, tagged differently */
+  memset(save, 0x42, sizeof(save));
+
+  for (int i = 0; i < PUMPNET_LIB_FILE_TYPE_COUNT; i++) {
+    pumpnet_mock_server_put(server, "nx2", i, PLAYER_REF_ID, save, SAVE_SIZE);
+  }
+
+  assert_true(pumpnet_lib_init_profile_cache(cache_dir_path));
+}
+
+static void assert_get_save(void)
+{
+  uint8_t buffer[SAVE_SIZE];
+  uint8_t server_save[SAVE_SIZE];
+
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer)));
+  get_server_save(server_save);
+  assert_memory_equal(buffer, server_save, SAVE_SIZE);
+}
+
+static void test_profile_cache_store_load(void **state)
+{
+  struct pumpnet_lib_profile_cache *cache;
+  char etag[PUMPNET_LIB_HTTP_ETAG_SIZE];
+  uint8_t buffer[16];
+  size_t size;
+
+  cache =
+      pumpnet_lib_profile_cache_open(cache_dir_path, ASSET_GAME_VERSION_NX2);
+  assert_non_null(cache);
+
+  assert_false(pumpnet_lib_profile_cache_get_etag(
+      cache, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, etag));
+  assert_false(pumpnet_lib_profile_cache_load(
+      cache,
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      buffer,
+      sizeof(buffer),
+      &size));
+
+  assert_true(pumpnet_lib_profile_cache_store(
+      cache, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, "save", 4, "\"1\""));
+
+  assert_true(pumpnet_lib_profile_cache_get_etag(
+      cache, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, etag));
+  assert_string_equal(etag, "\"1\"");
+  assert_true(pumpnet_lib_profile_cache_load(
+      cache,
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      buffer,
+      sizeof(buffer),
+      &size));
+  assert_int_equal(size, 4);
+  assert_memory_equal(buffer, "save", 4);
+
+  /* Other file type and player are not cached */
+  assert_false(pumpnet_lib_profile_cache_get_etag(
+      cache, PUMPNET_LIB_FILE_TYPE_RANK, PLAYER_REF_ID, etag));
+  assert_false(pumpnet_lib_profile_cache_get_etag(
+      cache, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID + 1, etag));
+
+  /* Too large for the buffer */
+  assert_false(pumpnet_lib_profile_cache_load(
+      cache, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, 2, &size));
+
+  pumpnet_lib_profile_cache_invalidate(
+      cache, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID);
+
+  assert_false(pumpnet_lib_profile_cache_get_etag(
+      cache, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, etag));
+
+  pumpnet_lib_profile_cache_close(cache);
+}
+
+static void test_profile_cache_game(void **state)
+{
+  struct pumpnet_lib_profile_cache *cache;
+  char etag[PUMPNET_LIB_HTTP_ETAG_SIZE];
+
+  cache =
+      pumpnet_lib_profile_cache_open(cache_dir_path, ASSET_GAME_VERSION_NX2);
+  assert_non_null(cache);
+  assert_true(pumpnet_lib_profile_cache_store(
+      cache, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, "save", 4, "\"1\""));
+  pumpnet_lib_profile_cache_close(cache);
+
+  /* Same directory shared by another game */
+  cache =
+      pumpnet_lib_profile_cache_open(cache_dir_path, ASSET_GAME_VERSION_NXA);
+  assert_non_null(cache);
+  assert_false(pumpnet_lib_profile_cache_get_etag(
+      cache, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, etag));
+  pumpnet_lib_profile_cache_close(cache);
+}
+
+static void test_profile_cache_corrupted(void **state)
+{
+  struct pumpnet_lib_profile_cache *cache;
+  uint8_t buffer[64];
+  size_t size;
+
+  cache =
+      pumpnet_lib_profile_cache_open(cache_dir_path, ASSET_GAME_VERSION_NX2);
+  assert_non_null(cache);
+
+  memset(buffer, 0x11, sizeof(buffer));
+
+  assert_true(pumpnet_lib_profile_cache_store(
+      cache,
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      buffer,
+      sizeof(buffer),
+      "\"1\""));
+
+  corrupt_cache_files("save");
+
+  assert_false(pumpnet_lib_profile_cache_load(
+      cache,
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      buffer,
+      sizeof(buffer),
+      &size));
+
+  pumpnet_lib_profile_cache_close(cache);
+}
+
+static void test_profile_cache_get_not_modified(void **state)
+{
+  init();
+
+  assert_get_save();
+  assert_get_save();
+
+  /* Second get revalidated without transferring the data again */
+  assert_int_equal(get_request_count(), 2);
+  assert_int_equal(get_not_modified_count(), 1);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_profile_cache_get_modified(void **state)
+{
+  init();
+
+  assert_get_save();
+
+  update_server_save(0x11);
+
+  assert_get_save();
+  assert_int_equal(get_not_modified_count(), 0);
+
+  /* Cache updated with the new data */
+  assert_get_save();
+  assert_int_equal(get_not_modified_count(), 1);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_profile_cache_put(void **state)
+{
+  uint8_t buffer[SAVE_SIZE];
+  uint8_t server_save[SAVE_SIZE];
+
+  init();
+
+  memset(buffer, 0x22, sizeof(buffer));
+
+  assert_true(pumpnet_lib_put(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer)));
+
+  /* Uploaded data cached with the entity tag of the server */
+  assert_get_save();
+  get_server_save(server_save);
+  assert_memory_equal(server_save, buffer, SAVE_SIZE);
+  assert_int_equal(get_not_modified_count(), 1);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_profile_cache_get_corrupted(void **state)
+{
+  init();
+
+  assert_get_save();
+
+  corrupt_cache_files("save");
+
+  /* Not modified, but the cached data is invalid, get again */
+  assert_get_save();
+  assert_int_equal(get_request_count(), 3);
+  assert_int_equal(get_not_modified_count(), 1);
+
+  /* Cache repaired */
+  assert_get_save();
+  assert_int_equal(get_not_modified_count(), 2);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_profile_cache_prefetch(void **state)
+{
+  struct pumpnet_lib_prefetch *prefetch;
+  uint8_t buffer[SAVE_SIZE];
+  uint8_t server_save[SAVE_SIZE];
+
+  init();
+  get_server_save(server_save);
+
+  for (int i = 0; i < 2; i++) {
+    prefetch = pumpnet_lib_prefetch_start(PLAYER_REF_ID, SAVE_SIZE, SAVE_SIZE);
+
+    for (int j = 0; j < PUMPNET_LIB_FILE_TYPE_COUNT; j++) {
+      memset(buffer, 0, sizeof(buffer));
+
+      assert_true(
+          pumpnet_lib_prefetch_wait(prefetch, j, buffer, sizeof(buffer)));
+      assert_memory_equal(buffer, server_save, SAVE_SIZE);
+    }
+
+    pumpnet_lib_prefetch_free(prefetch);
+  }
+
+  /* Save and rank of the second prefetch served from the cache */
+  assert_int_equal(get_not_modified_count(), 2);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup_teardown(
+          test_profile_cache_store_load, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_profile_cache_game, setup, teardown),
+      cmocka_unit_test_setup_teardown(
+          test_profile_cache_corrupted, setup, teardown),
+      cmocka_unit_test_setup_teardown(
+          test_profile_cache_get_not_modified, setup, teardown),
+      cmocka_unit_test_setup_teardown(
+          test_profile_cache_get_modified, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_profile_cache_put, setup, teardown),
+      cmocka_unit_test_setup_teardown(
+          test_profile_cache_get_corrupted, setup, teardown),
+      cmocka_unit_test_setup_teardown(
+          test_profile_cache_prefetch, setup, teardown)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,259 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cmocka/cmocka.h>
+
+#include "pumpnet/lib/profile-token-watcher.h"
+#include "pumpnet/lib/profile-token.h"
+
+#define SLOTS 2
+#define WAIT_TIMEOUT_MS 2000
+
+/* Long enough that only inotify can report changes within the timeout */
+#define POLL_INTERVAL_NO_FALLBACK_MS 60000
+
+struct changes {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  size_t count;
+  uint64_t player_ref_id[SLOTS];
+};
+
+static struct changes changes;
+static char dir_path[64];
+static char token_paths[SLOTS][128];
+static const char *token_path_ptrs[SLOTS];
+
+static void changed(size_t slot, uint64_t player_ref_id, void *ctx)
+{
+  assert_ptr_equal(ctx, &changes);
+  assert_true(slot < SLOTS);
+
+  pthread_mutex_lock(&changes.mutex);
+  changes.count++;
+  changes.player_ref_id[slot] = player_ref_id;
+  pthread_cond_broadcast(&changes.cond);
+  pthread_mutex_unlock(&changes.mutex);
+}
+
+/* Wait for the number of changes reported so far to reach count */
+static bool wait_changes(size_t count)
+{
+  struct timespec ts;
+  bool res;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += WAIT_TIMEOUT_MS / 1000;
+
+  pthread_mutex_lock(&changes.mutex);
+
+  while (changes.count < count) {
+    if (pthread_cond_timedwait(&changes.cond, &changes.mutex, &ts) != 0) {
+      break;
+    }
+  }
+
+  res = changes.count >= count;
+
+  pthread_mutex_unlock(&changes.mutex);
+
+  return res;
+}
+
+static uint64_t get_player_ref_id(size_t slot)
+{
+  uint64_t player_ref_id;
+
+  pthread_mutex_lock(&changes.mutex);
+  player_ref_id = changes.player_ref_id[slot];
+  pthread_mutex_unlock(&changes.mutex);
+
+  return player_ref_id;
+}
+
+static void write_file(const char *path, const void *data, size_t size)
+{
+  FILE *file;
+
+  file = fopen(path, "wb");
+  assert_non_null(file);
+  assert_int_equal(fwrite(data, 1, size, file), size);
+  fclose(file);
+}
+
+static void write_token(size_t slot, uint64_t player_ref_id)
+{
+  char tmp_path[160];
+
+  /* Moved in place like a copy to a usb stick would do, i.e. complete */
+  sprintf(tmp_path, "%s.tmp", token_paths[slot]);
+  write_file(tmp_path, &player_ref_id, sizeof(player_ref_id));
+  assert_int_equal(rename(tmp_path, token_paths[slot]), 0);
+}
+
+static int setup(void **state)
+{
+  strcpy(dir_path, "/tmp/test-pumpnet-token-watcher-XXXXXX");
+  assert_non_null(mkdtemp(dir_path));
+
+  for (int i = 0; i < SLOTS; i++) {
+    sprintf(token_paths[i], "%s/%d/pumpnet.bin", dir_path, i);
+    token_path_ptrs[i] = token_paths[i];
+  }
+
+  memset(&changes, 0, sizeof(changes));
+  pthread_mutex_init(&changes.mutex, NULL);
+  pthread_cond_init(&changes.cond, NULL);
+
+  return 0;
+}
+
+static int teardown(void **state)
+{
+  char path[128];
+
+  for (int i = 0; i < SLOTS; i++) {
+    unlink(token_paths[i]);
+    sprintf(path, "%s/%d", dir_path, i);
+    rmdir(path);
+  }
+
+  rmdir(dir_path);
+
+  pthread_cond_destroy(&changes.cond);
+  pthread_mutex_destroy(&changes.mutex);
+
+  return 0;
+}
+
+static void mkdir_slot(size_t slot)
+{
+  char path[128];
+
+  sprintf(path, "%s/%d", dir_path, (int) slot);
+  assert_int_equal(mkdir(path, 0755), 0);
+}
+
+static void test_present_on_start(void **state)
+{
+  struct pumpnet_lib_profile_token_watcher *watcher;
+
+  mkdir_slot(0);
+  write_token(0, 0x1234);
+
+  watcher = pumpnet_lib_profile_token_watcher_start(
+      token_path_ptrs,
+      SLOTS,
+      POLL_INTERVAL_NO_FALLBACK_MS,
+      changed,
+      &changes);
+  assert_non_null(watcher);
+
+  assert_true(wait_changes(1));
+  assert_int_equal(get_player_ref_id(0), 0x1234);
+
+  pumpnet_lib_profile_token_watcher_stop(watcher);
+
+  /* Missing tokens are not reported */
+  assert_int_equal(changes.count, 1);
+}
+
+static void test_appear_change_remove(void **state)
+{
+  struct pumpnet_lib_profile_token_watcher *watcher;
+
+  mkdir_slot(0);
+  mkdir_slot(1);
+
+  watcher = pumpnet_lib_profile_token_watcher_start(
+      token_path_ptrs,
+      SLOTS,
+      POLL_INTERVAL_NO_FALLBACK_MS,
+      changed,
+      &changes);
+  assert_non_null(watcher);
+
+  write_token(1, 0x1111);
+
+  assert_true(wait_changes(1));
+  assert_int_equal(get_player_ref_id(1), 0x1111);
+
+  write_token(1, 0x2222);
+
+  assert_true(wait_changes(2));
+  assert_int_equal(get_player_ref_id(1), 0x2222);
+
+  assert_int_equal(unlink(token_paths[1]), 0);
+
+  assert_true(wait_changes(3));
+  assert_int_equal(get_player_ref_id(1), PUMPNET_LIB_PROFILE_TOKEN_INVALID);
+
+  pumpnet_lib_profile_token_watcher_stop(watcher);
+
+  assert_int_equal(changes.count, 3);
+}
+
+static void test_invalid_token(void **state)
+{
+  struct pumpnet_lib_profile_token_watcher *watcher;
+  uint8_t data[4] = {0};
+
+  mkdir_slot(0);
+
+  watcher = pumpnet_lib_profile_token_watcher_start(
+      token_path_ptrs,
+      SLOTS,
+      POLL_INTERVAL_NO_FALLBACK_MS,
+      changed,
+      &changes);
+  assert_non_null(watcher);
+
+  /* Wrong size, e.g. partially written */
+  write_file(token_paths[0], data, sizeof(data));
+
+  write_token(0, 0x4321);
+
+  assert_true(wait_changes(1));
+  assert_int_equal(get_player_ref_id(0), 0x4321);
+
+  pumpnet_lib_profile_token_watcher_stop(watcher);
+
+  assert_int_equal(changes.count, 1);
+}
+
+static void test_dir_created_later(void **state)
+{
+  struct pumpnet_lib_profile_token_watcher *watcher;
+
+  /* Not watched until it exists, picked up by the poll interval */
+  watcher = pumpnet_lib_profile_token_watcher_start(
+      token_path_ptrs, SLOTS, 50, changed, &changes);
+  assert_non_null(watcher);
+
+  mkdir_slot(0);
+  write_token(0, 0x5678);
+
+  assert_true(wait_changes(1));
+  assert_int_equal(get_player_ref_id(0), 0x5678);
+
+  pumpnet_lib_profile_token_watcher_stop(watcher);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup_teardown(test_present_on_start, setup, teardown),
+      cmocka_unit_test_setup_teardown(
+          test_appear_change_remove, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_invalid_token, setup, teardown),
+      cmocka_unit_test_setup_teardown(
+          test_dir_created_later, setup, teardown)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,313 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <cmocka/cmocka.h>
+
+#include "test-util/pumpnet.h"
+
+#include "pumpnet/lib/pumpnet.h"
+#include "pumpnet/lib/retry.h"
+#include "pumpnet/mock/server.h"
+
+#include "util/time.h"
+
+#define SAVE_SIZE 1024
+
+#define PLAYER_REF_ID 0x1234
+
+static const struct pumpnet_lib_circuit_breaker_config breaker_config = {
+    .window_size = 10,
+    .min_requests = 4,
+    .failure_threshold_percent = 50,
+    .open_time_ms = 100,
+};
+
+static struct pumpnet_mock_server *init(
+    const struct pumpnet_lib_retry_policy *policy,
+    const struct pumpnet_lib_circuit_breaker_config *config)
+{
+  struct pumpnet_mock_server_config server_config;
+  struct pumpnet_mock_server *server;
+  uint8_t save[SAVE_SIZE];
+
+  pumpnet_mock_server_config_init(&server_config);
+  server = pumpnet_mock_server_start(&server_config);
+  assert_non_null(server);
+
+  memset(save, 0x11, sizeof(save));
+  pumpnet_mock_server_put(
+      server,
+      "nx2",
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      save,
+      SAVE_SIZE);
+
+  pumpnet_lib_configure_retry(policy, config);
+  test_util_pumpnet_init_lib(pumpnet_mock_server_get_port(server));
+
+  return server;
+}
+
+static uint64_t get_request_count(struct pumpnet_mock_server *server)
+{
+  struct pumpnet_mock_server_stats stats;
+
+  pumpnet_mock_server_get_stats(server, &stats);
+
+  return stats.requests;
+}
+
+static bool get_save(void)
+{
+  uint8_t buffer[SAVE_SIZE];
+
+  return pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer));
+}
+
+static void test_retry_policy_delay(void **state)
+{
+  struct pumpnet_lib_retry_policy policy = {
+      .max_attempts = 0,
+      .base_delay_ms = 100,
+      .max_delay_ms = 1000,
+      .deadline_ms = 0,
+  };
+  uint32_t delay;
+  uint32_t min;
+  uint32_t max;
+  uint32_t cap;
+
+  for (uint32_t attempt = 0; attempt < 40; attempt++) {
+    cap = attempt < 4 ? 100 << attempt : 1000;
+    min = UINT32_MAX;
+    max = 0;
+
+    for (int i = 0; i < 1000; i++) {
+      delay = pumpnet_lib_retry_policy_get_delay_ms(&policy, attempt);
+
+      assert_true(delay <= cap);
+
+      min = delay < min ? delay : min;
+      max = delay > max ? delay : max;
+    }
+
+    /* Full jitter, spread over the whole range */
+    assert_true(min < cap / 4);
+    assert_true(max > cap * 3 / 4);
+  }
+}
+
+static void test_circuit_breaker_trips(void **state)
+{
+  struct pumpnet_lib_circuit_breaker breaker;
+
+  pumpnet_lib_circuit_breaker_init(&breaker, &breaker_config);
+
+  /* Not enough requests to judge */
+  assert_true(pumpnet_lib_circuit_breaker_allow(&breaker));
+  pumpnet_lib_circuit_breaker_record(&breaker, false);
+  assert_true(pumpnet_lib_circuit_breaker_allow(&breaker));
+  pumpnet_lib_circuit_breaker_record(&breaker, true);
+  assert_true(pumpnet_lib_circuit_breaker_allow(&breaker));
+  pumpnet_lib_circuit_breaker_record(&breaker, true);
+
+  assert_int_equal(
+      pumpnet_lib_circuit_breaker_get_state(&breaker),
+      PUMPNET_LIB_CIRCUIT_BREAKER_STATE_CLOSED);
+
+  /* 2 of 4 failed */
+  assert_true(pumpnet_lib_circuit_breaker_allow(&breaker));
+  pumpnet_lib_circuit_breaker_record(&breaker, false);
+
+  assert_int_equal(
+      pumpnet_lib_circuit_breaker_get_state(&breaker),
+      PUMPNET_LIB_CIRCUIT_BREAKER_STATE_OPEN);
+  assert_false(pumpnet_lib_circuit_breaker_allow(&breaker));
+
+  pumpnet_lib_circuit_breaker_fini(&breaker);
+}
+
+static void test_circuit_breaker_below_threshold(void **state)
+{
+  struct pumpnet_lib_circuit_breaker breaker;
+
+  pumpnet_lib_circuit_breaker_init(&breaker, &breaker_config);
+
+  /* Sporadic failures, 1 of 4 */
+  for (int i = 0; i < 30; i++) {
+    assert_true(pumpnet_lib_circuit_breaker_allow(&breaker));
+    pumpnet_lib_circuit_breaker_record(&breaker, i % 4 != 3);
+  }
+
+  assert_int_equal(
+      pumpnet_lib_circuit_breaker_get_state(&breaker),
+      PUMPNET_LIB_CIRCUIT_BREAKER_STATE_CLOSED);
+
+  pumpnet_lib_circuit_breaker_fini(&breaker);
+}
+
+static void test_circuit_breaker_half_open(void **state)
+{
+  struct pumpnet_lib_circuit_breaker breaker;
+
+  pumpnet_lib_circuit_breaker_init(&breaker, &breaker_config);
+
+  for (int i = 0; i < 4; i++) {
+    assert_true(pumpnet_lib_circuit_breaker_allow(&breaker));
+    pumpnet_lib_circuit_breaker_record(&breaker, false);
+  }
+
+  assert_false(pumpnet_lib_circuit_breaker_allow(&breaker));
+
+  util_time_sleep_ms(breaker_config.open_time_ms + 20);
+
+  /* Single probe */
+  assert_true(pumpnet_lib_circuit_breaker_allow(&breaker));
+  assert_int_equal(
+      pumpnet_lib_circuit_breaker_get_state(&breaker),
+      PUMPNET_LIB_CIRCUIT_BREAKER_STATE_HALF_OPEN);
+  assert_false(pumpnet_lib_circuit_breaker_allow(&breaker));
+
+  /* Probe failed, open again */
+  pumpnet_lib_circuit_breaker_record(&breaker, false);
+
+  assert_int_equal(
+      pumpnet_lib_circuit_breaker_get_state(&breaker),
+      PUMPNET_LIB_CIRCUIT_BREAKER_STATE_OPEN);
+  assert_false(pumpnet_lib_circuit_breaker_allow(&breaker));
+
+  util_time_sleep_ms(breaker_config.open_time_ms + 20);
+
+  /* Probe successful, closed */
+  assert_true(pumpnet_lib_circuit_breaker_allow(&breaker));
+  pumpnet_lib_circuit_breaker_record(&breaker, true);
+
+  assert_int_equal(
+      pumpnet_lib_circuit_breaker_get_state(&breaker),
+      PUMPNET_LIB_CIRCUIT_BREAKER_STATE_CLOSED);
+  assert_true(pumpnet_lib_circuit_breaker_allow(&breaker));
+
+  pumpnet_lib_circuit_breaker_fini(&breaker);
+}
+
+static void test_get_retries_transient_faults(void **state)
+{
+  struct pumpnet_mock_server *server;
+  struct pumpnet_lib_retry_policy policy = {
+      .max_attempts = 5,
+      .base_delay_ms = 10,
+      .max_delay_ms = 20,
+      .deadline_ms = 5000,
+  };
+
+  server = init(&policy, &test_util_pumpnet_breaker_lenient);
+
+  pumpnet_mock_server_inject_faults(server, 503, 1);
+  assert_true(get_save());
+  assert_int_equal(get_request_count(server), 2);
+
+  /* Connection closed without response */
+  pumpnet_mock_server_inject_faults(server, 0, 2);
+  assert_true(get_save());
+  assert_int_equal(get_request_count(server), 5);
+
+  /* Rejected requests are not retried */
+  pumpnet_mock_server_inject_faults(server, 404, 1);
+  assert_false(get_save());
+  assert_int_equal(get_request_count(server), 6);
+
+  /* Attempts exhausted */
+  pumpnet_mock_server_inject_faults(server, 503, 5);
+  assert_false(get_save());
+  assert_int_equal(get_request_count(server), 11);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_get_deadline(void **state)
+{
+  struct pumpnet_mock_server *server;
+  struct pumpnet_lib_retry_policy policy = {
+      .max_attempts = 0,
+      .base_delay_ms = 50,
+      .max_delay_ms = 50,
+      .deadline_ms = 300,
+  };
+  uint64_t start_ms;
+  uint64_t elapsed_ms;
+
+  server = init(&policy, &test_util_pumpnet_breaker_lenient);
+
+  /* Server down for longer than the deadline */
+  pumpnet_mock_server_inject_faults(server, 503, 1000);
+
+  start_ms = util_time_get_monotonic_ns() / 1000 / 1000;
+  assert_false(get_save());
+  elapsed_ms = util_time_get_monotonic_ns() / 1000 / 1000 - start_ms;
+
+  assert_true(elapsed_ms < policy.deadline_ms + 100);
+  assert_true(get_request_count(server) > 1);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_get_circuit_breaker(void **state)
+{
+  struct pumpnet_mock_server *server;
+  struct pumpnet_lib_retry_policy policy = {
+      .max_attempts = 2,
+      .base_delay_ms = 1,
+      .max_delay_ms = 1,
+      .deadline_ms = 5000,
+  };
+  uint64_t start_ms;
+  uint64_t requests;
+
+  server = init(&policy, &breaker_config);
+
+  /* Server down, trips after 4 failed attempts */
+  pumpnet_mock_server_inject_faults(server, 0, 1000);
+
+  assert_false(get_save());
+  assert_false(get_save());
+
+  requests = get_request_count(server);
+  assert_int_equal(requests, 4);
+
+  /* Fails fast without contacting the server */
+  start_ms = util_time_get_monotonic_ns() / 1000 / 1000;
+
+  for (int i = 0; i < 10; i++) {
+    assert_false(get_save());
+  }
+
+  assert_true(util_time_get_monotonic_ns() / 1000 / 1000 - start_ms < 50);
+  assert_int_equal(get_request_count(server), requests);
+
+  /* Server back, probed once the breaker is half-open */
+  pumpnet_mock_server_inject_faults(server, 0, 0);
+  util_time_sleep_ms(breaker_config.open_time_ms + 20);
+
+  assert_true(get_save());
+  assert_true(get_save());
+  assert_int_equal(get_request_count(server), requests + 2);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_retry_policy_delay),
+      cmocka_unit_test(test_circuit_breaker_trips),
+      cmocka_unit_test(test_circuit_breaker_below_threshold),
+      cmocka_unit_test(test_circuit_breaker_half_open),
+      cmocka_unit_test(test_get_retries_transient_faults),
+      cmocka_unit_test(test_get_deadline),
+      cmocka_unit_test(test_get_circuit_breaker)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,244 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmocka/cmocka.h>
+
+#include "test-util/pumpnet.h"
+
+#include "pumpnet/lib/pumpnet.h"
+#include "pumpnet/lib/trace.h"
+#include "pumpnet/mock/server.h"
+
+#define SAVE_SIZE 1024
+
+#define PLAYER_REF_ID 0x1234
+
+static char trace_path[64];
+
+static struct pumpnet_mock_server *
+init(const struct pumpnet_mock_server_config *config, const char *suffix)
+{
+  int fd;
+
+  sprintf(trace_path, "/tmp/test-pumpnet-trace-XXXXXX%s", suffix);
+  fd = mkstemps(trace_path, strlen(suffix));
+  assert_true(fd >= 0);
+  close(fd);
+
+  return test_util_pumpnet_init_mock(config);
+}
+
+static void shutdown_(struct pumpnet_mock_server *server)
+{
+  test_util_pumpnet_shutdown_mock(server);
+  unlink(trace_path);
+}
+
+static size_t read_records(
+    struct pumpnet_lib_trace_record *records, size_t max_count)
+{
+  struct pumpnet_lib_trace_file_header header;
+  FILE *file;
+  size_t count;
+
+  file = fopen(trace_path, "rb");
+  assert_non_null(file);
+
+  assert_int_equal(fread(&header, sizeof(header), 1, file), 1);
+  assert_int_equal(header.magic, PUMPNET_LIB_TRACE_FILE_MAGIC);
+  assert_int_equal(header.version, PUMPNET_LIB_TRACE_FILE_VERSION);
+  assert_int_equal(
+      header.record_size, sizeof(struct pumpnet_lib_trace_record));
+
+  count = fread(
+      records, sizeof(struct pumpnet_lib_trace_record), max_count, file);
+
+  fclose(file);
+
+  return count;
+}
+
+static void test_histogram_percentile(void **state)
+{
+  struct pumpnet_lib_trace_histogram histogram;
+
+  memset(&histogram, 0, sizeof(histogram));
+
+  assert_int_equal(
+      pumpnet_lib_trace_histogram_get_percentile_us(&histogram, 50), 0);
+
+  /* 90 x 100 us (bucket [64, 128)), 10 x 1000 us (bucket [512, 1024)) */
+  histogram.count = 100;
+  histogram.buckets[7] = 90;
+  histogram.buckets[10] = 10;
+  histogram.max_us = 1000;
+
+  assert_int_equal(
+      pumpnet_lib_trace_histogram_get_percentile_us(&histogram, 50), 127);
+  assert_int_equal(
+      pumpnet_lib_trace_histogram_get_percentile_us(&histogram, 90), 127);
+  /* Capped at the max */
+  assert_int_equal(
+      pumpnet_lib_trace_histogram_get_percentile_us(&histogram, 91), 1000);
+  assert_int_equal(
+      pumpnet_lib_trace_histogram_get_percentile_us(&histogram, 100), 1000);
+}
+
+static void test_jsonl(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server *server;
+  uint8_t save[SAVE_SIZE];
+  char line[1024];
+  FILE *file;
+
+  pumpnet_mock_server_config_init(&config);
+  server = init(&config, ".jsonl");
+
+  assert_true(pumpnet_lib_init_trace(trace_path));
+
+  memset(save, 0x11, sizeof(save));
+
+  assert_true(pumpnet_lib_put(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, save, sizeof(save)));
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, save, sizeof(save)));
+
+  /* Flushed after each span */
+  file = fopen(trace_path, "r");
+  assert_non_null(file);
+
+  assert_non_null(fgets(line, sizeof(line), file));
+  assert_non_null(strstr(line, "\"method\":\"POST\""));
+  assert_non_null(strstr(line, "\"file_type\":\"save\""));
+  assert_non_null(strstr(line, "\"http_code\":200"));
+  assert_non_null(strstr(line, "\"success\":true"));
+  assert_non_null(strstr(line, "\"attempts\":1"));
+  assert_non_null(strstr(line, "\"backoff_us\":0"));
+
+  assert_non_null(fgets(line, sizeof(line), file));
+  assert_non_null(strstr(line, "\"method\":\"GET\""));
+  assert_non_null(strstr(line, "\"player_ref_id\":\"0000000000001234\""));
+  assert_non_null(strstr(line, "\"success\":true"));
+
+  assert_null(fgets(line, sizeof(line), file));
+
+  fclose(file);
+
+  shutdown_(server);
+}
+
+static void test_binary_append(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server *server;
+  struct pumpnet_lib_trace_record records[4];
+  uint8_t save[SAVE_SIZE];
+
+  pumpnet_mock_server_config_init(&config);
+  server = init(&config, ".bin");
+
+  assert_true(pumpnet_lib_init_trace(trace_path));
+
+  memset(save, 0x22, sizeof(save));
+
+  assert_true(pumpnet_lib_put(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, save, sizeof(save)));
+
+  /* Restart, appended to the existing trace file */
+  pumpnet_lib_shutdown();
+
+  test_util_pumpnet_init_lib(pumpnet_mock_server_get_port(server));
+
+  assert_true(pumpnet_lib_init_trace(trace_path));
+
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, save, sizeof(save)));
+
+  assert_int_equal(read_records(records, 4), 2);
+
+  assert_int_equal(records[0].player_ref_id, PLAYER_REF_ID);
+  assert_int_equal(records[0].file_type, PUMPNET_LIB_FILE_TYPE_SAVE);
+  assert_true(records[0].is_post);
+  assert_int_equal(records[0].http_code, 200);
+  assert_true(records[0].success);
+  assert_int_equal(records[0].attempts, 1);
+  assert_true(records[0].send_encoded_size >= SAVE_SIZE);
+  assert_true(records[0].duration_us[PUMPNET_LIB_TRACE_PHASE_TOTAL] > 0);
+
+  assert_false(records[1].is_post);
+  assert_true(records[1].success);
+  assert_true(records[1].recv_encoded_size >= SAVE_SIZE);
+  assert_true(records[1].trace_id != records[0].trace_id);
+  assert_true(records[1].start_time_us >= records[0].start_time_us);
+
+  shutdown_(server);
+}
+
+static void test_binary_invalid_file(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server *server;
+  FILE *file;
+
+  pumpnet_mock_server_config_init(&config);
+  server = init(&config, ".bin");
+
+  file = fopen(trace_path, "wb");
+  assert_non_null(file);
+  fputs("not a trace file", file);
+  fclose(file);
+
+  assert_false(pumpnet_lib_init_trace(trace_path));
+
+  shutdown_(server);
+}
+
+static void test_retries(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server *server;
+  struct pumpnet_lib_trace_record records[2];
+  uint8_t buffer[SAVE_SIZE];
+
+  pumpnet_mock_server_config_init(&config);
+  config.error_rate_percent = 100;
+  server = init(&config, ".bin");
+
+  assert_true(pumpnet_lib_init_trace(trace_path));
+
+  assert_false(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer)));
+
+  assert_int_equal(read_records(records, 2), 1);
+
+  assert_false(records[0].success);
+  assert_int_equal(
+      records[0].attempts, test_util_pumpnet_retry_policy.max_attempts);
+  assert_true(records[0].http_code >= 500);
+  /* Full jitter, at most the max delay for each retry */
+  assert_true(
+      records[0].duration_us[PUMPNET_LIB_TRACE_PHASE_BACKOFF] <=
+      (test_util_pumpnet_retry_policy.max_attempts - 1) *
+          test_util_pumpnet_retry_policy.max_delay_ms * 1000);
+  assert_true(
+      records[0].duration_us[PUMPNET_LIB_TRACE_PHASE_TOTAL] >=
+      records[0].duration_us[PUMPNET_LIB_TRACE_PHASE_BACKOFF]);
+
+  shutdown_(server);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_histogram_percentile),
+      cmocka_unit_test(test_jsonl),
+      cmocka_unit_test(test_binary_append),
+      cmocka_unit_test(test_binary_invalid_file),
+      cmocka_unit_test(test_retries)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,221 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <cmocka/cmocka.h>
+
+#include "test-util/pumpnet.h"
+
+#include "pumpnet/lib/http.h"
+#include "pumpnet/lib/protocol.h"
+#include "pumpnet/lib/pumpnet.h"
+#include "pumpnet/mock/server.h"
+
+/* Size of the nx2 usb save */
+#define SAVE_SIZE 30780
+
+#define PLAYER_REF_ID 0x1234
+
+static struct pumpnet_mock_server *server;
+
+static void init(
+    enum pumpnet_lib_http_transport client_transport,
+    enum pumpnet_lib_http_transport server_transport)
+{
+  struct pumpnet_mock_server_config config;
+  uint8_t save[SAVE_SIZE];
+
+  /* Mostly zero like an actual save, compresses well */
+  memset(save, 0, sizeof(save));
+
+  for (size_t i = 0; i < sizeof(save); i += 97) {
+    save[i] = (uint8_t) i;
+  }
+
+  pumpnet_mock_server_config_init(&config);
+  config.transport = server_transport;
+
+  pumpnet_lib_configure_transport(client_transport);
+  server = test_util_pumpnet_init_mock(&config);
+
+  pumpnet_mock_server_put(
+      server,
+      "nx2",
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      save,
+      SAVE_SIZE);
+}
+
+static void get_server_save(uint8_t *buffer)
+{
+  assert_true(pumpnet_mock_server_get(
+      server,
+      "nx2",
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      buffer,
+      SAVE_SIZE));
+}
+
+static size_t get_body_bytes_received(void)
+{
+  struct pumpnet_mock_server_stats stats;
+
+  pumpnet_mock_server_get_stats(server, &stats);
+
+  return stats.body_bytes_received;
+}
+
+static uint64_t get_request_count(void)
+{
+  struct pumpnet_mock_server_stats stats;
+
+  pumpnet_mock_server_get_stats(server, &stats);
+
+  return stats.requests;
+}
+
+static void assert_get_save(void)
+{
+  uint8_t buffer[SAVE_SIZE];
+  uint8_t server_save[SAVE_SIZE];
+
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer)));
+  get_server_save(server_save);
+  assert_memory_equal(buffer, server_save, SAVE_SIZE);
+}
+
+/* Uploads a modified save and returns the request body bytes received */
+static size_t assert_put_save(uint8_t value)
+{
+  uint8_t buffer[SAVE_SIZE];
+  uint8_t server_save[SAVE_SIZE];
+  size_t bytes;
+
+  get_server_save(buffer);
+  memset(buffer, value, 1024);
+
+  bytes = get_body_bytes_received();
+
+  assert_true(pumpnet_lib_put(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer)));
+  get_server_save(server_save);
+  assert_memory_equal(buffer, server_save, SAVE_SIZE);
+
+  return get_body_bytes_received() - bytes;
+}
+
+static void test_transport_base64_server(void **state)
+{
+  init(
+      PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE,
+      PUMPNET_LIB_HTTP_TRANSPORT_BASE64);
+
+  assert_get_save();
+  assert_put_save(0x11);
+
+  /* Server not supporting binary, stays with base64 */
+  assert_int_equal(
+      pumpnet_lib_http_get_transport(), PUMPNET_LIB_HTTP_TRANSPORT_BASE64);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_transport_base64_client(void **state)
+{
+  init(PUMPNET_LIB_HTTP_TRANSPORT_BASE64, PUMPNET_LIB_HTTP_TRANSPORT_BINARY);
+
+  assert_get_save();
+  assert_put_save(0x11);
+
+  assert_int_equal(
+      pumpnet_lib_http_get_transport(), PUMPNET_LIB_HTTP_TRANSPORT_BASE64);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_transport_negotiate_binary(void **state)
+{
+  size_t bytes_base64;
+  size_t bytes_binary;
+
+  init(PUMPNET_LIB_HTTP_TRANSPORT_BINARY, PUMPNET_LIB_HTTP_TRANSPORT_BINARY);
+
+  /* Base64 until the server responded with binary */
+  bytes_base64 = assert_put_save(0x11);
+
+  assert_int_equal(
+      pumpnet_lib_http_get_transport(), PUMPNET_LIB_HTTP_TRANSPORT_BINARY);
+
+  bytes_binary = assert_put_save(0x22);
+  assert_get_save();
+
+  assert_int_equal(
+      bytes_binary, sizeof(struct pumpnet_lib_put_save_req) + SAVE_SIZE);
+  assert_true(bytes_binary * 4 <= bytes_base64 * 3);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_transport_negotiate_deflate(void **state)
+{
+  size_t bytes;
+
+  init(
+      PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE,
+      PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE);
+
+  assert_get_save();
+
+  assert_int_equal(
+      pumpnet_lib_http_get_transport(),
+      PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE);
+
+  bytes = assert_put_save(0x11);
+  assert_get_save();
+
+  assert_true(bytes < SAVE_SIZE / 4);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_transport_fallback_rejected(void **state)
+{
+  uint64_t requests;
+
+  init(PUMPNET_LIB_HTTP_TRANSPORT_BINARY, PUMPNET_LIB_HTTP_TRANSPORT_BINARY);
+
+  assert_get_save();
+
+  assert_int_equal(
+      pumpnet_lib_http_get_transport(), PUMPNET_LIB_HTTP_TRANSPORT_BINARY);
+
+  /* E.g. server rolled back, rejects binary request bodies */
+  pumpnet_mock_server_set_transport(server, PUMPNET_LIB_HTTP_TRANSPORT_BASE64);
+  requests = get_request_count();
+
+  assert_put_save(0x11);
+
+  /* Rejected and sent again */
+  assert_int_equal(get_request_count(), requests + 2);
+  assert_int_equal(
+      pumpnet_lib_http_get_transport(), PUMPNET_LIB_HTTP_TRANSPORT_BASE64);
+
+  assert_get_save();
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_transport_base64_server),
+      cmocka_unit_test(test_transport_base64_client),
+      cmocka_unit_test(test_transport_negotiate_binary),
+      cmocka_unit_test(test_transport_negotiate_deflate),
+      cmocka_unit_test(test_transport_fallback_rejected)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
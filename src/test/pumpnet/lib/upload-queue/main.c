@@ -0,0 +1,325 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmocka/cmocka.h>
+
+#include "pumpnet/lib/upload-queue.h"
+
+#define PLAYER_REF_ID 0x1234
+
+#define FLUSH_TIMEOUT_MS 5000
+
+struct put_ctx {
+  /* Results to return on the first calls, OK afterwards */
+  enum pumpnet_lib_upload_queue_result results[8];
+  size_t num_results;
+
+  size_t calls;
+  enum pumpnet_lib_file_type last_file_type;
+  uint64_t last_player_ref_id;
+  uint8_t last_data[64];
+  size_t last_size;
+};
+
+static char journal_path[64];
+
+static const struct pumpnet_lib_retry_policy retry_policy = {
+    .max_attempts = 0,
+    .base_delay_ms = 5,
+    .max_delay_ms = 10,
+    .deadline_ms = 0,
+};
+
+static enum pumpnet_lib_upload_queue_result put(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size,
+    void *ctx)
+{
+  struct put_ctx *put_ctx;
+  size_t call;
+
+  put_ctx = (struct put_ctx *) ctx;
+  call = put_ctx->calls++;
+
+  put_ctx->last_file_type = file_type;
+  put_ctx->last_player_ref_id = player_ref_id;
+  put_ctx->last_size = size;
+  memcpy(put_ctx->last_data, data, size);
+
+  if (call < put_ctx->num_results) {
+    return put_ctx->results[call];
+  }
+
+  return PUMPNET_LIB_UPLOAD_QUEUE_RESULT_OK;
+}
+
+static enum pumpnet_lib_upload_queue_result put_offline(
+    enum pumpnet_lib_file_type file_type,
+    uint64_t player_ref_id,
+    const void *data,
+    size_t size,
+    void *ctx)
+{
+  return PUMPNET_LIB_UPLOAD_QUEUE_RESULT_RETRY;
+}
+
+static off_t journal_size(void)
+{
+  struct stat st;
+
+  assert_int_equal(stat(journal_path, &st), 0);
+
+  return st.st_size;
+}
+
+static int setup(void **state)
+{
+  int fd;
+
+  strcpy(journal_path, "/tmp/test-pumpnet-upload-queue-XXXXXX");
+  fd = mkstemp(journal_path);
+  assert_true(fd != -1);
+  close(fd);
+
+  return 0;
+}
+
+static int teardown(void **state)
+{
+  unlink(journal_path);
+
+  return 0;
+}
+
+static void test_push(void **state)
+{
+  struct pumpnet_lib_upload_queue *queue;
+  struct put_ctx ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+
+  queue = pumpnet_lib_upload_queue_open(journal_path, &retry_policy, put, &ctx);
+  assert_non_null(queue);
+
+  assert_true(pumpnet_lib_upload_queue_push(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, "save", 4));
+  assert_true(pumpnet_lib_upload_queue_flush(queue, FLUSH_TIMEOUT_MS));
+
+  assert_int_equal(ctx.calls, 1);
+  assert_int_equal(ctx.last_file_type, PUMPNET_LIB_FILE_TYPE_SAVE);
+  assert_int_equal(ctx.last_player_ref_id, PLAYER_REF_ID);
+  assert_int_equal(ctx.last_size, 4);
+  assert_memory_equal(ctx.last_data, "save", 4);
+
+  /* Journal is reset once all uploads completed */
+  assert_int_equal(pumpnet_lib_upload_queue_pending(queue), 0);
+  assert_int_equal(journal_size(), 0);
+
+  pumpnet_lib_upload_queue_close(queue);
+}
+
+static void test_retry(void **state)
+{
+  struct pumpnet_lib_upload_queue *queue;
+  struct put_ctx ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.results[0] = PUMPNET_LIB_UPLOAD_QUEUE_RESULT_RETRY;
+  ctx.results[1] = PUMPNET_LIB_UPLOAD_QUEUE_RESULT_RETRY;
+  ctx.results[2] = PUMPNET_LIB_UPLOAD_QUEUE_RESULT_RETRY;
+  ctx.num_results = 3;
+
+  queue = pumpnet_lib_upload_queue_open(journal_path, &retry_policy, put, &ctx);
+  assert_non_null(queue);
+
+  assert_true(pumpnet_lib_upload_queue_push(
+      queue, PUMPNET_LIB_FILE_TYPE_RANK, PLAYER_REF_ID, "rank", 4));
+  assert_true(pumpnet_lib_upload_queue_flush(queue, FLUSH_TIMEOUT_MS));
+
+  assert_int_equal(ctx.calls, 4);
+  assert_int_equal(ctx.last_file_type, PUMPNET_LIB_FILE_TYPE_RANK);
+  assert_memory_equal(ctx.last_data, "rank", 4);
+
+  pumpnet_lib_upload_queue_close(queue);
+}
+
+static void test_failed_dropped(void **state)
+{
+  struct pumpnet_lib_upload_queue *queue;
+  struct put_ctx ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.results[0] = PUMPNET_LIB_UPLOAD_QUEUE_RESULT_FAILED;
+  ctx.num_results = 1;
+
+  queue = pumpnet_lib_upload_queue_open(journal_path, &retry_policy, put, &ctx);
+  assert_non_null(queue);
+
+  assert_true(pumpnet_lib_upload_queue_push(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, "save", 4));
+  assert_true(pumpnet_lib_upload_queue_flush(queue, FLUSH_TIMEOUT_MS));
+
+  assert_int_equal(ctx.calls, 1);
+
+  pumpnet_lib_upload_queue_close(queue);
+}
+
+static void test_get_pending(void **state)
+{
+  struct pumpnet_lib_upload_queue *queue;
+  char buffer[4];
+
+  queue = pumpnet_lib_upload_queue_open(
+      journal_path, &retry_policy, put_offline, NULL);
+  assert_non_null(queue);
+
+  assert_false(pumpnet_lib_upload_queue_get_pending(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, 4));
+
+  assert_true(pumpnet_lib_upload_queue_push(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, "old!", 4));
+  assert_true(pumpnet_lib_upload_queue_push(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, "new!", 4));
+
+  /* Latest pending data of the player and file type */
+  assert_true(pumpnet_lib_upload_queue_get_pending(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, 4));
+  assert_memory_equal(buffer, "new!", 4);
+
+  assert_false(pumpnet_lib_upload_queue_get_pending(
+      queue, PUMPNET_LIB_FILE_TYPE_RANK, PLAYER_REF_ID, buffer, 4));
+  assert_false(pumpnet_lib_upload_queue_get_pending(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID + 1, buffer, 4));
+
+  /* Buffer too small */
+  assert_false(pumpnet_lib_upload_queue_get_pending(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, 3));
+
+  pumpnet_lib_upload_queue_close(queue);
+}
+
+static void test_replay(void **state)
+{
+  struct pumpnet_lib_upload_queue *queue;
+  struct put_ctx ctx;
+
+  /* Server not reachable until the game shuts down */
+  queue = pumpnet_lib_upload_queue_open(
+      journal_path, &retry_policy, put_offline, NULL);
+  assert_non_null(queue);
+
+  assert_true(pumpnet_lib_upload_queue_push(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, "save", 4));
+  assert_false(pumpnet_lib_upload_queue_flush(queue, 50));
+  assert_int_equal(pumpnet_lib_upload_queue_pending(queue), 1);
+
+  pumpnet_lib_upload_queue_close(queue);
+
+  assert_true(journal_size() > 0);
+
+  memset(&ctx, 0, sizeof(ctx));
+
+  queue = pumpnet_lib_upload_queue_open(journal_path, &retry_policy, put, &ctx);
+  assert_non_null(queue);
+
+  assert_true(pumpnet_lib_upload_queue_flush(queue, FLUSH_TIMEOUT_MS));
+
+  assert_int_equal(ctx.calls, 1);
+  assert_int_equal(ctx.last_player_ref_id, PLAYER_REF_ID);
+  assert_memory_equal(ctx.last_data, "save", 4);
+  assert_int_equal(journal_size(), 0);
+
+  pumpnet_lib_upload_queue_close(queue);
+}
+
+static void test_replay_superseded(void **state)
+{
+  struct pumpnet_lib_upload_queue *queue;
+  struct put_ctx ctx;
+
+  queue = pumpnet_lib_upload_queue_open(
+      journal_path, &retry_policy, put_offline, NULL);
+  assert_non_null(queue);
+
+  assert_true(pumpnet_lib_upload_queue_push(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, "old!", 4));
+  assert_true(pumpnet_lib_upload_queue_push(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, "new!", 4));
+
+  pumpnet_lib_upload_queue_close(queue);
+
+  memset(&ctx, 0, sizeof(ctx));
+
+  queue = pumpnet_lib_upload_queue_open(journal_path, &retry_policy, put, &ctx);
+  assert_non_null(queue);
+
+  assert_true(pumpnet_lib_upload_queue_flush(queue, FLUSH_TIMEOUT_MS));
+
+  /* Only the latest version of the file is uploaded */
+  assert_int_equal(ctx.calls, 1);
+  assert_memory_equal(ctx.last_data, "new!", 4);
+
+  pumpnet_lib_upload_queue_close(queue);
+}
+
+static void test_replay_torn_record(void **state)
+{
+  struct pumpnet_lib_upload_queue *queue;
+  struct put_ctx ctx;
+  off_t size;
+  FILE *file;
+
+  queue = pumpnet_lib_upload_queue_open(
+      journal_path, &retry_policy, put_offline, NULL);
+  assert_non_null(queue);
+
+  assert_true(pumpnet_lib_upload_queue_push(
+      queue, PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, "save", 4));
+  assert_true(pumpnet_lib_upload_queue_push(
+      queue, PUMPNET_LIB_FILE_TYPE_RANK, PLAYER_REF_ID, "rank", 4));
+
+  pumpnet_lib_upload_queue_close(queue);
+
+  /* Power loss while writing the second record */
+  size = journal_size();
+  assert_int_equal(truncate(journal_path, size - 2), 0);
+
+  /* And garbage following it */
+  file = fopen(journal_path, "ab");
+  assert_non_null(file);
+  fwrite("garbage", 7, 1, file);
+  fclose(file);
+
+  memset(&ctx, 0, sizeof(ctx));
+
+  queue = pumpnet_lib_upload_queue_open(journal_path, &retry_policy, put, &ctx);
+  assert_non_null(queue);
+
+  assert_true(pumpnet_lib_upload_queue_flush(queue, FLUSH_TIMEOUT_MS));
+
+  assert_int_equal(ctx.calls, 1);
+  assert_int_equal(ctx.last_file_type, PUMPNET_LIB_FILE_TYPE_SAVE);
+  assert_memory_equal(ctx.last_data, "save", 4);
+
+  pumpnet_lib_upload_queue_close(queue);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup_teardown(test_push, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_retry, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_failed_dropped, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_get_pending, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_replay, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_replay_superseded, setup, teardown),
+      cmocka_unit_test_setup_teardown(
+          test_replay_torn_record, setup, teardown)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,234 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <cmocka/cmocka.h>
+
+#include "test-util/pumpnet.h"
+
+#include "pumpnet/lib/pumpnet.h"
+#include "pumpnet/mock/server.h"
+
+#include "util/mem.h"
+#include "util/time.h"
+
+#define SAVE_SIZE 1024
+#define RANK_SIZE 256
+
+#define PLAYER_REF_ID 0x1234
+
+static void test_put_get(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server_stats stats;
+  struct pumpnet_mock_server *server;
+  uint8_t save[SAVE_SIZE];
+  uint8_t buffer[SAVE_SIZE];
+
+  pumpnet_mock_server_config_init(&config);
+  server = test_util_pumpnet_init_mock(&config);
+
+  for (int i = 0; i < SAVE_SIZE; i++) {
+    save[i] = (uint8_t) i;
+  }
+
+  assert_true(pumpnet_lib_put(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, save, sizeof(save)));
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer)));
+  assert_memory_equal(buffer, save, SAVE_SIZE);
+
+  /* Not uploaded, 404 */
+  assert_false(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_RANK, PLAYER_REF_ID, buffer, sizeof(buffer)));
+
+  pumpnet_mock_server_get_stats(server, &stats);
+
+  assert_int_equal(stats.requests, 3);
+  assert_int_equal(stats.puts, 1);
+  assert_int_equal(stats.gets, 2);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_put_get_base64(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server *server;
+  uint8_t rank[RANK_SIZE];
+  uint8_t buffer[RANK_SIZE];
+
+  pumpnet_mock_server_config_init(&config);
+  config.transport = PUMPNET_LIB_HTTP_TRANSPORT_BASE64;
+
+  /* Binary request bodies rejected, resent as base64 */
+  pumpnet_lib_configure_transport(PUMPNET_LIB_HTTP_TRANSPORT_BINARY_DEFLATE);
+  server = test_util_pumpnet_init_mock(&config);
+
+  memset(rank, 0x42, sizeof(rank));
+
+  assert_true(pumpnet_lib_put(
+      PUMPNET_LIB_FILE_TYPE_RANK, PLAYER_REF_ID, rank, sizeof(rank)));
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_RANK, PLAYER_REF_ID, buffer, sizeof(buffer)));
+  assert_memory_equal(buffer, rank, RANK_SIZE);
+
+  test_util_pumpnet_shutdown_mock(server);
+
+  pumpnet_lib_configure_transport(PUMPNET_LIB_HTTP_TRANSPORT_BINARY);
+}
+
+static void test_preloaded(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server *server;
+  uint8_t save[SAVE_SIZE];
+  uint8_t buffer[SAVE_SIZE];
+
+  pumpnet_mock_server_config_init(&config);
+  server = test_util_pumpnet_init_mock(&config);
+
+  memset(save, 0x11, sizeof(save));
+
+  pumpnet_mock_server_put(
+      server,
+      "nx2",
+      PUMPNET_LIB_FILE_TYPE_SAVE,
+      PLAYER_REF_ID,
+      save,
+      sizeof(save));
+
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer)));
+  assert_memory_equal(buffer, save, SAVE_SIZE);
+
+  /* Other game */
+  pumpnet_mock_server_put(
+      server, "nxa", PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID + 1, save, 1);
+
+  assert_false(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID + 1, buffer, sizeof(buffer)));
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_generated_payload(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server *server;
+  uint8_t save[SAVE_SIZE];
+  uint8_t buffer[SAVE_SIZE];
+
+  pumpnet_mock_server_config_init(&config);
+  config.payload_size[PUMPNET_LIB_FILE_TYPE_SAVE] = SAVE_SIZE;
+  server = test_util_pumpnet_init_mock(&config);
+
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, save, sizeof(save)));
+
+  /* Generated once, stored */
+  assert_true(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer)));
+  assert_memory_equal(buffer, save, SAVE_SIZE);
+
+  /* Too large for the buffer */
+  assert_false(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID + 1, buffer, SAVE_SIZE / 2));
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_error_rate(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server_stats stats;
+  struct pumpnet_lib_stats lib_stats;
+  struct pumpnet_mock_server *server;
+  uint8_t buffer[SAVE_SIZE];
+
+  pumpnet_mock_server_config_init(&config);
+  config.error_rate_percent = 100;
+  server = test_util_pumpnet_init_mock(&config);
+
+  assert_false(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer)));
+
+  pumpnet_mock_server_get_stats(server, &stats);
+  pumpnet_lib_get_stats(&lib_stats);
+
+  assert_int_equal(stats.errors, test_util_pumpnet_retry_policy.max_attempts);
+  assert_int_equal(stats.gets, 0);
+  assert_int_equal(
+      lib_stats.attempts, test_util_pumpnet_retry_policy.max_attempts);
+  assert_int_equal(
+      lib_stats.retries, test_util_pumpnet_retry_policy.max_attempts - 1);
+  assert_int_equal(lib_stats.failed, 1);
+  assert_int_equal(lib_stats.rejected, 0);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_drop_rate(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server_stats stats;
+  struct pumpnet_lib_stats lib_stats;
+  struct pumpnet_mock_server *server;
+  uint8_t buffer[SAVE_SIZE];
+
+  pumpnet_mock_server_config_init(&config);
+  config.drop_rate_percent = 100;
+  server = test_util_pumpnet_init_mock(&config);
+
+  assert_false(pumpnet_lib_get(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, buffer, sizeof(buffer)));
+
+  pumpnet_mock_server_get_stats(server, &stats);
+  pumpnet_lib_get_stats(&lib_stats);
+
+  /* Fresh connection per attempt, not resent by curl */
+  assert_int_equal(stats.drops, test_util_pumpnet_retry_policy.max_attempts);
+  assert_int_equal(
+      lib_stats.attempts, test_util_pumpnet_retry_policy.max_attempts);
+  assert_int_equal(lib_stats.failed, 1);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+static void test_latency(void **state)
+{
+  struct pumpnet_mock_server_config config;
+  struct pumpnet_mock_server *server;
+  uint8_t save[SAVE_SIZE];
+  uint64_t start;
+
+  pumpnet_mock_server_config_init(&config);
+  config.latency_ms = 100;
+  config.latency_jitter_ms = 50;
+  server = test_util_pumpnet_init_mock(&config);
+
+  memset(save, 0x11, sizeof(save));
+
+  start = util_time_get_monotonic_ns() / 1000 / 1000;
+
+  assert_true(pumpnet_lib_put(
+      PUMPNET_LIB_FILE_TYPE_SAVE, PLAYER_REF_ID, save, sizeof(save)));
+
+  assert_true(util_time_get_monotonic_ns() / 1000 / 1000 - start >= 100);
+
+  test_util_pumpnet_shutdown_mock(server);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_put_get),
+      cmocka_unit_test(test_put_get_base64),
+      cmocka_unit_test(test_preloaded),
+      cmocka_unit_test(test_generated_payload),
+      cmocka_unit_test(test_error_rate),
+      cmocka_unit_test(test_drop_rate),
+      cmocka_unit_test(test_latency)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,57 @@
+#define LOG_MODULE "test-util-pumpnet"
+
+#include <stdio.h>
+
+#include "test-util/pumpnet.h"
+
+#include "pumpnet/lib/pumpnet.h"
+
+#include "util/log.h"
+
+const struct pumpnet_lib_retry_policy test_util_pumpnet_retry_policy = {
+    .max_attempts = 3,
+    .base_delay_ms = 10,
+    .max_delay_ms = 20,
+    .deadline_ms = 5000,
+};
+
+const struct pumpnet_lib_circuit_breaker_config
+    test_util_pumpnet_breaker_lenient = {
+        .window_size = 64,
+        .min_requests = 64,
+        .failure_threshold_percent = 100,
+        .open_time_ms = 1000,
+};
+
+void test_util_pumpnet_init_lib(uint16_t port)
+{
+  char addr[64];
+
+  sprintf(addr, "http://127.0.0.1:%d", port);
+
+  pumpnet_lib_init(ASSET_GAME_VERSION_NX2, addr, 0, NULL, false);
+}
+
+struct pumpnet_mock_server *
+test_util_pumpnet_init_mock(const struct pumpnet_mock_server_config *config)
+{
+  struct pumpnet_mock_server *server;
+
+  server = pumpnet_mock_server_start(config);
+
+  if (!server) {
+    log_die("Starting mock server failed");
+  }
+
+  pumpnet_lib_configure_retry(
+      &test_util_pumpnet_retry_policy, &test_util_pumpnet_breaker_lenient);
+  test_util_pumpnet_init_lib(pumpnet_mock_server_get_port(server));
+
+  return server;
+}
+
+void test_util_pumpnet_shutdown_mock(struct pumpnet_mock_server *server)
+{
+  pumpnet_lib_shutdown();
+  pumpnet_mock_server_stop(server);
+}
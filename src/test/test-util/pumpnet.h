@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "pumpnet/lib/retry.h"
+#include "pumpnet/mock/server.h"
+
+/**
+ * Retry policy with short delays to keep tests with injected faults fast.
+ */
+extern const struct pumpnet_lib_retry_policy test_util_pumpnet_retry_policy;
+
+/**
+ * Circuit breaker config which does not trip on the faults injected by tests.
+ */
+extern const struct pumpnet_lib_circuit_breaker_config
+    test_util_pumpnet_breaker_lenient;
+
+/**
+ * Initialize the pumpnet lib for nx2 with a server on the loopback interface.
+ * Retry and transport configuration is up to the caller.
+ *
+ * @param port Port of the server
+ */
+void test_util_pumpnet_init_lib(uint16_t port);
+
+/**
+ * Start a mock server and initialize the pumpnet lib with it, using the retry
+ * policy and lenient circuit breaker above.
+ *
+ * @param config Config of the mock server
+ * @return Mock server started
+ */
+struct pumpnet_mock_server *
+test_util_pumpnet_init_mock(const struct pumpnet_mock_server_config *config);
+
+/**
+ * Shut down the pumpnet lib and stop the mock server.
+ */
+void test_util_pumpnet_shutdown_mock(struct pumpnet_mock_server *server);
@@ -0,0 +1,178 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka/cmocka.h>
+
+#include "util/adler32.h"
+#include "util/time.h"
+
+/* Sizes of the usb save (nx2) and rank (nxa) files */
+#define SAVE_SIZE 30780
+#define RANK_SIZE 24648
+
+#define BENCH_ITERATIONS 2000
+
+static const enum util_adler32_impl impls[] = {
+    UTIL_ADLER32_IMPL_SCALAR,
+    UTIL_ADLER32_IMPL_SSE2,
+    UTIL_ADLER32_IMPL_AVX2,
+};
+
+static const char *impl_names[] = {
+    "scalar",
+    "sse2",
+    "avx2",
+};
+
+static uint8_t buffer[SAVE_SIZE + 64];
+
+static uint32_t reference(uint32_t initval, const uint8_t *input, size_t length)
+{
+  uint32_t s1 = initval & 0xffff;
+  uint32_t s2 = (initval >> 16) & 0xffff;
+
+  for (size_t n = 0; n < length; n++) {
+    s1 = (s1 + input[n]) % 65521;
+    s2 = (s2 + s1) % 65521;
+  }
+
+  return (s2 << 16) + s1;
+}
+
+static void fill_random(uint8_t *buf, size_t length, uint32_t seed)
+{
+  for (size_t i = 0; i < length; i++) {
+    seed = seed * 1103515245 + 12345;
+    buf[i] = (uint8_t) (seed >> 16);
+  }
+}
+
+static void assert_all_impls(uint32_t initval, const uint8_t *buf, size_t len)
+{
+  uint32_t expected;
+
+  expected = reference(initval, buf, len);
+
+  assert_int_equal(util_adler32_calc(initval, buf, len), expected);
+
+  for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+    if (util_adler32_impl_supported(impls[i])) {
+      assert_int_equal(
+          util_adler32_calc_impl(impls[i], initval, buf, len), expected);
+    }
+  }
+}
+
+static void test_adler32_known(void **state)
+{
+  const char *str = "Wikipedia";
+
+  assert_int_equal(
+      util_adler32_calc(1, (const uint8_t *) str, strlen(str)), 0x11E60398);
+}
+
+static void test_adler32_empty(void **state)
+{
+  assert_all_impls(1, buffer, 0);
+  assert_all_impls(0xABCD1234 % 65521, buffer, 0);
+}
+
+static void test_adler32_lengths(void **state)
+{
+  fill_random(buffer, sizeof(buffer), 1);
+
+  for (size_t len = 0; len < 1100; len++) {
+    assert_all_impls(1, buffer, len);
+  }
+}
+
+static void test_adler32_unaligned(void **state)
+{
+  fill_random(buffer, sizeof(buffer), 2);
+
+  for (size_t offset = 0; offset < 64; offset++) {
+    assert_all_impls(1, buffer + offset, 4096 + offset);
+  }
+}
+
+static void test_adler32_initval(void **state)
+{
+  fill_random(buffer, sizeof(buffer), 3);
+
+  assert_all_impls(0, buffer, 5000);
+  assert_all_impls((65520 << 16) | 65520, buffer, 5000);
+  assert_all_impls(0x12345678, buffer, 5000);
+}
+
+static void test_adler32_max_bytes(void **state)
+{
+  /* Worst case for the deferred modulo */
+  memset(buffer, 0xFF, sizeof(buffer));
+
+  assert_all_impls((65520 << 16) | 65520, buffer, SAVE_SIZE);
+  assert_all_impls((65520 << 16) | 65520, buffer, RANK_SIZE);
+}
+
+static void test_adler32_save_rank_size(void **state)
+{
+  fill_random(buffer, sizeof(buffer), 4);
+
+  assert_all_impls(1, buffer, SAVE_SIZE);
+  assert_all_impls(1, buffer, RANK_SIZE);
+}
+
+static void bench(size_t length)
+{
+  volatile uint32_t res;
+  uint64_t start_ns;
+  uint64_t elapsed_ns;
+
+  for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+    if (!util_adler32_impl_supported(impls[i])) {
+      print_message("%6s %5zu bytes: not supported\n", impl_names[i], length);
+      continue;
+    }
+
+    start_ns = util_time_get_monotonic_ns();
+
+    for (int j = 0; j < BENCH_ITERATIONS; j++) {
+      res = util_adler32_calc_impl(impls[i], 1, buffer, length);
+    }
+
+    /* Avoid division by zero on coarse clocks */
+    elapsed_ns = util_time_get_monotonic_ns() - start_ns + 1;
+
+    (void) res;
+
+    print_message(
+        "%6s %5zu bytes: %llu ns/call, %llu MB/s\n",
+        impl_names[i],
+        length,
+        (unsigned long long) (elapsed_ns / BENCH_ITERATIONS),
+        (unsigned long long) (length * BENCH_ITERATIONS * 1000ULL /
+                              elapsed_ns));
+  }
+}
+
+static void test_adler32_bench(void **state)
+{
+  fill_random(buffer, sizeof(buffer), 5);
+
+  bench(SAVE_SIZE);
+  bench(RANK_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_adler32_known),
+      cmocka_unit_test(test_adler32_empty),
+      cmocka_unit_test(test_adler32_lengths),
+      cmocka_unit_test(test_adler32_unaligned),
+      cmocka_unit_test(test_adler32_initval),
+      cmocka_unit_test(test_adler32_max_bytes),
+      cmocka_unit_test(test_adler32_save_rank_size),
+      cmocka_unit_test(test_adler32_bench)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,326 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmocka/cmocka.h>
+
+#include "util/batch.h"
+#include "util/str.h"
+#include "util/time.h"
+
+#define ITEMS 1000
+#define THREADS 4
+#define QUEUE_SIZE 2
+
+struct gate {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  bool open;
+  atomic_size_t pushed;
+  struct util_batch *batch;
+  size_t items;
+};
+
+static atomic_size_t processed;
+static atomic_size_t sum;
+
+static char *proc_count(const char *item, void *ctx)
+{
+  atomic_fetch_add(&processed, 1);
+  atomic_fetch_add(&sum, strtoul(item, NULL, 10));
+
+  return NULL;
+}
+
+/* Odd items fail, the message is the item itself */
+static char *proc_fail_odd(const char *item, void *ctx)
+{
+  if (strtoul(item, NULL, 10) % 2) {
+    return util_str_dup(item);
+  }
+
+  return NULL;
+}
+
+/* Blocks all workers until the gate is opened */
+static char *proc_gate(const char *item, void *ctx)
+{
+  struct gate *gate;
+
+  gate = (struct gate *) ctx;
+
+  pthread_mutex_lock(&gate->mutex);
+
+  while (!gate->open) {
+    pthread_cond_wait(&gate->cond, &gate->mutex);
+  }
+
+  pthread_mutex_unlock(&gate->mutex);
+
+  atomic_fetch_add(&processed, 1);
+
+  return NULL;
+}
+
+static char *proc_collect(const char *item, void *ctx)
+{
+  /* Reported as error to get the items back with the result */
+  return util_str_dup("collected");
+}
+
+static void *push_proc(void *arg)
+{
+  struct gate *gate;
+  char item[32];
+
+  gate = (struct gate *) arg;
+
+  for (size_t i = 0; i < gate->items; i++) {
+    sprintf(item, "%zu", i);
+    util_batch_push(gate->batch, item);
+    atomic_fetch_add(&gate->pushed, 1);
+  }
+
+  return NULL;
+}
+
+static bool
+has_error_item(const struct util_batch_result *result, const char *item)
+{
+  const struct util_batch_error *error;
+
+  for (size_t i = 0; i < result->errors.nitems; i++) {
+    error = util_array_item(struct util_batch_error, &result->errors, i);
+
+    if (!strcmp(error->item, item)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static int setup(void **state)
+{
+  atomic_store(&processed, 0);
+  atomic_store(&sum, 0);
+
+  return 0;
+}
+
+static void test_batch_all_processed(void **state)
+{
+  struct util_batch *batch;
+  struct util_batch_result result;
+  char item[32];
+
+  batch = util_batch_start(THREADS, QUEUE_SIZE, proc_count, NULL);
+
+  for (size_t i = 0; i < ITEMS; i++) {
+    sprintf(item, "%zu", i);
+    util_batch_push(batch, item);
+  }
+
+  util_batch_finish(batch, &result);
+
+  assert_int_equal(result.processed, ITEMS);
+  assert_int_equal(result.failed, 0);
+  assert_int_equal(result.errors.nitems, 0);
+  assert_int_equal(atomic_load(&processed), ITEMS);
+  assert_int_equal(atomic_load(&sum), ITEMS * (ITEMS - 1) / 2);
+
+  util_batch_result_fini(&result);
+}
+
+static void test_batch_no_items(void **state)
+{
+  struct util_batch *batch;
+  struct util_batch_result result;
+
+  /* Number of online processors */
+  batch = util_batch_start(0, QUEUE_SIZE, proc_count, NULL);
+
+  util_batch_finish(batch, &result);
+
+  assert_int_equal(result.processed, 0);
+  assert_int_equal(result.failed, 0);
+  assert_int_equal(atomic_load(&processed), 0);
+
+  util_batch_result_fini(&result);
+}
+
+static void test_batch_errors(void **state)
+{
+  struct util_batch *batch;
+  struct util_batch_result result;
+  const struct util_batch_error *error;
+  char item[32];
+
+  batch = util_batch_start(THREADS, QUEUE_SIZE, proc_fail_odd, NULL);
+
+  for (size_t i = 0; i < 100; i++) {
+    sprintf(item, "%zu", i);
+    util_batch_push(batch, item);
+  }
+
+  util_batch_finish(batch, &result);
+
+  assert_int_equal(result.processed, 100);
+  assert_int_equal(result.failed, 50);
+  assert_int_equal(result.errors.nitems, 50);
+
+  for (size_t i = 0; i < result.errors.nitems; i++) {
+    error = util_array_item(struct util_batch_error, &result.errors, i);
+
+    assert_int_equal(strtoul(error->item, NULL, 10) % 2, 1);
+    assert_string_equal(error->msg, error->item);
+  }
+
+  util_batch_result_fini(&result);
+}
+
+static void test_batch_push_blocks_if_full(void **state)
+{
+  struct gate gate;
+  struct util_batch_result result;
+  pthread_t thread;
+
+  pthread_mutex_init(&gate.mutex, NULL);
+  pthread_cond_init(&gate.cond, NULL);
+  gate.open = false;
+  atomic_store(&gate.pushed, 0);
+  gate.items = 1 + QUEUE_SIZE + 2;
+  gate.batch = util_batch_start(1, QUEUE_SIZE, proc_gate, &gate);
+
+  assert_int_equal(pthread_create(&thread, NULL, push_proc, &gate), 0);
+
+  util_time_sleep_ms(200);
+
+  /* One item taken by the blocked worker, the queue full, the next push
+     blocks */
+  assert_int_equal(atomic_load(&gate.pushed), 1 + QUEUE_SIZE);
+  assert_int_equal(atomic_load(&processed), 0);
+
+  pthread_mutex_lock(&gate.mutex);
+  gate.open = true;
+  pthread_cond_broadcast(&gate.cond);
+  pthread_mutex_unlock(&gate.mutex);
+
+  pthread_join(thread, NULL);
+
+  assert_int_equal(atomic_load(&gate.pushed), gate.items);
+
+  util_batch_finish(gate.batch, &result);
+
+  assert_int_equal(result.processed, gate.items);
+  assert_int_equal(atomic_load(&processed), gate.items);
+
+  util_batch_result_fini(&result);
+
+  pthread_cond_destroy(&gate.cond);
+  pthread_mutex_destroy(&gate.mutex);
+}
+
+static void test_batch_push_path_list(void **state)
+{
+  struct util_batch *batch;
+  struct util_batch_result result;
+  char path[] = "/tmp/test-util-batch-list-XXXXXX";
+  const char *list = "a/\r\nb/\n\nc/\n";
+  int fd;
+
+  fd = mkstemp(path);
+  assert_true(fd != -1);
+  assert_int_equal(write(fd, list, strlen(list)), strlen(list));
+  close(fd);
+
+  batch = util_batch_start(THREADS, QUEUE_SIZE, proc_collect, NULL);
+
+  assert_true(util_batch_push_path(batch, path));
+
+  util_batch_finish(batch, &result);
+
+  /* Empty lines skipped */
+  assert_int_equal(result.processed, 3);
+  assert_true(has_error_item(&result, "a/"));
+  assert_true(has_error_item(&result, "b/"));
+  assert_true(has_error_item(&result, "c/"));
+
+  util_batch_result_fini(&result);
+
+  unlink(path);
+}
+
+static void test_batch_push_path_dir(void **state)
+{
+  struct util_batch *batch;
+  struct util_batch_result result;
+  char dir_path[] = "/tmp/test-util-batch-dir-XXXXXX";
+  const char *names[] = {"1001", "1002", ".hidden"};
+  char path[64];
+  char item[64];
+
+  assert_non_null(mkdtemp(dir_path));
+
+  for (size_t i = 0; i < 3; i++) {
+    sprintf(path, "%s/%s", dir_path, names[i]);
+    assert_int_equal(mkdir(path, 0755), 0);
+  }
+
+  batch = util_batch_start(THREADS, QUEUE_SIZE, proc_collect, NULL);
+
+  assert_true(util_batch_push_path(batch, dir_path));
+
+  util_batch_finish(batch, &result);
+
+  /* Hidden entries skipped, entries pushed as path prefix */
+  assert_int_equal(result.processed, 2);
+
+  for (size_t i = 0; i < 2; i++) {
+    sprintf(item, "%s/%s/", dir_path, names[i]);
+    assert_true(has_error_item(&result, item));
+  }
+
+  util_batch_result_fini(&result);
+
+  for (size_t i = 0; i < 3; i++) {
+    sprintf(path, "%s/%s", dir_path, names[i]);
+    rmdir(path);
+  }
+
+  rmdir(dir_path);
+}
+
+static void test_batch_push_path_missing(void **state)
+{
+  struct util_batch *batch;
+  struct util_batch_result result;
+
+  batch = util_batch_start(THREADS, QUEUE_SIZE, proc_count, NULL);
+
+  assert_false(util_batch_push_path(batch, "/tmp/test-util-batch-missing"));
+
+  util_batch_finish(batch, &result);
+
+  assert_int_equal(result.processed, 0);
+
+  util_batch_result_fini(&result);
+}
+
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup(test_batch_all_processed, setup),
+      cmocka_unit_test_setup(test_batch_no_items, setup),
+      cmocka_unit_test_setup(test_batch_errors, setup),
+      cmocka_unit_test_setup(test_batch_push_blocks_if_full, setup),
+      cmocka_unit_test_setup(test_batch_push_path_list, setup),
+      cmocka_unit_test_setup(test_batch_push_path_dir, setup),
+      cmocka_unit_test_setup(test_batch_push_path_missing, setup)};
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -1,3 +1,5 @@
+#include <stdio.h>
+
 #include <cmocka/cmocka.h>
 
 #include "test-util/mem.h"
@@ -86,6 +88,103 @@ static void test_str_split3(void **state)
   util_str_free_split(toks, count);
 }
 
+static void test_strbuf_append(void **state)
+{
+  struct util_strbuf buf;
+
+  util_strbuf_init(&buf, 4);
+
+  util_strbuf_append(&buf, "asd");
+  util_strbuf_append(&buf, "123");
+  util_strbuf_append(&buf, "");
+
+  assert_string_equal(buf.str, "asd123");
+  assert_int_equal(buf.len, 6);
+  assert_true(buf.size > buf.len);
+
+  util_strbuf_fini(&buf);
+}
+
+static void test_strbuf_append_format(void **state)
+{
+  struct util_strbuf buf;
+  char expected[4096];
+  size_t len;
+
+  util_strbuf_init(&buf, 8);
+
+  len = 0;
+
+  for (int i = 0; i < 256; i++) {
+    util_strbuf_append_format(&buf, "%d: %X\n", i, i);
+    len += sprintf(expected + len, "%d: %X\n", i, i);
+  }
+
+  assert_string_equal(buf.str, expected);
+  assert_int_equal(buf.len, len);
+
+  util_strbuf_fini(&buf);
+}
+
+static void test_strbuf_append_buffer(void **state)
+{
+  struct util_strbuf buf;
+  const uint8_t data[] = {0x00, 0x0A, 0xFF};
+
+  util_strbuf_init(&buf, 0);
+
+  util_strbuf_append(&buf, "data: ");
+  util_strbuf_append_buffer(&buf, data, sizeof(data));
+
+  assert_string_equal(buf.str, "data: 00 0A FF ");
+
+  util_strbuf_fini(&buf);
+}
+
+static void test_strbuf_clear(void **state)
+{
+  struct util_strbuf buf;
+
+  util_strbuf_init(&buf, 0);
+
+  util_strbuf_append(&buf, "asd");
+  util_strbuf_clear(&buf);
+
+  assert_string_equal(buf.str, "");
+  assert_int_equal(buf.len, 0);
+
+  util_strbuf_append(&buf, "123");
+
+  assert_string_equal(buf.str, "123");
+
+  util_strbuf_fini(&buf);
+}
+
+static void test_strbuf_detach(void **state)
+{
+  struct util_strbuf buf;
+  char *str;
+
+  util_strbuf_init(&buf, 0);
+
+  util_strbuf_append(&buf, "asd");
+  str = util_strbuf_detach(&buf);
+
+  assert_string_equal(str, "asd");
+  assert_null(buf.str);
+  assert_int_equal(buf.len, 0);
+
+  util_xfree((void **) &str);
+
+  /* Detaching an empty buffer returns an empty string */
+  str = util_strbuf_detach(&buf);
+
+  assert_string_equal(str, "");
+
+  util_xfree((void **) &str);
+  util_strbuf_fini(&buf);
+}
+
 int main(int argc, char *argv[])
 {
   const struct CMUnitTest tests[] = {
@@ -94,7 +193,12 @@ int main(int argc, char *argv[])
       cmocka_unit_test_setup(test_str_split0, setup),
       cmocka_unit_test_setup(test_str_split1, setup),
       cmocka_unit_test_setup(test_str_split2, setup),
-      cmocka_unit_test_setup(test_str_split3, setup)};
+      cmocka_unit_test_setup(test_str_split3, setup),
+      cmocka_unit_test_setup(test_strbuf_append, setup),
+      cmocka_unit_test_setup(test_strbuf_append_format, setup),
+      cmocka_unit_test_setup(test_strbuf_append_buffer, setup),
+      cmocka_unit_test_setup(test_strbuf_clear, setup),
+      cmocka_unit_test_setup(test_strbuf_detach, setup)};
 
   return cmocka_run_group_tests(tests, NULL, NULL);
 }
\ No newline at end of file